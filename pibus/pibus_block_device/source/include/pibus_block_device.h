@@ -9,16 +9,18 @@
 // This component can perform data transfers between one single file belonging 
 // to the host system and a buffer in the memory of the virtual system. 
 // The file name is an argument of the constructor, 
-// as well as the block size (bytes), and the access latency (cycles). 
+// as well as the block size (bytes), the access latency (cycles),
+// and the PIBUS burst length (words). 
 // This component has a DMA capability, and is both a target and an initiator.
 // Both read and write transfers are supported. An IRQ is optionally
 // asserted when the transfer is completed. 
 //
 // As a target this block device controler contains 8 memory mapped registers,
-// taking 32 bytes in the address space.
+// taking 32 bytes in the address space, and 6 optional command queue registers
+// (see below), if the segment size is at least 64 bytes.
 // - BLOCK_DEVICE_BUFFER        0x00 (read/write)    Memory buffer base address.
-// - BLOCK_DEVICE_COUNT         0x04 (read/write)    Number of blocks to be transfered.
-// - BLOCK_DEVICE_LBA           0x08 (read/write)    Index of first block in the file.
+// - BLOCK_DEVICE_LBA           0x04 (read/write)    Index of first block in the file.
+// - BLOCK_DEVICE_COUNT         0x08 (read/write)    Number of blocks to be transfered.
 // - BLOCK_DEVICE_OP            0x0C (write-only)    Writing here starts the operation.
 // - BLOCK_DEVICE_STATUS        0x10 (read-only)     Block Device status.
 // - BLOCK_DEVICE_IRQ_ENABLE    0x14 (read/write)    IRQ enabled if non zero.
@@ -45,14 +47,74 @@
 // the master FSM state to IDLE, and acknowledge the IRQ.
 // Any write access to registers BUFFER, COUNT, LBA, OP is ignored
 // if the device is not IDLE.
+// When a target answers PIBUS_ACK_RETRY (split transaction), the
+// bus is released, and the block transfer burst is retried.
+// A transfer exceeding the device size (LBA + COUNT > SIZE) is not
+// started, and completes with a READ_ERROR or WRITE_ERROR status,
+// as a transfer of 4 Gbytes or more. A transfer of 0 block completes
+// at once with a READ_SUCCESS or WRITE_SUCCESS status.
+//
+// The transfer (COUNT * block size bytes) is split in PIBUS bursts,
+// whose length is defined by the burst constructor parameter, 
+// independently of the block size : a burst can be a part of a block,
+// or cover several blocks. The default burst length is one block
+// (limited to 1024 words). The access latency is applied before each burst.
+//
+// Host I/O : the file is mapped in the simulator address space (mmap),
+// and the kernel is asked to read ahead the whole transfer when it
+// starts (madvise), so the bursts are copied from / to the mapping
+// without system call. If the file cannot be mapped, each burst is
+// transfered with one pread() / pwrite() system call.
+//
+// Command queue : the software can queue up to 32 commands in a ring
+// of command descriptors in memory, without waiting the completion of 
+// the previous commands. Each descriptor contains 4 words (16 bytes) :
+// - word 0 : memory buffer base address
+// - word 1 : index of first block in the file
+// - word 2 : number of blocks
+// - word 3 : operation (READ / WRITE), replaced by the command status
+//            (READ_SUCCESS / WRITE_SUCCESS / READ_ERROR / WRITE_ERROR,
+//            or IDLE for any other operation) when the command is completed.
+// The command queue is controled by 6 memory mapped registers :
+// - BLOCK_DEVICE_QUEUE_BASE    0x20 (read/write)    Ring base address (16 bytes aligned).
+// - BLOCK_DEVICE_QUEUE_SIZE    0x24 (read/write)    Ring size (0 (disabled), 1, 2, 4.. 32).
+// - BLOCK_DEVICE_QUEUE_HEAD    0x28 (read-only)     Number of completed commands.
+// - BLOCK_DEVICE_QUEUE_TAIL    0x2C (read/write)    Number of submitted commands.
+// - BLOCK_DEVICE_QUEUE_DONE    0x30 (read/write)    Completed commands not acknowledged.
+// - BLOCK_DEVICE_QUEUE_COALESCE 0x34 (read/write)   IRQ coalescing threshold.
+// HEAD and TAIL are free running counters : the descriptor of command (n)
+// is the entry (n % QUEUE_SIZE) of the ring, and the queue contains 
+// (TAIL - HEAD) commands, that cannot be larger than QUEUE_SIZE. 
+// The software submits commands by writing the descriptors, and then the 
+// new TAIL value. The device fetches the descriptors (4 words burst), 
+// executes the commands in order, and writes the status in the descriptor.
+// The QUEUE_BASE and QUEUE_SIZE registers can only be written when the
+// queue is empty (HEAD == TAIL).
+// Completions are coalesced : the IRQ is asserted (if enabled) when the
+// number of completed commands not acknowledged (DONE) reaches the
+// COALESCE threshold, or when the queue is empty and DONE is not zero.
+// Writing a value (n) in register QUEUE_DONE acknowledges (n) completions. 
+// A command written in the BUFFER, LBA, COUNT and OP registers has 
+// priority on the queued commands, and is accepted when the device is IDLE.
+//
+// The following 64 bits counters can be registered in a PibusCounterRegistry
+// (registerCounters() method) : completed transfers, transfers completed with
+// error (counted when acknowledged), read blocks, written blocks, RETRY responses,
+// busy cycles (transfer in progress), and completed queued commands.
+// This component implements the PibusCheckpointable interface, and can
+// be checkpointed when the target FSM is IDLE and the master FSM is not
+// in a bus transaction. The file content is not saved : the file must
+// not be modified between the checkpoint and the restore (the file can
+// be copied with the checkpoint if the software writes in the file).
 ///////////////////////////////////////////////////////////////////////////
-// This component has 6 "constructor" parameters :
+// This component has 7 "constructor" parameters :
 // - sc_module_name 	name	    : instance name
 // - unsigned int	tgtid	    : target index
 // - PibusSegmentTable 	segtab	    : segment table
 // - string             file_name   : file name on the host processor
-// - unsigned int	block_size  : number of bytes (128/256/512/1024)
-// - unsigned int	latency	    : access latency
+// - unsigned int	block_size  : number of bytes (power of 2, 128 to 1M)
+// - unsigned int	latency	    : access latency (cycles per burst)
+// - unsigned int	burst	    : burst length (words, 0 for one block)
 ////////////////////////////////////////////////////////////////////////////
 
 #ifndef SOCLIB_VCI_BLOCK_DEVICE_H
@@ -61,10 +123,12 @@
 #include <systemc.h>
 #include "pibus_mnemonics.h"
 #include "pibus_segment_table.h"
+#include "pibus_counter_registry.h"
+#include "pibus_checkpoint.h"
 
 namespace soclib { namespace caba {
 
-class PibusBlockDevice : sc_module {
+class PibusBlockDevice : sc_module, public PibusCheckpointable {
 
     // REGISTERS
     sc_register<int>      	r_target_fsm;	// target fsm state register
@@ -74,12 +138,31 @@ class PibusBlockDevice : sc_module {
     sc_register<uint32_t> 	r_buf_address;	// memory buffer address
     sc_register<uint32_t> 	r_lba;		// first block index
     sc_register<bool>       	r_read;         // requested operation
-    sc_register<uint32_t> 	r_word_count;	// byte counter (in a block)
-    sc_register<uint32_t> 	r_block_count;	// block counter (in a transfer)
+    sc_register<uint32_t> 	r_word_count;	// word counter (in a burst)
+    sc_register<uint32_t> 	r_offset;	// byte counter (in a transfer)
     sc_register<bool> 		r_go;         	// transmit command from T_FSM to M_FSM
     sc_register<uint32_t>	r_latency_count;// latency access (for each block)
    
-    uint32_t*			m_local_buffer;	// capacity is one block 
+    sc_register<uint32_t> 	r_queue_base;	// command ring base address
+    sc_register<uint32_t> 	r_queue_size;	// command ring size (0 : disabled)
+    sc_register<uint32_t> 	r_queue_head;	// completed commands counter
+    sc_register<uint32_t> 	r_queue_tail;	// submitted commands counter
+    sc_register<uint32_t> 	r_queue_acked;	// acknowledged completions counter
+    sc_register<uint32_t> 	r_queue_coalesce;// IRQ coalescing threshold
+    sc_register<bool>       	r_queued;       // current command from the ring
+    sc_register<uint32_t> 	r_cpl_status;	// current command status
+   
+    uint32_t*			m_local_buffer;	// capacity is one burst
+    uint32_t			m_entry[4];	// fetched command descriptor
+
+    // INSTRUMENTATION
+    uint64_t			c_transfer_count;	// completed transfers
+    uint64_t			c_error_count;		// transfers completed with error
+    uint64_t			c_read_blocks;		// blocks read from the file
+    uint64_t			c_write_blocks;		// blocks written to the file
+    uint64_t			c_retry_count;		// RETRY responses
+    uint64_t			c_busy_cycles;		// transfer in progress
+    uint64_t			c_queue_commands;	// completed queued commands
 
     // STRUCTURAL PARAMETERS
     const char*		        m_name;		// instance name
@@ -91,9 +174,12 @@ class PibusBlockDevice : sc_module {
     int                        	m_fd;           // File descriptor
     uint64_t                   	m_device_size;  // Total number of blocks
     const uint32_t	        m_block_size;   // number of bytes in a block
+    uint32_t		        m_burst;        // max number of words in a burst
+    uint8_t*		        m_mmap;         // file mapping (NULL if not mapped)
+    size_t		        m_mmap_size;    // mapping size (bytes)
 
-    char	                m_master_str[17][20];	// master FSM states names
-    char	                m_target_str[14][20];	// target FSM states names
+    char	                m_master_str[25][20];	// master FSM states names
+    char	                m_target_str[25][20];	// target FSM states names
 
     //  MASTER_FSM STATES
     enum {
@@ -114,6 +200,14 @@ class PibusBlockDevice : sc_module {
     M_WRITE_ERROR	= 14,
     M_READ_TEST		= 15,
     M_WRITE_TEST 	= 16,
+    M_QUEUE_REQ		= 17,
+    M_QUEUE_AD		= 18,
+    M_QUEUE_DTAD	= 19,
+    M_QUEUE_DT		= 20,
+    M_QUEUE_CMD		= 21,
+    M_CPL_REQ		= 22,
+    M_CPL_AD		= 23,
+    M_CPL_DT		= 24,
     };
 
     // TARGET FSM STATES
@@ -132,6 +226,17 @@ class PibusBlockDevice : sc_module {
     T_READ_SIZE 	= 11,
     T_READ_BLOCK 	= 12,
     T_ERROR		= 13,
+    T_WRITE_QBASE	= 14,
+    T_READ_QBASE	= 15,
+    T_WRITE_QSIZE	= 16,
+    T_READ_QSIZE	= 17,
+    T_READ_QHEAD	= 18,
+    T_WRITE_QTAIL	= 19,
+    T_READ_QTAIL	= 20,
+    T_WRITE_QDONE	= 21,
+    T_READ_QDONE	= 22,
+    T_WRITE_QCOAL	= 23,
+    T_READ_QCOAL	= 24,
     };
 
     // Addressable registers map
@@ -144,6 +249,12 @@ class PibusBlockDevice : sc_module {
     BLOCK_DEVICE_IRQEN	= 5,
     BLOCK_DEVICE_SIZE	= 6,
     BLOCK_DEVICE_BLOCK	= 7,
+    BLOCK_DEVICE_QBASE	= 8,
+    BLOCK_DEVICE_QSIZE	= 9,
+    BLOCK_DEVICE_QHEAD	= 10,
+    BLOCK_DEVICE_QTAIL	= 11,
+    BLOCK_DEVICE_QDONE	= 12,
+    BLOCK_DEVICE_QCOAL	= 13,
     };
 
     // Status values
@@ -163,6 +274,13 @@ class PibusBlockDevice : sc_module {
     BLOCK_DEVICE_WRITE,
     };
 
+    uint32_t burstWords();
+    int  startTransfer(bool read, uint32_t lba, uint32_t nblocks);
+    uint32_t queueEntry();
+    bool queueIrq();
+    bool readDisk(uint64_t offset, uint32_t nbytes);
+    bool writeDisk(uint64_t offset, uint32_t nbytes);
+
 protected:
 
     SC_HAS_PROCESS(PibusBlockDevice);
@@ -188,6 +306,12 @@ public:
     void transition();
     void genMoore();
     void printTrace();
+    void registerCounters(PibusCounterRegistry &registry);
+
+    // CHECKPOINT
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
 
     // Constructor   
     PibusBlockDevice( sc_module_name                      name,
@@ -195,7 +319,10 @@ public:
 		      soclib::common::PibusSegmentTable   &segtab,
                       char*                               filename,
                       uint32_t                            block_size = 512,
-                      uint32_t                            latency = 0);
+                      uint32_t                            latency = 0,
+                      uint32_t                            burst = 0);
+
+    ~PibusBlockDevice();
 
 }; // end class PibusBlockDevice
 
@@ -10,6 +10,9 @@
 #include <stdint.h>
 #include <iostream>
 #include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
 
 namespace soclib { namespace caba {
 
@@ -25,11 +28,26 @@ void PibusBlockDevice::transition()
 	    r_target_fsm = T_IDLE;
 	    r_irq_enable = true;
         r_go         = false;
+        r_queued     = false;
+        r_queue_base     = 0;
+        r_queue_size     = 0;
+        r_queue_head     = 0;
+        r_queue_tail     = 0;
+        r_queue_acked    = 0;
+        r_queue_coalesce = 1;
+        c_transfer_count = 0;
+        c_error_count    = 0;
+        c_read_blocks    = 0;
+        c_write_blocks   = 0;
+        c_retry_count    = 0;
+        c_busy_cycles    = 0;
+        c_queue_commands = 0;
 	return;
     } 
 
     // The Target FSM controls the following registers:
     // r_target_fsm, r_irq_enable, r_nblocks, r_buf adress, r_lba, r_go, r_read
+    // r_queue_base, r_queue_size, r_queue_tail, r_queue_acked, r_queue_coalesce
     switch(r_target_fsm) {
     case T_IDLE:
         if(p_sel.read() == true) 
@@ -37,18 +55,29 @@ void PibusBlockDevice::transition()
 	        uint32_t address = (uint32_t)p_a.read();
             bool     read    = p_read.read();
 	        if( (address < m_segbase) || (address >= m_segbase + m_segsize) ) 	    r_target_fsm = T_ERROR;
-            else if( !read && ((address & 0x1F) == (BLOCK_DEVICE_BUFFER<<2)) ) 		r_target_fsm = T_WRITE_BUFFER;
-            else if(  read && ((address & 0x1F) == (BLOCK_DEVICE_BUFFER<<2)) ) 		r_target_fsm = T_READ_BUFFER;
-            else if( !read && ((address & 0x1F) == (BLOCK_DEVICE_COUNT<<2)) ) 		r_target_fsm = T_WRITE_COUNT;
-            else if(  read && ((address & 0x1F) == (BLOCK_DEVICE_COUNT<<2)) ) 		r_target_fsm = T_READ_COUNT;
-            else if( !read && ((address & 0x1F) == (BLOCK_DEVICE_LBA<<2)) ) 		r_target_fsm = T_WRITE_LBA;
-            else if(  read && ((address & 0x1F) == (BLOCK_DEVICE_LBA<<2)) ) 		r_target_fsm = T_READ_LBA;
-            else if( !read && ((address & 0x1F) == (BLOCK_DEVICE_OP<<2)) ) 		    r_target_fsm = T_WRITE_OP;
-            else if(  read && ((address & 0x1F) == (BLOCK_DEVICE_STATUS<<2)) ) 		r_target_fsm = T_READ_STATUS;
-            else if( !read && ((address & 0x1F) == (BLOCK_DEVICE_IRQEN<<2)) ) 		r_target_fsm = T_WRITE_IRQEN;
-            else if(  read && ((address & 0x1F) == (BLOCK_DEVICE_IRQEN<<2)) ) 		r_target_fsm = T_READ_IRQEN;
-            else if(  read && ((address & 0x1F) == (BLOCK_DEVICE_SIZE<<2)) ) 		r_target_fsm = T_READ_SIZE;
-            else if(  read && ((address & 0x1F) == (BLOCK_DEVICE_BLOCK<<2)) ) 		r_target_fsm = T_READ_BLOCK;
+            else if( !read && ((address & 0x3F) == (BLOCK_DEVICE_BUFFER<<2)) ) 		r_target_fsm = T_WRITE_BUFFER;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_BUFFER<<2)) ) 		r_target_fsm = T_READ_BUFFER;
+            else if( !read && ((address & 0x3F) == (BLOCK_DEVICE_COUNT<<2)) ) 		r_target_fsm = T_WRITE_COUNT;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_COUNT<<2)) ) 		r_target_fsm = T_READ_COUNT;
+            else if( !read && ((address & 0x3F) == (BLOCK_DEVICE_LBA<<2)) ) 		r_target_fsm = T_WRITE_LBA;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_LBA<<2)) ) 		r_target_fsm = T_READ_LBA;
+            else if( !read && ((address & 0x3F) == (BLOCK_DEVICE_OP<<2)) ) 		    r_target_fsm = T_WRITE_OP;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_STATUS<<2)) ) 		r_target_fsm = T_READ_STATUS;
+            else if( !read && ((address & 0x3F) == (BLOCK_DEVICE_IRQEN<<2)) ) 		r_target_fsm = T_WRITE_IRQEN;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_IRQEN<<2)) ) 		r_target_fsm = T_READ_IRQEN;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_SIZE<<2)) ) 		r_target_fsm = T_READ_SIZE;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_BLOCK<<2)) ) 		r_target_fsm = T_READ_BLOCK;
+            else if( !read && ((address & 0x3F) == (BLOCK_DEVICE_QBASE<<2)) ) 		r_target_fsm = T_WRITE_QBASE;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_QBASE<<2)) ) 		r_target_fsm = T_READ_QBASE;
+            else if( !read && ((address & 0x3F) == (BLOCK_DEVICE_QSIZE<<2)) ) 		r_target_fsm = T_WRITE_QSIZE;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_QSIZE<<2)) ) 		r_target_fsm = T_READ_QSIZE;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_QHEAD<<2)) ) 		r_target_fsm = T_READ_QHEAD;
+            else if( !read && ((address & 0x3F) == (BLOCK_DEVICE_QTAIL<<2)) ) 		r_target_fsm = T_WRITE_QTAIL;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_QTAIL<<2)) ) 		r_target_fsm = T_READ_QTAIL;
+            else if( !read && ((address & 0x3F) == (BLOCK_DEVICE_QDONE<<2)) ) 		r_target_fsm = T_WRITE_QDONE;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_QDONE<<2)) ) 		r_target_fsm = T_READ_QDONE;
+            else if( !read && ((address & 0x3F) == (BLOCK_DEVICE_QCOAL<<2)) ) 		r_target_fsm = T_WRITE_QCOAL;
+            else if(  read && ((address & 0x3F) == (BLOCK_DEVICE_QCOAL<<2)) ) 		r_target_fsm = T_READ_QCOAL;
             else                                                        	        r_target_fsm = T_ERROR;
         }
         break;
@@ -84,6 +113,45 @@ void PibusBlockDevice::transition()
         r_irq_enable    = (p_d.read() != 0);
         r_target_fsm    = T_IDLE;
         break;
+    case T_WRITE_QBASE:
+        if( r_queue_head.read() == r_queue_tail.read() ) 
+        {
+            if( (p_d.read() & 0xF) != 0 )
+            {
+	            printf("ERROR in component PibusBlockDevice : %s\n", m_name);
+	            printf("The command queue base address must be multiple of 16 bytes\n");
+                exit(1);
+            }
+            r_queue_base = p_d.read();
+        }
+        r_target_fsm    = T_IDLE;
+        break;
+    case T_WRITE_QSIZE:
+        if( r_queue_head.read() == r_queue_tail.read() ) 
+        {
+            uint32_t size = p_d.read();
+            if( (size > 32) || ((size & (size - 1)) != 0) )
+            {
+	            printf("ERROR in component PibusBlockDevice : %s\n", m_name);
+	            printf("The command queue size must be 0, or a power of 2 no larger than 32\n");
+                exit(1);
+            }
+            r_queue_size = size;
+        }
+        r_target_fsm    = T_IDLE;
+        break;
+    case T_WRITE_QTAIL:
+        if( r_queue_size.read() != 0 ) r_queue_tail = p_d.read();
+        r_target_fsm    = T_IDLE;
+        break;
+    case T_WRITE_QDONE:
+        r_queue_acked   = r_queue_acked.read() + p_d.read();
+        r_target_fsm    = T_IDLE;
+        break;
+    case T_WRITE_QCOAL:
+        r_queue_coalesce = p_d.read();
+        r_target_fsm    = T_IDLE;
+        break;
 
     case T_READ_BUFFER:
     case T_READ_COUNT:
@@ -91,6 +159,12 @@ void PibusBlockDevice::transition()
     case T_READ_IRQEN:
     case T_READ_SIZE:
     case T_READ_BLOCK:
+    case T_READ_QBASE:
+    case T_READ_QSIZE:
+    case T_READ_QHEAD:
+    case T_READ_QTAIL:
+    case T_READ_QDONE:
+    case T_READ_QCOAL:
     case T_ERROR:
         r_target_fsm    = T_IDLE;
         break;
@@ -106,29 +180,114 @@ void PibusBlockDevice::transition()
     } // end switch target fsm
 	
     // The master FSM controls the following registers :
-    // r_master_fsm, r_word_count, r_block_count, m_local_buffer 
+    // r_master_fsm, r_word_count, r_offset, r_latency_count, m_local_buffer,
+    // r_queued, r_cpl_status, r_queue_head, and m_entry.
+    // For a queued command, it also loads r_buf_address, r_lba, r_nblocks
+    // and r_read from the descriptor (the target FSM only writes these
+    // registers when the master FSM is IDLE).
+    if( (r_master_fsm != M_IDLE) && 
+        (r_master_fsm != M_READ_SUCCESS) && (r_master_fsm != M_READ_ERROR) &&
+        (r_master_fsm != M_WRITE_SUCCESS) && (r_master_fsm != M_WRITE_ERROR) ) c_busy_cycles++;
+
     switch(r_master_fsm) {
     case M_IDLE :
-	if (r_read && r_go) 
+        if ( r_go )
         {
-            r_block_count = 0;
-            r_latency_count = m_latency;
-            r_master_fsm = M_READ_BLOCK;
+            r_master_fsm = startTransfer(r_read.read(), r_lba.read(), r_nblocks.read());
         }
-	if (!r_read && r_go) 
+        else if ( (r_queue_size.read() != 0) && 
+                  (r_queue_head.read() != r_queue_tail.read()) )
         {
-            r_block_count = 0;
-            r_latency_count = m_latency;
-            r_master_fsm = M_WRITE_REQ;
+            r_master_fsm = M_QUEUE_REQ;
+        }
+        break;
+    case M_QUEUE_REQ:	// fetch the command descriptor
+	    if(p_gnt.read() == true) 
+        {
+            r_master_fsm = M_QUEUE_AD;
+            r_word_count = 0;
+        }
+        break;
+    case M_QUEUE_AD:
+	    r_word_count  = r_word_count + 1;
+	    r_master_fsm = M_QUEUE_DTAD;
+        break;
+    case M_QUEUE_DTAD:
+    case M_QUEUE_DT:
+        if ( p_tout.read() or (p_ack.read() == PIBUS_ACK_ERROR) )	// descriptor lost
+        {
+            r_cpl_status = BLOCK_DEVICE_READ_ERROR;
+            r_queued     = true;
+            r_master_fsm = M_CPL_REQ;
+        }
+        else if ( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
+        {
+            r_master_fsm = M_QUEUE_REQ;
+            c_retry_count++;
+        }
+	    else if ( p_ack.read() == PIBUS_ACK_READY ) 
+        {
+            m_entry[r_word_count - 1] = p_d.read();
+            if ( r_master_fsm == M_QUEUE_DT ) 
+            {
+                r_word_count = 0;
+                r_master_fsm = M_QUEUE_CMD;
+            }
+            else
+            {
+	            r_word_count  = r_word_count + 1;
+	            if(r_word_count == 3) r_master_fsm = M_QUEUE_DT;
+            }
+	    }
+        break;
+    case M_QUEUE_CMD:	// start the queued command
+        r_queued      = true;
+        r_buf_address = m_entry[BLOCK_DEVICE_BUFFER];
+        r_lba         = m_entry[BLOCK_DEVICE_LBA];
+        r_nblocks     = m_entry[BLOCK_DEVICE_COUNT];
+        if ( (m_entry[BLOCK_DEVICE_OP] == BLOCK_DEVICE_READ) ||
+             (m_entry[BLOCK_DEVICE_OP] == BLOCK_DEVICE_WRITE) )
+        {
+            bool read    = (m_entry[BLOCK_DEVICE_OP] == BLOCK_DEVICE_READ);
+            r_read       = read;
+            r_master_fsm = startTransfer(read, m_entry[BLOCK_DEVICE_LBA], m_entry[BLOCK_DEVICE_COUNT]);
+        }
+        else
+        {
+            r_cpl_status = BLOCK_DEVICE_IDLE;
+            r_master_fsm = M_CPL_REQ;
         }
         break;
-    case M_READ_BLOCK:  // read one block after waiting m_latency cycles
+    case M_CPL_REQ:	// write the command status in the descriptor
+	    if(p_gnt.read() == true) r_master_fsm = M_CPL_AD;
+        break;
+    case M_CPL_AD:
+	    r_master_fsm = M_CPL_DT;
+        break;
+    case M_CPL_DT:
+        if ( p_ack.read() == PIBUS_ACK_RETRY )	// restart the transaction
+        {
+            r_master_fsm = M_CPL_REQ;
+            c_retry_count++;
+        }
+        else if ( p_tout.read() or (p_ack.read() != PIBUS_ACK_WAIT) ) 
+        {
+            if ( r_cpl_status.read() == BLOCK_DEVICE_READ_SUCCESS )       c_transfer_count++;
+            else if ( r_cpl_status.read() == BLOCK_DEVICE_WRITE_SUCCESS ) c_transfer_count++;
+            else if ( r_cpl_status.read() != BLOCK_DEVICE_IDLE )          c_error_count++;
+            c_queue_commands++;
+            r_queued     = false;
+            r_queue_head = r_queue_head.read() + 1;
+            r_master_fsm = M_IDLE;
+        }
+        break;
+    case M_READ_BLOCK:  // read one burst after waiting m_latency cycles
         if(r_latency_count == 0)
         {
             r_latency_count = m_latency;
-            ::lseek(m_fd, (r_lba + r_block_count)*m_block_size, SEEK_SET);
-            if( ::read(m_fd, m_local_buffer, m_block_size) < 0 )  r_master_fsm = M_READ_ERROR;
-            else                                                  r_master_fsm = M_READ_REQ;
+            uint64_t offset = (uint64_t)r_lba.read()*m_block_size + r_offset.read();
+            if( not readDisk(offset, burstWords()<<2) )  r_master_fsm = M_READ_ERROR;
+            else                                         r_master_fsm = M_READ_REQ;
         }
         else
         {
@@ -144,23 +303,34 @@ void PibusBlockDevice::transition()
         break;
     case M_READ_AD:
 	    r_word_count  = r_word_count + 1;
-		r_master_fsm = M_READ_DTAD;
+	    if( burstWords() == 1 ) r_master_fsm = M_READ_DT;
+	    else                    r_master_fsm = M_READ_DTAD;
         break;
     case M_READ_DTAD:
         if ( p_tout.read() or (p_ack.read() == PIBUS_ACK_ERROR) )
         {
             r_master_fsm = M_READ_ERROR;
+        }
+        else if ( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
+        {
+            r_master_fsm = M_READ_REQ;
+            c_retry_count++;
         }
 	    else if ( p_ack.read() == PIBUS_ACK_READY ) 
         {
 	        r_word_count  = r_word_count + 1;
-	        if(r_word_count == (m_block_size>>2)-1) r_master_fsm = M_READ_DT;
+	        if(r_word_count == burstWords()-1) r_master_fsm = M_READ_DT;
 	    }
         break;
     case M_READ_DT:
 	    if ( (p_ack.read() == PIBUS_ACK_ERROR) or p_tout.read() )  
         {
             r_master_fsm = M_READ_ERROR;
+        }
+        else if ( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
+        {
+            r_master_fsm = M_READ_REQ;
+            c_retry_count++;
         }
 	    else if ( p_ack.read() == PIBUS_ACK_READY )  
         {
@@ -169,22 +339,44 @@ void PibusBlockDevice::transition()
         }
         break;
     case M_READ_TEST:
-        if( r_block_count == r_nblocks - 1 )
+    {
+        uint32_t offset = r_offset.read() + (burstWords()<<2);
+        c_read_blocks   = c_read_blocks + offset/m_block_size - r_offset.read()/m_block_size;
+        if( offset == (uint64_t)r_nblocks.read()*m_block_size )
         {
-            r_block_count = 0;
+            r_offset     = 0;
             r_master_fsm = M_READ_SUCCESS;
-         }
+        }
         else
         {
-            r_block_count = r_block_count + 1;
+            r_offset     = offset;
             r_master_fsm = M_READ_BLOCK;
         }
         break;
+    }
     case M_READ_SUCCESS:
-        if( !r_go ) r_master_fsm = M_IDLE;
+        if( r_queued )
+        {
+            r_cpl_status = BLOCK_DEVICE_READ_SUCCESS;
+            r_master_fsm = M_CPL_REQ;
+        }
+        else if( !r_go ) 
+        {
+            r_master_fsm = M_IDLE;
+            c_transfer_count++;
+        }
         break;
     case M_READ_ERROR:
-        if( !r_go ) r_master_fsm = M_IDLE;
+        if( r_queued )
+        {
+            r_cpl_status = BLOCK_DEVICE_READ_ERROR;
+            r_master_fsm = M_CPL_REQ;
+        }
+        else if( !r_go ) 
+        {
+            r_master_fsm = M_IDLE;
+            c_error_count++;
+        }
         break;
 
     case M_WRITE_REQ:
@@ -196,18 +388,24 @@ void PibusBlockDevice::transition()
         break;
     case M_WRITE_AD:
 	    r_word_count  = r_word_count + 1;
-		r_master_fsm = M_WRITE_DTAD;
+	    if( burstWords() == 1 ) r_master_fsm = M_WRITE_DT;
+	    else                    r_master_fsm = M_WRITE_DTAD;
         break;
     case M_WRITE_DTAD:
         if ( p_tout.read() or (p_ack.read() == PIBUS_ACK_ERROR) ) 
         {
             r_master_fsm = M_WRITE_ERROR;
         }
+        else if ( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
+        {
+            r_master_fsm = M_WRITE_REQ;
+            c_retry_count++;
+        }
         else if ( p_ack.read() == PIBUS_ACK_READY ) 
         {
             m_local_buffer[r_word_count - 1] = p_d.read();
 	        r_word_count  = r_word_count + 1;
-	        if(r_word_count == (m_block_size>>2)-1) r_master_fsm = M_WRITE_DT;
+	        if(r_word_count == burstWords()-1) r_master_fsm = M_WRITE_DT;
 	    }
         break;
     case M_WRITE_DT:
@@ -215,6 +413,11 @@ void PibusBlockDevice::transition()
         {
             r_master_fsm = M_WRITE_ERROR;
         }
+        else if ( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
+        {
+            r_master_fsm = M_WRITE_REQ;
+            c_retry_count++;
+        }
         else if ( p_ack.read() == PIBUS_ACK_READY ) 
         {
             m_local_buffer[r_word_count - 1] = p_d.read();
@@ -222,13 +425,13 @@ void PibusBlockDevice::transition()
             r_word_count = 0;
         }
         break;
-    case M_WRITE_BLOCK:
+    case M_WRITE_BLOCK:	// write one burst after waiting m_latency cycles
         if(r_latency_count == 0)
         {
             r_latency_count = m_latency;
-            ::lseek(m_fd, (r_lba + r_block_count)*m_block_size, SEEK_SET);
-            if( ::write(m_fd, m_local_buffer, m_block_size) < 0 )  r_master_fsm = M_WRITE_ERROR;
-            else                                                   r_master_fsm = M_WRITE_TEST;
+            uint64_t offset = (uint64_t)r_lba.read()*m_block_size + r_offset.read();
+            if( not writeDisk(offset, burstWords()<<2) )  r_master_fsm = M_WRITE_ERROR;
+            else                                          r_master_fsm = M_WRITE_TEST;
         }
         else
         {
@@ -236,27 +439,142 @@ void PibusBlockDevice::transition()
         }
         break;
     case M_WRITE_TEST:
-        if( r_block_count == r_nblocks - 1 )
+    {
+        uint32_t offset = r_offset.read() + (burstWords()<<2);
+        c_write_blocks  = c_write_blocks + offset/m_block_size - r_offset.read()/m_block_size;
+        if( offset == (uint64_t)r_nblocks.read()*m_block_size )
         {
-            r_block_count = 0;
+            r_offset     = 0;
             r_master_fsm = M_WRITE_SUCCESS;
         }
         else
         {
-            r_block_count = r_block_count + 1;
+            r_offset     = offset;
             r_master_fsm = M_WRITE_REQ;
         }
         break;
+    }
     case M_WRITE_SUCCESS:
-        if( !r_go ) r_master_fsm = M_IDLE;
+        if( r_queued )
+        {
+            r_cpl_status = BLOCK_DEVICE_WRITE_SUCCESS;
+            r_master_fsm = M_CPL_REQ;
+        }
+        else if( !r_go ) 
+        {
+            r_master_fsm = M_IDLE;
+            c_transfer_count++;
+        }
         break;
     case M_WRITE_ERROR:
-        if( !r_go ) r_master_fsm = M_IDLE;
+        if( r_queued )
+        {
+            r_cpl_status = BLOCK_DEVICE_WRITE_ERROR;
+            r_master_fsm = M_CPL_REQ;
+        }
+        else if( !r_go ) 
+        {
+            r_master_fsm = M_IDLE;
+            c_error_count++;
+        }
         break;
     } // end switch r_master_fsm
 
 }  // end transition
 
+///////////////////////////////////////////////////////////////////
+// This function initialises a transfer of nblocks blocks from block
+// lba, and returns the next master FSM state.
+// A transfer of 0 block is completed at once (SUCCESS), and a
+// transfer of 4 Gbytes or more is rejected (the byte counter
+// r_offset is a 32 bits register).
+///////////////////////////////////////////////////////////////////
+int PibusBlockDevice::startTransfer(bool read, uint32_t lba, uint32_t nblocks)
+{
+    r_offset        = 0;
+    r_latency_count = m_latency;
+    if ( ((uint64_t)lba + (uint64_t)nblocks > m_device_size) ||
+         ((uint64_t)nblocks*m_block_size >= ((uint64_t)1 << 32)) )
+    {
+        if ( read ) return M_READ_ERROR;
+        else        return M_WRITE_ERROR;
+    }
+    if ( nblocks == 0 )
+    {
+        if ( read ) return M_READ_SUCCESS;
+        else        return M_WRITE_SUCCESS;
+    }
+    if ( read ) 
+    {
+        if ( m_mmap )    // asynchronous read ahead (page aligned)
+        {
+            size_t page  = (size_t)::sysconf(_SC_PAGESIZE);
+            size_t start = (size_t)lba*m_block_size;
+            size_t size  = (size_t)nblocks*m_block_size + (start & (page - 1));
+            ::madvise( m_mmap + (start & ~(page - 1)), size, MADV_WILLNEED );
+        }
+        return M_READ_BLOCK;
+    }
+    return M_WRITE_REQ;
+}
+
+///////////////////////////////////////////////////////////////////
+// This function returns the address of the descriptor of the
+// oldest command in the command queue.
+///////////////////////////////////////////////////////////////////
+uint32_t PibusBlockDevice::queueEntry()
+{
+    return r_queue_base.read() + ((r_queue_head.read() & (r_queue_size.read() - 1)) << 4);
+}
+
+///////////////////////////////////////////////////////////////////
+// This function returns true when the command queue IRQ condition
+// is satisfied (completions coalescing).
+///////////////////////////////////////////////////////////////////
+bool PibusBlockDevice::queueIrq()
+{
+    uint32_t done      = r_queue_head.read() - r_queue_acked.read();
+    uint32_t threshold = r_queue_coalesce.read();
+    if ( done == 0 )          return false;
+    if ( threshold == 0 )     threshold = 1;
+    return (done >= threshold) || (r_queue_head.read() == r_queue_tail.read());
+}
+
+///////////////////////////////////////////////////////////////////
+// This function returns the length (words) of the current burst :
+// the burst length, or the number of words remaining in the transfer.
+///////////////////////////////////////////////////////////////////
+uint32_t PibusBlockDevice::burstWords()
+{
+    uint64_t remaining = ((uint64_t)r_nblocks.read()*m_block_size - r_offset.read()) >> 2;
+    if ( remaining < m_burst ) return (uint32_t)remaining;
+    else                       return m_burst;
+}
+
+///////////////////////////////////////////////////////////////////
+// These functions transfer nbytes between the file (at byte offset)
+// and the local buffer. They return false in case of host I/O error.
+///////////////////////////////////////////////////////////////////
+bool PibusBlockDevice::readDisk(uint64_t offset, uint32_t nbytes)
+{
+    if ( m_mmap )
+    {
+        memcpy(m_local_buffer, m_mmap + offset, nbytes);
+        return true;
+    }
+    return ::pread(m_fd, m_local_buffer, nbytes, offset) == (ssize_t)nbytes;
+}
+
+bool PibusBlockDevice::writeDisk(uint64_t offset, uint32_t nbytes)
+{
+    if ( m_mmap )
+    {
+        memcpy(m_mmap + offset, m_local_buffer, nbytes);
+        return true;
+    }
+    return ::pwrite(m_fd, m_local_buffer, nbytes, offset) == (ssize_t)nbytes;
+}
+
 /////////////////////////////////
 void PibusBlockDevice::genMoore()
 {
@@ -298,6 +616,30 @@ void PibusBlockDevice::genMoore()
         p_ack = PIBUS_ACK_READY;
         p_d = (uint32_t)m_block_size;
         break;
+    case T_READ_QBASE:
+        p_ack = PIBUS_ACK_READY;
+        p_d = (uint32_t)r_queue_base;
+        break;
+    case T_READ_QSIZE:
+        p_ack = PIBUS_ACK_READY;
+        p_d = (uint32_t)r_queue_size;
+        break;
+    case T_READ_QHEAD:
+        p_ack = PIBUS_ACK_READY;
+        p_d = (uint32_t)r_queue_head;
+        break;
+    case T_READ_QTAIL:
+        p_ack = PIBUS_ACK_READY;
+        p_d = (uint32_t)r_queue_tail;
+        break;
+    case T_READ_QDONE:
+        p_ack = PIBUS_ACK_READY;
+        p_d = (uint32_t)(r_queue_head.read() - r_queue_acked.read());
+        break;
+    case T_READ_QCOAL:
+        p_ack = PIBUS_ACK_READY;
+        p_d = (uint32_t)r_queue_coalesce;
+        break;
     case T_ERROR:
         p_ack = PIBUS_ACK_ERROR;
         break;
@@ -307,41 +649,61 @@ void PibusBlockDevice::genMoore()
     } // end switch target fsm
 
     // p_req signal
-    if((r_master_fsm == M_READ_REQ) || (r_master_fsm == M_WRITE_REQ)) 	p_req = true;
+    if((r_master_fsm == M_READ_REQ) || (r_master_fsm == M_WRITE_REQ) ||
+       (r_master_fsm == M_QUEUE_REQ) || (r_master_fsm == M_CPL_REQ)) 	p_req = true;
     else								                                p_req = false;
 
     // p_a, p_lock, p_read, p_opc signals
     if((r_master_fsm == M_READ_AD) || (r_master_fsm == M_READ_DTAD)) 
     {
         p_a   = (uint32_t)r_buf_address + 
-                (uint32_t)(r_block_count*m_block_size) + 
+                (uint32_t)r_offset + 
                 (uint32_t)(r_word_count*4);
         p_opc = PIBUS_OPC_WDU;
         p_read = false;
-        if(r_word_count == (m_block_size>>2)-1) 	p_lock = false;
+        if(r_word_count == burstWords()-1) 	p_lock = false;
         else		                            	p_lock = true;
     }
     if((r_master_fsm == M_WRITE_AD) || (r_master_fsm == M_WRITE_DTAD)) 
     {
         p_a   = (uint32_t)r_buf_address + 
-                (uint32_t)(r_block_count*m_block_size) + 
+                (uint32_t)r_offset + 
                 (uint32_t)(r_word_count*4);
         p_opc = PIBUS_OPC_WDU;
         p_read = true;
-        if(r_word_count == (m_block_size>>2)-1) 	p_lock = false;
+        if(r_word_count == burstWords()-1) 	p_lock = false;
         else			                            p_lock = true;
     }
 
+    if((r_master_fsm == M_QUEUE_AD) || (r_master_fsm == M_QUEUE_DTAD)) 
+    {
+        p_a   = queueEntry() + (uint32_t)(r_word_count*4);
+        p_opc = PIBUS_OPC_WDU;
+        p_read = true;
+        if(r_word_count == 3) 	p_lock = false;
+        else			p_lock = true;
+    }
+    if(r_master_fsm == M_CPL_AD) 
+    {
+        p_a   = queueEntry() + (BLOCK_DEVICE_OP<<2);
+        p_opc = PIBUS_OPC_WDU;
+        p_read = false;
+        p_lock = false;
+    }
+
     // p_d signal
     if((r_master_fsm == M_READ_DTAD) || (r_master_fsm == M_READ_DT)) 
         p_d = m_local_buffer[r_word_count - 1];
-
-    // IRQ signal
-    if(((r_master_fsm == M_READ_SUCCESS)    ||
-        (r_master_fsm == M_WRITE_SUCCESS)   ||
-        (r_master_fsm == M_READ_ERROR)      ||
-        (r_master_fsm == M_WRITE_ERROR) ) &&  r_irq_enable) p_irq = true;
-    else			                            p_irq = false;
+    if(r_master_fsm == M_CPL_DT) 
+        p_d = (uint32_t)r_cpl_status;
+
+    // IRQ signal (single command, or coalesced queued commands)
+    bool command_irq = ((r_master_fsm == M_READ_SUCCESS)    ||
+                        (r_master_fsm == M_WRITE_SUCCESS)   ||
+                        (r_master_fsm == M_READ_ERROR)      ||
+                        (r_master_fsm == M_WRITE_ERROR) ) && !r_queued;
+    if((command_irq || queueIrq()) &&  r_irq_enable) p_irq = true;
+    else			                     p_irq = false;
 } // end GenMoore()
 
 /////////////////////////////////////////////////////////////
@@ -350,12 +712,16 @@ PibusBlockDevice::PibusBlockDevice( sc_module_name	   	name,
 	  		                        PibusSegmentTable	&segtab,
 	  		                        char*       	    filename,
 	  		                        uint32_t	        block_size,
-                                    uint32_t          	latency)
+                                    uint32_t          	latency,
+                                    uint32_t          	burst)
 
     : m_name(name),
       m_tgtid(tgtid),
       m_latency(latency),
       m_block_size(block_size),
+      m_burst(burst),
+      m_mmap(NULL),
+      m_mmap_size(0),
       p_ck("p_ck"),
       p_resetn("p_resetn"),
       p_req("p_req"),
@@ -393,6 +759,14 @@ PibusBlockDevice::PibusBlockDevice( sc_module_name	   	name,
     strcpy (m_master_str[14], "WRITE_ERROR");
     strcpy (m_master_str[15], "READ_TEST");
     strcpy (m_master_str[16], "WRITE_TEST");
+    strcpy (m_master_str[17], "QUEUE_REQ");
+    strcpy (m_master_str[18], "QUEUE_AD");
+    strcpy (m_master_str[19], "QUEUE_DTAD");
+    strcpy (m_master_str[20], "QUEUE_DT");
+    strcpy (m_master_str[21], "QUEUE_CMD");
+    strcpy (m_master_str[22], "CPL_REQ");
+    strcpy (m_master_str[23], "CPL_AD");
+    strcpy (m_master_str[24], "CPL_DT");
 
     strcpy (m_target_str[0], "IDLE");
     strcpy (m_target_str[1], "WRITE_BUFFER");
@@ -408,18 +782,40 @@ PibusBlockDevice::PibusBlockDevice( sc_module_name	   	name,
     strcpy (m_target_str[11], "READ_SIZE");
     strcpy (m_target_str[12], "READ_BLOCK");
     strcpy (m_target_str[13], "ERROR");
+    strcpy (m_target_str[14], "WRITE_QBASE");
+    strcpy (m_target_str[15], "READ_QBASE");
+    strcpy (m_target_str[16], "WRITE_QSIZE");
+    strcpy (m_target_str[17], "READ_QSIZE");
+    strcpy (m_target_str[18], "READ_QHEAD");
+    strcpy (m_target_str[19], "WRITE_QTAIL");
+    strcpy (m_target_str[20], "READ_QTAIL");
+    strcpy (m_target_str[21], "WRITE_QDONE");
+    strcpy (m_target_str[22], "READ_QDONE");
+    strcpy (m_target_str[23], "WRITE_QCOAL");
+    strcpy (m_target_str[24], "READ_QCOAL");
+
+    if( (m_block_size < 128) || 
+        (m_block_size > (1<<20)) || 
+        ((m_block_size & (m_block_size - 1)) != 0) )
+    {
+	    printf("ERROR in component PibusBlockDevice : %s\n", m_name);
+	    printf("The block size must be a power of 2 between 128 bytes and 1 Mbytes\n");
+        exit(1);
+    }
 
-    if( (m_block_size != 128) && 
-        (m_block_size != 256) && 
-        (m_block_size != 512) && 
-        (m_block_size != 1024) )
+    if( m_burst == 0 ) 
+    {
+        m_burst = m_block_size>>2;
+        if( m_burst > 1024 ) m_burst = 1024;
+    }
+    if( m_burst > 1024 )
     {
 	    printf("ERROR in component PibusBlockDevice : %s\n", m_name);
-	    printf("The block size must be 128, 256, 512 or 1024 bytes\n");
+	    printf("The burst length cannot be larger than 1024 words\n");
         exit(1);
     }
 
-    std::list<SegmentTableEntry> seglist = segtab.getTargetSegmentList(tgtid);
+    const std::list<SegmentTableEntry> &seglist = segtab.getTargetSegmentList(tgtid);
     m_segbase = (*seglist.begin()).getBase();
     m_segsize = (*seglist.begin()).getSize();
     m_segname = (*seglist.begin()).getName();
@@ -455,25 +851,141 @@ PibusBlockDevice::PibusBlockDevice( sc_module_name	   	name,
         m_device_size = ((uint64_t)1<<32);
     }
 
-    m_local_buffer = new uint32_t[m_block_size>>2];
+    m_mmap_size = (size_t)m_device_size*m_block_size;
+    if ( m_mmap_size != 0 )
+    {
+        void* map = ::mmap(NULL, m_mmap_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if ( map != MAP_FAILED ) m_mmap = (uint8_t*)map;
+        else
+        {
+            std::cout << "Warning: block device " << m_name << std::endl;
+            std::cout << "The file " << filename << " cannot be mapped : "
+                      << "using pread() / pwrite()" << std::endl;
+        }
+    }
+
+    m_local_buffer = new uint32_t[m_burst];
 
     std::cout << std::endl << "Instanciation of PibusBlockDevice : " << m_name << std::endl;
     std::cout << "    file_name  = " << filename << std::endl;
     std::cout << "    block_size = " << std::dec << m_block_size << std::endl;
     std::cout << "    latency    = " << std::dec << m_latency << std::endl;
+    std::cout << "    burst      = " << std::dec << m_burst << std::endl;
+    std::cout << "    host I/O   = " << (m_mmap ? "mmap" : "pread/pwrite") << std::endl;
     std::cout << "    segment " << m_segname << std::hex
               << " | base = 0x" << m_segbase
               << " | size = 0x" << m_segsize << std::endl;
 
 } // end constructor
 
+/////////////////////////////////////
+PibusBlockDevice::~PibusBlockDevice()
+{
+    if ( m_mmap ) 
+    {
+        ::msync(m_mmap, m_mmap_size, MS_SYNC);
+        ::munmap(m_mmap, m_mmap_size);
+    }
+    ::close(m_fd);
+    delete [] m_local_buffer;
+}
+
 ///////////////////////////////////
 void PibusBlockDevice::printTrace()
 {
     std::cout << m_name << "_target : " << m_target_str[r_target_fsm] << "   "
               << m_name << "_master : " << m_master_str[r_master_fsm] 
               << "    irq_enable = " << r_irq_enable.read() 
-              << "    block_count = " << r_block_count.read() << std::endl; 
+              << "    offset = " << r_offset.read();
+    if ( r_queue_size.read() != 0 )
+        std::cout << "    queue head = " << r_queue_head.read() 
+                  << " / tail = " << r_queue_tail.read(); 
+    std::cout << std::endl; 
+}
+
+////////////////////////////////////////////////////////////////////////
+void PibusBlockDevice::registerCounters(PibusCounterRegistry &registry)
+{
+    registry.add(m_name, "transfer_count", &c_transfer_count);
+    registry.add(m_name, "error_count",    &c_error_count);
+    registry.add(m_name, "read_blocks",    &c_read_blocks);
+    registry.add(m_name, "write_blocks",   &c_write_blocks);
+    registry.add(m_name, "retry_count",    &c_retry_count);
+    registry.add(m_name, "busy_cycles",    &c_busy_cycles);
+    registry.add(m_name, "queue_commands", &c_queue_commands);
+}
+
+//////////////////////////////////////////
+bool PibusBlockDevice::checkpointReady()
+{
+    int m = r_master_fsm.read();
+    bool transaction = ((m >= M_READ_AD)  && (m <= M_READ_DT))  ||
+                       ((m >= M_WRITE_AD) && (m <= M_WRITE_DT)) ||
+                       ((m >= M_QUEUE_AD) && (m <= M_QUEUE_DT)) ||
+                       (m == M_CPL_AD) || (m == M_CPL_DT);
+    return (r_target_fsm == T_IDLE) && not transaction;
+}
+////////////////////////////////////////////////////////////////////
+void PibusBlockDevice::saveState(PibusCheckpointWriter &writer)
+{
+    writer.put(m_burst);
+    writer.put(m_device_size);
+    writer.put(r_target_fsm);
+    writer.put(r_master_fsm);
+    writer.put(r_irq_enable);
+    writer.put(r_nblocks);
+    writer.put(r_buf_address);
+    writer.put(r_lba);
+    writer.put(r_read);
+    writer.put(r_word_count);
+    writer.put(r_offset);
+    writer.put(r_go);
+    writer.put(r_latency_count);
+    writer.put(r_queue_base);
+    writer.put(r_queue_size);
+    writer.put(r_queue_head);
+    writer.put(r_queue_tail);
+    writer.put(r_queue_acked);
+    writer.put(r_queue_coalesce);
+    writer.put(r_queued);
+    writer.put(r_cpl_status);
+    writer.putArray(m_entry, 4);
+    writer.putArray(m_local_buffer, m_burst);
+}
+////////////////////////////////////////////////////////////////////
+void PibusBlockDevice::restoreState(PibusCheckpointReader &reader)
+{
+    uint32_t burst;
+    uint64_t device_size;
+    reader.get(burst);
+    reader.get(device_size);
+    if ((burst != m_burst) || (device_size != m_device_size))
+    {
+	printf("ERROR in component PibusBlockDevice : %s\n", m_name);
+	printf("The checkpoint burst or device size does not match\n");
+	exit(1);
+    }
+    reader.get(r_target_fsm);
+    reader.get(r_master_fsm);
+    reader.get(r_irq_enable);
+    reader.get(r_nblocks);
+    reader.get(r_buf_address);
+    reader.get(r_lba);
+    reader.get(r_read);
+    reader.get(r_word_count);
+    reader.get(r_offset);
+    reader.get(r_go);
+    reader.get(r_latency_count);
+    reader.get(r_queue_base);
+    reader.get(r_queue_size);
+    reader.get(r_queue_head);
+    reader.get(r_queue_tail);
+    reader.get(r_queue_acked);
+    reader.get(r_queue_coalesce);
+    reader.get(r_queued);
+    reader.get(r_cpl_status);
+    reader.getArray(m_entry, 4);
+    reader.getArray(m_local_buffer, m_burst);
 }
 
 
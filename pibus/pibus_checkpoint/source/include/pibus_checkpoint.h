@@ -0,0 +1,521 @@
+///////////////////////////////////////////////////////////////////////////
+// File : pibus_checkpoint.h
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// These objects implement the checkpoint / restore of a PIBUS platform
+// state, to start many simulations from a single (boot) simulation.
+// - PibusCheckpointable : interface implemented by the components.
+//   The saveState() and restoreState() methods write and read the
+//   component state (registers and internal tables) in a section of
+//   the checkpoint file, and the checkpointReady() method returns
+//   true when the component can be checkpointed (see below).
+// - PibusCheckpointWriter / PibusCheckpointReader : the section
+//   serialization. The registers are written in the host format, and
+//   the memory pages (4 Kbytes) are aligned on the host pages in the
+//   file, in order to be mapped (mmap) on restore. The null pages are
+//   not written (only their index is registered).
+// - PibusCheckpoint : the registry of the checkpointed components,
+//   identified by their instance name, as the PibusCounterRegistry.
+//
+// The file contains a header (magic number, format version, cycle,
+// and parent checkpoint name), and one section per component
+// (name, length, payload). A checkpoint can be incremental : the
+// memory components only write the pages modified since the parent
+// checkpoint (the last checkpoint saved or restored), and the restore
+// applies the parent chain first. The whole platform state is
+// written in all checkpoints, except the memory pages.
+//
+// The checkpoint must be saved when the ready() method returns true
+// (all masters are idle, and no bus transaction is running : the
+// platform can be simulated cycle by cycle until this condition),
+// and it must be restored after the reset of the platform, that
+// defines the memory image and the structural parameters. It is the
+// responsibility of the user to restore on the same platform, with
+// the same memory image. The instrumentation counters are not saved.
+//
+// Limitations :
+// - PibusMips32Xcache : only the GDB debug registers of the ISS are
+//   saved (general registers, SR, LO, HI, BADVADDR, CAUSE, PC). The
+//   other CP0 registers (EPC, EBASE, Count, Compare, ...) restart from
+//   their reset value, and the save is refused (error) when the
+//   software has written one of them (except EPC) or read Count.
+//   The caches are restored empty, and the fast-forward mode cannot
+//   be checkpointed.
+// - The block device disk image is not saved.
+// - The PibusTargetMultiFifos coprocessor state is not saved, and the
+//   PibusFunctionalBus is not checkpointable.
+// - The checkpoint is not compressed : the size reduction relies on the
+//   null pages elision and on the incremental checkpoints, because the
+//   mmap restore requires uncompressed pages aligned in the file.
+///////////////////////////////////////////////////////////////////////////
+// The constructors have no parameter.
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef PIBUS_CHECKPOINT_H
+#define PIBUS_CHECKPOINT_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <systemc>
+
+#define PIBUS_CHECKPOINT_MAGIC		"PIBUSCKP"
+#define PIBUS_CHECKPOINT_VERSION	1
+#define PIBUS_CHECKPOINT_PAGE		4096	// bytes
+
+namespace soclib { namespace caba {
+
+/////////////////////////////
+class PibusCheckpointWriter {
+
+FILE*		m_file;		// checkpoint file
+std::string	m_name;		// file name
+long		m_section;	// current section length offset
+bool		m_incremental;	// parent checkpoint defined
+
+///////////////////////////////////////////
+void write(const void* data, size_t size)
+{
+	if (fwrite(data, 1, size, m_file) != size)
+	{
+		printf("ERROR in PibusCheckpoint\n");
+		printf("Cannot write the checkpoint file %s\n", m_name.c_str());
+		exit(1);
+	}
+};
+
+public:
+
+////////////////////////////////////////////////////////////////////
+PibusCheckpointWriter(const std::string &name,
+                      const std::string &parent,
+                      uint64_t cycle)
+	: m_name(name),
+	  m_section(-1),
+	  m_incremental(parent.size() != 0)
+{
+	// a new file is created : the pages of a previous file with the
+	// same name can be mapped in the memory components
+	unlink(name.c_str());
+	m_file = fopen(name.c_str(), "wb");
+	if (m_file == NULL)
+	{
+		printf("ERROR in PibusCheckpoint\n");
+		printf("Cannot create the checkpoint file %s\n", name.c_str());
+		exit(1);
+	}
+	uint32_t version = PIBUS_CHECKPOINT_VERSION;
+	write(PIBUS_CHECKPOINT_MAGIC, 8);
+	put(version);
+	put(cycle);
+	putString(parent);
+};
+/////////////////////////
+~PibusCheckpointWriter()
+{
+	uint32_t end = 0;	// null section name
+	put(end);
+	if (fclose(m_file) != 0)
+	{
+		printf("ERROR in PibusCheckpoint\n");
+		printf("Cannot write the checkpoint file %s\n", m_name.c_str());
+		exit(1);
+	}
+};
+////////////////////////////////////////
+// only the modified pages must be saved
+bool isIncremental() const
+{
+	return m_incremental;
+};
+///////////////////////////////////////////////////
+void beginSection(const std::string &name)
+{
+	uint64_t length = 0;
+	putString(name);
+	m_section = ftell(m_file);
+	put(length);
+};
+///////////////////
+void endSection()
+{
+	long     end    = ftell(m_file);
+	uint64_t length = end - m_section - sizeof(uint64_t);
+	fseek(m_file, m_section, SEEK_SET);
+	put(length);
+	fseek(m_file, end, SEEK_SET);
+	m_section = -1;
+};
+//////////////////////////////
+template<class T>
+void put(const T &value)
+{
+	write(&value, sizeof(T));
+};
+//////////////////////////////////////////////////
+template<class T>
+void put(const sc_core::sc_signal<T> &reg)
+{
+	T value = reg.read();
+	write(&value, sizeof(T));
+};
+/////////////////////////////////////////////
+template<class T>
+void putArray(const T* values, size_t n)
+{
+	if (n != 0) write(values, n * sizeof(T));
+};
+/////////////////////////////////////////////
+void putString(const std::string &s)
+{
+	uint32_t size = s.size();
+	put(size);
+	write(s.data(), size);
+};
+///////////////////////////////////////////////////////////////////
+// writes a 4 Kbytes page, aligned on the host pages in the file.
+// A null page is not written.
+void putPage(uint32_t index, const void* page)
+{
+	const uint64_t* words = (const uint64_t*)page;
+	uint32_t        full  = 0;
+	for (size_t i = 0 ; i < (PIBUS_CHECKPOINT_PAGE >> 3) ; i++)
+	{
+		if (words[i] != 0) { full = 1; break; }
+	}
+	put(index);
+	put(full);
+	if (full == 0) return;
+	static const char zero[PIBUS_CHECKPOINT_PAGE] = { 0 };
+	size_t pad = (PIBUS_CHECKPOINT_PAGE - (ftell(m_file) % PIBUS_CHECKPOINT_PAGE))
+                     % PIBUS_CHECKPOINT_PAGE;
+	write(zero, pad);
+	write(page, PIBUS_CHECKPOINT_PAGE);
+};
+
+}; // end PibusCheckpointWriter
+
+/////////////////////////////
+class PibusCheckpointReader {
+
+std::string	m_name;		// file name
+int		m_fd;		// file descriptor
+const char*	m_base;		// file mapping
+size_t		m_size;		// file size
+size_t		m_pos;		// read offset
+size_t		m_end;		// end of the current section
+uint64_t	m_cycle;	// checkpoint cycle
+std::string	m_parent;	// parent checkpoint name
+
+///////////////////////////////////////
+void error(const char* message) const
+{
+	printf("ERROR in PibusCheckpoint\n");
+	printf("%s : %s\n", message, m_name.c_str());
+	exit(1);
+};
+//////////////////////////////////////
+void read(void* data, size_t size)
+{
+	if (m_pos + size > m_end) error("Corrupted checkpoint file");
+	memcpy(data, m_base + m_pos, size);
+	m_pos = m_pos + size;
+};
+
+public:
+
+/////////////////////////////////////////////////
+PibusCheckpointReader(const std::string &name)
+	: m_name(name),
+	  m_pos(0)
+{
+	struct stat st;
+	m_fd = open(name.c_str(), O_RDONLY);
+	if ((m_fd < 0) || (fstat(m_fd, &st) != 0)) error("Cannot open the checkpoint file");
+	m_size = st.st_size;
+	m_end  = m_size;
+	void* base = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (base == MAP_FAILED) error("Cannot map the checkpoint file");
+	m_base = (const char*)base;
+
+	uint32_t version;
+	if ((m_size < 8) || (memcmp(m_base, PIBUS_CHECKPOINT_MAGIC, 8) != 0))
+		error("Not a checkpoint file");
+	m_pos = 8;
+	get(version);
+	if (version != PIBUS_CHECKPOINT_VERSION) error("Unsupported checkpoint version");
+	get(m_cycle);
+	getString(m_parent);
+};
+/////////////////////////
+~PibusCheckpointReader()
+{
+	munmap((void*)m_base, m_size);
+	close(m_fd);
+};
+//////////////////////////////////////////
+uint64_t getCycle() const
+{
+	return m_cycle;
+};
+//////////////////////////////////////////
+const std::string &getParent() const
+{
+	return m_parent;
+};
+//////////////////////////////////////////////////////////
+// returns false at the end of the file
+bool nextSection(std::string &name)
+{
+	uint64_t length;
+	m_end = m_size;
+	getString(name);
+	if (name.size() == 0) return false;
+	get(length);
+	if (length > m_size - m_pos) error("Corrupted checkpoint file");
+	m_end = m_pos + length;
+	return true;
+};
+//////////////////////////////////////////
+// the section must be entirely read
+void endSection()
+{
+	if (m_pos != m_end) error("Corrupted checkpoint file");
+	m_end = m_size;
+};
+//////////////////////////////
+template<class T>
+void get(T &value)
+{
+	read(&value, sizeof(T));
+};
+////////////////////////////////////////////
+template<class T>
+void get(sc_core::sc_signal<T> &reg)
+{
+	T value;
+	read(&value, sizeof(T));
+	reg = value;
+};
+///////////////////////////////////////
+template<class T>
+void getArray(T* values, size_t n)
+{
+	if (n != 0) read(values, n * sizeof(T));
+};
+////////////////////////////////////
+void getString(std::string &s)
+{
+	uint32_t size;
+	get(size);
+	if (m_pos + size > m_end) error("Corrupted checkpoint file");
+	s.assign(m_base + m_pos, size);
+	m_pos = m_pos + size;
+};
+///////////////////////////////////////////////////////////////////
+// reads a page written by putPage(), and returns a pointer on the
+// page in the file mapping, or NULL for a null page.
+// The page file offset is returned in offset.
+const void* getPage(uint32_t* index, off_t* offset)
+{
+	uint32_t full;
+	get(*index);
+	get(full);
+	if (full == 0) return NULL;
+	m_pos = m_pos + (PIBUS_CHECKPOINT_PAGE - (m_pos % PIBUS_CHECKPOINT_PAGE))
+                        % PIBUS_CHECKPOINT_PAGE;
+	if (m_pos + PIBUS_CHECKPOINT_PAGE > m_end) error("Corrupted checkpoint file");
+	*offset = m_pos;
+	m_pos   = m_pos + PIBUS_CHECKPOINT_PAGE;
+	return m_base + *offset;
+};
+//////////////////////////////////////////////////////////
+// file descriptor, to map the pages in the components
+int getFd() const
+{
+	return m_fd;
+};
+
+}; // end PibusCheckpointReader
+
+//////////////////////////
+class PibusCheckpointable {
+
+public:
+
+virtual ~PibusCheckpointable() {};
+
+// the component can be checkpointed (default : true)
+virtual bool checkpointReady() { return true; };
+
+virtual void saveState(PibusCheckpointWriter &writer) = 0;
+virtual void restoreState(PibusCheckpointReader &reader) = 0;
+
+}; // end PibusCheckpointable
+
+///////////////////////
+class PibusCheckpoint {
+
+std::vector<std::string>		m_names;	// component names
+std::vector<PibusCheckpointable*>	m_components;	// component pointers
+std::string				m_parent;	// last saved or restored checkpoint
+
+/////////////////////////////////////////////////////////////////////
+// returns true if the two names are the same existing file
+static bool sameFile(const std::string &a, const std::string &b)
+{
+	struct stat sa;
+	struct stat sb;
+	if ((stat(a.c_str(), &sa) != 0) || (stat(b.c_str(), &sb) != 0)) return false;
+	return (sa.st_dev == sb.st_dev) && (sa.st_ino == sb.st_ino);
+};
+/////////////////////////////////////////////////////////////////////
+// returns true if the file is in the list (same name or same file)
+static bool inList(const std::string &name, const std::vector<std::string> &list)
+{
+	for (size_t i = 0 ; i < list.size() ; i++)
+	{
+		if ((list[i] == name) || sameFile(list[i], name)) return true;
+	}
+	return false;
+};
+/////////////////////////////////////////////////////////////////////
+// returns true if the file is in the parent chain of the last saved
+// or restored checkpoint
+bool inParentChain(const std::string &name) const
+{
+	std::vector<std::string> chain;
+	std::string              parent = m_parent;
+	while ((parent.size() != 0) && not inList(parent, chain))
+	{
+		if ((parent == name) || sameFile(parent, name)) return true;
+		struct stat st;
+		if (stat(parent.c_str(), &st) != 0) return false;
+		chain.push_back(parent);
+		PibusCheckpointReader reader(parent);
+		parent = reader.getParent();
+	}
+	return false;
+};
+/////////////////////////////////////////////////////////////////////
+// restores the parent chain, then the checkpoint. The chain contains
+// the descendants of the checkpoint (cycle detection).
+uint64_t restoreChain(const std::string &name, std::vector<std::string> &chain)
+{
+	if (inList(name, chain))
+	{
+		printf("ERROR in PibusCheckpoint\n");
+		printf("The parent chain of checkpoint %s contains a cycle\n", chain[0].c_str());
+		exit(1);
+	}
+	chain.push_back(name);
+
+	PibusCheckpointReader reader(name);
+	if (reader.getParent().size() != 0) restoreChain(reader.getParent(), chain);
+
+	std::vector<bool> done(m_components.size(), false);
+	std::string       section;
+	while (reader.nextSection(section))
+	{
+		size_t k = 0;
+		while ((k < m_names.size()) && (m_names[k] != section)) k++;
+		if (k == m_names.size())
+		{
+			printf("ERROR in PibusCheckpoint\n");
+			printf("Unknown component %s in checkpoint %s\n",
+                               section.c_str(), name.c_str());
+			exit(1);
+		}
+		m_components[k]->restoreState(reader);
+		reader.endSection();
+		done[k] = true;
+	}
+	for (size_t k = 0 ; k < m_components.size() ; k++)
+	{
+		if (done[k]) continue;
+		printf("ERROR in PibusCheckpoint\n");
+		printf("Component %s not found in checkpoint %s\n",
+                       m_names[k].c_str(), name.c_str());
+		exit(1);
+	}
+	m_parent = name;
+	return reader.getCycle();
+};
+
+public:
+
+///////////////////////////////////////////////////////////////////////
+void add(const std::string &name, PibusCheckpointable* component)
+{
+	m_names.push_back(name);
+	m_components.push_back(component);
+};
+////////////////////////////////////////////////////////
+// all components can be checkpointed
+bool ready() const
+{
+	for (size_t k = 0 ; k < m_components.size() ; k++)
+	{
+		if (not m_components[k]->checkpointReady()) return false;
+	}
+	return true;
+};
+///////////////////////////////////////////////////////////////////////
+// The checkpoint is incremental when the incremental argument is true,
+// and a checkpoint has been previously saved or restored. A full
+// checkpoint is saved when the file is in the parent chain (the old
+// file is replaced, and the chain would be lost).
+void save(const std::string &name, uint64_t cycle, bool incremental = true)
+{
+	if (not ready())
+	{
+		printf("ERROR in PibusCheckpoint\n");
+		printf("The platform cannot be checkpointed in this cycle\n");
+		exit(1);
+	}
+	if (incremental && inParentChain(name))
+	{
+		printf("PibusCheckpoint : %s is in the parent chain, a full checkpoint is saved\n",
+                       name.c_str());
+		incremental = false;
+	}
+	{
+		PibusCheckpointWriter writer(name, incremental ? m_parent : std::string(), cycle);
+		for (size_t k = 0 ; k < m_components.size() ; k++)
+		{
+			writer.beginSection(m_names[k]);
+			m_components[k]->saveState(writer);
+			writer.endSection();
+		}
+	}
+	m_parent = name;
+};
+///////////////////////////////////////////////////////////////////////
+// restores the parent chain, then the checkpoint, and returns the
+// checkpoint cycle. All components must be found in the checkpoint,
+// and a cycle in the parent chain is an error.
+uint64_t restore(const std::string &name)
+{
+	std::vector<std::string> chain;
+	return restoreChain(name, chain);
+};
+////////////////////////////////////////
+const std::string &getParent() const
+{
+	return m_parent;
+};
+
+}; // end PibusCheckpoint
+
+}} // end namespaces
+
+#endif
@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////
+// File : pibus_counter_registry.h
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// This object is a registry of named performance counters, shared by
+// all the PIBUS components of a platform.
+// Each component owns its counters (64 bits unsigned integers), and
+// registers them in the registry with the registerCounters() method,
+// before the beginning of the simulation. A counter is identified by
+// the component instance name and the counter name : "name.counter".
+// The registry only contains pointers : the counter update cost is
+// not modified.
+//
+// The sample() method writes, for all registered counters, the 
+// increment since the previous sample (delta), and can be used
+// periodically by the PibusCounterSampler component.
+// Two formats are supported :
+// - CSV : one header line (cycle , counter names), then one line
+//   per sample (cycle , deltas).
+// - BINARY : one header line (counter names separated by commas),
+//   then one record per sample : the cycle and the deltas, each
+//   value encoded as an unsigned LEB128 variable length integer
+//   (7 bits per byte, the most significant bit is set for all
+//   bytes but the last). Most deltas are encoded on one byte.
+///////////////////////////////////////////////////////////////////////////
+// The constructor has no parameter.
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef PIBUS_COUNTER_REGISTRY_H
+#define PIBUS_COUNTER_REGISTRY_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <iostream>
+
+namespace soclib { namespace caba {
+
+class PibusCounterRegistry {
+
+std::vector<std::string>	m_names;	// counter names
+std::vector<const uint64_t*>	m_values;	// counter pointers
+std::vector<uint64_t>		m_last;		// values at the previous sample
+
+////////////////////////////////////////////////////////
+static void writeVarint(std::ostream &o, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		o.put((char)((value & 0x7F) | 0x80));
+		value = value >> 7;
+	}
+	o.put((char)value);
+};
+
+public:
+
+//////////////////////////////////////////////////////////////
+void add(const std::string &component, 
+         const std::string &counter, 
+         const uint64_t* value)
+{
+	m_names.push_back(component + "." + counter);
+	m_values.push_back(value);
+	m_last.push_back(0);
+};
+////////////////////////////////
+size_t getNCounters() const
+{
+	return m_names.size();
+};
+/////////////////////////////////////////////////
+const std::string &getName(size_t k) const
+{
+	return m_names[k];
+};
+//////////////////////////////////////
+uint64_t getValue(size_t k) const
+{
+	return *m_values[k];
+};
+//////////////////////////////////////////////////////
+// the components reset their counters to 0 with the 
+// platform reset : the reference values are reset
+//////////////////////////////////////////////////////
+void reset()
+{
+	for (size_t k = 0 ; k < m_last.size() ; k++) m_last[k] = 0;
+};
+//////////////////////////////////////////////////////
+void printHeader(std::ostream &o, bool binary) const
+{
+	if (not binary) o << "cycle,";
+	for (size_t k = 0 ; k < m_names.size() ; k++) 
+	{
+		o << m_names[k] << ((k + 1 < m_names.size()) ? "," : "");
+	}
+	o << std::endl;
+};
+///////////////////////////////////////////////////////////////
+// writes the deltas since the previous sample.
+// A counter that has been reset by the component (smaller
+// value) is reported with its current value.
+///////////////////////////////////////////////////////////////
+void sample(std::ostream &o, uint64_t cycle, bool binary)
+{
+	if (binary) writeVarint(o, cycle);
+	else        o << std::dec << cycle;
+	for (size_t k = 0 ; k < m_values.size() ; k++)
+	{
+		uint64_t value = *m_values[k];
+		uint64_t delta = (value >= m_last[k]) ? value - m_last[k] : value;
+		m_last[k] = value;
+		if (binary) writeVarint(o, delta);
+		else        o << "," << delta;
+	}
+	if (not binary) o << std::endl;
+};
+//////////////////////////////////////
+// prints all counters (name = value)
+//////////////////////////////////////
+void print(std::ostream &o) const
+{
+	for (size_t k = 0 ; k < m_names.size() ; k++) 
+	{
+		o << m_names[k] << " = " << std::dec << *m_values[k] << std::endl;
+	}
+};
+
+}; // end class PibusCounterRegistry
+
+}} // end namespaces
+
+#endif
@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////
+// File : pibus_counter_sampler.h
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// This component samples periodically the performance counters
+// registered in a PibusCounterRegistry, and writes the deltas
+// (increments during the last period) in a file, in CSV or in
+// compact binary format (see the PibusCounterRegistry object).
+// It is not connected to the PIBUS : it only uses the clock and
+// reset signals. The header is written at reset, when all the
+// components have registered their counters.
+// The sample() method can be called by the top cell at the end of
+// the simulation, to write the last (incomplete) period.
+///////////////////////////////////////////////////////////////////////////
+// This component has 5 "constructor" parameters :
+// - sc_module_name		name		: instance name
+// - PibusCounterRegistry	registry	: counter registry
+// - uint32_t			period		: sampling period (cycles)
+// - const char*		filename	: output file name
+// - bool			binary		: binary format (default = false)
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef PIBUS_COUNTER_SAMPLER_H
+#define PIBUS_COUNTER_SAMPLER_H
+
+#include <systemc>
+#include <fstream>
+#include "pibus_counter_registry.h"
+
+namespace soclib { namespace caba {
+
+class PibusCounterSampler : sc_core::sc_module {
+
+    // structural parameters
+    const char*			m_name;			// instance name
+    PibusCounterRegistry	&m_registry;		// counter registry
+    const uint32_t		m_period;		// sampling period
+    const bool			m_binary;		// binary format
+    std::ofstream		m_file;			// output file
+
+    // state
+    uint64_t			m_cycle;		// cycles since reset
+    uint32_t			m_count;		// cycles in the current period
+    bool			m_header_done;		// header written
+
+protected:
+
+    SC_HAS_PROCESS(PibusCounterSampler);
+
+public:
+
+    // I/O ports
+    sc_core::sc_in<bool>	p_ck;
+    sc_core::sc_in<bool>	p_resetn;
+
+    // constructor
+    PibusCounterSampler(sc_core::sc_module_name	name,
+			PibusCounterRegistry	&registry,
+			uint32_t		period,
+			const char*		filename,
+			bool			binary = false);
+
+    ~PibusCounterSampler();
+
+    // methods
+    void transition();
+    void sample();
+    uint64_t getCycle() { return m_cycle; }
+
+}; // end class PibusCounterSampler
+
+}} // end namespaces
+
+#endif
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////
+// File : pibus_counter_sampler.cpp
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include "pibus_counter_sampler.h"
+
+namespace soclib { namespace caba {
+
+using namespace sc_core;
+
+////////////////////////////////////////////////////////////////////////
+PibusCounterSampler::PibusCounterSampler(sc_module_name		name,
+					 PibusCounterRegistry	&registry,
+					 uint32_t		period,
+					 const char*		filename,
+					 bool			binary)
+    : m_name(name),
+      m_registry(registry),
+      m_period(period),
+      m_binary(binary),
+      m_cycle(0),
+      m_count(0),
+      m_header_done(false),
+      p_ck("p_ck"),
+      p_resetn("p_resetn")
+{
+    SC_METHOD(transition);
+    sensitive << p_ck.pos();
+
+    if ( period == 0 )
+    {
+        std::cout << "ERROR in PibusCounterSampler : " << m_name << std::endl;
+        std::cout << "The sampling period cannot be 0" << std::endl;
+        exit(0);
+    }
+    if ( binary ) m_file.open(filename, std::ios::out | std::ios::binary);
+    else          m_file.open(filename, std::ios::out);
+    if ( not m_file )
+    {
+        std::cout << "ERROR in PibusCounterSampler : " << m_name << std::endl;
+        std::cout << "Cannot open the file " << filename << std::endl;
+        exit(0);
+    }
+
+    std::cout << std::endl << "Instanciation of PibusCounterSampler : " << m_name << std::endl;
+    std::cout << "    period   = " << period << std::endl;
+    std::cout << "    file     = " << filename << std::endl;
+    std::cout << "    binary   = " << binary << std::endl;
+} // end constructor
+
+///////////////////////////////////////////
+PibusCounterSampler::~PibusCounterSampler()
+{
+    m_file.close();
+}
+
+/////////////////////////////////
+void PibusCounterSampler::sample()
+{
+    if ( not m_header_done ) return;
+    m_registry.sample(m_file, m_cycle, m_binary);
+    m_count = 0;
+}
+
+/////////////////////////////////////
+void PibusCounterSampler::transition()
+{
+    if ( p_resetn == false )
+    {
+        if ( not m_header_done ) m_registry.printHeader(m_file, m_binary);
+        m_registry.reset();
+        m_header_done = true;
+        m_cycle       = 0;
+        m_count       = 0;
+        return;
+    }
+
+    m_cycle++;
+    m_count++;
+    if ( m_count == m_period ) sample();
+} // end transition()
+
+}} // end namespaces
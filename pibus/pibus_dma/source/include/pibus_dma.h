@@ -40,6 +40,15 @@
 // if the IRQ_DISABLED register contains a non-zero value.
 // Writing in the RESET register is the normal way to acknowledge IRQ.
 // The initiator FSM uses an internal buffer to store a burst.
+// When a target answers PIBUS_ACK_RETRY (split transaction), the
+// bus is released, and the complete burst is retried.
+//
+// The following 64 bits counters can be registered in a PibusCounterRegistry
+// (registerCounters() method) : completed transfers, bus errors, read words,
+// written words, RETRY responses, and busy cycles (master FSM not idle).
+// This component implements the PibusCheckpointable interface, and can
+// be checkpointed when the target FSM is IDLE and the master FSM is not
+// in a bus transaction (a transfer can be checkpointed between bursts).
 ///////////////////////////////////////////////////////////////////////////
 // This component has 4 "constructor" parameters :
 // - sc_module_name 	name	: instance name
@@ -54,10 +63,12 @@
 #include <systemc.h>
 #include "pibus_mnemonics.h"
 #include "pibus_segment_table.h"
+#include "pibus_counter_registry.h"
+#include "pibus_checkpoint.h"
 
 namespace soclib { namespace caba {
 
-class PibusDma : sc_module {
+class PibusDma : sc_module, public PibusCheckpointable {
 
     // REGISTERS
     sc_register<int>      	r_target_fsm;		// target fsm state register
@@ -75,6 +86,14 @@ class PibusDma : sc_module {
    
     uint32_t*			m_buf;			// local buffer
 
+    // INSTRUMENTATION
+    uint64_t			c_transfer_count;	// completed transfers
+    uint64_t			c_error_count;		// transfers completed with error
+    uint64_t			c_read_words;		// read words
+    uint64_t			c_write_words;		// written words
+    uint64_t			c_retry_count;		// RETRY responses
+    uint64_t			c_busy_cycles;		// master FSM not idle
+
     // STRUCTURAL PARAMETERS
     const char*			m_name;			// instance name
     const uint32_t		m_tgtid;		// target index
@@ -150,6 +169,12 @@ public:
     void transition();
     void genMoore();
     void printTrace();
+    void registerCounters(PibusCounterRegistry &registry);
+
+    // CHECKPOINT
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
 
     // Constructor   
     PibusDma(sc_module_name			name, 
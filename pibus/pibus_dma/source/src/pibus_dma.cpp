@@ -22,6 +22,12 @@ void PibusDma::transition()
 	r_target_fsm  = TGT_IDLE;
 	r_stop        = true;
 	r_irq_disable = 0;
+        c_transfer_count = 0;
+        c_error_count    = 0;
+        c_read_words     = 0;
+        c_write_words    = 0;
+        c_retry_count    = 0;
+        c_busy_cycles    = 0;
 	return;
     } 
 
@@ -114,6 +120,8 @@ void PibusDma::transition()
     // In case of bus error, it goes to the DMA_WRITE_ERROR or DMA_READ_ERROR
     // state to assert the IRQ signaling the completion.
 
+    if(r_master_fsm > DMA_IDLE) c_busy_cycles++;
+
     switch(r_master_fsm) {
     case DMA_IDLE :
 	if (r_stop == false) 
@@ -140,28 +148,48 @@ void PibusDma::transition()
     case DMA_READ_DTAD :
 	if(p_ack.read() == PIBUS_ACK_READY) 
         {
+            c_read_words++;
             m_buf[r_index] = (uint32_t)p_d.read();
             r_index 	= r_index + 1;
             r_count 	= r_count - 1;
             r_read_ptr 	= r_read_ptr + 4;
 	    if(r_index == r_max-1)	r_master_fsm = DMA_READ_DT;
 	}
+        else if(p_ack.read() == PIBUS_ACK_RETRY) 	// restart the burst
+        {
+            r_read_ptr   = r_read_ptr.read() - (r_index.read() << 2);
+            r_count      = r_count.read() + r_index.read();
+            r_index      = 0;
+            r_master_fsm = DMA_READ_REQ;
+            c_retry_count++;
+        }
         else if(p_ack.read() == PIBUS_ACK_ERROR) 
         {
             r_master_fsm = DMA_READ_ERROR;
+            c_error_count++;
         }
         break;
    case DMA_READ_DT :
 	if(p_ack.read() == PIBUS_ACK_READY) 
         {
+            c_read_words++;
             m_buf[r_index] = (uint32_t)p_d.read();
             r_index      = 0;
 	    if(r_stop == true) 	r_master_fsm = DMA_IDLE; 
             else  		r_master_fsm = DMA_WRITE_REQ;
 	}
+        else if(p_ack.read() == PIBUS_ACK_RETRY) 	// restart the burst
+        {
+            r_read_ptr   = r_read_ptr.read() - (r_index.read() << 2);
+            r_count      = r_count.read() + r_index.read();
+            r_index      = 0;
+            r_master_fsm = DMA_READ_REQ;
+            c_retry_count++;
+        }
         else if(p_ack.read() == PIBUS_ACK_ERROR) 
         {
             r_master_fsm = DMA_READ_ERROR;
+            c_error_count++;
         }
         break;
     case DMA_WRITE_REQ :
@@ -176,21 +204,35 @@ void PibusDma::transition()
     case DMA_WRITE_DTAD :
         if(p_ack.read() == PIBUS_ACK_READY) 
         {
+            c_write_words++;
             r_index = r_index + 1;
             r_write_ptr = r_write_ptr + 4;
             if(r_index == r_max - 1) 	r_master_fsm = DMA_WRITE_DT;
 	}
+        else if(p_ack.read() == PIBUS_ACK_RETRY) 	// restart the burst
+        {
+            r_write_ptr  = r_write_ptr.read() - (r_index.read() << 2);
+            r_index      = 0;
+            r_master_fsm = DMA_WRITE_REQ;
+            c_retry_count++;
+        }
         else if(p_ack.read() == PIBUS_ACK_ERROR) 
         {
             r_master_fsm = DMA_WRITE_ERROR;
+            c_error_count++;
         }
         break;
     case DMA_WRITE_DT :
         if(p_ack.read() == PIBUS_ACK_READY) 
         {
+            c_write_words++;
             r_index = 0;
             if(r_stop == true)  	r_master_fsm = DMA_IDLE; 
-            else if(r_count == 0)	r_master_fsm = DMA_SUCCESS; 
+            else if(r_count == 0)
+            {
+                r_master_fsm = DMA_SUCCESS; 
+                c_transfer_count++;
+            }
             else 
             {
                 if(r_count < m_burst)  	r_max = r_count;
@@ -198,9 +240,17 @@ void PibusDma::transition()
                 r_master_fsm = DMA_READ_REQ;
             }
         }
+        if(p_ack.read() == PIBUS_ACK_RETRY) 	// restart the burst
+        {
+            r_write_ptr  = r_write_ptr.read() - (r_index.read() << 2);
+            r_index      = 0;
+            r_master_fsm = DMA_WRITE_REQ;
+            c_retry_count++;
+        }
         if(p_ack.read() == PIBUS_ACK_ERROR) 
         {
             r_master_fsm = DMA_WRITE_ERROR;
+            c_error_count++;
         }
         break;
     case DMA_SUCCESS :
@@ -339,7 +389,7 @@ PibusDma::PibusDma(sc_module_name		name,
     m_buf = new uint32_t[m_burst];
 
     // get segment base address and segment size
-    std::list<SegmentTableEntry> seglist = segtab.getTargetSegmentList(tgtid);
+    const std::list<SegmentTableEntry> &seglist = segtab.getTargetSegmentList(tgtid);
     m_segbase = (*seglist.begin()).getBase();
     m_segsize = (*seglist.begin()).getSize();
     m_segname = (*seglist.begin()).getName();
@@ -375,5 +425,67 @@ void PibusDma::printTrace()
               << " / wcount = " << std::dec << r_count.read() << std::endl;
 }
 
+////////////////////////////////////////////////////////////////
+void PibusDma::registerCounters(PibusCounterRegistry &registry)
+{
+    registry.add(m_name, "transfer_count", &c_transfer_count);
+    registry.add(m_name, "error_count",    &c_error_count);
+    registry.add(m_name, "read_words",     &c_read_words);
+    registry.add(m_name, "write_words",    &c_write_words);
+    registry.add(m_name, "retry_count",    &c_retry_count);
+    registry.add(m_name, "busy_cycles",    &c_busy_cycles);
+}
+
+//////////////////////////////////
+bool PibusDma::checkpointReady()
+{
+    int master = r_master_fsm.read();
+    return (r_target_fsm == TGT_IDLE) &&
+           ((master < DMA_READ_AD) || (master > DMA_WRITE_DT) || (master == DMA_WRITE_REQ));
+}
+////////////////////////////////////////////////////////////
+void PibusDma::saveState(PibusCheckpointWriter &writer)
+{
+    writer.put(m_burst);
+    writer.put(r_target_fsm);
+    writer.put(r_master_fsm);
+    writer.put(r_source);
+    writer.put(r_dest);
+    writer.put(r_nwords);
+    writer.put(r_irq_disable);
+    writer.put(r_stop);
+    writer.put(r_read_ptr);
+    writer.put(r_write_ptr);
+    writer.put(r_index);
+    writer.put(r_max);
+    writer.put(r_count);
+    writer.putArray(m_buf, m_burst);
+}
+////////////////////////////////////////////////////////////
+void PibusDma::restoreState(PibusCheckpointReader &reader)
+{
+    uint32_t burst;
+    reader.get(burst);
+    if (burst != m_burst)
+    {
+	printf("ERROR in component PibusDma : %s\n", m_name);
+	printf("The checkpoint burst size does not match\n");
+	exit(1);
+    }
+    reader.get(r_target_fsm);
+    reader.get(r_master_fsm);
+    reader.get(r_source);
+    reader.get(r_dest);
+    reader.get(r_nwords);
+    reader.get(r_irq_disable);
+    reader.get(r_stop);
+    reader.get(r_read_ptr);
+    reader.get(r_write_ptr);
+    reader.get(r_index);
+    reader.get(r_max);
+    reader.get(r_count);
+    reader.getArray(m_buf, m_burst);
+}
+
 
 }} // end namespace
@@ -8,8 +8,66 @@
 // This component implements a PIBUS compliant frame buffer.
 // It use the generic SoCLib fb_controler that contains 
 // the buffer itself, and supports both read & write accesses.
+//
+// Display refresh : the written words are tracked (dirty flag and
+// range of dirty words), and the display is refreshed only when the
+// frame has been modified since the last refresh. The refresh rate
+// is defined in wall-clock time (default is 40 ms, that is 25 frames
+// per second), and the host clock is checked every 1000 cycles.
+// The fb_controler only supports a complete refresh of the surface,
+// so the dirty range is only reported by printTrace() (as a range
+// of lines), and is used to count the refreshs (printStatistics()).
+//
+// Headless mode : no fb_controler is instanciated (no display),
+// and the frame is stored in a local buffer. In both modes, the
+// dumpFrame() method writes the frame (raw pixels, in the subsampling
+// format) to a file, on demand of the top cell.
+//
+// Blitter : if a second segment is allocated to this target in the
+// segment table, it contains 8 memory mapped registers (32 bytes),
+// controlling a blitter, that has a PIBUS master port :
+// - BLIT_SRC        0x00 (read/write)  Source (byte offset in the frame for COPY,
+//                                      memory address for MEMCOPY).
+// - BLIT_DST        0x04 (read/write)  Destination (byte offset in the frame).
+// - BLIT_WIDTH      0x08 (read/write)  Rectangle width (bytes).
+// - BLIT_HEIGHT     0x0C (read/write)  Rectangle height (lines).
+// - BLIT_SRC_PITCH  0x10 (read/write)  Source line pitch (bytes).
+// - BLIT_DST_PITCH  0x14 (read/write)  Destination line pitch (bytes).
+// - BLIT_COLOR      0x18 (read/write)  Fill value (32 bits word).
+// - BLIT_CMD        0x1C (write)       Writing here starts the operation.
+//   BLIT_STATUS     0x1C (read)        Blitter status.
+// The supported operations are :
+// - BLIT_FILL    (1) : the destination rectangle is filled with COLOR.
+// - BLIT_COPY    (2) : rectangle copy inside the frame (overlap supported).
+// - BLIT_MEMCOPY (3) : the rectangle is read from memory, with PIBUS
+//                      bursts (up to 16 words, in one line) on the master port.
+// The FILL and COPY operations are done on the host (one memset/memmove 
+// like loop per line), and their duration is modeled as 4 words per cycle. 
+// All addresses, offsets, pitches and the width must be multiple of 4 bytes,
+// and the rectangles must be contained in the frame buffer segment. 
+// The status values are IDLE (0), BUSY (1), SUCCESS (2), ERROR (3) : an
+// illegal operation or a bus error is signaled by the ERROR status.
+// The IRQ is asserted in the SUCCESS and ERROR states, and a read
+// of the status register in these states acknowledges the IRQ, and
+// returns the blitter to IDLE. Any write to the blitter registers is
+// ignored if the blitter is not IDLE.
+//
+// Ports : the p_ck, p_resetn, p_sel, p_a, p_read, p_opc, p_ack, p_d
+// and p_tout ports are always bound by the top cell (p_a, p_read and
+// p_opc are driven by the blitter master port). The p_req, p_gnt,
+// p_lock and p_irq ports are only used by the blitter :
+// - without blitter segment, they are bound by the constructor to
+//   internal signals, and must NOT be bound by the top cell (the
+//   existing platforms are not modified).
+// - with a blitter segment, they must be bound by the top cell, and
+//   the component must be allocated a master index in the BCU.
+//
+// This component implements the PibusCheckpointable interface, and can
+// be checkpointed when the target FSM is IDLE and the blitter is not in
+// a bus transaction. The registers and the frame (frame size bytes) are
+// saved, and the whole frame is marked dirty on restore.
 //////////////////////////////////////////////////////////////////////////
-// This component has 7 constructor parameters
+// This component has 8 constructor parameters
 // - sc_module_name		name    : instance name
 // - unsigned int  		index   : target index      
 // - pibusSegmentTable		segmap  : segment table
@@ -17,6 +75,7 @@
 // - unsigned int		width	: number of pixels per line
 // - unsigned int		height  : number of lines
 // - unsigned int		subsampling : default = 420
+// - bool			headless : no display (default = false)
 //////////////////////////////////////////////////////////////////////////
 
 #ifndef PIBUS_FRAME_BUFFER_H
@@ -24,22 +83,33 @@
 
 #include <systemc>
 #include <stdio.h>
+#include <inttypes.h>
 #include "pibus_segment_table.h"
 #include "pibus_mnemonics.h"
 #include "fb_controller.h"
 #include "process_wrapper.h"
+#include "pibus_checkpoint.h"
 
 namespace soclib { namespace caba {
 
-class PibusFrameBuffer : sc_core::sc_module {
+class PibusFrameBuffer : sc_core::sc_module, public PibusCheckpointable {
 
    //  REGISTERS
     sc_register<int>			r_fsm_state;		// FSM state
     sc_register<uint32_t>		r_counter;		// Latency counter
-    sc_register<uint32_t>		r_display;		// display counter
+    sc_register<uint32_t>		r_display;		// host clock polling counter
     sc_register<size_t>			r_word;			// word index in the frame buffer
     sc_register<int>			r_opc;			// PIBUS codop 
 
+    sc_register<int>			r_blit_fsm;		// blitter FSM state
+    sc_register<uint32_t>*		r_blit_reg;		// blitter registers [8]
+    sc_register<bool>			r_blit_go;		// start command (target FSM -> blitter)
+    sc_register<uint32_t>		r_blit_count;		// duration counter (FILL / COPY)
+    sc_register<uint32_t>		r_blit_line;		// current line (MEMCOPY)
+    sc_register<uint32_t>		r_blit_col;		// current byte in line (MEMCOPY)
+    sc_register<uint32_t>		r_blit_word;		// word counter in a burst
+    sc_register<uint32_t>		r_blit_burst;		// actual burst length (words)
+
     //  STRUCTURAL PARAMETERS
     const char*				m_name;			// instance name
     const uint32_t			m_tgtid;		// target index
@@ -47,8 +117,35 @@ class PibusFrameBuffer : sc_core::sc_module {
     uint32_t				m_segbase;		// segment base address
     uint32_t				m_segsize;   		// segment size
     const char*				m_segname;		// segment name
-    soclib::common::FbController        m_fb_controller;	// generic controller
-    char				m_fsm_str[6][20];	// FSM states names
+    uint32_t				m_regbase;		// blitter segment base address
+    uint32_t				m_regsize;		// blitter segment size (0 if no blitter)
+    const uint32_t			m_width;		// number of pixels per line
+    const uint32_t			m_height;		// number of lines
+    const int				m_subsampling;		// pixel format
+    soclib::common::FbController*       m_fb_controller;	// generic controller (NULL if headless)
+    uint32_t*				m_surface;		// frame buffer
+    uint32_t				m_frame_bytes;		// frame size (bytes)
+    uint32_t				m_line_bytes;		// line size (bytes, luminance)
+    char				m_fsm_str[8][20];	// FSM states names
+    char				m_blit_str[8][20];	// blitter FSM states names
+
+    // DIRTY TRACKING & REFRESH
+    bool				m_dirty;		// frame modified since last refresh
+    uint32_t				m_dirty_first;		// first dirty word
+    uint32_t				m_dirty_last;		// last dirty word
+    uint32_t				m_refresh_period;	// refresh period (ms)
+    uint64_t				m_last_refresh;		// last refresh date (ms)
+    uint64_t				c_refresh_count;	// display refreshs
+    uint64_t				c_skip_count;		// skipped refreshs (clean frame)
+    uint64_t				c_dump_count;		// dumped frames
+    uint64_t				c_blit_count;		// completed blitter operations
+    uint64_t				c_blit_words;		// words written by the blitter
+
+    // internal signals bound to the master ports (no blitter)
+    sc_core::sc_signal<bool>		m_nc_req;
+    sc_core::sc_signal<bool>		m_nc_gnt;
+    sc_core::sc_signal<bool>		m_nc_lock;
+    sc_core::sc_signal<bool>		m_nc_irq;
 
     // FSM states
     enum {
@@ -57,25 +154,79 @@ class PibusFrameBuffer : sc_core::sc_module {
 	FSM_READ_OK	= 2,
 	FSM_WRITE_WAIT	= 3,
 	FSM_WRITE_OK	= 4,
-	FSM_ERROR	= 5
+	FSM_ERROR	= 5,
+	FSM_REG_READ	= 6,
+	FSM_REG_WRITE	= 7,
+    };
+
+    // BLITTER FSM states
+    enum {
+	BLT_IDLE	= 0,
+	BLT_WAIT	= 1,
+	BLT_REQ		= 2,
+	BLT_AD		= 3,
+	BLT_DTAD	= 4,
+	BLT_DT		= 5,
+	BLT_SUCCESS	= 6,
+	BLT_ERROR	= 7,
+    };
+
+    // blitter registers
+    enum {
+	BLIT_SRC	= 0,
+	BLIT_DST	= 1,
+	BLIT_WIDTH	= 2,
+	BLIT_HEIGHT	= 3,
+	BLIT_SRC_PITCH	= 4,
+	BLIT_DST_PITCH	= 5,
+	BLIT_COLOR	= 6,
+	BLIT_CMD	= 7,
+    };
+
+    // blitter parameters
+    enum {
+	BLIT_BURST	= 16,		// max burst length (words)
+	BLIT_SPEED	= 4,		// FILL & COPY words per cycle
     };
 
+    void markDirty(uint32_t first, uint32_t last);
+    bool blitRectangle(uint32_t offset, uint32_t pitch);
+    int  blitStart();
+
 protected:
 
     SC_HAS_PROCESS(PibusFrameBuffer);
 
 public:
 
+    // blitter operations & status
+    enum {
+	BLIT_NOP	= 0,
+	BLIT_FILL	= 1,
+	BLIT_COPY	= 2,
+	BLIT_MEMCOPY	= 3,
+    };
+    enum {
+	BLIT_STATUS_IDLE	= 0,
+	BLIT_STATUS_BUSY	= 1,
+	BLIT_STATUS_SUCCESS	= 2,
+	BLIT_STATUS_ERROR	= 3,
+    };
+
     // IO PORTS
     sc_core::sc_in<bool> 		p_ck;
     sc_core::sc_in<bool> 		p_resetn;
+    sc_core::sc_out<bool>		p_req;
+    sc_core::sc_in<bool>		p_gnt;
     sc_core::sc_in<bool>		p_sel;
-    sc_core::sc_in<uint32_t>		p_a;
-    sc_core::sc_in<bool>		p_read;
-    sc_core::sc_in<uint32_t>		p_opc;
-    sc_core::sc_out<uint32_t>		p_ack;
+    sc_core::sc_inout<uint32_t>		p_a;
+    sc_core::sc_inout<bool>		p_read;
+    sc_core::sc_inout<uint32_t>		p_opc;
+    sc_core::sc_out<bool>		p_lock;
+    sc_core::sc_inout<uint32_t>		p_ack;
     sc_core::sc_inout<uint32_t>		p_d;
     sc_core::sc_in<bool>		p_tout;
+    sc_core::sc_out<bool>		p_irq;
 
     // constructor
     PibusFrameBuffer (sc_core::sc_module_name		name, 			// instance name
@@ -84,11 +235,22 @@ public:
 		uint32_t				latency, 		// access latency
 		uint32_t				width, 			// frame width
 		uint32_t				height, 		// frame height
-		int					subsampling = 420); 	// pixel format
+		int					subsampling = 420, 	// pixel format
+		bool					headless = false);	// no display
+    ~PibusFrameBuffer();
+
     // methods
     void transition();
     void genMoore();
     void printTrace();
+    void printStatistics();
+    void setRefreshPeriod(uint32_t ms) { m_refresh_period = ms; }
+    bool dumpFrame(const char* filename);
+
+    // checkpoint
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
 
 #ifdef SOCVIEW
     void registerDebug( SocviewDebugger db );
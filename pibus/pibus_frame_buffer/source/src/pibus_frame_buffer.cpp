@@ -6,7 +6,11 @@
 // Copyright : UPMC-LIP6
 ///////////////////////////////////////////////////////////
 
+#include <string.h>
+#include <sys/time.h>
+#include <algorithm>
 #include "pibus_frame_buffer.h"
+#include "alloc_elems.h"
 
 namespace soclib { namespace caba {
 
@@ -21,20 +25,30 @@ PibusFrameBuffer::PibusFrameBuffer (sc_module_name	name,
 				uint32_t		latency,
 				uint32_t		width,
 				uint32_t		height,
-				int			subsampling)
-    : m_name(name),
+				int			subsampling,
+				bool			headless)
+    : r_blit_reg(alloc_elems<sc_signal<uint32_t> >("r_blit_reg", 8)),
+      m_name(name),
       m_tgtid(tgtid),
       m_latency(latency),
-      m_fb_controller((const char*)name, width, height, subsampling),
+      m_width(width),
+      m_height(height),
+      m_subsampling(subsampling),
+      m_fb_controller(NULL),
+      m_refresh_period(40),
       p_ck("p_ck"),
       p_resetn("p_resetn"),
+      p_req("p_req"),
+      p_gnt("p_gnt"),
       p_sel("p_sel"),
       p_a("p_a"),
       p_read("p_read"),
       p_opc("p_opc"),
+      p_lock("p_lock"),
       p_ack("p_ack"),
       p_d("p_d"),
-      p_tout("p_tout")
+      p_tout("p_tout"),
+      p_irq("p_irq")
 {
     SC_METHOD (transition);
     sensitive_pos << p_ck;
@@ -43,10 +57,34 @@ PibusFrameBuffer::PibusFrameBuffer (sc_module_name	name,
     sensitive_neg << p_ck;
 
     // segments allocation
-    std::list<SegmentTableEntry> seglist = segtab.getTargetSegmentList(tgtid);
+    const std::list<SegmentTableEntry> &seglist = segtab.getTargetSegmentList(tgtid);
     m_segbase = (*seglist.begin()).getBase();
     m_segsize = (*seglist.begin()).getSize();
     m_segname = (*seglist.begin()).getName();
+
+    // optional blitter segment
+    m_regbase = 0;
+    m_regsize = 0;
+    if(seglist.size() > 1)
+    {
+        std::list<SegmentTableEntry>::const_iterator seg = seglist.begin();
+        seg++;
+        m_regbase = (*seg).getBase();
+        m_regsize = (*seg).getSize();
+        if(((m_regbase & 0x1F) != 0) || (m_regsize < 32))
+        {
+	    printf("ERROR in component PibusFrameBuffer %s\n", m_name);
+	    printf("The blitter segment must be 32 bytes aligned, and at least 32 bytes\n");
+	    exit(1);
+        }
+    }
+    else	// no blitter : the master ports are not used
+    {
+        p_req  (m_nc_req);
+        p_gnt  (m_nc_gnt);
+        p_lock (m_nc_lock);
+        p_irq  (m_nc_irq);
+    }
     
     if((m_segbase & 0x00000003) != 0x0) 
     {
@@ -61,21 +99,74 @@ PibusFrameBuffer::PibusFrameBuffer (sc_module_name	name,
 	exit(1);
     }
 
+    // frame & line sizes, depending on the pixel format
+    switch (subsampling) {
+    case 420 : m_frame_bytes = width*height*3/2; m_line_bytes = width;   break;
+    case 422 : m_frame_bytes = width*height*2;   m_line_bytes = width;   break;
+    case 16  : m_frame_bytes = width*height*2;   m_line_bytes = width*2; break;
+    case 32  : m_frame_bytes = width*height*4;   m_line_bytes = width*4; break;
+    default  : m_frame_bytes = width*height;     m_line_bytes = width;   break;
+    }
+    if(m_frame_bytes > m_segsize) m_frame_bytes = m_segsize;
+
+    if(headless)
+    {
+        m_surface = new uint32_t[(m_segsize + 3) >> 2];
+        memset(m_surface, 0, (m_segsize + 3) & ~3);
+    }
+    else
+    {
+        m_fb_controller = new FbController((const char*)name, width, height, subsampling);
+        m_surface       = m_fb_controller->surface();
+    }
+
     strcpy(m_fsm_str[0], "IDLE");
     strcpy(m_fsm_str[1], "READ_WAIT");
     strcpy(m_fsm_str[2], "READ_OK");
     strcpy(m_fsm_str[3], "WRITE_WAIT");
     strcpy(m_fsm_str[4], "WRITE_OK");
     strcpy(m_fsm_str[5], "ERROR");
+    strcpy(m_fsm_str[6], "REG_READ");
+    strcpy(m_fsm_str[7], "REG_WRITE");
+
+    strcpy(m_blit_str[0], "IDLE");
+    strcpy(m_blit_str[1], "WAIT");
+    strcpy(m_blit_str[2], "REQ");
+    strcpy(m_blit_str[3], "AD");
+    strcpy(m_blit_str[4], "DTAD");
+    strcpy(m_blit_str[5], "DT");
+    strcpy(m_blit_str[6], "SUCCESS");
+    strcpy(m_blit_str[7], "ERROR");
 
     std::cout << std::endl << "Instanciation of PibusFrameBuffer : " << m_name << std::endl;
     std::cout << "    latency = " << latency << std::endl;
+    std::cout << "    display = " << (headless ? "none (headless)" : "fb_controller") << std::endl;
     std::cout << "    segment " << m_segname << std::hex
               << " | base = 0x" << m_segbase
               << " | size = 0x" << m_segsize << std::endl;
+    if(m_regsize)
+    std::cout << "    blitter registers" << std::hex
+              << " | base = 0x" << m_regbase
+              << " | size = 0x" << m_regsize << std::endl;
 
 } // end constructor
 
+/////////////////////////////////////
+PibusFrameBuffer::~PibusFrameBuffer()
+{
+    if(m_fb_controller) delete m_fb_controller;
+    else                delete [] m_surface;
+    dealloc_elems(r_blit_reg, 8);
+} // end destructor
+
+///////////////////////////////////////
+static uint64_t wallclock_ms()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec*1000 + tv.tv_usec/1000;
+} // end wallclock_ms()
+
 ////////////////////////////////////////////////////////////////////////
 void write_buf(uint32_t* buf, size_t index, uint32_t data, uint32_t opc)
 {
@@ -122,6 +213,18 @@ void PibusFrameBuffer::transition()
     {
         r_fsm_state = FSM_IDLE;
         r_display = 0;
+        m_dirty         = true;		// first refresh
+        m_dirty_first   = 0;
+        m_dirty_last    = (m_frame_bytes >> 2) - 1;
+        m_last_refresh  = 0;
+        c_refresh_count = 0;
+        c_skip_count    = 0;
+        c_dump_count    = 0;
+        c_blit_count    = 0;
+        c_blit_words    = 0;
+        r_blit_fsm      = BLT_IDLE;
+        r_blit_go       = false;
+        for(size_t i = 0 ; i < 8 ; i++) r_blit_reg[i] = 0;
         return;
     } // end p_resetn
 
@@ -131,8 +234,14 @@ void PibusFrameBuffer::transition()
         if (p_sel == true) 
         {
             uint32_t address = ((uint32_t)p_a.read()) & 0xfffffffc; 
-            if ((address >= m_segbase) && (address < m_segbase + m_segsize)) 
-                { 
+            if ((address >= m_regbase) && (address < m_regbase + m_regsize)) 
+            {
+                r_word = ((address - m_regbase) >> 2) & 0x7;
+                if(p_read == true) r_fsm_state = FSM_REG_READ;
+                else               r_fsm_state = FSM_REG_WRITE;
+            }
+            else if ((address >= m_segbase) && (address < m_segbase + m_segsize)) 
+            { 
                 r_word  = (address - m_segbase) >> 2;
                 r_opc   = (int) p_opc.read();
                 r_counter = m_latency;
@@ -153,6 +262,24 @@ void PibusFrameBuffer::transition()
 	r_fsm_state = FSM_IDLE;
         break;
     }
+    case FSM_REG_READ :		// status read acknowledges the blitter IRQ
+    {
+        if((r_word.read() == BLIT_CMD) && 
+           ((r_blit_fsm.read() == BLT_SUCCESS) || (r_blit_fsm.read() == BLT_ERROR))) r_blit_go = false;
+	r_fsm_state = FSM_IDLE;
+        break;
+    }
+    case FSM_REG_WRITE :
+    {
+        if((r_blit_fsm.read() == BLT_IDLE) && (r_blit_go.read() == false))
+        {
+            uint32_t data = (uint32_t)p_d.read();
+            r_blit_reg[r_word.read()] = data;
+            if((r_word.read() == BLIT_CMD) && (data != BLIT_NOP)) r_blit_go = true;
+        }
+	r_fsm_state = FSM_IDLE;
+        break;
+    }
     case FSM_READ_WAIT :
     {
 	r_counter = r_counter - 1;
@@ -190,8 +317,16 @@ void PibusFrameBuffer::transition()
     case FSM_WRITE_OK :   
     {
 	uint32_t data     = (uint32_t)p_d.read(); 
-        uint32_t* buf     = m_fb_controller.surface();
-  	write_buf(buf, r_word, data, r_opc);
+        uint32_t word     = r_word.read();
+  	write_buf(m_surface, word, data, r_opc);
+        if(not m_dirty)
+        {
+            m_dirty       = true;
+            m_dirty_first = word;
+            m_dirty_last  = word;
+        }
+        else if(word < m_dirty_first) m_dirty_first = word;
+        else if(word > m_dirty_last)  m_dirty_last  = word;
 	if (p_sel == true) 
         { 
 	    uint32_t address = ((uint32_t)p_a.read()) & 0xfffffffc; 
@@ -204,6 +339,7 @@ void PibusFrameBuffer::transition()
             else 
             {
                 r_word = (address - m_segbase) >> 2;
+                r_opc  = (int) p_opc.read();	// byte enable of the next word
             } 
 	} 
         else 
@@ -214,10 +350,115 @@ void PibusFrameBuffer::transition()
     }
     } // end switch r_fsm_state
 
+    // The blitter FSM controls the r_blit_* registers, except 
+    // r_blit_reg[] and r_blit_go, that are written by the target FSM.
+    switch (r_blit_fsm) {
+    case BLT_IDLE :
+    {
+        if(r_blit_go.read()) r_blit_fsm = blitStart();
+        break;
+    }
+    case BLT_WAIT :
+    {
+        if(r_blit_count.read() == 0) r_blit_fsm = BLT_SUCCESS;
+        else                         r_blit_count = r_blit_count.read() - 1;
+        break;
+    }
+    case BLT_REQ :
+    {
+        if(p_gnt.read() == true)
+        {
+            uint32_t nwords = (r_blit_reg[BLIT_WIDTH].read() - r_blit_col.read()) >> 2;
+            if(nwords > BLIT_BURST) nwords = BLIT_BURST;
+            r_blit_burst = nwords;
+            r_blit_word  = 0;
+            r_blit_fsm   = BLT_AD;
+        }
+        break;
+    }
+    case BLT_AD :
+    {
+        r_blit_word = r_blit_word.read() + 1;
+        if(r_blit_burst.read() == 1) r_blit_fsm = BLT_DT;
+        else                         r_blit_fsm = BLT_DTAD;
+        break;
+    }
+    case BLT_DTAD :
+    case BLT_DT :
+    {
+        if(p_tout.read() || (p_ack.read() == PIBUS_ACK_ERROR))
+        {
+            r_blit_fsm = BLT_ERROR;
+        }
+        else if(p_ack.read() == PIBUS_ACK_RETRY)	// restart the burst
+        {
+            r_blit_fsm = BLT_REQ;
+        }
+        else if(p_ack.read() == PIBUS_ACK_READY)
+        {
+            uint32_t line   = r_blit_line.read();
+            uint32_t col    = r_blit_col.read();
+            uint32_t offset = r_blit_reg[BLIT_DST].read() + 
+                              line*r_blit_reg[BLIT_DST_PITCH].read() + col;
+            m_surface[(offset >> 2) + r_blit_word.read() - 1] = (uint32_t)p_d.read();
+            if(r_blit_fsm.read() == BLT_DTAD)
+            {
+                r_blit_word = r_blit_word.read() + 1;
+                if(r_blit_word.read() == r_blit_burst.read() - 1) r_blit_fsm = BLT_DT;
+            }
+            else	// last word of the burst
+            {
+                c_blit_words = c_blit_words + r_blit_burst.read();
+                markDirty(offset >> 2, (offset >> 2) + r_blit_burst.read() - 1);
+                col = col + (r_blit_burst.read() << 2);
+                if(col == r_blit_reg[BLIT_WIDTH].read())
+                {
+                    col  = 0;
+                    line = line + 1;
+                }
+                r_blit_col  = col;
+                r_blit_line = line;
+                if(line == r_blit_reg[BLIT_HEIGHT].read()) r_blit_fsm = BLT_SUCCESS;
+                else                                       r_blit_fsm = BLT_REQ;
+            }
+        }
+        break;
+    }
+    case BLT_SUCCESS :
+    case BLT_ERROR :
+    {
+        if(r_blit_go.read() == false) 
+        {
+            c_blit_count++;
+            r_blit_fsm = BLT_IDLE;
+        }
+        break;
+    }
+    } // end switch r_blit_fsm
+
+    // the display is refreshed if the refresh period is elapsed
+    // and the frame has been modified
     if(r_display == 0)
     {
-        m_fb_controller.update();
         r_display = 1000;
+        if(m_fb_controller)
+        {
+            uint64_t now = wallclock_ms();
+            if(now - m_last_refresh >= m_refresh_period)
+            {
+                m_last_refresh = now;
+                if(m_dirty)
+                {
+                    m_fb_controller->update();
+                    m_dirty = false;
+                    c_refresh_count++;
+                }
+                else
+                {
+                    c_skip_count++;
+                }
+            }
+        }
     }
     else
     {
@@ -241,8 +482,7 @@ void PibusFrameBuffer::genMoore()
     case FSM_READ_OK :
     {
         p_ack = PIBUS_ACK_READY;
-        uint32_t* buf = m_fb_controller.surface();
-        p_d = buf[r_word];
+        p_d = m_surface[r_word];
         break;
     }
     case FSM_WRITE_WAIT :
@@ -251,15 +491,228 @@ void PibusFrameBuffer::genMoore()
     case FSM_WRITE_OK :
         p_ack = PIBUS_ACK_READY;
         break;
+    case FSM_REG_READ :
+    {
+        p_ack = PIBUS_ACK_READY;
+        if(r_word.read() != BLIT_CMD) p_d = r_blit_reg[r_word.read()].read();
+        else if(r_blit_fsm.read() == BLT_SUCCESS) p_d = BLIT_STATUS_SUCCESS;
+        else if(r_blit_fsm.read() == BLT_ERROR)   p_d = BLIT_STATUS_ERROR;
+        else if((r_blit_fsm.read() == BLT_IDLE) && 
+                (r_blit_go.read() == false))      p_d = BLIT_STATUS_IDLE;
+        else                                      p_d = BLIT_STATUS_BUSY;
+        break;
+    }
+    case FSM_REG_WRITE :
+        p_ack = PIBUS_ACK_READY;
+        break;
     } 
+
+    // master port (MEMCOPY)
+    p_req = (r_blit_fsm.read() == BLT_REQ);
+    if((r_blit_fsm.read() == BLT_AD) || (r_blit_fsm.read() == BLT_DTAD))
+    {
+        p_a    = r_blit_reg[BLIT_SRC].read() + 
+                 r_blit_line.read()*r_blit_reg[BLIT_SRC_PITCH].read() + 
+                 r_blit_col.read() + (r_blit_word.read() << 2);
+        p_opc  = PIBUS_OPC_WDU;
+        p_read = true;
+        p_lock = (r_blit_word.read() != r_blit_burst.read() - 1);
+    }
+
+    // IRQ signal
+    p_irq = (r_blit_fsm.read() == BLT_SUCCESS) || (r_blit_fsm.read() == BLT_ERROR);
 } // end genMoore()
 
+/////////////////////////////////////////////////////////////////
+// This function extends the dirty range to words [first, last].
+/////////////////////////////////////////////////////////////////
+void PibusFrameBuffer::markDirty(uint32_t first, uint32_t last)
+{
+    if(not m_dirty)
+    {
+        m_dirty       = true;
+        m_dirty_first = first;
+        m_dirty_last  = last;
+    }
+    else
+    {
+        if(first < m_dirty_first) m_dirty_first = first;
+        if(last > m_dirty_last)   m_dirty_last  = last;
+    }
+} // end markDirty()
+
+/////////////////////////////////////////////////////////////////
+// This function returns true if the rectangle defined by its 
+// byte offset in the frame buffer, its pitch, and the WIDTH & 
+// HEIGHT registers, is word aligned and contained in the segment.
+/////////////////////////////////////////////////////////////////
+bool PibusFrameBuffer::blitRectangle(uint32_t offset, uint32_t pitch)
+{
+    uint32_t width  = r_blit_reg[BLIT_WIDTH].read();
+    uint32_t height = r_blit_reg[BLIT_HEIGHT].read();
+    if(((offset | pitch | width) & 0x3) != 0) return false;
+    return ((uint64_t)offset + (uint64_t)(height - 1)*pitch + width) <= m_segsize;
+} // end blitRectangle()
+
+/////////////////////////////////////////////////////////////////
+// This function starts the command defined by the blitter 
+// registers, and returns the next blitter FSM state :
+// the FILL and COPY commands are executed on the host, and the
+// duration is modeled by the BLT_WAIT state.
+/////////////////////////////////////////////////////////////////
+int PibusFrameBuffer::blitStart()
+{
+    uint32_t cmd    = r_blit_reg[BLIT_CMD].read();
+    uint32_t src    = r_blit_reg[BLIT_SRC].read();
+    uint32_t dst    = r_blit_reg[BLIT_DST].read();
+    uint32_t width  = r_blit_reg[BLIT_WIDTH].read();
+    uint32_t height = r_blit_reg[BLIT_HEIGHT].read();
+    uint32_t spitch = r_blit_reg[BLIT_SRC_PITCH].read();
+    uint32_t dpitch = r_blit_reg[BLIT_DST_PITCH].read();
+    uint32_t nwords = width >> 2;
+
+    if((width == 0) || (height == 0))                  return BLT_SUCCESS;
+    if(not blitRectangle(dst, dpitch))                 return BLT_ERROR;
+
+    switch (cmd) {
+    case BLIT_FILL :
+    {
+        uint32_t color = r_blit_reg[BLIT_COLOR].read();
+        for(uint32_t l = 0 ; l < height ; l++)
+        {
+            uint32_t* line = m_surface + ((dst + l*dpitch) >> 2);
+            std::fill(line, line + nwords, color);
+        }
+        break;
+    }
+    case BLIT_COPY :
+    {
+        if(not blitRectangle(src, spitch))             return BLT_ERROR;
+        bool up = (dst > src);		// copy the last line first
+        for(uint32_t n = 0 ; n < height ; n++)
+        {
+            uint32_t l = up ? (height - 1 - n) : n;
+            memmove(m_surface + ((dst + l*dpitch) >> 2),
+                    m_surface + ((src + l*spitch) >> 2), width);
+        }
+        break;
+    }
+    case BLIT_MEMCOPY :
+    {
+        if(((src | spitch) & 0x3) != 0)                return BLT_ERROR;
+        r_blit_line = 0;
+        r_blit_col  = 0;
+        return BLT_REQ;
+    }
+    default :
+        return BLT_ERROR;
+    }
+    c_blit_words = c_blit_words + (uint64_t)nwords*height;
+    markDirty(dst >> 2, (dst + (height - 1)*dpitch + width - 4) >> 2);
+    r_blit_count = (nwords*height)/BLIT_SPEED + m_latency;
+    return BLT_WAIT;
+} // end blitStart()
+
 /////////////////////////////////
 void PibusFrameBuffer::printTrace()
 {
-    std::cout << m_name << " : " << m_fsm_str[r_fsm_state] << std::endl;
+    std::cout << m_name << " : " << m_fsm_str[r_fsm_state];
+    if(m_regsize) std::cout << " / blitter : " << m_blit_str[r_blit_fsm.read()];
+    if(m_dirty) std::cout << " / dirty lines " << std::dec 
+                          << (m_dirty_first << 2)/m_line_bytes << " to " 
+                          << (m_dirty_last << 2)/m_line_bytes;
+    std::cout << std::endl;
 } // end print()
 
+//////////////////////////////////////////
+void PibusFrameBuffer::printStatistics()
+{
+    std::cout << "*** " << m_name << " statistics" << std::endl;
+    std::cout << "    refreshs         = " << std::dec << c_refresh_count << std::endl;
+    std::cout << "    skipped refreshs = " << c_skip_count << std::endl;
+    std::cout << "    dumped frames    = " << c_dump_count << std::endl;
+    std::cout << "    blitter commands = " << c_blit_count << std::endl;
+    std::cout << "    blitter words    = " << c_blit_words << std::endl;
+} // end printStatistics()
+
+//////////////////////////////////////////////////////////
+// This function writes the frame (raw pixels) to a file.
+// It returns false if the file cannot be written.
+//////////////////////////////////////////////////////////
+bool PibusFrameBuffer::dumpFrame(const char* filename)
+{
+    FILE* file = fopen(filename, "wb");
+    if(file == NULL)
+    {
+        std::cout << "Warning: frame buffer " << m_name 
+                  << " cannot open the file " << filename << std::endl;
+        return false;
+    }
+    bool ok = (fwrite(m_surface, 1, m_frame_bytes, file) == m_frame_bytes);
+    fclose(file);
+    if(ok) c_dump_count++;
+    return ok;
+} // end dumpFrame()
+
+//////////////////////////////////////////
+bool PibusFrameBuffer::checkpointReady()
+{
+    int blit = r_blit_fsm.read();
+    return (r_fsm_state == FSM_IDLE) && 
+           (blit != BLT_AD) && (blit != BLT_DTAD) && (blit != BLT_DT);
+}
+////////////////////////////////////////////////////////////////////
+void PibusFrameBuffer::saveState(PibusCheckpointWriter &writer)
+{
+    writer.put(m_frame_bytes);
+    writer.put(m_regsize);
+    writer.put(r_fsm_state);
+    writer.put(r_counter);
+    writer.put(r_display);
+    writer.put(r_word);
+    writer.put(r_opc);
+    writer.put(r_blit_fsm);
+    for(size_t i = 0 ; i < 8 ; i++) writer.put(r_blit_reg[i]);
+    writer.put(r_blit_go);
+    writer.put(r_blit_count);
+    writer.put(r_blit_line);
+    writer.put(r_blit_col);
+    writer.put(r_blit_word);
+    writer.put(r_blit_burst);
+    writer.putArray((const char*)m_surface, m_frame_bytes);
+}
+////////////////////////////////////////////////////////////////////
+void PibusFrameBuffer::restoreState(PibusCheckpointReader &reader)
+{
+    uint32_t frame_bytes;
+    uint32_t regsize;
+    reader.get(frame_bytes);
+    reader.get(regsize);
+    if((frame_bytes != m_frame_bytes) || (regsize != m_regsize))
+    {
+	printf("ERROR in component PibusFrameBuffer %s\n", m_name);
+	printf("The checkpoint frame size or blitter segment does not match\n");
+	exit(1);
+    }
+    reader.get(r_fsm_state);
+    reader.get(r_counter);
+    reader.get(r_display);
+    reader.get(r_word);
+    reader.get(r_opc);
+    reader.get(r_blit_fsm);
+    for(size_t i = 0 ; i < 8 ; i++) reader.get(r_blit_reg[i]);
+    reader.get(r_blit_go);
+    reader.get(r_blit_count);
+    reader.get(r_blit_line);
+    reader.get(r_blit_col);
+    reader.get(r_blit_word);
+    reader.get(r_blit_burst);
+    reader.getArray((char*)m_surface, m_frame_bytes);
+    m_dirty       = true;
+    m_dirty_first = 0;
+    m_dirty_last  = (m_frame_bytes >> 2) - 1;
+}
+
 #ifdef SOCVIEW
 
 /////////////////////////////////////////////////////
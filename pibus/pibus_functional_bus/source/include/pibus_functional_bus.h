@@ -0,0 +1,278 @@
+///////////////////////////////////////////////////////////////////////////
+// File : pibus_functional_bus.h
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// This object implements a functional (transaction level) PIBUS, used
+// to "fast-forward" a simulation (typically the operating system boot)
+// before the region of interest is simulated cycle by cycle.
+//
+// In fast-forward mode, the masters do not use the PIBUS signals:
+// they call directly the read() & write() methods of the functional bus,
+// that decodes the address with the Target ROM built from the
+// PibusSegmentTable (as the PIBUS_BCU), and calls the functionalRead()
+// and functionalWrite() methods of the selected target.
+// There is no arbitration, and no per-cycle signal evaluation.
+// A target supporting the functional access must implement the
+// PibusFunctionalTarget interface, and must be registered with the
+// registerTarget() method. An access to a target that has not been
+// registered is not supported : the master must perform this access
+// with a normal (cycle-accurate) PIBUS transaction.
+//
+// The LL/SC reservations are handled by the functional bus : there is
+// one reservation per master (registered with registerMaster()),
+// and a reservation is cancelled by any functional write from another
+// master to the reserved address.
+//
+// The functional bus is active from the beginning of the simulation.
+// It is definitely stopped (and all masters switch to cycle-accurate
+// mode) when one of the following conditions is satisfied:
+// - a master reaches the processor cycle defined by setSwitchCycle(),
+// - a master fetches the instruction defined by setSwitchPc(),
+// - the stop() method is called (for example by the top cell).
+// The masters hand over their state (LL/SC reservation) when they
+// switch to cycle-accurate mode (see getReservation()).
+//
+// The quantum is the number of processor cycles executed by each
+// master in fast-forward mode during one simulation cycle.
+// The targets that are not accessed functionally (timers, ...)
+// are still clocked once per simulation cycle.
+///////////////////////////////////////////////////////////////////////////
+// The constructor has 2 parameters :
+// - PibusSegmentTable	segtab		: segment table
+// - uint32_t		quantum		: processor cycles per simulation cycle
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef PIBUS_FUNCTIONAL_BUS_H
+#define PIBUS_FUNCTIONAL_BUS_H
+
+#include <vector>
+#include <stdint.h>
+#include <iostream>
+#include <cstdlib>
+#include "pibus_segment_table.h"
+#include "pibus_mnemonics.h"
+
+namespace soclib { namespace caba {
+
+using namespace soclib::common;
+
+//////////////////////////////////////////////////////////////////////////////////
+//			PibusFunctionalTarget definition
+//////////////////////////////////////////////////////////////////////////////////
+// Both methods return false in case of bus error (segmentation violation,
+// or illegal access). The burst argument is a number of words, and the
+// address of the first word must be word aligned. For a write, the opc
+// argument is the PIBUS OPC field (WDU, HW0, HW1, BY0, BY1, BY2, BY3)
+// and is used for all words of the burst.
+//////////////////////////////////////////////////////////////////////////////////
+
+class PibusFunctionalTarget {
+
+public:
+
+virtual ~PibusFunctionalTarget() {}
+
+virtual bool functionalRead(uint32_t	address,
+			    uint32_t*	data,
+			    uint32_t	opc,
+			    size_t	burst) = 0;
+
+virtual bool functionalWrite(uint32_t		address,
+			     const uint32_t*	data,
+			     uint32_t		opc,
+			     size_t		burst) = 0;
+
+}; // end class PibusFunctionalTarget
+
+//////////////////////////////////////////////////////////////////////////////////
+//			PibusFunctionalBus definition
+//////////////////////////////////////////////////////////////////////////////////
+
+class PibusFunctionalBus {
+
+const size_t*				m_target_table;	// MSB to tgtid transcoding ROM
+std::vector<PibusFunctionalTarget*>	m_targets;	// registered targets (indexed by tgtid)
+std::vector<bool>			m_llsc_valid;	// LL reservations (indexed by master)
+std::vector<uint32_t>			m_llsc_addr;	// LL addresses (indexed by master)
+const uint32_t				m_quantum;	// processor cycles per simulation cycle
+bool					m_active;	// fast-forward mode
+bool					m_switch_cycle_ok;
+uint64_t				m_switch_cycle;
+bool					m_switch_pc_ok;
+uint32_t				m_switch_pc;
+uint64_t				c_read_count;	// number of read words
+uint64_t				c_write_count;	// number of written words
+
+public:
+
+//////////////////////////////////////////////////////
+PibusFunctionalBus( PibusSegmentTable	&segtab,
+		    uint32_t		quantum = 1 )
+	: m_target_table(segtab.getDecodeRom().getTargetTable()),
+	  m_targets(32, (PibusFunctionalTarget*)NULL),
+	  m_quantum(quantum),
+	  m_active(true),
+	  m_switch_cycle_ok(false),
+	  m_switch_cycle(0),
+	  m_switch_pc_ok(false),
+	  m_switch_pc(0),
+	  c_read_count(0),
+	  c_write_count(0)
+{
+	if (quantum == 0)
+	{
+		std::cerr << "ERROR in PibusFunctionalBus" << std::endl;
+		std::cerr << "The quantum argument cannot be 0" << std::endl;
+		exit(0);
+	}
+}; // end constructor
+
+//////////////////////////////////////////////////////////////////
+void registerTarget(size_t tgtid, PibusFunctionalTarget* target)
+{
+	if (tgtid >= m_targets.size())
+	{
+		std::cerr << "ERROR in PibusFunctionalBus" << std::endl;
+		std::cerr << "The target index cannot be larger than 31" << std::endl;
+		exit(0);
+	}
+	m_targets[tgtid] = target;
+};
+////////////////////////
+size_t registerMaster()
+{
+	m_llsc_valid.push_back(false);
+	m_llsc_addr.push_back(0);
+	return m_llsc_valid.size() - 1;
+};
+////////////////////////////////////
+void setSwitchCycle(uint64_t cycle)
+{
+	m_switch_cycle_ok = true;
+	m_switch_cycle    = cycle;
+};
+////////////////////////////////
+void setSwitchPc(uint32_t pc)
+{
+	m_switch_pc_ok = true;
+	m_switch_pc    = pc;
+};
+///////////
+void stop()
+{
+	m_active = false;
+};
+////////////////////////
+bool isActive() const
+{
+	return m_active;
+};
+////////////////////////////
+uint32_t getQuantum() const
+{
+	return m_quantum;
+};
+///////////////////////////////////////////////
+// returns true if the target selected by the
+// address can be accessed functionally.
+///////////////////////////////////////////////
+bool isSupported(uint32_t address) const
+{
+	return m_targets[m_target_table[address >> PIBUS_DECODE_SHIFT]] != NULL;
+};
+/////////////////////////////////////////////////////////////
+// This method is called by the masters before each
+// instruction fetch. It stops the functional bus, and
+// returns true, when a switch condition is satisfied.
+/////////////////////////////////////////////////////////////
+bool checkSwitch(uint64_t cycle, uint32_t pc)
+{
+	if ( m_active &&
+	     ((m_switch_cycle_ok && (cycle >= m_switch_cycle)) ||
+	      (m_switch_pc_ok && (pc == m_switch_pc))) )
+	{
+		std::cout << "PibusFunctionalBus : switch to cycle-accurate mode"
+			  << std::dec << " at cycle " << cycle
+			  << std::hex << " / pc = 0x" << pc << std::dec << std::endl;
+		m_active = false;
+	}
+	return not m_active;
+};
+//////////////////////////////////////////////////////////////
+bool read(size_t	master,
+	  uint32_t	address,
+	  uint32_t*	data,
+	  uint32_t	opc,
+	  size_t	burst)
+{
+	PibusFunctionalTarget* target = m_targets[m_target_table[address >> PIBUS_DECODE_SHIFT]];
+	c_read_count = c_read_count + burst;
+	return target->functionalRead(address & 0xFFFFFFFC, data, opc, burst);
+};
+//////////////////////////////////////////////////////////////
+bool write(size_t		master,
+	   uint32_t		address,
+	   const uint32_t*	data,
+	   uint32_t		opc,
+	   size_t		burst)
+{
+	PibusFunctionalTarget* target = m_targets[m_target_table[address >> PIBUS_DECODE_SHIFT]];
+	uint32_t first = address & 0xFFFFFFFC;
+	// cancel the reservations of the other masters
+	for (size_t i = 0 ; i < m_llsc_valid.size() ; i++)
+	{
+		if ( (i != master) && m_llsc_valid[i] &&
+		     ((m_llsc_addr[i] & 0xFFFFFFFC) - first < 4*burst) ) m_llsc_valid[i] = false;
+	}
+	c_write_count = c_write_count + burst;
+	return target->functionalWrite(first, data, opc, burst);
+};
+////////////////////////////////////////////////////////
+// LL : read and register a reservation
+////////////////////////////////////////////////////////
+bool linkedLoad(size_t master, uint32_t address, uint32_t* data)
+{
+	m_llsc_valid[master] = true;
+	m_llsc_addr[master]  = address;
+	return read(master, address, data, PIBUS_OPC_WDU, 1);
+};
+////////////////////////////////////////////////////////
+// SC : write if the reservation is still valid.
+// The reservation is cancelled in both cases.
+////////////////////////////////////////////////////////
+bool storeConditional(size_t master, uint32_t address, uint32_t data, bool* atomic)
+{
+	*atomic = m_llsc_valid[master] && (m_llsc_addr[master] == address);
+	m_llsc_valid[master] = false;
+	if ( not *atomic ) return true;
+	return write(master, address, &data, PIBUS_OPC_WDU, 1);
+};
+//////////////////////////////////////////////////////////////////////////
+// state hand over between the functional and the cycle-accurate modes
+//////////////////////////////////////////////////////////////////////////
+bool getReservation(size_t master, uint32_t* address) const
+{
+	*address = m_llsc_addr[master];
+	return m_llsc_valid[master];
+};
+////////////////////////////////////////////////////////////////////
+void setReservation(size_t master, bool valid, uint32_t address)
+{
+	m_llsc_valid[master] = valid;
+	m_llsc_addr[master]  = address;
+};
+//////////////////////
+void printStatistics()
+{
+	std::cout << "PibusFunctionalBus : Statistics" << std::dec << std::endl;
+	std::cout << "- READ WORDS  = " << c_read_count  << std::endl;
+	std::cout << "- WRITE WORDS = " << c_write_count << std::endl;
+};
+
+}; // end class PibusFunctionalBus
+
+}} // end namespaces
+
+#endif
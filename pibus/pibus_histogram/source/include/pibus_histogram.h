@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////
+// File : pibus_histogram.h
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// This object is an instrumentation histogram, used by the PIBUS
+// components to report latencies (number of cycles).
+// The buckets have a logarithmic width :
+// - bucket 0 contains the 0 values,
+// - bucket k (k > 0) contains the values in [2**(k-1) , 2**k[.
+// The last bucket contains all values larger than its lower bound.
+// The number of samples, the sum and the maximum value are also
+// registered, to compute the mean value.
+// The percentiles are estimated by linear interpolation inside
+// the selected bucket (the error is bounded by the bucket width).
+// The cost of the add() method is a few instructions, and the
+// histogram can be used in long simulations.
+///////////////////////////////////////////////////////////////////////////
+// The constructor has 1 parameter :
+// - size_t	nbuckets	: number of buckets (default = 32)
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef PIBUS_HISTOGRAM_H
+#define PIBUS_HISTOGRAM_H
+
+#include <vector>
+#include <stdint.h>
+#include <iostream>
+
+namespace soclib { namespace caba {
+
+class PibusHistogram {
+
+std::vector<uint64_t>	m_buckets;	// number of samples per bucket
+uint64_t		m_count;	// total number of samples
+uint64_t		m_sum;		// sum of all samples
+uint64_t		m_max;		// largest sample
+
+public:
+
+//////////////////////////////////////
+PibusHistogram(size_t nbuckets = 32)
+	: m_buckets(nbuckets < 2 ? 2 : nbuckets, 0),
+	  m_count(0),
+	  m_sum(0),
+	  m_max(0)
+{
+};
+
+////////////
+void reset()
+{
+	for (size_t k = 0 ; k < m_buckets.size() ; k++) m_buckets[k] = 0;
+	m_count = 0;
+	m_sum   = 0;
+	m_max   = 0;
+};
+///////////////////////////////////////////
+// bucket index : number of significant bits
+///////////////////////////////////////////
+size_t getIndex(uint64_t value) const
+{
+	size_t k = (value == 0) ? 0 : 64 - __builtin_clzll(value);
+	return (k < m_buckets.size()) ? k : m_buckets.size() - 1;
+};
+//////////////////////////
+void add(uint64_t value)
+{
+	m_buckets[getIndex(value)]++;
+	m_count++;
+	m_sum = m_sum + value;
+	if (value > m_max) m_max = value;
+};
+//////////////////////////////
+size_t getNBuckets() const
+{
+	return m_buckets.size();
+};
+//////////////////////////////////////
+uint64_t getBucket(size_t k) const
+{
+	return m_buckets[k];
+};
+///////////////////////////////////////////
+// lower bound of the values in bucket k
+///////////////////////////////////////////
+uint64_t getLowerBound(size_t k) const
+{
+	return (k == 0) ? 0 : (uint64_t)1 << (k - 1);
+};
+///////////////////////////
+uint64_t getCount() const
+{
+	return m_count;
+};
+/////////////////////////
+uint64_t getSum() const
+{
+	return m_sum;
+};
+/////////////////////////
+uint64_t getMax() const
+{
+	return m_max;
+};
+////////////////////////
+double getMean() const
+{
+	return (m_count == 0) ? 0.0 : (double)m_sum / (double)m_count;
+};
+///////////////////////////////////////////////////
+// estimated value such that a fraction p of the
+// samples are smaller (0.0 <= p <= 1.0)
+///////////////////////////////////////////////////
+double getPercentile(double p) const
+{
+	if (m_count == 0) return 0.0;
+	double rank = p * (double)m_count;
+	uint64_t cumul = 0;
+	for (size_t k = 0 ; k < m_buckets.size() ; k++)
+	{
+		if (m_buckets[k] == 0) continue;
+		if ((double)(cumul + m_buckets[k]) >= rank)
+		{
+			double low  = (double)getLowerBound(k);
+			double high = (k == m_buckets.size() - 1) ? (double)m_max + 1.0
+							       : (double)getLowerBound(k + 1);
+			if (high > (double)m_max + 1.0) high = (double)m_max + 1.0;
+			double value = low + (high - low) * (rank - (double)cumul) / (double)m_buckets[k];
+			return (value > (double)m_max) ? (double)m_max : value;
+		}
+		cumul = cumul + m_buckets[k];
+	}
+	return (double)m_max;
+};
+/////////////////////////////////////////////////////////
+// prints the non empty buckets, with the
+//  [lower_bound , upper_bound[ : count  format
+/////////////////////////////////////////////////////////
+void print(std::ostream &o) const
+{
+	o << "n = " << std::dec << m_count
+	  << " , mean = " << getMean()
+	  << " , p50 = " << getPercentile(0.50)
+	  << " , p90 = " << getPercentile(0.90)
+	  << " , p99 = " << getPercentile(0.99)
+	  << " , max = " << m_max << std::endl;
+	for (size_t k = 0 ; k < m_buckets.size() ; k++)
+	{
+		if (m_buckets[k] == 0) continue;
+		o << "    [" << getLowerBound(k) << " , ";
+		if (k == m_buckets.size() - 1) o << "...";
+		else                            o << getLowerBound(k + 1);
+		o << "[ : " << m_buckets[k] << std::endl;
+	}
+};
+//////////////////////////////////////////////////////////////////
+// prints a JSON object : the non empty buckets are registered
+// as [lower_bound , count] pairs
+//////////////////////////////////////////////////////////////////
+void printJson(std::ostream &o) const
+{
+	o << "{ \"count\": " << std::dec << m_count
+	  << ", \"mean\": " << getMean()
+	  << ", \"p50\": " << getPercentile(0.50)
+	  << ", \"p90\": " << getPercentile(0.90)
+	  << ", \"p99\": " << getPercentile(0.99)
+	  << ", \"max\": " << m_max
+	  << ", \"buckets\": [";
+	bool first = true;
+	for (size_t k = 0 ; k < m_buckets.size() ; k++)
+	{
+		if (m_buckets[k] == 0) continue;
+		if (not first) o << ", ";
+		o << "[" << getLowerBound(k) << ", " << m_buckets[k] << "]";
+		first = false;
+	}
+	o << "] }";
+};
+
+}; // end class PibusHistogram
+
+}} // end namespaces
+
+#endif
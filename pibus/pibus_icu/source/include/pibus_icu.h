@@ -7,7 +7,7 @@
 ////////////////////////////////////////////////////////////////////////////////////
 // This component implements a vectorised interrupt controler and router,
 // as a PIBUS target. It concentrates up to 32 input interrupt requests
-// IRQ_IN[NIRQ] and controls up to 8 output interrupt signals IRQ_OUT[NPROC].
+// IRQ_IN[NIRQ] and controls up to 32 output interrupt signals IRQ_OUT[NPROC].
 // The NIRQ parameter defines the number of input IRQs.
 // The NPROC parameter defines the number of output IRQs.
 // This component emulates NPROC independant single output ICUs.
@@ -17,17 +17,35 @@
 // to the proper output IRQ, i.e. to the proper processor. 
 // IN_IRQ[i] is enabled when the corresponding mask bit is set to 1.
 //
+// Each input IRQ has a priority level, in the range [0 , 7] : the ICU_IT_VECTOR
+// register returns the index of the active IRQ with the highest level, and 
+// the smallest index amongst the active IRQs of this level. All input IRQs
+// have the level 0 after reset, and the vector is then the smallest active IRQ.
+// The input IRQs are packed in a 32 bits word, and each output is resolved
+// by a mask & pending operation, and a count trailing zeros.
+//
 // This component takes 32 * NPROC bytes in the address space.
 // Each single output ICU is seen as 5  memory mapped registers :
 // - ICU_INT 	   	(0x00)	(Read-Only)   returns the the 32 input IRQs.
 // - ICU_MASK 	  	(0x04)	(Read-Only)   returns the current mask value.
 // - ICU_MASK_SET 	(0x08)	(Write-Only)  mask <= mask | wdata.
 // - ICU_MASK_RESET	(0x0C)	(Write-Only)  mask <= mask & ~wdata.
-// - ICU_IT_VECTOR	(0x10)	(Read-Only)   index of the smallest active IRQ.
+// - ICU_IT_VECTOR	(0x10)	(Read-Only)   index of the highest priority active IRQ.
 // 	(if there is no active IRQ, the returned value is 32).
+// The priority levels are seen as NIRQ memory mapped registers, that are
+// shared by all outputs, and can only be accessed if the segment size is
+// at least 0x400 + 4 * NIRQ bytes (the size of 32 single output ICUs, plus
+// the priority registers) :
+// - ICU_PRIO[k]	(0x400 + 4*k) (Read/Write) priority level of IRQ_IN[k].
 // 
 // This component cheks address for segmentation violation,
 // and can be used as a default target.
+// When the PIBUS_CLOCK_GATING flag is defined, the transition() and
+// genMoore() methods are not evaluated when the FSM is IDLE (see the
+// PibusSimpleRam component). The genMealy() method, computing the
+// output IRQs, is not modified.
+// This component implements the PibusCheckpointable interface, and
+// can be checkpointed when the FSM is IDLE.
 //////////////////////////////////////////////////////////////////////////////////
 // This component has 5 "generator" parameters :
 // - sc_module_name	name    : instance name
@@ -43,10 +61,11 @@
 #include <systemc.h>
 #include "pibus_mnemonics.h"
 #include "pibus_segment_table.h"
+#include "pibus_checkpoint.h"
 
 namespace soclib { namespace caba {
 
-class PibusIcu : sc_module {
+class PibusIcu : sc_module, public PibusCheckpointable {
 
     // Structural parameters
     const char*                 m_name;                 // instance name
@@ -56,11 +75,14 @@ class PibusIcu : sc_module {
     uint32_t                    m_segbase;              // segment base address
     uint32_t                    m_segsize;              // segment size
     const char*                 m_segname;              // segment name
-    char			m_fsm_str[7][20];	// FSM states names
+    char			m_fsm_str[9][20];	// FSM states names
+    bool			m_sleep_transition;	// transition() is not clocked (clock gating)
+    bool			m_sleep_moore;		// genMoore() is not clocked (clock gating)
 
     // 	REGISTERS
     sc_register<uint32_t>	r_index;		// index of the selected output
-    sc_register<uint32_t> 	r_mask[8];		// interrupt masks for the 8 outputs
+    sc_register<uint32_t> 	r_mask[32];		// interrupt masks for the 32 outputs
+    sc_register<uint32_t> 	r_level[8];		// input IRQs for each priority level
     sc_register<int>		r_fsm_state;		// FSM State
 
     // FSM states
@@ -72,6 +94,8 @@ class PibusIcu : sc_module {
     FSM_SET_MASK	= 0x4,
     FSM_RESET_MASK	= 0x5,
     FSM_ERROR         	= 0x6,
+    FSM_READ_PRIO	= 0x7,
+    FSM_WRITE_PRIO	= 0x8,
     };
 
     // Registers mapping
@@ -81,8 +105,17 @@ class PibusIcu : sc_module {
     ICU_MASK_SET      	= 0x8,				// write only
     ICU_MASK_CLEAR    	= 0xC,				// write only
     ICU_IT_VECTOR    	= 0x10,				// read_only
+    ICU_PRIO		= 0x400,			// read/write (first priority)
+    };
+
+    // Priority levels
+    enum {
+    ICU_LEVELS		= 8,
     };
 
+    uint32_t inputs();
+    uint32_t vector(uint32_t pending);
+
 protected:
 
     SC_HAS_PROCESS(PibusIcu);
@@ -115,6 +148,11 @@ public:
     void genMealy();
     void printTrace();
 
+    // checkpoint
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
+
 }; // end PibusIcu
 
 }} // end namespace
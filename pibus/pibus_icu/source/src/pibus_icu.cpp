@@ -53,17 +53,22 @@ PibusIcu::PibusIcu(sc_module_name		insname,
     strcpy (m_fsm_str[4], "SET_MASK");
     strcpy (m_fsm_str[5], "RESET_MASK");
     strcpy (m_fsm_str[6], "ERROR");
+    strcpy (m_fsm_str[7], "READ_PRIO");
+    strcpy (m_fsm_str[8], "WRITE_PRIO");
+
+    m_sleep_transition = false;
+    m_sleep_moore      = false;
 
     // get the base address & segment size
-    std::list<SegmentTableEntry> seglist = segtab.getTargetSegmentList(tgtid);
+    const std::list<SegmentTableEntry> &seglist = segtab.getTargetSegmentList(tgtid);
     m_segbase = (*seglist.begin()).getBase();
     m_segsize = (*seglist.begin()).getSize();
     m_segname = (*seglist.begin()).getName();
 
-    if ((m_nproc < 1) || (m_nproc > 8))
+    if ((m_nproc < 1) || (m_nproc > 32))
     {
         printf(" ERROR in PibusIcu component : %s\n", m_name);
-        printf(" The number of output IRQs cannot be larger than 8 !\n");
+        printf(" The number of output IRQs cannot be larger than 32 !\n");
         exit(1);
     }
     if ((m_nirq < 1) || (m_nirq > 32))
@@ -88,6 +93,8 @@ PibusIcu::PibusIcu(sc_module_name		insname,
     std::cout << std::endl << "Instanciation of PibusIcu : " << m_name << std::endl;
     std::cout << "    irq_in  = " << m_nirq << std::endl;
     std::cout << "    irq_out = " << m_nproc << std::endl;
+    if (m_segsize >= ICU_PRIO + 4*m_nirq)
+    std::cout << "    priority registers enabled" << std::endl;
     std::cout << "    segment " << m_segname << std::hex
                   << " | base = 0x" << m_segbase
                   << " | size = 0x" << m_segsize << std::endl;
@@ -96,10 +103,25 @@ PibusIcu::PibusIcu(sc_module_name		insname,
 ///////////////////////////
 void PibusIcu::transition()
 {
+#ifdef PIBUS_CLOCK_GATING
+    // woken up by p_sel or p_resetn : wait the clock edge
+    if ( m_sleep_transition )
+    {
+        m_sleep_transition = false;
+        if ( not p_ck.posedge() )
+        {
+            next_trigger( p_ck.posedge_event() );
+            return;
+        }
+    }
+#endif
+
     if(p_resetn == false) 
     {
 	r_fsm_state = FSM_IDLE;
         for(size_t i=0 ; i<m_nproc ; i++) r_mask[i] = 0x00000000;
+        r_level[0] = 0xFFFFFFFF;
+        for(size_t l=1 ; l<ICU_LEVELS ; l++) r_level[l] = 0x00000000;
 	return;	
     }
 
@@ -108,15 +130,32 @@ void PibusIcu::transition()
 	if(p_sel == true) 
         {
 	    uint32_t address = (uint32_t)p_a.read() & 0xFFFFFFFC;
-            r_index = (address>>5) & 0x7;
-            if((address < m_segbase) || (address > (m_segbase+m_segsize))) 	r_fsm_state = FSM_ERROR;  
+            uint32_t offset  = address - m_segbase;
+            if((address < m_segbase) || (address >= (m_segbase+m_segsize))) 	r_fsm_state = FSM_ERROR;  
+            else if( offset >= ICU_PRIO )
+            {
+                r_index = (offset - ICU_PRIO)>>2;
+                if( ((offset - ICU_PRIO)>>2) >= m_nirq )                        r_fsm_state = FSM_ERROR;
+                else if( p_read.read() )                                        r_fsm_state = FSM_READ_PRIO;
+                else                                                            r_fsm_state = FSM_WRITE_PRIO;
+            }
+            else if( (offset>>5) >= m_nproc )                                   r_fsm_state = FSM_ERROR;
             else if( p_read.read() &&  ((address & 0x1F) == ICU_IT_VECTOR))     r_fsm_state = FSM_READ_VECTOR; 
             else if( p_read.read() &&  ((address & 0x1F) == ICU_INT))           r_fsm_state = FSM_READ_IRQS; 
             else if( p_read.read() &&  ((address & 0x1F) == ICU_MASK))          r_fsm_state = FSM_READ_MASK;  
             else if( !p_read.read() && ((address & 0x1F) == ICU_MASK_SET))      r_fsm_state = FSM_SET_MASK; 
             else if( !p_read.read() && ((address & 0x1F) == ICU_MASK_CLEAR))    r_fsm_state = FSM_RESET_MASK; 
             else                                                                r_fsm_state = FSM_ERROR; 
+            if( offset < ICU_PRIO ) r_index = offset>>5;
 	}
+#ifdef PIBUS_CLOCK_GATING
+        else
+        {
+            // sleep until the next selection or reset
+            m_sleep_transition = true;
+            next_trigger( p_sel.posedge_event() | p_resetn.negedge_event() );
+        }
+#endif
         break;
     case FSM_SET_MASK :
 	r_fsm_state = FSM_IDLE;
@@ -126,6 +165,18 @@ void PibusIcu::transition()
 	r_fsm_state = FSM_IDLE;
 	r_mask[r_index] = r_mask[r_index] & ~(uint32_t)p_d.read();
         break;
+    case FSM_WRITE_PRIO :	// IRQ_IN[r_index] is moved to the new level
+    {
+        uint32_t bit   = 1 << r_index.read();
+        uint32_t level = (uint32_t)p_d.read() & (ICU_LEVELS - 1);
+	r_fsm_state = FSM_IDLE;
+        for(size_t l=0 ; l<ICU_LEVELS ; l++)
+        {
+            if( l == level ) r_level[l] = r_level[l].read() | bit;
+            else             r_level[l] = r_level[l].read() & ~bit;
+        }
+        break;
+    }
     default :
 	r_fsm_state = FSM_IDLE;
     break;
@@ -135,34 +186,47 @@ void PibusIcu::transition()
 /////////////////////////
 void PibusIcu::genMoore()
 {
+#ifdef PIBUS_CLOCK_GATING
+    // woken up by a FSM state change : wait the clock edge
+    if ( m_sleep_moore )
+    {
+        m_sleep_moore = false;
+        if ( not p_ck.negedge() )
+        {
+            next_trigger( p_ck.negedge_event() );
+            return;
+        }
+    }
+#endif
 
     switch(r_fsm_state) {
     case FSM_IDLE : 
+#ifdef PIBUS_CLOCK_GATING
+        // sleep until the FSM leaves the IDLE state
+        m_sleep_moore = true;
+        next_trigger( r_fsm_state.value_changed_event() );
+#endif
         break; 
     case FSM_ERROR :
 	p_ack.write(PIBUS_ACK_ERROR);
         break;
     case FSM_READ_VECTOR :
-    {
-        uint32_t index = 32;
-        for(size_t n = m_nirq ; n > 0 ; n--) 
-        {
-            size_t	i = n-1;
-            if( p_irq_in[i].read() && (((r_mask[r_index]>>i) & 0x1) == 0x1) ) index = i; 
-	} 
 	p_ack.write(PIBUS_ACK_READY);
-	p_d.write(index);
+	p_d.write(vector(inputs() & r_mask[r_index].read()));
         break;
-    }
     case FSM_READ_IRQS :
+	p_ack.write(PIBUS_ACK_READY);
+	p_d.write(inputs() & r_mask[r_index].read());
+        break;
+    case FSM_READ_PRIO :
     {
-        uint32_t val = 0;
-        for(size_t n = 0 ; n < m_nirq ; n++)
+        uint32_t level = 0;
+        for(size_t l=1 ; l<ICU_LEVELS ; l++) 
         {
-            if( p_irq_in[n].read() && (((r_mask[r_index]>>n) & 0x1) == 0x1) ) val |= 1<<n;
+            if( (r_level[l].read() >> r_index.read()) & 0x1 ) level = l;
         }
 	p_ack.write(PIBUS_ACK_READY);
-	p_d.write(val);
+	p_d.write(level);
         break;
     }
     case FSM_READ_MASK :
@@ -171,22 +235,48 @@ void PibusIcu::genMoore()
         break;
     case FSM_SET_MASK :
     case FSM_RESET_MASK :
+    case FSM_WRITE_PRIO :
 	p_ack.write(PIBUS_ACK_READY);
         break;
     } // end switch FSM
 } // end genMoore()
 
+/////////////////////////////////////////////
+// This function returns the input IRQs,
+// packed in a 32 bits word.
+/////////////////////////////////////////////
+uint32_t PibusIcu::inputs()
+{
+    uint32_t pending = 0;
+    for(size_t n=0 ; n<m_nirq ; n++) 
+    {
+        if( p_irq_in[n].read() ) pending |= 1<<n;
+    }
+    return pending;
+} // end inputs()
+
+/////////////////////////////////////////////
+// This function returns the index of the
+// highest priority IRQ in the pending 
+// IRQs word, or 32 if there is none.
+/////////////////////////////////////////////
+uint32_t PibusIcu::vector(uint32_t pending)
+{
+    for(size_t n=ICU_LEVELS ; n>0 ; n--) 
+    {
+        uint32_t active = pending & r_level[n-1].read();
+        if( active ) return __builtin_ctz(active);
+    }
+    return 32;
+} // end vector()
+
 /////////////////////////
 void PibusIcu::genMealy()
 {
+    uint32_t pending = inputs();
     for(size_t i=0 ; i<m_nproc ; i++)
     {
-        bool it = false;	
-        for(size_t n=0 ; n<m_nirq ; n++) 
-        {
-	    it = it || (p_irq_in[n].read() && (((r_mask[i]>>n)&0x1) == 0x1));
-        }
-        p_irq_out[i].write(it);
+        p_irq_out[i].write( (pending & r_mask[i].read()) != 0 );
     }
 } // end genMealy
 
@@ -199,4 +289,35 @@ void PibusIcu::printTrace()
     std::cout << std::endl;
 }
 
+//////////////////////////////////
+bool PibusIcu::checkpointReady()
+{
+    return (r_fsm_state == FSM_IDLE);
+}
+////////////////////////////////////////////////////////////
+void PibusIcu::saveState(PibusCheckpointWriter &writer)
+{
+    writer.put(m_nproc);
+    writer.put(r_fsm_state);
+    writer.put(r_index);
+    for(size_t i=0 ; i<m_nproc ; i++) writer.put(r_mask[i]);
+    for(size_t k=0 ; k<ICU_LEVELS ; k++) writer.put(r_level[k]);
+}
+////////////////////////////////////////////////////////////
+void PibusIcu::restoreState(PibusCheckpointReader &reader)
+{
+    size_t nproc;
+    reader.get(nproc);
+    if (nproc != m_nproc)
+    {
+        printf(" ERROR in PibusIcu component : %s\n", m_name);
+        printf(" The checkpoint number of outputs does not match\n");
+        exit(1);
+    }
+    reader.get(r_fsm_state);
+    reader.get(r_index);
+    for(size_t i=0 ; i<m_nproc ; i++) reader.get(r_mask[i]);
+    for(size_t k=0 ; k<ICU_LEVELS ; k++) reader.get(r_level[k]);
+}
+
 }} // end namespace
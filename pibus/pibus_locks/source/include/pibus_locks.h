@@ -5,40 +5,109 @@
 // This program is released under the GNU Public License
 // Copyright : UPMC-LIP6
 //////////////////////////////////////////////////////////////////////////
-// This component implements a PIBUS peripheral for binary locks : 
-// - All read requests are considered as "set" : 
+// This component implements a PIBUS peripheral for locks.
+// The lock semantic is defined by the mode parameter :
+//
+// - LOCKS_MODE_TAS (binary test-and-set locks) :
+// All read requests are considered as "set" :
 // The read value is returned, and the memory cell is set to 1.
-// - All write requests are considered as "reset" : 
+// All write requests are considered as "reset" :
 // the memory cell is set to 0.
 // Each binary lock corresponds to 4 bytes in the adress space.
+//
+// - LOCKS_MODE_TICKET (FIFO ticket locks) :
+// Each lock corresponds to 8 bytes in the address space :
+// - TICKET (0x0) : a read returns a ticket number, and increments the
+//   next ticket number. A write is a "release" : the serving number
+//   is incremented.
+// - SERVING (0x4) : a read returns the serving number (the ticket
+//   of the lock owner). A write is a "release".
+// The waiting processors get the lock in the order of their tickets.
+//
+// - LOCKS_MODE_DEFER (wait-for-release binary locks) :
+// A read is a "set", and a write is a "reset", as in TAS mode, but a
+// failed "set" (on a lock already set) registers a waiter, and the
+// "reset" of a lock with registered waiters raises the p_irq signal.
+// The waiters can therefore sleep until the IRQ, instead of spinning
+// on the lock with uncached reads. The IRQ is a level signal : it is
+// reset by the next successful "set" of the released lock, and each
+// successful "set" decrements the number of registered waiters : the
+// other waiters remain registered, and the next "reset" raises the
+// IRQ again, even if they did not see the first one. A woken waiter
+// that fails again is registered again : the count can be larger than
+// the number of waiters, which only causes spurious IRQs.
+// There is no master index in the PIBUS protocol, and the lock
+// is not directly transfered to a waiter. A read request cannot be
+// delayed by WAIT responses until the release : the bus would be
+// held, and the lock owner could not release the lock.
+//
+// The lock acquire latency is registered in a PibusHistogram :
+// - in TICKET mode, from the ticket read to the release that gives
+//   the lock to this ticket.
+// - in TAS and DEFER modes, from the first failed "set" to the next
+//   successful "set" of the same lock (the first waiter latency).
+// The lock hold time (from the "set" to the "reset") is also
+// registered, and the 64 bits counters can be registered in a
+// PibusCounterRegistry.
+//
+// Ports : the p_irq port is only used in DEFER mode. In TAS and TICKET
+// modes, it is bound by the constructor to an internal signal, and
+// must NOT be bound by the top cell. In DEFER mode, it must be bound
+// by the top cell (to an ICU input).
+//
 // This component contains a single segment defined by 
 // a BASE address and a SIZE.
 // Both the BASE and SIZE must be multiple of 4 bytes.
 // This component cheks address for segmentation violation,
 // and can be used as a default target.
+// When the PIBUS_CLOCK_GATING flag is defined, the transition() and
+// genMoore() methods are not evaluated when the FSM is IDLE (see the
+// PibusSimpleRam component). The simulation result is not modified.
+// The cycle counter used by the histograms is updated with the number
+// of elapsed cycles when the transition() is woken up : this requires
+// p_ck to be connected to a sc_clock.
+// This component implements the PibusFunctionalTarget interface
+// (fast-forward mode) : a functional read is a "set" (or a ticket),
+// and a functional write is a "reset" (or a release).
+// This component implements the PibusCheckpointable interface, and
+// can be checkpointed when the FSM is IDLE. The lock states and the
+// acquire dates are saved (not the histograms and counters).
 /////////////////////////////////////////////////////////////////////////
-// This component has 4 "generator" parameters :
+// This component has 5 "generator" parameters :
 // - sc_module_name	name    : instance name
 // - uint32_t	index   : target index
 // - pibusSegmentTable	segmap  : segment table
 // - uint32_t	nlocks	: number of locks
+// - int		mode	: lock mode (default = LOCKS_MODE_TAS)
 /////////////////////////////////////////////////////////////////////////
 
 #ifndef PIBUS_LOCKS_H
 #define PIBUS_LOCKS_H
 
 #include <systemc.h>
+#include <deque>
 #include "pibus_mnemonics.h"
 #include "pibus_segment_table.h"
+#include "pibus_functional_bus.h"
+#include "pibus_histogram.h"
+#include "pibus_counter_registry.h"
+#include "pibus_checkpoint.h"
 
 namespace soclib { namespace caba {
 
-class PibusLocks : sc_core::sc_module {
+class PibusLocks : sc_core::sc_module, public PibusFunctionalTarget,
+                   public PibusCheckpointable {
 
     //  REGISTERS
     sc_register<int>		r_fsm_state;
     sc_register<uint32_t>      	r_index;
-    bool*			r_locks;
+    sc_register<uint32_t>      	r_rdata;		// read response
+    bool*			r_locks;		// lock set (TAS & DEFER)
+    uint32_t*			r_next;			// next ticket (TICKET)
+    uint32_t*			r_serving;		// serving ticket (TICKET)
+    uint32_t*			r_waiters;		// registered waiters (DEFER)
+    bool*			r_wake;			// released with waiters (DEFER)
+    uint32_t			r_nwake;		// number of r_wake set
 
     //  STRUCTURAL PARAMETERS
     const char*			m_name;			// instance name
@@ -47,7 +116,28 @@ class PibusLocks : sc_core::sc_module {
     uint32_t			m_segbase;		// segment base
     const char*			m_segname;		// segment name
     uint32_t			m_nlocks;		// number of locks
+    const int			m_mode;			// lock mode
     char			m_fsm_str[4][20];	// FSM states names
+    bool			m_sleep_transition;	// transition() is not clocked (clock gating)
+    bool			m_sleep_moore;		// genMoore() is not clocked (clock gating)
+    sc_core::sc_time		m_sleep_time;		// date of the last transition() before sleep
+    sc_core::sc_time		m_cycle;		// clock period
+    sc_core::sc_event		m_restore_event;	// state restored (clock gating)
+
+    //  INSTRUMENTATION
+    uint64_t			m_cycles;		// cycles since reset
+    uint64_t*			m_contend_cycle;	// first failed set (TAS & DEFER)
+    uint64_t*			m_acquire_cycle;	// lock acquire cycle
+    std::deque<uint64_t>*	m_tickets;		// waiting tickets cycles (TICKET)
+    uint64_t			c_acquire_count;	// successful acquires
+    uint64_t			c_fail_count;		// failed sets (TAS & DEFER)
+    uint64_t			c_release_count;	// releases
+    uint64_t			c_wakeup_count;		// releases raising the IRQ (DEFER)
+    PibusHistogram		m_acquire_latency;	// lock acquire latency
+    PibusHistogram		m_hold_time;		// lock hold time
+
+    // INTERNAL SIGNALS (p_irq not used in TAS & TICKET modes)
+    sc_core::sc_signal<bool>	m_nc_irq;
 
     // FSM states
     enum{
@@ -57,12 +147,24 @@ class PibusLocks : sc_core::sc_module {
         LOCKS_ERROR   = 3,
         };
 
+    bool decode(uint32_t address, size_t* index, uint32_t* cell);
+    uint32_t readLock(size_t index, uint32_t cell);
+    void writeLock(size_t index);
+    void acquired(size_t index, uint64_t latency);
+
 protected:
 
     SC_HAS_PROCESS(PibusLocks);
 
 public:
 
+    // LOCK MODES
+    enum{
+        LOCKS_MODE_TAS		= 0,
+        LOCKS_MODE_TICKET	= 1,
+        LOCKS_MODE_DEFER	= 2,
+        };
+
     // IO PORTS
     sc_core::sc_in<bool>		p_ck;
     sc_core::sc_in<bool>		p_resetn;
@@ -73,17 +175,32 @@ public:
     sc_core::sc_out<uint32_t>		p_ack;
     sc_core::sc_inout<uint32_t>		p_d;
     sc_core::sc_in<bool>    		p_tout;
+    sc_core::sc_out<bool>    		p_irq;
 
     //	constructor
     PibusLocks(sc_core::sc_module_name		name, 
   	     size_t 				tgtid,	
 	     soclib::common::PibusSegmentTable	&segtab,	
-  	     uint32_t				nlocks);
+  	     uint32_t				nlocks,
+  	     int				mode = LOCKS_MODE_TAS);
+
+    ~PibusLocks();
 
     //	methods
     void transition();
     void genMoore();
     void printTrace();
+    void printStatistics();
+    void registerCounters(PibusCounterRegistry &registry);
+
+    // functional access (fast-forward mode)
+    bool functionalRead(uint32_t address, uint32_t* data, uint32_t opc, size_t burst);
+    bool functionalWrite(uint32_t address, const uint32_t* data, uint32_t opc, size_t burst);
+
+    // checkpoint
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
 
 };  // end class PibusLocks
 
@@ -14,14 +14,19 @@ using namespace sc_core;
 using namespace soclib::caba;
 using namespace soclib::common;
 
+// no pending contention on a lock
+static const uint64_t NO_CONTENTION = ~(uint64_t)0;
+
 //////////////////////////////////////////////////////
 PibusLocks::PibusLocks(sc_module_name		name, 
   	     		size_t			tgtid,	
      			PibusSegmentTable	&segtab,
-			uint32_t		nlocks)	
+			uint32_t		nlocks,
+			int			mode)	
     : m_name(name),
       m_tgtid(tgtid),
       m_nlocks(nlocks),
+      m_mode(mode),
       p_ck("p_ck"),
       p_resetn("p_resetn"),
       p_sel("p_sel"),
@@ -30,7 +35,8 @@ PibusLocks::PibusLocks(sc_module_name		name,
       p_opc("p_opc"),
       p_ack("p_ack"),
       p_d("p_d"),
-      p_tout("p_tout")
+      p_tout("p_tout"),
+      p_irq("p_irq")
 {
     SC_METHOD (transition);
     sensitive_pos << p_ck;
@@ -39,7 +45,7 @@ PibusLocks::PibusLocks(sc_module_name		name,
     sensitive_neg << p_ck;
 
     // segment definition
-    std::list<SegmentTableEntry> seglist = segtab.getTargetSegmentList(tgtid);
+    const std::list<SegmentTableEntry> &seglist = segtab.getTargetSegmentList(tgtid);
     m_segbase = (*seglist.begin()).getBase();
     m_segsize = (*seglist.begin()).getSize();
     m_segname = (*seglist.begin()).getName();
@@ -50,15 +56,43 @@ PibusLocks::PibusLocks(sc_module_name		name,
         printf("The segment base address must be word aligned\n");
         exit(1);
     }
-    if(m_segsize < nlocks*4)
+    if((m_mode != LOCKS_MODE_TAS) && (m_mode != LOCKS_MODE_TICKET) && (m_mode != LOCKS_MODE_DEFER))
+    {
+        printf("ERROR in component PibusLocks %s\n", m_name);
+        printf("The mode must be LOCKS_MODE_TAS, LOCKS_MODE_TICKET or LOCKS_MODE_DEFER\n");
+        exit(1);
+    }
+    if(m_mode != LOCKS_MODE_DEFER)	// no IRQ : the p_irq port is not used
+    {
+        p_irq (m_nc_irq);
+    }
+    if((m_mode != LOCKS_MODE_TICKET) && (m_segsize < nlocks*4))
     {
         printf("ERROR in component PibusLocks %s\n", m_name);
         printf("The segment size must be at least : 4 * nlocks\n");
         exit(1);
     }
+    if((m_mode == LOCKS_MODE_TICKET) && (m_segsize < nlocks*8))
+    {
+        printf("ERROR in component PibusLocks %s\n", m_name);
+        printf("The segment size must be at least : 8 * nlocks in TICKET mode\n");
+        exit(1);
+    }
 
     // Lock array allocation
-    r_locks = new bool[nlocks];
+    r_locks         = new bool[nlocks];
+    r_next          = new uint32_t[nlocks];
+    r_serving       = new uint32_t[nlocks];
+    r_waiters       = new uint32_t[nlocks];
+    r_wake          = new bool[nlocks];
+    m_contend_cycle = new uint64_t[nlocks];
+    m_acquire_cycle = new uint64_t[nlocks];
+    m_tickets       = new std::deque<uint64_t>[nlocks];
+
+    m_sleep_transition = false;
+    m_sleep_moore      = false;
+    m_cycle            = SC_ZERO_TIME;
+    m_cycles           = 0;
 
     strcpy(m_fsm_str[0], "IDLE");
     strcpy(m_fsm_str[1], "READ");
@@ -67,41 +101,214 @@ PibusLocks::PibusLocks(sc_module_name		name,
 
     std::cout << std::endl << "Instanciation of PibusLocks : " << m_name << std::endl;
     std::cout << "    nlocks = " << nlocks << std::endl;
+    std::cout << "    mode   = " << ((m_mode == LOCKS_MODE_TAS)    ? "TAS" :
+                                     (m_mode == LOCKS_MODE_TICKET) ? "TICKET" : "DEFER") << std::endl;
     std::cout << "    segment " << m_segname << std::hex
               << " | base = 0x" << m_segbase
               << " | size = 0x" << m_segsize << std::endl;
 } // end constructor
 
+/////////////////////////////
+PibusLocks::~PibusLocks()
+{
+    delete [] r_locks;
+    delete [] r_next;
+    delete [] r_serving;
+    delete [] r_waiters;
+    delete [] r_wake;
+    delete [] m_contend_cycle;
+    delete [] m_acquire_cycle;
+    delete [] m_tickets;
+} // end destructor
+
+////////////////////////////////////////////////////////////////////
+// This function returns false if the address is not in the segment.
+// Otherwise, it returns the lock index, and the cell (TICKET mode).
+////////////////////////////////////////////////////////////////////
+bool PibusLocks::decode(uint32_t address, size_t* index, uint32_t* cell)
+{
+    if ((address < m_segbase) || (address >= m_segbase + m_segsize)) return false;
+    uint32_t offset = address - m_segbase;
+    if (m_mode == LOCKS_MODE_TICKET)
+    {
+        *index = offset >> 3;
+        *cell  = (offset >> 2) & 0x1;
+    }
+    else
+    {
+        *index = offset >> 2;
+        *cell  = 0;
+    }
+    return (*index < m_nlocks);
+} // end decode()
+
+////////////////////////////////////////////////////////////////////
+// This function registers the acquire of a lock.
+////////////////////////////////////////////////////////////////////
+void PibusLocks::acquired(size_t index, uint64_t latency)
+{
+    c_acquire_count++;
+    m_acquire_latency.add(latency);
+    m_acquire_cycle[index] = m_cycles;
+} // end acquired()
+
+////////////////////////////////////////////////////////////////////
+// This function executes a read request on a lock ("set", or 
+// ticket), and returns the read value.
+////////////////////////////////////////////////////////////////////
+uint32_t PibusLocks::readLock(size_t index, uint32_t cell)
+{
+    if (m_mode == LOCKS_MODE_TICKET)
+    {
+        if (cell != 0) return r_serving[index];
+        uint32_t ticket = r_next[index];
+        r_next[index] = ticket + 1;
+        if (ticket == r_serving[index]) acquired(index, 0);
+        else                            m_tickets[index].push_back(m_cycles);
+        return ticket;
+    }
+    if (r_locks[index])		// failed set
+    {
+        c_fail_count++;
+        if (m_contend_cycle[index] == NO_CONTENTION) m_contend_cycle[index] = m_cycles;
+        if (m_mode == LOCKS_MODE_DEFER) r_waiters[index]++;
+        return 1;
+    }
+    if (m_contend_cycle[index] == NO_CONTENTION) acquired(index, 0);
+    else                                         acquired(index, m_cycles - m_contend_cycle[index]);
+    m_contend_cycle[index] = NO_CONTENTION;
+    r_locks[index] = true;
+    if (r_wake[index])
+    {
+        r_wake[index] = false;
+        r_nwake--;
+    }
+    // the other waiters remain registered for the next release
+    if (r_waiters[index] != 0) r_waiters[index]--;
+    return 0;
+} // end readLock()
+
+////////////////////////////////////////////////////////////////////
+// This function executes a write request on a lock ("reset", or
+// release).
+////////////////////////////////////////////////////////////////////
+void PibusLocks::writeLock(size_t index)
+{
+    if (m_mode == LOCKS_MODE_TICKET)
+    {
+        if (r_serving[index] == r_next[index]) return;	// not owned
+        c_release_count++;
+        m_hold_time.add(m_cycles - m_acquire_cycle[index]);
+        r_serving[index]++;
+        if (not m_tickets[index].empty())		// the next ticket owns the lock
+        {
+            acquired(index, m_cycles - m_tickets[index].front());
+            m_tickets[index].pop_front();
+        }
+        return;
+    }
+    if (not r_locks[index]) return;			// not set
+    c_release_count++;
+    m_hold_time.add(m_cycles - m_acquire_cycle[index]);
+    r_locks[index] = false;
+    if ((m_mode == LOCKS_MODE_DEFER) && (r_waiters[index] != 0) && not r_wake[index])
+    {
+        c_wakeup_count++;
+        r_wake[index] = true;
+        r_nwake++;
+    }
+} // end writeLock()
+
 /////////////////////////////
 void PibusLocks::transition()
 {
+    uint64_t	increment = 1;		// m_cycles increment
+
+#ifdef PIBUS_CLOCK_GATING
+    // woken up by p_sel or p_resetn : wait the clock edge, and
+    // compute the number of cycles since the last evaluation 
+    if ( m_sleep_transition )
+    {
+        if ( not p_ck.posedge() )
+        {
+            next_trigger( p_ck.posedge_event() );
+            return;
+        }
+        m_sleep_transition = false;
+        if ( m_cycle != SC_ZERO_TIME ) 
+            increment = (uint64_t)((sc_time_stamp() - m_sleep_time) / m_cycle + 0.5);
+    }
+#endif
+
     if (p_resetn.read() == false) 
     {
         r_fsm_state = LOCKS_IDLE;
-        for (size_t i = 0 ; i < m_nlocks ; i++) r_locks[i] = false; 
+        for (size_t i = 0 ; i < m_nlocks ; i++) 
+        {
+            r_locks[i]         = false; 
+            r_next[i]          = 0;
+            r_serving[i]       = 0;
+            r_waiters[i]       = 0;
+            r_wake[i]          = false;
+            m_contend_cycle[i] = NO_CONTENTION;
+            m_acquire_cycle[i] = 0;
+            m_tickets[i].clear();
+        }
+        r_nwake         = 0;
+        m_cycles        = 0;
+        c_acquire_count = 0;
+        c_fail_count    = 0;
+        c_release_count = 0;
+        c_wakeup_count  = 0;
+        m_acquire_latency.reset();
+        m_hold_time.reset();
         return;
     } // end reset
 
+    m_cycles = m_cycles + increment;
+
     switch (r_fsm_state) {       	
     case LOCKS_IDLE :
         if (p_sel.read() == true) 
         {
             uint32_t address = (uint32_t)p_a.read() & 0xfffffffc;
-            if ((address >= m_segbase) && (address <  m_segbase + m_segsize)) 
+            size_t   index;
+            uint32_t cell;
+            if (decode(address, &index, &cell)) 
             { 
-                r_index = (address - m_segbase)  >> 2;
-                if(p_read.read() == true) r_fsm_state = LOCKS_READ;
-                else			  r_fsm_state = LOCKS_WRITE;
+                r_index = index;
+                if(p_read.read() == true) 
+                {
+                    r_rdata     = readLock(index, cell);
+                    r_fsm_state = LOCKS_READ;
+                }
+                else
+                {
+                    writeLock(index);
+                    r_fsm_state = LOCKS_WRITE;
+                }
             } 
             else 			  r_fsm_state = LOCKS_ERROR;
 	}		
+#ifdef PIBUS_CLOCK_GATING
+        else
+        {
+            // sleep until the next selection or reset
+            if ( m_cycle == SC_ZERO_TIME )
+            {
+                sc_clock* clock = dynamic_cast<sc_clock*>( p_ck.get_interface() );
+                if ( clock ) m_cycle = clock->period();
+            }
+            m_sleep_transition = true;
+            m_sleep_time       = sc_time_stamp();
+            next_trigger( p_sel.posedge_event() | p_resetn.negedge_event() );
+        }
+#endif
         break;
     case LOCKS_READ :
-	r_locks[r_index] = true;	
 	r_fsm_state	= LOCKS_IDLE;
         break;
     case LOCKS_WRITE :
-	r_locks[r_index] = false;
 	r_fsm_state	= LOCKS_IDLE;
         break;
     case LOCKS_ERROR : 	
@@ -113,13 +320,32 @@ void PibusLocks::transition()
 ////////////////////////////
 void PibusLocks::genMoore()
 {
+#ifdef PIBUS_CLOCK_GATING
+    // woken up by a FSM state change : wait the clock edge
+    if ( m_sleep_moore )
+    {
+        m_sleep_moore = false;
+        if ( not p_ck.negedge() )
+        {
+            next_trigger( p_ck.negedge_event() );
+            return;
+        }
+    }
+#endif
+
+    p_irq = (r_nwake != 0);
+
     switch(r_fsm_state) {
     case LOCKS_IDLE :
+#ifdef PIBUS_CLOCK_GATING
+        // sleep until the FSM leaves the IDLE state, or a restore
+        m_sleep_moore = true;
+        next_trigger( r_fsm_state.value_changed_event() | m_restore_event );
+#endif
         break;
     case LOCKS_READ :
 	p_ack = PIBUS_ACK_READY;
-        if(r_locks[r_index] == false) p_d = 0;
-        else                  	      p_d = 1;
+        p_d   = r_rdata.read();
         break;
     case LOCKS_WRITE :
 	p_ack = PIBUS_ACK_READY;
@@ -130,10 +356,138 @@ void PibusLocks::genMoore()
     } // end switch r_fsm_state
 } // end genMoore()
 
+///////////////////////////////////////////////////////////
+bool PibusLocks::functionalRead(uint32_t	address,
+				uint32_t*	data,
+				uint32_t	opc,
+				size_t		burst)
+{
+    for (size_t i = 0 ; i < burst ; i++) 
+    {
+        size_t   index;
+        uint32_t cell;
+        if (not decode(address + 4*i, &index, &cell)) return false;
+        data[i] = readLock(index, cell);
+    }
+    return true;
+} // end functionalRead()
+
+///////////////////////////////////////////////////////////
+bool PibusLocks::functionalWrite(uint32_t		address,
+				 const uint32_t*	data,
+				 uint32_t		opc,
+				 size_t			burst)
+{
+    for (size_t i = 0 ; i < burst ; i++) 
+    {
+        size_t   index;
+        uint32_t cell;
+        if (not decode(address + 4*i, &index, &cell)) return false;
+        writeLock(index);
+    }
+    return true;
+} // end functionalWrite()
+
 /////////////////////////////////
 void PibusLocks::printTrace()
 {
     std::cout << m_name << " : " << m_fsm_str[r_fsm_state] << std::endl;
 } // end print()
 
+/////////////////////////////////
+void PibusLocks::printStatistics()
+{
+    std::cout << m_name << " : Statistics" << std::dec << std::endl;
+    std::cout << "- CYCLES           = " << m_cycles << std::endl;
+    std::cout << "- ACQUIRES         = " << c_acquire_count << std::endl;
+    std::cout << "- FAILED SETS      = " << c_fail_count << std::endl;
+    std::cout << "- RELEASES         = " << c_release_count << std::endl;
+    std::cout << "- WAKE-UP IRQS     = " << c_wakeup_count << std::endl;
+    std::cout << "- ACQUIRE LATENCY  : ";
+    m_acquire_latency.print(std::cout);
+    std::cout << "- HOLD TIME        : ";
+    m_hold_time.print(std::cout);
+} // end printStatistics()
+
+///////////////////////////////////////////////////////////////////
+void PibusLocks::registerCounters(PibusCounterRegistry &registry)
+{
+    registry.add(m_name, "acquire_count", &c_acquire_count);
+    registry.add(m_name, "fail_count",    &c_fail_count);
+    registry.add(m_name, "release_count", &c_release_count);
+    registry.add(m_name, "wakeup_count",  &c_wakeup_count);
+} // end registerCounters()
+
+////////////////////////////////////
+bool PibusLocks::checkpointReady()
+{
+    return (r_fsm_state == LOCKS_IDLE);
+} // end checkpointReady()
+
+/////////////////////////////////////////////////////////////
+void PibusLocks::saveState(PibusCheckpointWriter &writer)
+{
+    writer.put(m_nlocks);
+    writer.put(m_mode);
+    writer.put(r_fsm_state);
+    writer.put(r_index);
+    writer.put(r_rdata);
+    writer.put(r_nwake);
+    writer.putArray(r_locks, m_nlocks);
+    writer.putArray(r_next, m_nlocks);
+    writer.putArray(r_serving, m_nlocks);
+    writer.putArray(r_waiters, m_nlocks);
+    writer.putArray(r_wake, m_nlocks);
+    writer.put(m_cycles);
+    writer.putArray(m_contend_cycle, m_nlocks);
+    writer.putArray(m_acquire_cycle, m_nlocks);
+    for (size_t i = 0 ; i < m_nlocks ; i++)
+    {
+        uint32_t ntickets = m_tickets[i].size();
+        writer.put(ntickets);
+        for (size_t k = 0 ; k < ntickets ; k++) writer.put(m_tickets[i][k]);
+    }
+} // end saveState()
+
+/////////////////////////////////////////////////////////////
+void PibusLocks::restoreState(PibusCheckpointReader &reader)
+{
+    uint32_t nlocks;
+    int      mode;
+    reader.get(nlocks);
+    reader.get(mode);
+    if ((nlocks != m_nlocks) || (mode != m_mode))
+    {
+        printf("ERROR in component PibusLocks %s\n", m_name);
+        printf("The checkpoint number of locks or mode does not match\n");
+        exit(1);
+    }
+    reader.get(r_fsm_state);
+    reader.get(r_index);
+    reader.get(r_rdata);
+    reader.get(r_nwake);
+    reader.getArray(r_locks, m_nlocks);
+    reader.getArray(r_next, m_nlocks);
+    reader.getArray(r_serving, m_nlocks);
+    reader.getArray(r_waiters, m_nlocks);
+    reader.getArray(r_wake, m_nlocks);
+    reader.get(m_cycles);
+    reader.getArray(m_contend_cycle, m_nlocks);
+    reader.getArray(m_acquire_cycle, m_nlocks);
+    for (size_t i = 0 ; i < m_nlocks ; i++)
+    {
+        uint32_t ntickets;
+        reader.get(ntickets);
+        m_tickets[i].clear();
+        for (size_t k = 0 ; k < ntickets ; k++)
+        {
+            uint64_t cycle;
+            reader.get(cycle);
+            m_tickets[i].push_back(cycle);
+        }
+    }
+    // the p_irq signal is computed by the sleeping genMoore()
+    m_restore_event.notify(sc_core::SC_ZERO_TIME);
+} // end restoreState()
+
 }} // end namespaces
@@ -14,7 +14,8 @@
 //     => The number of words per line must be a power of 2 and no larger than 32.
 //     => The number of associative ways per set must be a power of 2 no larger than 8.
 // It contains a write buffer implemented a simple FIFO. The FIFO depth is a parameter.
-// All Pibus write transactions are single word.
+// The Pibus write transactions are single word, unless the write combining
+// is activated (see below).
 // The data cache supports a snoop-invalidate mechanism.
 //     
 // INSTRUCTION CACHE
@@ -65,8 +66,14 @@
 // SNOOP
 // The Data cache supports an optionnal SNOOP mechanism : The SNOOP_FSM snoops
 // the bus to detect external write requests. In case of "external hit",
-// the corresponding cache line is invalidated. If there is too many
-// successive external hits, the cache is flushed.
+// an invalidation request is posted in the snoop invalidation queue
+// (a FIFO whose depth is the snoop_depth parameter), and the corresponding
+// cache line is invalidated by the DCACHE FSM (one line per cycle, with
+// higher priority than the processor requests). The cache is flushed
+// only when an external hit is detected with the invalidation queue full.
+// An optionnal snoop filter (PibusSnoopFilter, with snoop_filter counters)
+// registers the pages containing valid cache lines : the external writes
+// to other pages are rejected without DCACHE directory lookup.
 // 
 // LL/LC
 // The Data cache supports cachable LL/SC requests, using the
@@ -87,6 +94,47 @@
 // - PIBUS_FSM controls the PIBUS interface. 
 // - SNOOP_FSM controls the snoop-invalidate mechanism.
 //
+// MISS STATUS HOLDING REGISTERS
+// The ICACHE and DCACHE misses use separate response buffers and response
+// flags (MSHRs) : an instruction miss and a data miss can be outstanding
+// simultaneously, and the PIBUS FSM can start the second transaction
+// while the first response is used to update the cache.
+//
+// INSTRUCTION PREFETCH
+// When the icache_prefetch constructor argument is true, the ICACHE FSM
+// requests a sequential prefetch of the next line (if cacheable and not
+// already in the cache) after each instruction miss. The line is stored 
+// in a dedicated prefetch buffer (one line) by the PIBUS FSM, with the
+// lowest priority. An instruction miss matching the prefetch buffer
+// (or the prefetch transaction in progress) is a prefetch hit : the
+// cache is updated from the prefetch buffer, without new transaction.
+// The frozen cycles of prefetch hits (IPREF_FRZ) are not counted
+// in the IMISS_FRZ counter.
+//
+// WRITE COMBINING
+// When the write_combining constructor argument is true, the successive
+// write requests contained in the write buffer, targeting consecutive
+// addresses in the same cache line of a cachable segment, are combined
+// in a single Pibus write burst (up to DCACHE_WORDS words). Each word
+// keeps its own OPC field (byte enable). The words are collected in the
+// PIBUS_WBUF buffer while the burst is running : the next request is
+// popped from the FIFO when the previous address is accepted, and the
+// LOCK signal is asserted if this request can be combined.
+// The write requests are still transmitted in order, and the burst
+// is atomic on the bus (snoop ordering is not modified). The SC requests
+// and the uncachable writes are never combined, and a combined burst
+// is not aborted by a snoop hit on the LL/SC address.
+//
+// SPLIT TRANSACTIONS
+// When a target answers PIBUS_ACK_RETRY (split transaction), the PIBUS_FSM
+// releases the bus, and requests again the bus to retry the complete
+// transaction (the burst is restarted from the first word).
+// The SC write is retried as the other transactions, and the SC is only
+// completed (SC_ATOMIC) by the READY response of the data phase : a split
+// RAM does not write the data of a retried transaction. While the SC is
+// not on the bus (not granted), it is aborted (SC_NOT_ATOMIC) by a snoop
+// hit on the LL/SC address.
+//
 // INSTRUMENTATION
 // Six counters can be used for instrumentation :
 // 1) IMISS_COUNTER : Number of Instruction MISS transactions
@@ -95,11 +143,79 @@
 // 4) WRITE_COUNTER : Number of Write transactions
 // 5) IREQ_COUNTER  : Total number of Instruction Read requests
 // 6) DREQ_COUNTER  : Total number of Cached Read requests	
+// In prefetch mode, the number of prefetch transactions and the
+// number of prefetch hits (IPREF_COUNTER & IPREF_HIT) are registered.
+// In write combining mode, the number of write bursts and the number
+// of combined write requests (WBURST_COUNTER & WCOMB_COUNTER) are registered.
+// In snoop mode, the number of snooped external writes, of filtered
+// writes, of line invalidations and of flushes are registered.
+// All counters are 64 bits, and can be registered in a PibusCounterRegistry
+// (registerCounters() method) to be sampled during the simulation.
 // The Dcache Miss Rate can be computed as DMISS_COUNTER / DREQ_COUNTER
 // The Icache Miss Rate can be computed as IMISS_COUNTER / IREQ_COUNTER
 //
+// CLOCK GATING
+// When the PIBUS_CLOCK_GATING flag is defined, the genMoore() method is
+// only evaluated when the PIBUS outputs can change, and the transition()
+// method is reduced to the ISS cycle and the instrumentation counters
+// when the processor is frozen, waiting a read response from the PIBUS.
+// The transition() cannot be skipped : the ISS must be clocked at each
+// cycle (CP0 cycle counter, interrupts), and the bus must be snooped.
+// The simulation result is not modified.
+//
+// PARALLEL MODE
+// When a PibusWorkerPool is attached (setParallel() method), the ISS
+// cycle is executed by a host thread of the pool, in parallel with the
+// other SystemC processes, and is completed at the beginning of the next
+// cycle. The PIBUS signals and the caches are still handled by the
+// SystemC process. The write bus errors are signaled to the ISS at
+// the beginning of the next cycle (in both modes).
+// The simulation result is not modified. The GDB server must not be
+// used in parallel mode, and the fast-forward cycles are sequential.
+// The worker pool must be deleted before the component.
+//
+// FAST-FORWARD
+// When a PibusFunctionalBus is attached (setFastForward() method), the
+// component starts in fast-forward mode : at each cycle, the ISS executes
+// QUANTUM cycles, and the instruction & data requests are directly
+// handled by the functional bus, without using the caches, the write
+// buffer, and the PIBUS interface. The LL/SC reservation is handled
+// by the functional bus. The write bus errors are signaled to the
+// processor at the next cycle.
+// The fast-forward is only possible when the four FSMs are idle and the 
+// write buffer is empty. When a request targets a peripheral that does
+// not support the functional access, the component switches temporarily
+// to the cycle-accurate mode, until this request has been completed.
+// When the functional bus is stopped, the component switches definitely
+// to the cycle-accurate mode.
+// As the caches are not updated nor snooped in fast-forward mode, they are
+// flushed at each switch to the cycle-accurate mode, and the LL/SC
+// reservation is copied from the functional bus to the r_llsc registers.
+// The cycle counter (used by the switch condition) is the number of
+// executed processor cycles.
+//
+// CHECKPOINT
+// This component implements the PibusCheckpointable interface. The
+// ISS state is saved through the GDB debug registers (general registers,
+// SR, LO, HI, BADVADDR, CAUSE, PC), and the other CP0 registers
+// (EPC, EBASE, Count, Compare, ...) are not accessible : they are
+// restored in their reset state. The component watches the instructions
+// sent to the ISS, and the checkpoint is refused (error at the save)
+// when the software has written a CP0 register other than SR, CAUSE
+// and EPC, or has read the Count register (MFC0 or RDHWR) since the
+// reset. EPC is assumed to be used only in the exception handlers.
+// The GenericCache and GenericFifo contents are not
+// accessible either : the checkpoint is only possible in cycle-accurate
+// mode when the component is quiescent (four FSMs idle, empty write
+// buffer and snoop queue, no pending data request), outside an
+// exception handler (SR.EXL and SR.ERL reset), and when the last
+// instruction sent to the ISS is not a branch (the delay slot state
+// is not accessible). As the caches are write-through, the memory is
+// up to date, and the caches are restored empty (as after a switch
+// from the fast-forward mode). The LL/SC reservation is saved.
+//
 /////////////////////////////////////////////////////////////////////////////// 
-// This component has 11 "constructor" parameters
+// This component has 15 "constructor" parameters
 // - sc_module_name 	name		: instance name
 // - pibusSegmentTable 	segtab 		: segment table
 // - uint32_t		proc_id		: processor identifier
@@ -111,6 +227,10 @@
 // - uint32_t		dcache_words 	: number of words per line (dcache)
 // - uint32_t		wbuf_depth   	: write buffer depth 
 // - bool		snoop_active    : default value is true
+// - bool		icache_prefetch : default value is false
+// - bool		write_combining : default value is false
+// - uint32_t		snoop_filter    : snoop filter counters (default = 0 : no filter)
+// - uint32_t		snoop_depth     : snoop invalidation queue depth (default = 4)
 //////////////////////////////////////////////////////////////////////////////
 
 #ifndef PIBUS_MIPS32_XCACHE_H
@@ -124,6 +244,11 @@
 #include "mips32.h"
 #include "iss2.h"
 #include "gdbserver.h"
+#include "pibus_functional_bus.h"
+#include "pibus_worker_pool.h"
+#include "pibus_snoop_filter.h"
+#include "pibus_counter_registry.h"
+#include "pibus_checkpoint.h"
 
 namespace soclib { namespace caba {
 
@@ -132,7 +257,7 @@ using namespace soclib::common;
 using namespace soclib::caba;
 
 /////////////////////////////////////
-class PibusMips32Xcache : sc_module {
+class PibusMips32Xcache : sc_module, public PibusCheckpointable {
 
     // structural parameters 
     const char*			m_name;
@@ -143,21 +268,43 @@ class PibusMips32Xcache : sc_module {
     const uint32_t		m_dcache_sets;
     const uint32_t		m_dcache_words;
     const uint32_t		m_dcache_ways;
-    const uint32_t		m_msb_shift;
-    const uint32_t		m_msb_mask;
     const bool			m_snoop_active;
+    const bool			m_icache_prefetch;
+    const bool			m_write_combining;
     uint32_t			m_line_data_mask;
     uint32_t			m_line_inst_mask;
 
     char			m_dcache_fsm_str[12][20];
     char			m_icache_fsm_str[8][20];
-    char			m_pibus_fsm_str[8][20];
+    char			m_pibus_fsm_str[9][20];
 
     Iss2::InstructionRequest 	m_ireq;
     Iss2::InstructionResponse 	m_irsp;
     Iss2::DataRequest 		m_dreq;
     Iss2::DataResponse 		m_drsp;
 
+    // fast-forward mode
+    PibusFunctionalBus*		m_ff_bus;		  // functional bus (NULL if not used)
+    size_t			m_ff_master;		  // master index on the functional bus
+    bool			m_ff_mode;		  // fast-forward mode
+    bool			m_ff_ca;		  // cycle-accurate request in fast-forward mode
+    bool			m_sleep_moore;		  // genMoore() is not clocked (clock gating)
+
+    // parallel mode : the ISS cycle is a job executed by a worker pool
+    struct IssJob : public PibusWorkerJob {
+        PibusMips32Xcache*	m_cache;
+        void run() 
+        { 
+            m_cache->r_proc.executeNCycles(1, m_cache->m_irsp, m_cache->m_drsp, m_cache->m_iss_it); 
+        }
+    };
+    PibusWorkerPool*		m_pool;			  // worker pool (NULL if not used)
+    IssJob			m_iss_job;		  // ISS cycle job
+    uint32_t			m_iss_it;		  // ISS interrupt input
+    bool			m_write_berr;		  // write bus error to be signaled to the ISS
+    uint32_t			m_last_ins;		  // last instruction sent to the ISS (checkpoint)
+    uint32_t			m_cp0_ins;		  // last instruction using a lost CP0 register (checkpoint)
+
     // processor
     GdbServer<Mips32ElIss>	r_proc;
 
@@ -184,23 +331,44 @@ class PibusMips32Xcache : sc_module {
     sc_register<uint32_t>	r_icache_save_set;
     sc_register<bool>		r_icache_miss_req;  	  // request to Pibus FSM
     sc_register<bool>		r_icache_unc_req;  	  // request to Pibus FSM
+    sc_register<bool>		r_icache_pref_hit;  	  // miss served by the prefetch buffer
+
+    sc_register<bool>		r_ipref_req;  		  // prefetch request to Pibus FSM
+    sc_register<bool>		r_ipref_pending;  	  // prefetch transaction not completed
+    sc_register<bool>		r_ipref_valid;  	  // prefetch buffer contains the line
+    sc_register<uint32_t>	r_ipref_addr;  		  // prefetched line address
 
     sc_register<int>		r_pibus_fsm;		  // PIBUS FSM state
     sc_register<uint32_t>	r_pibus_wcount;		  // word counter 
     sc_register<bool>		r_pibus_ins;		  // instruction request when true
+    sc_register<bool>		r_pibus_pref;		  // prefetch request when true
     sc_register<uint32_t>	r_pibus_addr; 		  // base address
-    sc_register<uint32_t>	r_pibus_wdata;		  // written data
-    sc_register<uint32_t>	r_pibus_opc;		  // transaction opc
-    sc_register<bool>		r_pibus_rsp_ok;		  // transaction completed : success
-    sc_register<bool>		r_pibus_rsp_error;	  // transaction completed : error  
-    uint32_t			r_pibus_buf[32];	  // data buffer 
-
-    sc_register<bool>           r_snoop_dcache_inval_req; // dcache slot must be invalidated
-    sc_register<uint32_t>	r_snoop_dcache_inval_way; // way to be invalidated
-    sc_register<uint32_t>	r_snoop_dcache_inval_set; // set to be invalidated
+    sc_register<uint32_t>	r_pibus_opc;		  // transaction opc (read)
+    sc_register<uint32_t>	r_pibus_wnext;		  // number of words in the write burst
+    sc_register<bool>		r_pibus_wc;		  // write burst can be extended
+    sc_register<bool>		r_pibus_sc;		  // the write transaction is a SC request
+    uint32_t			r_pibus_wbuf_data[32];	  // write burst data 
+    uint32_t			r_pibus_wbuf_opc[32];	  // write burst opc (byte enable)
+
+    // MSHR : one miss status holding register per source
+    sc_register<bool>		r_icache_rsp_ok;	  // ICACHE transaction completed : success
+    sc_register<bool>		r_icache_rsp_error;	  // ICACHE transaction completed : error  
+    uint32_t			r_icache_buf[32];	  // ICACHE data buffer 
+    sc_register<bool>		r_dcache_rsp_ok;	  // DCACHE transaction completed : success
+    sc_register<bool>		r_dcache_rsp_error;	  // DCACHE transaction completed : error  
+    uint32_t			r_dcache_buf[32];	  // DCACHE data buffer 
+    uint32_t			r_ipref_buf[32];	  // prefetch data buffer 
+
     sc_register<bool>    	r_snoop_llsc_inval_req;	  // llsc reservation must be invalidated
     sc_register<bool>    	r_snoop_flush_req;        // panic: both dcache and llsc flush
-    sc_register<uint32_t>	r_snoop_address_save;     // previous external hit address
+    sc_register<uint32_t>	r_snoop_address_save;     // last queued external hit address
+
+    // Fifos implementing the snoop invalidation queue
+    GenericFifo<uint32_t>      	r_snoop_inval_way;	  // ways to be invalidated
+    GenericFifo<uint32_t>      	r_snoop_inval_set;	  // sets to be invalidated
+
+    // snoop filter
+    PibusSnoopFilter		m_snoop_filter;
    
 
     // Fifos implementing the write buffer
@@ -213,21 +381,31 @@ class PibusMips32Xcache : sc_module {
     soclib::GenericCache<uint32_t>	r_dcache;
 
     // Intrumentation counters
-    uint32_t			c_total_cycles;
-    uint32_t			c_frz_cycles;
-    uint32_t			c_imiss_count;
-    uint32_t			c_imiss_frz;
-    uint32_t			c_iunc_count;
-    uint32_t			c_iunc_frz;
-    uint32_t			c_dread_count;
-    uint32_t			c_dmiss_count;
-    uint32_t			c_dmiss_frz;
-    uint32_t			c_dunc_count;
-    uint32_t			c_dunc_frz;
-    uint32_t			c_write_count;
-    uint32_t			c_write_frz;
-    uint32_t			c_sc_ok_count;
-    uint32_t			c_sc_ko_count;
+    uint64_t			c_total_cycles;
+    uint64_t			c_frz_cycles;
+    uint64_t			c_imiss_count;
+    uint64_t			c_imiss_frz;
+    uint64_t			c_ipref_count;
+    uint64_t			c_ipref_hit;
+    uint64_t			c_ipref_frz;
+    uint64_t			c_iunc_count;
+    uint64_t			c_iunc_frz;
+    uint64_t			c_dread_count;
+    uint64_t			c_dmiss_count;
+    uint64_t			c_dmiss_frz;
+    uint64_t			c_dunc_count;
+    uint64_t			c_dunc_frz;
+    uint64_t			c_write_count;
+    uint64_t			c_write_frz;
+    uint64_t			c_wburst_count;
+    uint64_t			c_wcomb_count;
+    uint64_t			c_snoop_count;
+    uint64_t			c_snoop_filtered;
+    uint64_t			c_snoop_inval;
+    uint64_t			c_snoop_flush;
+    uint64_t			c_sc_ok_count;
+    uint64_t			c_sc_ko_count;
+    uint64_t			c_ff_cycles;
 
     // DCACHE_FSM STATES
     enum{
@@ -266,6 +444,7 @@ class PibusMips32Xcache : sc_module {
 	PIBUS_READ_DT,
 	PIBUS_WRITE_REQ,
 	PIBUS_WRITE_AD,
+	PIBUS_WRITE_DTAD,
 	PIBUS_WRITE_DT,
     };
 	
@@ -308,7 +487,11 @@ public:
 			uint32_t		dcache_sets,	// number of icache sets
 			uint32_t		dcache_words,	// number of words per line
                 	uint32_t		fifo_depth,	// write buffer depth
-			bool		snoop_active = true);	// snoop activation 
+			bool		snoop_active = true,	// snoop activation 
+			bool		icache_prefetch = false,	// next line prefetch 
+			bool		write_combining = false,	// write burst combining
+			uint32_t	snoop_filter = 0,		// snoop filter counters
+			uint32_t	snoop_depth = 4);		// snoop invalidation queue depth
 
     ~PibusMips32Xcache ();
 
@@ -317,6 +500,23 @@ public:
     void genMoore();
     void printStatistics();
     void printTrace();
+    void setFastForward(PibusFunctionalBus* bus);
+    void setParallel(PibusWorkerPool* pool);
+    void registerCounters(PibusCounterRegistry &registry);
+
+    // checkpoint
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
+
+private:
+
+    bool fastForward();
+    bool ffSupported();
+    bool frozenOnRead();
+    bool writeCombine();
+    void executeIss(uint32_t it);
+    void enterCycleAccurate();
 
 }; // end structure PibusMips32Xcache
  
@@ -9,6 +9,9 @@
 #include "pibus_mips32_xcache.h"
 #include "alloc_elems.h"
 
+// GDB debug register index of the CP0 status register (MIPS32)
+#define ISS_DEBUG_SR	32
+
 using namespace soclib::caba;
 using namespace soclib::common;
 
@@ -20,20 +23,13 @@ using namespace soclib::common;
 ////////////////////////////////////
 inline uint32_t be2mask(uint32_t be)
 {
-    switch(be) {
-    case 0xF : return 0xFFFFFFFF;
-    case 0x1 : return 0x000000FF;
-    case 0x2 : return 0x0000FF00;
-    case 0x4 : return 0x00FF0000;
-    case 0x8 : return 0xFF000000;
-    case 0x3 : return 0x0000FFFF;
-    case 0xC : return 0xFFFF0000;
-    case 0x0 : return 0x00000000;
-    default  :
+    if (((PIBUS_BE_CODES >> (be & 0xF)) & 0x1) == 0)
+    {
         std::cout << "ERROR in PibuMis32Xcache " << std::endl;
         std::cout << "Invalid value for the BE field in a write request" << std::endl;
         exit(0);
     }
+    return pibus_opc_mask[pibus_be_opc[be & 0xF]];
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -47,18 +43,32 @@ PibusMips32Xcache::PibusMips32Xcache (	sc_module_name 		name,
 					uint32_t		dcache_sets,
 					uint32_t		dcache_words,
 					uint32_t		wbuf_depth,
-					bool			snoop_active)
+					bool			snoop_active,
+					bool			icache_prefetch,
+					bool			write_combining,
+					uint32_t		snoop_filter,
+					uint32_t		snoop_depth)
     : m_name(name),
-      m_cached_table(segtab.getCachedTable()),
+      m_cached_table(segtab.getDecodeRom().getCachedTable()),
       m_icache_sets(icache_sets),
       m_icache_words(icache_words),
       m_icache_ways(icache_ways),
       m_dcache_sets(dcache_sets),
       m_dcache_words(dcache_words),
       m_dcache_ways(dcache_ways),
-      m_msb_shift(32 - segtab.getMSBnumber()),
-      m_msb_mask((0x1 << segtab.getMSBnumber()) - 1),
       m_snoop_active(snoop_active),
+      m_icache_prefetch(icache_prefetch),
+      m_write_combining(write_combining),
+      m_ff_bus(NULL),
+      m_ff_master(0),
+      m_ff_mode(false),
+      m_ff_ca(false),
+      m_sleep_moore(false),
+      m_pool(NULL),
+      m_iss_it(0),
+      m_write_berr(false),
+      m_last_ins(0),
+      m_cp0_ins(0),
 
       r_proc( (std::string)name, proc_id),
 
@@ -79,16 +89,20 @@ PibusMips32Xcache::PibusMips32Xcache (	sc_module_name 		name,
       r_pibus_fsm("r_pibus_fsm"),
       r_pibus_wcount("r_pibus_wcount"),
       r_pibus_addr("r_pibus_addr"),
-      r_pibus_wdata("r_pibus_wdata"),
       r_pibus_opc("r_pibus_opc"),
+      r_pibus_wnext("r_pibus_wnext"),
+      r_pibus_wc("r_pibus_wc"),
+      r_pibus_sc("r_pibus_sc"),
 
-      r_snoop_dcache_inval_req("r_snoop_dcache_inval_req"),
-      r_snoop_dcache_inval_way("r_snoop_dcache_inval_way"),
-      r_snoop_dcache_inval_set("r_snoop_dcache_inval_set"),
       r_snoop_llsc_inval_req("r_snoop_llsc_inval_req"),
       r_snoop_flush_req("r_snoop_flush_req"),
       r_snoop_address_save("r_snoop_address_save"),
 
+      r_snoop_inval_way("r_snoop_inval_way", snoop_depth),
+      r_snoop_inval_set("r_snoop_inval_set", snoop_depth),
+
+      m_snoop_filter(snoop_filter),
+
       r_wbuf_data("r_wbuf_data", wbuf_depth),
       r_wbuf_addr("r_wbuf_addr", wbuf_depth),
       r_wbuf_type("r_wbuf_type", wbuf_depth),
@@ -122,6 +136,12 @@ PibusMips32Xcache::PibusMips32Xcache (	sc_module_name 		name,
         std::cout << "The number of ways cannot be larger than 16" << std::endl;
         exit(0);
     }
+    if ( snoop_depth == 0 )
+    {
+        std::cout << "ERROR in PibusMips32Xcache : " << name << std::endl;
+        std::cout << "The snoop invalidation queue depth cannot be 0" << std::endl;
+        exit(0);
+    }
     if      ( m_icache_words == 1  )  m_line_inst_mask = 0xFFFFFFFC;
     else if ( m_icache_words == 2  )  m_line_inst_mask = 0xFFFFFFF8;
     else if ( m_icache_words == 4  )  m_line_inst_mask = 0xFFFFFFF0;
@@ -157,6 +177,10 @@ PibusMips32Xcache::PibusMips32Xcache (	sc_module_name 		name,
     std::cout << "    dcache_words = " << dcache_words << std::endl;
     std::cout << "    wbuf_depth   = " << wbuf_depth   << std::endl;
     std::cout << "    snoop        = " << snoop_active << std::endl;
+    std::cout << "    snoop_filter = " << snoop_filter << std::endl;
+    std::cout << "    snoop_depth  = " << snoop_depth  << std::endl;
+    std::cout << "    prefetch     = " << icache_prefetch << std::endl;
+    std::cout << "    combining    = " << write_combining << std::endl;
  
     strcpy(m_dcache_fsm_str[0],  "DCACHE_IDLE");
     strcpy(m_dcache_fsm_str[1],  "DCACHE_WRITE_UPDT");
@@ -187,16 +211,431 @@ PibusMips32Xcache::PibusMips32Xcache (	sc_module_name 		name,
     strcpy(m_pibus_fsm_str[4], "PIBUS_READ_DT");
     strcpy(m_pibus_fsm_str[5], "PIBUS_WRITE_REQ");
     strcpy(m_pibus_fsm_str[6], "PIBUS_WRITE_AD");
-    strcpy(m_pibus_fsm_str[7], "PIBUS_WRITE_DT");
+    strcpy(m_pibus_fsm_str[7], "PIBUS_WRITE_DTAD");
+    strcpy(m_pibus_fsm_str[8], "PIBUS_WRITE_DT");
 
 } // end  constructor
 
-PibusMips32Xcache::~PibusMips32Xcache () {} 
+// In parallel mode, the worker pool is deleted before the component
+// (the pool destructor completes the running jobs).
+PibusMips32Xcache::~PibusMips32Xcache () 
+{
+} 
+
+/////////////////////////////////////////////////////////////////
+void PibusMips32Xcache::setParallel(PibusWorkerPool* pool)
+{
+    m_pool            = pool;
+    m_iss_job.m_cache = this;
+    std::cout << m_name << " : parallel mode / nthreads = " 
+              << std::dec << pool->getNThreads() << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////
+// In parallel mode, the ISS cycle is posted to the worker pool,
+// and is completed at the beginning of the next transition().
+// The ISS only uses the m_irsp, m_drsp & m_iss_it variables,
+// that are not modified before completion.
+/////////////////////////////////////////////////////////////////
+void PibusMips32Xcache::executeIss(uint32_t it)
+{
+    if ( m_pool )
+    {
+        m_iss_it = it;
+        m_pool->post( &m_iss_job );
+    }
+    else
+    {
+        r_proc.executeNCycles(1, m_irsp, m_drsp, it);
+    }
+}
+
+/////////////////////////////////////////////////////////////////
+void PibusMips32Xcache::registerCounters(PibusCounterRegistry &registry)
+{
+    registry.add(m_name, "total_cycles", &c_total_cycles);
+    registry.add(m_name, "frz_cycles",   &c_frz_cycles);
+    registry.add(m_name, "imiss_count",  &c_imiss_count);
+    registry.add(m_name, "imiss_frz",    &c_imiss_frz);
+    registry.add(m_name, "iunc_count",   &c_iunc_count);
+    registry.add(m_name, "iunc_frz",     &c_iunc_frz);
+    registry.add(m_name, "dread_count",  &c_dread_count);
+    registry.add(m_name, "dmiss_count",  &c_dmiss_count);
+    registry.add(m_name, "dmiss_frz",    &c_dmiss_frz);
+    registry.add(m_name, "dunc_count",   &c_dunc_count);
+    registry.add(m_name, "dunc_frz",     &c_dunc_frz);
+    registry.add(m_name, "write_count",  &c_write_count);
+    registry.add(m_name, "write_frz",    &c_write_frz);
+    registry.add(m_name, "sc_ok_count",  &c_sc_ok_count);
+    registry.add(m_name, "sc_ko_count",  &c_sc_ko_count);
+    if ( m_icache_prefetch )
+    {
+        registry.add(m_name, "ipref_count", &c_ipref_count);
+        registry.add(m_name, "ipref_hit",   &c_ipref_hit);
+        registry.add(m_name, "ipref_frz",   &c_ipref_frz);
+    }
+    if ( m_write_combining )
+    {
+        registry.add(m_name, "wburst_count", &c_wburst_count);
+        registry.add(m_name, "wcomb_count",  &c_wcomb_count);
+    }
+    if ( m_snoop_active )
+    {
+        registry.add(m_name, "snoop_count",    &c_snoop_count);
+        registry.add(m_name, "snoop_filtered", &c_snoop_filtered);
+        registry.add(m_name, "snoop_inval",    &c_snoop_inval);
+        registry.add(m_name, "snoop_flush",    &c_snoop_flush);
+    }
+    if ( m_ff_bus ) registry.add(m_name, "ff_cycles", &c_ff_cycles);
+}
+
+/////////////////////////////////////////////////////////////////
+void PibusMips32Xcache::setFastForward(PibusFunctionalBus* bus)
+{
+    m_ff_bus    = bus;
+    m_ff_master = bus->registerMaster();
+    std::cout << m_name << " : fast-forward mode / quantum = " 
+              << std::dec << bus->getQuantum() << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////
+// This function returns true if the pending processor requests
+// can be handled by the functional bus.
+/////////////////////////////////////////////////////////////////
+bool PibusMips32Xcache::ffSupported()
+{
+    if ( m_ireq.valid and not m_ff_bus->isSupported( m_ireq.addr ) ) return false;
+    if ( not m_dreq.valid ) return true;
+    if ( m_dreq.type == soclib::common::Iss2::XTN_WRITE )
+        return ( (m_dreq.addr/4 == soclib::common::Iss2::XTN_DCACHE_INVAL) or
+                 (m_dreq.addr/4 == soclib::common::Iss2::XTN_SYNC) );
+    if ( m_dreq.type == soclib::common::Iss2::XTN_READ ) return false;
+    return m_ff_bus->isSupported( m_dreq.addr );
+}
+
+/////////////////////////////////////////////////////////////////
+// The caches have not been updated in fast-forward mode,
+// and are flushed. The LL/SC reservation is handed over 
+// to the r_llsc registers.
+/////////////////////////////////////////////////////////////////
+void PibusMips32Xcache::enterCycleAccurate()
+{
+    uint32_t	llsc_addr;
+    bool	llsc_valid = m_ff_bus->getReservation( m_ff_master, &llsc_addr );
+
+    r_icache.reset();
+    r_dcache.reset();
+    r_snoop_inval_way.init();
+    r_snoop_inval_set.init();
+    m_snoop_filter.reset();
+    r_ipref_valid            = false;
+    r_llsc_pending           = llsc_valid;
+    r_llsc_addr              = llsc_addr;
+    r_snoop_flush_req        = false;
+    r_snoop_llsc_inval_req   = false;
+    m_ff_ca                  = true;
+    if ( not m_ff_bus->isActive() ) m_ff_mode = false;
+}
+
+/////////////////////////////////////////////////////////////////
+// This function returns true if the MIPS32 instruction is a
+// branch or a jump (including the REGIMM traps and the COP
+// branches) : the next instruction is a delay slot.
+/////////////////////////////////////////////////////////////////
+static bool isBranch(uint32_t ins)
+{
+    uint32_t op = ins >> 26;
+    if ( op == 0 ) return ((ins & 0x3F) == 0x08) or ((ins & 0x3F) == 0x09);	// JR / JALR
+    if ( (op >= 0x01) and (op <= 0x07) ) return true;				// REGIMM / J / JAL / Bxx
+    if ( (op >= 0x10) and (op <= 0x13) ) return ((ins >> 21) & 0x1F) == 0x08;	// BCz
+    return (op >= 0x14) and (op <= 0x17);					// Bxx likely
+}
+
+/////////////////////////////////////////////////////////////////
+// This function returns true if the instruction uses a CP0
+// register that is not accessible through the debug registers,
+// and cannot be restored : MTC0 to any register other than SR,
+// CAUSE and EPC, MFC0 of Count, and RDHWR of the cycle counter.
+// EPC is only used in the exception handlers (SR.EXL set).
+/////////////////////////////////////////////////////////////////
+static bool cp0Lost(uint32_t ins)
+{
+    uint32_t op  = ins >> 26;
+    uint32_t rd  = (ins >> 11) & 0x1F;
+    if ( op == 0x10 )
+    {
+        uint32_t rs = (ins >> 21) & 0x1F;
+        if ( rs == 0x04 ) return ((ins & 0x7) != 0) or (rd < 12) or (rd > 14);	// MTC0
+        if ( rs == 0x00 ) return (rd == 9);						// MFC0 Count
+        return false;
+    }
+    return (op == 0x1F) and ((ins & 0x3F) == 0x3B) and (rd == 2);		// RDHWR CC
+}
+
+/////////////////////////////////////////////////////////////////
+// The component can be checkpointed when it is quiescent, and
+// when the ISS state is entirely defined by the debug registers.
+// The ISS requests are the requests for the next cycle.
+/////////////////////////////////////////////////////////////////
+bool PibusMips32Xcache::checkpointReady()
+{
+    if ( m_pool ) m_pool->wait( &m_iss_job );
+
+    Iss2::InstructionRequest	ireq;
+    Iss2::DataRequest		dreq;
+    r_proc.getRequests( ireq, dreq );
+
+    return not m_ff_mode and
+           (r_dcache_fsm == DCACHE_IDLE) and
+           (r_icache_fsm == ICACHE_IDLE) and
+           (r_pibus_fsm == PIBUS_IDLE) and
+           not r_icache_miss_req.read() and
+           not r_icache_unc_req.read() and
+           not r_dcache_miss_req.read() and
+           not r_dcache_unc_req.read() and
+           not r_dcache_sc_req.read() and
+           not r_ipref_req.read() and
+           not r_ipref_pending.read() and
+           not r_wbuf_data.rok() and
+           not r_snoop_inval_way.rok() and
+           not r_snoop_llsc_inval_req.read() and
+           not r_snoop_flush_req.read() and
+           not m_write_berr and
+           not dreq.valid and
+           ((r_proc.debugGetRegisterValue(ISS_DEBUG_SR) & 0x6) == 0) and
+           not isBranch( m_last_ins );
+}
+
+/////////////////////////////////////////////////////////////////
+// The checkpoint is refused when the software has used a CP0
+// register that cannot be restored (EBASE, Count, Compare, ...).
+/////////////////////////////////////////////////////////////////
+void PibusMips32Xcache::saveState(PibusCheckpointWriter &writer)
+{
+    if ( m_cp0_ins != 0 )
+    {
+        std::cout << "ERROR in PibusMips32Xcache : " << m_name << std::endl;
+        std::cout << "The CP0 state cannot be checkpointed : instruction 0x" 
+                  << std::hex << m_cp0_ins << std::dec 
+                  << " uses a CP0 register that is not saved" << std::endl;
+        exit(1);
+    }
+    uint32_t nregs = r_proc.debugGetRegisterCount();
+    writer.put(nregs);
+    for ( uint32_t i = 0 ; i < nregs ; i++ ) 
+        writer.put((uint32_t)r_proc.debugGetRegisterValue(i));
+    writer.put(r_llsc_pending);
+    writer.put(r_llsc_addr);
+}
+
+/////////////////////////////////////////////////////////////////
+// The component has been reset : the caches, the FIFOs and
+// the FSMs are in the checkpoint state.
+/////////////////////////////////////////////////////////////////
+void PibusMips32Xcache::restoreState(PibusCheckpointReader &reader)
+{
+    uint32_t nregs;
+    reader.get(nregs);
+    if ( nregs != r_proc.debugGetRegisterCount() )
+    {
+        std::cout << "ERROR in PibusMips32Xcache : " << m_name << std::endl;
+        std::cout << "The checkpoint ISS registers do not match" << std::endl;
+        exit(1);
+    }
+    for ( uint32_t i = 0 ; i < nregs ; i++ )
+    {
+        uint32_t value;
+        reader.get(value);
+        r_proc.debugSetRegisterValue(i, value);
+    }
+    reader.get(r_llsc_pending);
+    reader.get(r_llsc_addr);
+    m_last_ins = 0;
+    m_cp0_ins  = 0;
+}
+
+/////////////////////////////////////////////////////////////////
+// This function returns true if the write request at the head
+// of the write buffer can be combined in the current write burst :
+// the burst can be extended, the address of the last word of the
+// burst is currently sent on the bus, and the request address is
+// the next address in the same cache line.
+/////////////////////////////////////////////////////////////////
+bool PibusMips32Xcache::writeCombine()
+{
+    uint32_t next = r_pibus_addr.read() + (r_pibus_wnext.read() << 2);
+
+    return r_pibus_wc.read() and 
+           r_wbuf_data.rok() and
+           (r_pibus_wcount.read() + 1 == r_pibus_wnext.read()) and
+           (r_wbuf_addr.read() == next) and
+           ((next & m_line_data_mask) == (r_pibus_addr.read() & m_line_data_mask));
+}
+
+/////////////////////////////////////////////////////////////////
+// This function returns true if the current cycle has no other
+// effect than the instrumentation counters and the ISS cycle :
+// - the PIBUS FSM is waiting the response of a read transaction,
+// - each cache FSM is waiting this response, or is idle without
+//   processor or snoop request,
+// - there is no external write on the bus to be snooped. 
+/////////////////////////////////////////////////////////////////
+bool PibusMips32Xcache::frozenOnRead()
+{
+    if ( (r_pibus_fsm != PIBUS_READ_DT) or
+         (p_ack.read() != PIBUS_ACK_WAIT) or
+         p_tout.read() or
+         r_icache_rsp_ok.read() or
+         r_icache_rsp_error.read() or
+         r_dcache_rsp_ok.read() or
+         r_dcache_rsp_error.read() ) return false;
+
+    // prefetch hit completed
+    if ( (r_icache_fsm == ICACHE_MISS_WAIT) and r_icache_pref_hit.read() and 
+         (r_ipref_valid.read() or not r_ipref_pending.read()) ) return false;
+
+    if ( m_snoop_active and p_avalid.read() ) return false;
+
+    bool icache_wait = (r_icache_fsm == ICACHE_MISS_WAIT) or 
+                       (r_icache_fsm == ICACHE_UNC_WAIT);
+    bool dcache_wait = (r_dcache_fsm == DCACHE_MISS_WAIT) or 
+                       (r_dcache_fsm == DCACHE_UNC_WAIT);
+    bool icache_idle = (r_icache_fsm == ICACHE_IDLE) and not m_ireq.valid;
+    bool dcache_idle = (r_dcache_fsm == DCACHE_IDLE) and not m_dreq.valid and
+                       not r_snoop_llsc_inval_req.read() and 
+                       not r_snoop_flush_req.read() and 
+                       not r_snoop_inval_way.rok();
+
+    return (icache_wait or dcache_wait) and 
+           (icache_wait or icache_idle) and 
+           (dcache_wait or dcache_idle);
+}
+
+/////////////////////////////////////////////////////////////////
+// This function executes QUANTUM processor cycles, using the
+// functional bus. It returns false if the current cycle must
+// be executed by the cycle-accurate FSMs.
+/////////////////////////////////////////////////////////////////
+bool PibusMips32Xcache::fastForward()
+{
+    // a cycle-accurate transaction is not completed
+    if ( (r_dcache_fsm != DCACHE_IDLE) or
+         (r_icache_fsm != ICACHE_IDLE) or
+         (r_pibus_fsm != PIBUS_IDLE) or
+         r_ipref_pending.read() or
+         r_wbuf_data.rok() ) return false;
+
+    if ( m_ff_ca )
+    {
+        if ( not m_ff_bus->isActive() )
+        {
+            m_ff_mode = false;
+            return false;
+        }
+        r_proc.getRequests( m_ireq, m_dreq );
+        if ( not ffSupported() ) return false;
+        // the LL/SC reservation is handed over to the functional bus
+        m_ff_bus->setReservation( m_ff_master, r_llsc_pending.read(), r_llsc_addr.read() );
+        m_ff_ca = false;
+    }
+
+    uint32_t it = 0;
+    if ( p_irq.read() ) it = 1;
+
+    size_t cycles;
+    for ( cycles = 0 ; cycles < m_ff_bus->getQuantum() ; cycles++ )
+    {
+        r_proc.getRequests( m_ireq, m_dreq );
+
+        if ( m_ireq.valid ) m_ff_bus->checkSwitch( c_total_cycles, m_ireq.addr );
+        if ( not m_ff_bus->isActive() or not ffSupported() ) break;
+
+        m_irsp.valid = false;
+        m_drsp.valid = false;
+        bool write_error = false;
+
+        if ( m_ireq.valid )
+        {
+            m_irsp.valid = true;
+            m_irsp.error = not m_ff_bus->read( m_ff_master, 
+                                               m_ireq.addr, 
+                                               &m_irsp.instruction,
+                                               PIBUS_OPC_WDU, 1 );
+            if ( cp0Lost( m_irsp.instruction ) ) m_cp0_ins = m_irsp.instruction;
+        }
+        if ( m_dreq.valid )
+        {
+            m_drsp.valid = true;
+            m_drsp.error = false;
+            m_drsp.rdata = 0;
+            switch ( m_dreq.type ) {
+            case soclib::common::Iss2::DATA_READ :
+                m_drsp.error = not m_ff_bus->read( m_ff_master,
+                                                   m_dreq.addr,
+                                                   &m_drsp.rdata,
+                                                   PIBUS_OPC_WDU, 1 );
+                break;
+            case soclib::common::Iss2::DATA_LL :
+                m_drsp.error = not m_ff_bus->linkedLoad( m_ff_master,
+                                                         m_dreq.addr,
+                                                         &m_drsp.rdata );
+                break;
+            case soclib::common::Iss2::DATA_WRITE :
+                write_error = not m_ff_bus->write( m_ff_master,
+                                                   m_dreq.addr,
+                                                   &m_dreq.wdata,
+                                                   pibus_be_opc[m_dreq.be & 0xF], 1 );
+                break;
+            case soclib::common::Iss2::DATA_SC :
+            {
+                bool atomic;
+                write_error = not m_ff_bus->storeConditional( m_ff_master,
+                                                              m_dreq.addr,
+                                                              m_dreq.wdata,
+                                                              &atomic );
+                if ( atomic ) m_drsp.rdata = Iss2::SC_ATOMIC;
+                else          m_drsp.rdata = Iss2::SC_NOT_ATOMIC;
+                break;
+            }
+            default :	// XTN_DCACHE_INVAL & XTN_SYNC
+                break;
+            }
+        }
+
+        r_proc.executeNCycles(1, m_irsp, m_drsp, it);
+        if ( write_error ) r_proc.setWriteBerr();
+        c_total_cycles++;
+        c_ff_cycles++;
+    }
+
+    // switch to the cycle-accurate mode (definitely or not) 
+    if ( cycles < m_ff_bus->getQuantum() ) 
+    {
+        enterCycleAccurate();
+        if ( cycles == 0 )
+        {
+            m_irsp.valid = false;
+            m_drsp.valid = false;
+            r_proc.executeNCycles(1, m_irsp, m_drsp, it);
+            c_total_cycles++;
+            c_frz_cycles++;
+        }
+    }
+    return true;
+} // end fastForward()
 
 
 ////////////////////////////////////
 void PibusMips32Xcache::transition()
 {
+    // complete the ISS cycle of the previous cycle 
+    if ( m_pool ) m_pool->wait( &m_iss_job );
+    if ( m_write_berr )
+    {
+        r_proc.setWriteBerr();
+        m_write_berr = false;
+    }
+
     // RESET
     if (p_resetn == false) 
     { 
@@ -206,6 +645,9 @@ void PibusMips32Xcache::transition()
         r_wbuf_addr.init();
         r_icache.reset();
         r_dcache.reset();
+        r_snoop_inval_way.init();
+        r_snoop_inval_set.init();
+        m_snoop_filter.reset();
 
         r_dcache_fsm             = DCACHE_IDLE; 
         r_icache_fsm             = ICACHE_IDLE; 
@@ -217,19 +659,31 @@ void PibusMips32Xcache::transition()
         r_dcache_unc_req         = false;
         r_dcache_sc_req          = false;
 
-        r_pibus_rsp_ok           = false;
-        r_pibus_rsp_error        = false;
+        r_icache_rsp_ok          = false;
+        r_icache_rsp_error       = false;
+        r_dcache_rsp_ok          = false;
+        r_dcache_rsp_error       = false;
+        r_icache_pref_hit        = false;
+        r_ipref_req              = false;
+        r_ipref_pending          = false;
+        r_ipref_valid            = false;
+        r_pibus_wc               = false;
+        r_pibus_sc               = false;
 
         r_llsc_pending	         = false;
 
         r_snoop_flush_req        = false;
-        r_snoop_dcache_inval_req = false;
         r_snoop_llsc_inval_req   = false;
+        m_last_ins               = 0;
+        m_cp0_ins                = 0;
 
         c_total_cycles  = 0;
         c_frz_cycles    = 0;
         c_imiss_count   = 0;
         c_imiss_frz     = 0;
+        c_ipref_count   = 0;
+        c_ipref_hit     = 0;
+        c_ipref_frz     = 0;
         c_iunc_count    = 0;
         c_iunc_frz      = 0;
         c_dread_count   = 0;
@@ -241,9 +695,22 @@ void PibusMips32Xcache::transition()
         c_sc_ok_count	= 0;
         c_sc_ko_count	= 0;
         c_write_frz     = 0;
+        c_wburst_count  = 0;
+        c_wcomb_count   = 0;
+        c_snoop_count   = 0;
+        c_snoop_filtered = 0;
+        c_snoop_inval   = 0;
+        c_snoop_flush   = 0;
+        c_ff_cycles     = 0;
+
+        m_ff_mode       = (m_ff_bus != NULL) and m_ff_bus->isActive();
+        m_ff_ca         = false;
         return;
     } 
 
+    // FAST-FORWARD
+    if ( m_ff_mode and fastForward() ) return;
+
     c_total_cycles++;
 
     r_proc.getRequests( m_ireq, m_dreq );
@@ -251,6 +718,28 @@ void PibusMips32Xcache::transition()
     m_irsp.valid = false;
     m_drsp.valid = false;
 
+#ifdef PIBUS_CLOCK_GATING
+    // The processor is frozen, waiting a read response from the PIBUS :
+    // only the instrumentation counters and the ISS are clocked.
+    if ( frozenOnRead() )
+    {
+        if      ( r_icache_fsm == ICACHE_MISS_WAIT ) 
+        {
+            if ( r_icache_pref_hit ) c_ipref_frz++;
+            else                     c_imiss_frz++;
+        }
+        else if ( r_icache_fsm == ICACHE_UNC_WAIT )  c_iunc_frz++;
+        if      ( r_dcache_fsm == DCACHE_MISS_WAIT ) c_dmiss_frz++;
+        else if ( r_dcache_fsm == DCACHE_UNC_WAIT )  c_dunc_frz++;
+
+        uint32_t it = 0;
+        if ( p_irq.read() ) it = 1;
+        executeIss(it);
+        if ( m_ireq.valid or m_dreq.valid ) c_frz_cycles++;
+        return;
+    }
+#endif
+
     /////////////////////////////////////////////////////////////////////
     // The ICACHE FSM has 6 states and controls :
     // - r_icache_fsm 
@@ -260,8 +749,13 @@ void PibusMips32Xcache::transition()
     // - r_icache_save_set 
     // - r_icache_miss_req set
     // - r_icache_unc_req set
-    // - r_pibus_rsp_ok reset
-    // - r_pibus_rsp_error reset
+    // - r_icache_pref_hit
+    // - r_icache_rsp_ok reset
+    // - r_icache_rsp_error reset
+    // - r_ipref_req set
+    // - r_ipref_pending set
+    // - r_ipref_valid reset
+    // - r_ipref_addr
     // - m_irsp 
     //////////////////////////////////////////////////////////////////////
 
@@ -275,7 +769,7 @@ void PibusMips32Xcache::transition()
             size_t      icache_way;
             size_t      icache_set;
             size_t      icache_word;
-            bool    	icache_cacheable = m_cached_table[((m_ireq.addr >> m_msb_shift) & m_msb_mask)];
+            bool    	icache_cacheable = m_cached_table[m_ireq.addr >> PIBUS_DECODE_SHIFT];
             if ( icache_cacheable ) 
             {
                 icache_hit = r_icache.read( m_ireq.addr,
@@ -291,13 +785,25 @@ void PibusMips32Xcache::transition()
                 }   
                 else 
                 { 
+                    uint32_t line = m_ireq.addr & m_line_inst_mask;
                     c_imiss_count++;
-                    c_imiss_frz++;
                     r_icache_save_way  = icache_way;
                     r_icache_save_set  = icache_set;
-                    r_icache_save_addr = m_ireq.addr & m_line_inst_mask;
-                    r_icache_miss_req  = true;
+                    r_icache_save_addr = line;
                     r_icache_fsm       = ICACHE_MISS_SELECT;
+                    if ( (r_ipref_valid.read() or r_ipref_pending.read()) and 
+                         (r_ipref_addr.read() == line) )	// prefetch hit
+                    {
+                        c_ipref_hit++;
+                        c_ipref_frz++;
+                        r_icache_pref_hit = true;
+                    }
+                    else
+                    {
+                        c_imiss_frz++;
+                        r_icache_pref_hit = false;
+                        r_icache_miss_req = true;
+                    }
                 }
             }
             else 			
@@ -313,7 +819,8 @@ void PibusMips32Xcache::transition()
     }
     case ICACHE_MISS_SELECT :
     {
-        c_imiss_frz++;
+        if ( r_icache_pref_hit ) c_ipref_frz++;
+        else                     c_imiss_frz++;
         uint32_t victim;	// unused
         bool	 valid;
         size_t   way;
@@ -330,7 +837,8 @@ void PibusMips32Xcache::transition()
     }
     case ICACHE_MISS_INVAL :
     {
-        c_imiss_frz++;
+        if ( r_icache_pref_hit ) c_ipref_frz++;
+        else                     c_imiss_frz++;
         uint32_t nline;		// unused
         r_icache.inval( r_icache_save_way.read(),
                         r_icache_save_set.read(),
@@ -340,41 +848,74 @@ void PibusMips32Xcache::transition()
     }
     case ICACHE_MISS_WAIT :
     {
-        c_imiss_frz++;
-        if( r_pibus_ins && r_pibus_rsp_ok )
+        if ( r_icache_pref_hit ) c_ipref_frz++;
+        else                     c_imiss_frz++;
+        if( r_icache_pref_hit )
+        {
+            if( r_ipref_valid ) 
+            {
+                r_icache_fsm      = ICACHE_MISS_UPDT;
+            }
+            else if( not r_ipref_pending )	// prefetch error : normal miss
+            {
+                r_icache_pref_hit = false;
+                r_icache_miss_req = true;
+            }
+            break;
+        }
+        if( r_icache_rsp_ok )
         {
             r_icache_fsm     = ICACHE_MISS_UPDT;
-            r_pibus_rsp_ok   = false;
+            r_icache_rsp_ok  = false;
         }
-        if( r_pibus_ins && r_pibus_rsp_error ) 
+        if( r_icache_rsp_error ) 
         {
-            r_icache_fsm      = ICACHE_ERROR;
-            r_pibus_rsp_error = false;
+            r_icache_fsm       = ICACHE_ERROR;
+            r_icache_rsp_error = false;
         }
         break;
     }
     case ICACHE_MISS_UPDT :
     {
-        c_imiss_frz++;
+        if ( r_icache_pref_hit ) c_ipref_frz++;
+        else                     c_imiss_frz++;
         r_icache.update( r_icache_save_addr.read(),
                          r_icache_save_way.read(),
                          r_icache_save_set.read(),
-                         r_pibus_buf );
-        r_icache_fsm = ICACHE_IDLE;
+                         r_icache_pref_hit ? r_ipref_buf : r_icache_buf );
+
+        // next line prefetch : the prefetch buffer is released
+        // once the icache has been updated
+        if( m_icache_prefetch and not r_ipref_pending.read() )
+        {
+            uint32_t	next = r_icache_save_addr.read() + (m_icache_words << 2);
+            size_t	way, set, word;
+            r_ipref_valid = false;
+            if( (next != 0) and m_cached_table[next >> PIBUS_DECODE_SHIFT] and
+                not r_icache.hit( next, &way, &set, &word ) )
+            {
+                c_ipref_count++;
+                r_ipref_addr    = next;
+                r_ipref_req     = true;
+                r_ipref_pending = true;
+            }
+        }
+        r_icache_pref_hit = false;
+        r_icache_fsm      = ICACHE_IDLE;
         break;
     }
     case ICACHE_UNC_WAIT :
     {
         c_iunc_frz++;
-        if( r_pibus_ins && r_pibus_rsp_ok )
+        if( r_icache_rsp_ok )
         {
             r_icache_fsm     = ICACHE_UNC_GO;
-            r_pibus_rsp_ok   = false;
+            r_icache_rsp_ok  = false;
         }
-        if( r_pibus_ins && r_pibus_rsp_error ) 
+        if( r_icache_rsp_error ) 
         {
-            r_icache_fsm      = ICACHE_ERROR;
-            r_pibus_rsp_error = false;
+            r_icache_fsm       = ICACHE_ERROR;
+            r_icache_rsp_error = false;
         }
         break;
     }
@@ -384,7 +925,7 @@ void PibusMips32Xcache::transition()
         {
             m_irsp.valid          = true; 
             m_irsp.error          = false;
-            m_irsp.instruction    = r_pibus_buf[0];
+            m_irsp.instruction    = r_icache_buf[0];
         }
         r_icache_fsm = ICACHE_IDLE;
         break;
@@ -413,13 +954,13 @@ void PibusMips32Xcache::transition()
     // - r_dcache_save_word
     // - r_dcache_miss_req set
     // - r_dcache_unc_req set
-    // - r_pibus_rsp_ok reset
-    // - r_pibus_rsp_error reset
+    // - r_dcache_rsp_ok reset
+    // - r_dcache_rsp_error reset
     // - r_llsc_pending
     // - r_llsc_addr
     // - m_drsp 
     // There is seven mutually exclusive conditions to exit the IDLE state :
-    // - SNOOP  => to SNOOP_INVAL_* or SNOOP_FLUSH for one cycle, then IDLE.
+    // - SNOOP  => one invalidation (from the snoop queue) or flush per cycle.
     // - CACHED READ MISS => to MISS_SELECT, then MISS_WAIT, then MISS_UPDT
     //   (to update the cache), and finally to IDLE.
     // - UNCACHED READ => to UNC_WAIT, then to UNC_GO
@@ -434,6 +975,13 @@ void PibusMips32Xcache::transition()
     // taken into account in the WRITEREQ state as well as in the IDLE state.
     //////////////////////////////////////////////////////////////////////////////////////
 
+    // snoop invalidation queue commands (see the end of transition)
+    bool	snoop_fifo_get  = false;
+    bool	snoop_fifo_put  = false;
+    bool	snoop_fifo_init = false;
+    uint32_t	snoop_fifo_way  = 0;
+    uint32_t	snoop_fifo_set  = 0;
+
     switch ( r_dcache_fsm.read() ) {
     case DCACHE_WRITE_REQ :
     {
@@ -459,20 +1007,21 @@ void PibusMips32Xcache::transition()
         if ( r_snoop_flush_req.read() )	    
         {
             r_dcache.reset();
+            m_snoop_filter.reset();
             r_snoop_flush_req        = false;
-            r_snoop_dcache_inval_req = false;
+            snoop_fifo_init          = true;
             r_dcache_fsm             = DCACHE_IDLE;     
         }
 
         // dcache inval request
-        else if ( r_snoop_dcache_inval_req.read() )
+        else if ( r_snoop_inval_way.rok() )
         {
-            uint32_t dummy;
-            r_dcache.inval( r_snoop_dcache_inval_way.read(), 
-                            r_snoop_dcache_inval_set.read(),
-                            &dummy );
-            r_snoop_dcache_inval_req = false;
-            r_dcache_fsm = DCACHE_IDLE;     
+            uint32_t nline;
+            if ( r_dcache.inval( r_snoop_inval_way.read(), 
+                                 r_snoop_inval_set.read(),
+                                 &nline ) ) m_snoop_filter.remove( nline * (m_dcache_words << 2) );
+            snoop_fifo_get = true;
+            r_dcache_fsm   = DCACHE_IDLE;     
         }
 
         // Processor request
@@ -480,7 +1029,7 @@ void PibusMips32Xcache::transition()
         {
             bool        dcache_hit;;
             uint32_t    dcache_rdata;
-            bool        dcache_cacheable = m_cached_table[((m_dreq.addr >> m_msb_shift) & m_msb_mask)];
+            bool        dcache_cacheable = m_cached_table[m_dreq.addr >> PIBUS_DECODE_SHIFT];
             size_t	dcache_way;
             size_t	dcache_set;
             size_t	dcache_word;
@@ -634,10 +1183,10 @@ void PibusMips32Xcache::transition()
     }
     case DCACHE_INVAL:
     {
-        uint32_t dummy;
-        r_dcache.inval( r_dcache_save_way.read(),
-                        r_dcache_save_set.read(),
-                        &dummy );
+        uint32_t nline;
+        if ( r_dcache.inval( r_dcache_save_way.read(),
+                             r_dcache_save_set.read(),
+                             &nline ) ) m_snoop_filter.remove( nline * (m_dcache_words << 2) );
         m_drsp.valid	= true;
         m_drsp.error    = false;
         m_drsp.rdata    = 0;
@@ -656,8 +1205,20 @@ void PibusMips32Xcache::transition()
     }
     case DCACHE_SC_WAIT:
     {
-        // abort the SC request and reset llsc registration in case of snoop request
-        if (  r_snoop_llsc_inval_req.read() )
+        // the SC write transaction is on the bus (or granted) : it cannot be aborted
+        bool sc_bus  = r_pibus_sc.read() and not r_dcache_sc_req.read() and
+                       ((r_pibus_fsm == PIBUS_WRITE_AD) or 
+                        (r_pibus_fsm == PIBUS_WRITE_DT) or
+                        ((r_pibus_fsm == PIBUS_WRITE_REQ) and p_gnt.read()));
+        // the data phase is completed
+        bool sc_done = sc_bus and (r_pibus_fsm == PIBUS_WRITE_DT) and 
+                       (p_tout.read() or (p_ack.read() == PIBUS_ACK_READY) or 
+                                         (p_ack.read() == PIBUS_ACK_ERROR));
+
+        // abort the SC request and reset llsc registration in case of snoop request,
+        // or in case of bus error
+        if ( (r_snoop_llsc_inval_req.read() and not sc_bus) or
+             (sc_done and (p_ack.read() != PIBUS_ACK_READY)) )
         {
             c_sc_ko_count++;
             r_llsc_pending  = false;
@@ -667,8 +1228,9 @@ void PibusMips32Xcache::transition()
             m_drsp.error    = false;
             m_drsp.rdata    = Iss2::SC_NOT_ATOMIC;
         }
-        // return to IDLE and complete SC request as soon as transaction accepted on Pibus
-        else if ( (r_pibus_fsm == PIBUS_WRITE_AD) and not r_dcache_sc_req.read() ) 
+        // return to IDLE and complete SC request when the data is written
+        // (READY response, a RETRY response restarts the transaction)
+        else if ( sc_done ) 
         {
             c_sc_ok_count++;
             r_llsc_pending = false;
@@ -706,25 +1268,25 @@ void PibusMips32Xcache::transition()
     case DCACHE_MISS_INVAL :
     {
         c_dmiss_frz++;
-        uint32_t nline;		// unused
-        r_dcache.inval( r_dcache_save_way.read(),
-                        r_dcache_save_set.read(),
-                        &nline );
+        uint32_t nline;
+        if ( r_dcache.inval( r_dcache_save_way.read(),
+                             r_dcache_save_set.read(),
+                             &nline ) ) m_snoop_filter.remove( nline * (m_dcache_words << 2) );
         r_dcache_fsm = DCACHE_MISS_WAIT;
         break;
     }
     case DCACHE_MISS_WAIT:
     {
         c_dmiss_frz++;
-        if( !r_pibus_ins && r_pibus_rsp_ok )
+        if( r_dcache_rsp_ok )
         {
             r_dcache_fsm     = DCACHE_MISS_UPDT;
-            r_pibus_rsp_ok   = false;
+            r_dcache_rsp_ok  = false;
         }
-        if( !r_pibus_ins && r_pibus_rsp_error ) 
+        if( r_dcache_rsp_error ) 
         {
-            r_dcache_fsm      = DCACHE_ERROR;
-            r_pibus_rsp_error = false;
+            r_dcache_fsm       = DCACHE_ERROR;
+            r_dcache_rsp_error = false;
         }
         break;
     }
@@ -734,22 +1296,23 @@ void PibusMips32Xcache::transition()
         r_dcache.update( r_dcache_save_addr.read(),
                          r_dcache_save_way.read(),
                          r_dcache_save_set.read(),
-                         r_pibus_buf );
+                         r_dcache_buf );
+        m_snoop_filter.insert( r_dcache_save_addr.read() );
         r_dcache_fsm = DCACHE_IDLE;
         break;
     }
     case DCACHE_UNC_WAIT:
     {
         c_dunc_frz++;
-        if( !r_pibus_ins && r_pibus_rsp_ok )
+        if( r_dcache_rsp_ok )
         {
             r_dcache_fsm     = DCACHE_UNC_GO;
-            r_pibus_rsp_ok   = false;
+            r_dcache_rsp_ok  = false;
         }
-        if( !r_pibus_ins && r_pibus_rsp_error ) 
+        if( r_dcache_rsp_error ) 
         {
-            r_dcache_fsm      = DCACHE_ERROR;
-            r_pibus_rsp_error = false;
+            r_dcache_fsm       = DCACHE_ERROR;
+            r_dcache_rsp_error = false;
         }
         break;
     }
@@ -759,7 +1322,7 @@ void PibusMips32Xcache::transition()
         {
             m_drsp.valid    = true; 
             m_drsp.error    = false;
-            m_drsp.rdata    = r_pibus_buf[0];
+            m_drsp.rdata    = r_dcache_buf[0];
         }
         r_dcache_fsm      = DCACHE_IDLE;
         break;
@@ -781,18 +1344,21 @@ void PibusMips32Xcache::transition()
 
     uint32_t it = 0;
     if ( p_irq.read() ) it = 1;
-    r_proc.executeNCycles(1, m_irsp, m_drsp, it);
+    if ( m_irsp.valid )
+    {
+        m_last_ins = m_irsp.instruction;
+        if ( cp0Lost( m_last_ins ) ) m_cp0_ins = m_last_ins;
+    }
+    executeIss(it);
     if ( (m_ireq.valid && !m_irsp.valid) || (m_dreq.valid && !m_drsp.valid) ) c_frz_cycles++;
 
     //////////////////////////////////////////////////////////////////////////////
     // The SNOOP FSM implements a snoop_invalidate policy.
     // It controls the following registers:
-    // - r_snoop_dcache_inval_req  : slot invalidation request to DCACHE FSM
-    // - r_snoop_dcache_inval_way  : way to be invalidated
-    // - r_snoop_dcache_inval_set  : set to be invalidated
+    // - r_snoop_inval_way/set     : slot invalidation queue to DCACHE FSM (put)
     // - r_snoop_llsc_inval_req    : LLSC reservation invalidation request
     // - r_snoop_flush_req         : flush request (both DCACHE & LLSC)
-    // - r_snoop_address_save      : previous external hit address
+    // - r_snoop_address_save      : last queued external hit address
     //
     // There is three types of external hit: 
     // - the external write matches a locally cached line.
@@ -803,13 +1369,16 @@ void PibusMips32Xcache::transition()
     // by the DCACHE FSM, and the snoop_llsc_inval combinational
     // signal used by the PIBUS FSM.
     //
+    // The snoop filter is checked before the DCACHE directory lookup :
+    // the external writes to pages without valid line are rejected.
+    //
     // In case of external hit, the SNOOP FSM request the DCACHE FSM to
     // invalidate the proper line and/or the LLSC reservation, using the
-    // r_snoop_dcache_inval_req and/or the r_snoop_llsc_inval_req flip-flops, 
-    // and the r_snoop_dcache_inval_set and r_snoop_dcache_inval_way registers.
-    // If another external hit is detected in this state, before completion
-    // of the first one, the SNOOP FSM enters the panic mode, and request
-    // a DCACHE global flush, using r_snoop_dcache_flush_req.
+    // r_snoop_inval_way/set queue and/or the r_snoop_llsc_inval_req flip-flop.
+    // A new hit on the last queued line is not registered twice.
+    // If an external hit is detected when the queue is full, the SNOOP FSM 
+    // enters the panic mode, and request a DCACHE global flush, 
+    // using r_snoop_flush_req.
     //
     // These three request are handled by the DCACHE FSM in the IDLE state,
     // and the request flip-flops are reset by the DCACHE FSM.
@@ -829,41 +1398,55 @@ void PibusMips32Xcache::transition()
   
         external_write = p_avalid.read() and 
                          not p_read.read() and 
-                         (r_pibus_fsm.read() != PIBUS_WRITE_AD); 
+                         (r_pibus_fsm.read() != PIBUS_WRITE_AD) and
+                         (r_pibus_fsm.read() != PIBUS_WRITE_DTAD); 
 
         if ( external_write )
         {
-            cache_hit = r_dcache.hit( snoop_addr, 
-                                      &snoop_way, 
-                                      &snoop_set, 
-                                      &snoop_word);
+            c_snoop_count++;
+
+            if ( m_snoop_filter.mayContain( snoop_addr ) )
+            {
+                cache_hit = r_dcache.hit( snoop_addr, 
+                                          &snoop_way, 
+                                          &snoop_set, 
+                                          &snoop_word);
+            }
+            else
+            {
+                c_snoop_filtered++;
+            }
 
             wait_hit  = ((snoop_addr & m_line_data_mask) == (r_dcache_save_addr.read() & m_line_data_mask))
                         and ((r_dcache_fsm == DCACHE_MISS_WAIT) or (r_dcache_fsm == DCACHE_MISS_UPDT));
 
-            // previous pending dcache inval request and new external hit on another line
-            if( r_snoop_dcache_inval_req.read() and (cache_hit  or wait_hit) and         
-                ((r_snoop_address_save.read() & m_line_data_mask) != (snoop_addr & m_line_data_mask)) ) 
-            {  
-                if ( r_dcache_fsm != DCACHE_IDLE ) // we cannot handle the new external hit
+            // new external hit on the last queued line : already registered
+            bool already = r_snoop_inval_way.rok() and 
+                ((r_snoop_address_save.read() & m_line_data_mask) == (snoop_addr & m_line_data_mask));
+
+            if ( (cache_hit or wait_hit) and not already )
+            {
+                if ( not r_snoop_inval_way.wok() )	// we cannot handle the new external hit
                 {
                     r_snoop_flush_req = true;
+                    c_snoop_flush++;
+                }
+                else if ( cache_hit ) 
+                {
+                    snoop_fifo_put       = true;
+                    snoop_fifo_way       = snoop_way;
+                    snoop_fifo_set       = snoop_set;
+                    r_snoop_address_save = snoop_addr;
+                    c_snoop_inval++;
+                }
+                else  // cache_hit and wait_hit cannot be simultaneously true
+                {
+                    snoop_fifo_put       = true;
+                    snoop_fifo_way       = r_dcache_save_way.read();
+                    snoop_fifo_set       = r_dcache_save_set.read();
+                    r_snoop_address_save = snoop_addr;
+                    c_snoop_inval++;
                 }
-            }
-
-            if ( cache_hit ) 
-            {
-                r_snoop_dcache_inval_req = true;
-                r_snoop_dcache_inval_way = snoop_way;
-                r_snoop_dcache_inval_set = snoop_set;
-                r_snoop_address_save     = snoop_addr;
-            }
-            else if ( wait_hit )  // cache_hit and wait_hit cannot be simultaneously true
-            {
-                r_snoop_dcache_inval_req = true;
-                r_snoop_dcache_inval_way = r_dcache_save_way.read();
-                r_snoop_dcache_inval_set = r_dcache_save_set.read();
-                r_snoop_address_save     = snoop_addr;
             }
 
             snoop_llsc_inval  = (snoop_addr == r_llsc_addr.read()) && r_llsc_pending.read();
@@ -880,7 +1463,13 @@ void PibusMips32Xcache::transition()
     // - r_pibus_write_data
     // - r_pibus_write_type
     // - r_pibus_read_type
-    // - r_pibus_buf 
+    // - r_pibus_pref
+    // - r_pibus_wnext, r_pibus_wc, r_pibus_wbuf_data, r_pibus_wbuf_opc
+    // - r_pibus_sc
+    // - r_icache_buf, r_icache_rsp_ok, r_icache_rsp_error
+    // - r_dcache_buf, r_dcache_rsp_ok, r_dcache_rsp_error
+    // - r_ipref_buf, r_ipref_valid set, r_ipref_pending reset
+    // - r_ipref_req reset
     // - r_icache_miss_req reset
     // - r_icache_unc_req reset
     // - r_dcache_miss_req reset
@@ -892,11 +1481,19 @@ void PibusMips32Xcache::transition()
     // Read requests can be for data or instructions.
     // The cache controller implement the following priorities :
     // 1/ DATA WRITE       : write buffer not empty
+    //    (the following requests can be combined in the same burst)
     // 2/ DATA SC          : r_dcache_sc_req
     // 3/ DATA READ        : r_dcache_miss_req or r_dcache_unc_req
     // 4/ INSTRUCTION READ : r_icache_miss_req or r_icache_unc_req
+    // 5/ INSTRUCTION PREFETCH : r_ipref_req
+    // The read data are written in the response buffer of the requester.
     //////////////////////////////////////////////////////////////////////////
 
+    uint32_t*	pibus_buf;
+    if      ( r_pibus_pref.read() ) pibus_buf = r_ipref_buf;
+    else if ( r_pibus_ins.read() )  pibus_buf = r_icache_buf;
+    else                            pibus_buf = r_dcache_buf;
+
     switch (r_pibus_fsm) {
     case PIBUS_IDLE : 
     {
@@ -905,24 +1502,34 @@ void PibusMips32Xcache::transition()
 	if ( r_wbuf_data.rok() )		// WRITE request
         {
             r_pibus_ins   = false;
+            r_pibus_pref  = false;
             r_pibus_addr  = r_wbuf_addr.read();
-            r_pibus_wdata = r_wbuf_data.read();
-            r_pibus_opc   = r_wbuf_type.read();
+            r_pibus_wnext = 1;
+            r_pibus_wc    = m_write_combining and 
+                            m_cached_table[r_wbuf_addr.read() >> PIBUS_DECODE_SHIFT];
+            r_pibus_wbuf_data[0] = r_wbuf_data.read();
+            r_pibus_wbuf_opc[0]  = r_wbuf_type.read();
+            r_pibus_sc    = false;
             r_pibus_fsm   = PIBUS_WRITE_REQ; 
+            c_wburst_count++;
         }
         else if ( r_dcache_sc_req.read() )	// SC request
         {
             // Cancel the bus transaction request in case of external hit on a LL/SC address
-            if (  snoop_llsc_inval )
+            if (  snoop_llsc_inval or r_snoop_llsc_inval_req.read() )
             {
                 r_dcache_sc_req = false;
             }
             else
             {
                 r_pibus_ins     = false;
+                r_pibus_pref    = false;
                 r_pibus_addr    = r_dcache_save_addr.read();
-                r_pibus_wdata   = r_dcache_save_wdata.read();
-                r_pibus_opc     = PIBUS_OPC_WDU;
+                r_pibus_wnext   = 1;
+                r_pibus_wc      = false;
+                r_pibus_wbuf_data[0] = r_dcache_save_wdata.read();
+                r_pibus_wbuf_opc[0]  = PIBUS_OPC_WDU;
+                r_pibus_sc      = true;
                 r_pibus_fsm     = PIBUS_WRITE_REQ; 
                 r_dcache_sc_req = false;
             }
@@ -930,6 +1537,7 @@ void PibusMips32Xcache::transition()
         else if ( r_dcache_miss_req.read() )	// DMISS request
         {
             r_pibus_ins   = false;
+            r_pibus_pref  = false;
             r_pibus_addr  = r_dcache_save_addr.read();
             if      ( m_dcache_words == 1  ) r_pibus_opc = PIBUS_OPC_WDU;
             else if ( m_dcache_words == 2  ) r_pibus_opc = PIBUS_OPC_WD2;
@@ -943,6 +1551,7 @@ void PibusMips32Xcache::transition()
         else if ( r_dcache_unc_req.read() )	// DUNC request
         {
             r_pibus_ins      = false;
+            r_pibus_pref     = false;
             r_pibus_addr     = r_dcache_save_addr.read();
             r_pibus_opc      = PIBUS_OPC_WDU;
             r_pibus_fsm      = PIBUS_READ_REQ;
@@ -951,6 +1560,7 @@ void PibusMips32Xcache::transition()
         else if ( r_icache_miss_req.read() )	// IMISS request
         {
             r_pibus_ins   = true;
+            r_pibus_pref  = false;
             r_pibus_addr  = r_icache_save_addr.read();
             if      ( m_icache_words == 1  ) r_pibus_opc = PIBUS_OPC_WDU;
             else if ( m_icache_words == 2  ) r_pibus_opc = PIBUS_OPC_WD2;
@@ -964,11 +1574,26 @@ void PibusMips32Xcache::transition()
         else if ( r_icache_unc_req.read() )	// IUNC request	
         {
             r_pibus_ins      = true;
+            r_pibus_pref     = false;
             r_pibus_addr     = r_icache_save_addr;
             r_pibus_opc      = PIBUS_OPC_WDU;
             r_pibus_fsm      = PIBUS_READ_REQ;
             r_icache_unc_req = false;
         }
+        else if ( r_ipref_req.read() )		// IPREF request
+        {
+            r_pibus_ins   = true;
+            r_pibus_pref  = true;
+            r_pibus_addr  = r_ipref_addr.read();
+            if      ( m_icache_words == 1  ) r_pibus_opc = PIBUS_OPC_WDU;
+            else if ( m_icache_words == 2  ) r_pibus_opc = PIBUS_OPC_WD2;
+            else if ( m_icache_words == 4  ) r_pibus_opc = PIBUS_OPC_WD4;
+            else if ( m_icache_words == 8  ) r_pibus_opc = PIBUS_OPC_WD8;
+            else if ( m_icache_words == 16 ) r_pibus_opc = PIBUS_OPC_WD16;
+            else if ( m_icache_words == 32 ) r_pibus_opc = PIBUS_OPC_WD32;
+            r_pibus_fsm   = PIBUS_READ_REQ;
+            r_ipref_req   = false;
+        }
         break;
     }
     // READ transaction
@@ -988,13 +1613,20 @@ void PibusMips32Xcache::transition()
     {
         if ( p_tout.read()  or (p_ack.read() == PIBUS_ACK_ERROR) )
         {
-            r_pibus_rsp_error             = true;
+            if      ( r_pibus_pref ) r_ipref_pending    = false;
+            else if ( r_pibus_ins )  r_icache_rsp_error = true;
+            else                     r_dcache_rsp_error = true;
             r_pibus_fsm                   = PIBUS_IDLE;
         }
+        else if ( p_ack.read() == PIBUS_ACK_RETRY )	// split transaction
+        {
+            r_pibus_wcount                = 0;
+            r_pibus_fsm                   = PIBUS_READ_REQ;
+        }
 	else if ( p_ack.read() == PIBUS_ACK_READY )
         { 
             r_pibus_wcount = r_pibus_wcount + 1;
-            r_pibus_buf[r_pibus_wcount - 1] = p_d.read();
+            pibus_buf[r_pibus_wcount - 1] = p_d.read();
             if (  r_pibus_ins and (r_pibus_wcount.read() == m_icache_words-1) ) r_pibus_fsm = PIBUS_READ_DT; 
             if ( !r_pibus_ins and (r_pibus_wcount.read() == m_dcache_words-1) ) r_pibus_fsm = PIBUS_READ_DT; 
 	} 
@@ -1004,13 +1636,26 @@ void PibusMips32Xcache::transition()
     {
 	if ( (p_ack.read() == PIBUS_ACK_ERROR) or p_tout.read() ) 
         { 
-            r_pibus_rsp_error             = true;
+            if      ( r_pibus_pref ) r_ipref_pending    = false;
+            else if ( r_pibus_ins )  r_icache_rsp_error = true;
+            else                     r_dcache_rsp_error = true;
             r_pibus_fsm                   = PIBUS_IDLE;
         } 
+        else if ( p_ack.read() == PIBUS_ACK_RETRY )	// split transaction
+        {
+            r_pibus_wcount                = 0;
+            r_pibus_fsm                   = PIBUS_READ_REQ;
+        }
         else if (p_ack.read() == PIBUS_ACK_READY) 
         { 
-            r_pibus_buf[r_pibus_wcount-1] = p_d.read();
-            r_pibus_rsp_ok                = true;
+            pibus_buf[r_pibus_wcount-1]   = p_d.read();
+            if ( r_pibus_pref )
+            {
+                r_ipref_valid             = true;
+                r_ipref_pending           = false;
+            }
+            else if ( r_pibus_ins )  r_icache_rsp_ok = true;
+            else                     r_dcache_rsp_ok = true;
             r_pibus_fsm                   = PIBUS_IDLE;
 	}
         break;
@@ -1024,15 +1669,52 @@ void PibusMips32Xcache::transition()
             r_pibus_fsm = PIBUS_WRITE_AD; 
         }
         // Abort the bus transaction in case of external hit on a LL/SC address
-        else if ( snoop_llsc_inval and (r_pibus_addr.read() == r_llsc_addr.read()) )
+        // (a combinable write burst is never aborted)
+        else if ( snoop_llsc_inval and not r_pibus_wc.read() and 
+                  (r_pibus_addr.read() == r_llsc_addr.read()) )
+        {
+            r_pibus_fsm = PIBUS_IDLE;
+        }
+        // Abort a retried SC transaction if the LL/SC reservation has been lost
+        else if ( r_pibus_sc.read() and r_snoop_llsc_inval_req.read() )
         {
             r_pibus_fsm = PIBUS_IDLE;
         }
         break;
     }
     case PIBUS_WRITE_AD :
+    case PIBUS_WRITE_DTAD :
     {
-	r_pibus_fsm = PIBUS_WRITE_DT; 
+        if ( (r_pibus_fsm == PIBUS_WRITE_DTAD) and 
+             (p_tout.read() or (p_ack.read() == PIBUS_ACK_ERROR)) )
+        {
+            r_pibus_fsm  = PIBUS_IDLE; 
+            m_write_berr = true;
+        }
+        else if ( (r_pibus_fsm == PIBUS_WRITE_DTAD) and 
+                  (p_ack.read() == PIBUS_ACK_RETRY) )	// split transaction
+        {
+            r_pibus_wcount = 0;
+            r_pibus_fsm    = PIBUS_WRITE_REQ; 
+        }
+        else if ( (r_pibus_fsm == PIBUS_WRITE_AD) or 
+                  (p_ack.read() == PIBUS_ACK_READY) )	// address accepted
+        {
+            // the next write request is popped from the write buffer 
+            // (see fifo_get below) when it is combined in the burst
+            bool combine = writeCombine();
+            bool lock    = combine or (r_pibus_wcount.read() + 1 < r_pibus_wnext.read());
+            if ( combine )
+            {
+                r_pibus_wbuf_data[r_pibus_wnext.read()] = r_wbuf_data.read();
+                r_pibus_wbuf_opc[r_pibus_wnext.read()]  = r_wbuf_type.read();
+                r_pibus_wnext = r_pibus_wnext.read() + 1;
+                c_wcomb_count++;
+            }
+            r_pibus_wcount = r_pibus_wcount.read() + 1;
+            if ( lock ) r_pibus_fsm = PIBUS_WRITE_DTAD;
+            else        r_pibus_fsm = PIBUS_WRITE_DT;
+        }
         break;
     }
     case PIBUS_WRITE_DT :
@@ -1040,7 +1722,12 @@ void PibusMips32Xcache::transition()
         if ( p_tout.read() or (p_ack.read() == PIBUS_ACK_ERROR) )
         {
             r_pibus_fsm = PIBUS_IDLE; 
-            r_proc.setWriteBerr();
+            m_write_berr = true;
+        }
+        else if ( p_ack.read() == PIBUS_ACK_RETRY )	// split transaction
+        {
+            r_pibus_wcount = 0;
+            r_pibus_fsm    = PIBUS_WRITE_REQ; 
         }
 	else if (p_ack.read() == PIBUS_ACK_READY) 
         { 
@@ -1057,17 +1744,14 @@ void PibusMips32Xcache::transition()
     //  from the DCACHE FSM to the PIBUS FSM.
     ///////////////////////////////////////////
 
-    bool 	fifo_get  = (r_pibus_fsm == PIBUS_IDLE) && r_wbuf_data.rok();
+    bool 	fifo_get  = ((r_pibus_fsm == PIBUS_IDLE) && r_wbuf_data.rok()) ||
+                            (((r_pibus_fsm == PIBUS_WRITE_AD) || 
+                              ((r_pibus_fsm == PIBUS_WRITE_DTAD) && (p_ack.read() == PIBUS_ACK_READY) && 
+                               !p_tout.read())) && writeCombine());
     bool 	fifo_put  = (r_dcache_fsm == DCACHE_WRITE_REQ) && r_wbuf_data.wok();
     uint32_t	fifo_wdata = r_dcache_save_wdata;
     uint32_t	fifo_waddr = r_dcache_save_addr;
-    uint32_t	fifo_wtype = PIBUS_OPC_WDU;
-    if      ( r_dcache_save_be == 0x3)		fifo_wtype = PIBUS_OPC_HW0; 
-    else if ( r_dcache_save_be == 0xC)		fifo_wtype = PIBUS_OPC_HW1; 
-    else if ( r_dcache_save_be == 0x1) 		fifo_wtype = PIBUS_OPC_BY0;
-    else if ( r_dcache_save_be == 0x2) 		fifo_wtype = PIBUS_OPC_BY1;
-    else if ( r_dcache_save_be == 0x4) 		fifo_wtype = PIBUS_OPC_BY2;
-    else if ( r_dcache_save_be == 0x8) 		fifo_wtype = PIBUS_OPC_BY3;
+    uint32_t	fifo_wtype = pibus_be_opc[r_dcache_save_be.read() & 0xF];
 
     if ((fifo_put == true) && (fifo_get == true)) 
     { 
@@ -1088,11 +1772,60 @@ void PibusMips32Xcache::transition()
 	r_wbuf_type.simple_get(); 
     }
 
+    ///////////////////////////////////////////
+    //  Snoop invalidation queue handling
+    //  These FIFOs contain the invalidation
+    //  requests from the SNOOP FSM to the 
+    //  DCACHE FSM.
+    ///////////////////////////////////////////
+
+    if ( snoop_fifo_init )
+    {
+        r_snoop_inval_way.init();
+        r_snoop_inval_set.init();
+    }
+    else if ( snoop_fifo_put and snoop_fifo_get )
+    {
+        r_snoop_inval_way.put_and_get(snoop_fifo_way);
+        r_snoop_inval_set.put_and_get(snoop_fifo_set);
+    }
+    else if ( snoop_fifo_put )
+    {
+        r_snoop_inval_way.simple_put(snoop_fifo_way);
+        r_snoop_inval_set.simple_put(snoop_fifo_set);
+    }
+    else if ( snoop_fifo_get )
+    {
+        r_snoop_inval_way.simple_get();
+        r_snoop_inval_set.simple_get();
+    }
+
 } // end transition()
 
 //////////////////////////////////
 void PibusMips32Xcache::genMoore()
 {
+#ifdef PIBUS_CLOCK_GATING
+    // woken up by a PIBUS FSM state change : wait the clock edge
+    if ( m_sleep_moore )
+    {
+        m_sleep_moore = false;
+        if ( not p_ck.negedge() )
+        {
+            next_trigger( p_ck.negedge_event() );
+            return;
+        }
+    }
+    // the outputs only depend on the PIBUS FSM state,
+    // except in the READ_AD, READ_DTAD, WRITE_AD and WRITE_DTAD states
+    if ( (r_pibus_fsm != PIBUS_READ_AD) and (r_pibus_fsm != PIBUS_READ_DTAD) and
+         (r_pibus_fsm != PIBUS_WRITE_AD) and (r_pibus_fsm != PIBUS_WRITE_DTAD) )
+    {
+        m_sleep_moore = true;
+        next_trigger( r_pibus_fsm.value_changed_event() );
+    }
+#endif
+
     switch (r_pibus_fsm) {
     case PIBUS_IDLE       :
     {
@@ -1126,18 +1859,20 @@ void PibusMips32Xcache::genMoore()
         break; 
     }
     case PIBUS_WRITE_AD :
+    case PIBUS_WRITE_DTAD :
     {
 	p_req  = false; 
-	p_a    = r_pibus_addr.read();
+	p_a    = r_pibus_addr.read() + ( r_pibus_wcount.read() << 2);
         p_read = false;
-	p_lock = false;
-	p_opc  = r_pibus_opc.read();
+	p_lock = (r_pibus_wcount.read() + 1 < r_pibus_wnext.read()) or writeCombine();
+	p_opc  = r_pibus_wbuf_opc[r_pibus_wcount.read()];
+	if ( r_pibus_fsm == PIBUS_WRITE_DTAD ) p_d = r_pibus_wbuf_data[r_pibus_wcount.read() - 1]; 
         break;
     }
     case PIBUS_WRITE_DT : 
     {
 	p_req = false;  
-	p_d   = r_pibus_wdata.read(); 
+	p_d   = r_pibus_wbuf_data[r_pibus_wcount.read() - 1]; 
         break; 
     }
     } // end switch r_pibus_fsm 
@@ -1157,13 +1892,17 @@ void PibusMips32Xcache::printTrace()
 
     if ( r_wbuf_data.rok() ) std::cout << "  WBUF = " << r_wbuf_data.filled_status() << " ";
     if ( r_dcache_sc_req.read() ) std::cout << "  SC_REQ";
-    if ( r_snoop_dcache_inval_req.read() ) std::cout << "  SNOOP_DCACHE_REQ";
+    if ( r_snoop_inval_way.rok() ) std::cout << "  SNOOP_QUEUE = " << r_snoop_inval_way.filled_status();
     if ( r_snoop_llsc_inval_req.read() ) std::cout << "  SNOOP_LLSC_REQ";
     if ( r_snoop_flush_req.read() ) std::cout << "  SNOOP_FLUSH_REQ";
     if ( r_llsc_pending.read() ) std::cout << "  LLSC_ADDR : " << std::hex << r_llsc_addr;
-    if ( r_wbuf_data.rok() or
+    if ( r_ipref_pending.read() ) std::cout << "  IPREF_PENDING : " << std::hex << r_ipref_addr;
+    if ( r_ipref_valid.read() ) std::cout << "  IPREF_VALID : " << std::hex << r_ipref_addr;
+    if ( r_ipref_pending.read() or
+         r_ipref_valid.read() or
+         r_wbuf_data.rok() or
          r_dcache_sc_req.read() or
-         r_snoop_dcache_inval_req.read() or
+         r_snoop_inval_way.rok() or
          r_snoop_llsc_inval_req.read() or
          r_snoop_flush_req.read() or 
          r_llsc_pending.read() ) std::cout << std::endl;
@@ -1181,10 +1920,31 @@ void PibusMips32Xcache::printStatistics()
     std::cout << "- WRITE RATE         = " << (float)c_write_count/run_cycles << std::endl;
     std::cout << "- IMISS RATE         = " << (float)c_imiss_count/run_cycles << std::endl;
     std::cout << "- DMISS RATE         = " << (float)c_dmiss_count/(c_dread_count - c_dunc_count) << std::endl ;
-    std::cout << "- IMISS COST         = " << (float)c_imiss_frz/c_imiss_count << std::endl;
+    std::cout << "- IMISS COST         = " << (float)c_imiss_frz/(c_imiss_count - c_ipref_hit) << std::endl;
     std::cout << "- DMISS COST         = " << (float)c_dmiss_frz/c_dmiss_count << std::endl;
     std::cout << "- UNC COST           = " << (float)c_dunc_frz/c_dunc_count << std::endl;
     std::cout << "- WRITE COST         = " << (float)c_write_frz/c_write_count << std::endl;
+    if ( m_icache_prefetch ) 
+    {
+    std::cout << "- IPREF COUNT        = " << c_ipref_count << std::endl;
+    std::cout << "- IPREF HIT RATE     = " << (float)c_ipref_hit/c_imiss_count << std::endl;
+    std::cout << "- IPREF HIT COST     = " << (float)c_ipref_frz/c_ipref_hit << std::endl;
+    }
+    if ( m_write_combining ) 
+    {
+    std::cout << "- WRITE BURSTS       = " << c_wburst_count << std::endl;
+    std::cout << "- COMBINED WRITES    = " << c_wcomb_count << std::endl;
+    std::cout << "- WORDS PER BURST    = " << (float)(c_wburst_count + c_wcomb_count)/c_wburst_count << std::endl;
+    }
+    if ( m_snoop_active ) 
+    {
+    std::cout << "- SNOOPED WRITES     = " << c_snoop_count << std::endl;
+    std::cout << "- SNOOP FILTERED     = " << c_snoop_filtered << std::endl;
+    std::cout << "- SNOOP INVAL        = " << c_snoop_inval << std::endl;
+    std::cout << "- SNOOP FLUSH        = " << c_snoop_flush << std::endl;
+    }
+    if ( m_ff_bus ) 
+    std::cout << "- FAST-FORWARD CYCLES= " << c_ff_cycles << std::endl;
 }
 
 }} // end namespaces
@@ -5,12 +5,15 @@
 // Copyright UPMC/LIP6
 //
 // This file defines the mnemonics for the PIBUS opcodes
-// and acknowledges.
+// and acknowledges, and the tables used to decode the 
+// single word write opcodes without branches.
 /////////////////////////////////////////////////////////////////
 
 #ifndef PIBUS_MNEMONICS_H
 #define PIBUS_MNEMONICS_H
 
+#include <stdint.h>
+
 #define sc_register sc_core::sc_signal
 
 namespace soclib { namespace common {
@@ -43,6 +46,56 @@ PIBUS_OPC_BY2   =0xE, // byre 2
 PIBUS_OPC_BY3   =0xF, // byte 3
 };
 
+// Bit vector of the OPC codes supported by a single word write :
+// NOP/WDU/HW0/HW1/BY0/BY1/BY2/BY3
+#define PIBUS_OPC_WRITE_CODES	0xF505
+
+// Bit vector of the byte enable values supported by the processors :
+// 0x0/0x1/0x2/0x4/0x8/0x3/0xC/0xF
+#define PIBUS_BE_CODES		0x911F
+
+// Write mask indexed by the OPC code (null for unsupported codes). 
+// The memory organisation is little endian.
+static const uint32_t pibus_opc_mask[16] = {
+0x00000000,	// NOP
+0x00000000,	// WD32
+0xFFFFFFFF,	// WDU
+0x00000000,	// WDC
+0x00000000,	// WD2
+0x00000000,	// WD4
+0x00000000,	// WD8
+0x00000000,	// WD16
+0x0000FFFF,	// HW0
+0x00000000,	// TB0
+0xFFFF0000,	// HW1
+0x00000000,	// TB1
+0x000000FF,	// BY0
+0x0000FF00,	// BY1
+0x00FF0000,	// BY2
+0xFF000000,	// BY3
+};
+
+// Write OPC code indexed by the byte enable value. 
+// The unsupported values are transmitted as WDU.
+static const uint32_t pibus_be_opc[16] = {
+PIBUS_OPC_NOP,	// 0x0
+PIBUS_OPC_BY0,	// 0x1
+PIBUS_OPC_BY1,	// 0x2
+PIBUS_OPC_HW0,	// 0x3
+PIBUS_OPC_BY2,	// 0x4
+PIBUS_OPC_WDU,	// 0x5
+PIBUS_OPC_WDU,	// 0x6
+PIBUS_OPC_WDU,	// 0x7
+PIBUS_OPC_BY3,	// 0x8
+PIBUS_OPC_WDU,	// 0x9
+PIBUS_OPC_WDU,	// 0xA
+PIBUS_OPC_WDU,	// 0xB
+PIBUS_OPC_HW1,	// 0xC
+PIBUS_OPC_WDU,	// 0xD
+PIBUS_OPC_WDU,	// 0xE
+PIBUS_OPC_WDU,	// 0xF
+};
+
 }} // end namespace
 
 #endif
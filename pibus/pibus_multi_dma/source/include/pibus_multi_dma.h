@@ -15,13 +15,15 @@
 // allocation policy (in case of simultaneous transferts) is round-robin
 // with a PIBUS transaction granularity.
 
-// For each channel, this DMA controler contains  5 memory mapped registers
+// For each channel, this DMA controler contains  7 memory mapped registers
 // (only the 5 less significant bits of the VCI address are decoded)
 // - SOURCE		(0x00)	Read/Write	Source buffer base address
 // - DEST		(0x04)  Read/Write	Destination buffer base address
 // - LENGTH/STATUS	(0x08)	Read/Write	Transfer length (bytes) / Status
 // - RESET  		(0x0C)	Write Only	Software reset & IRQ acknowledge
 // - NOIRQ       	(0x10)	Read/Write	IRQ disabled when non zeo
+// - DESC		(0x14)	Read/Write	Descriptor chain address
+// - ACK		(0x18)	Write Only	Descriptor IRQ acknowledge
 //
 // Both the source and destination address must be word aligned, and
 // and the transfer length must be a multiple of 4 bytes.
@@ -48,7 +50,41 @@
 // (states SUCCESS, READ_ERROR, WRITE_ERROR). The IRQ is not asserted
 // if the NOIRQ register contains a non-zero value.
 // Writing in the RESET register is the normal way to acknowledge IRQ.
-// Each DMA channel contains a private buffer to store a burst.
+//
+// Descriptor chain mode:
+// A write access to register DESC starts a chain of transfers, instead
+// of a single transfer. Each descriptor is an array of 5 words in memory,
+// whose address must be word aligned :
+// - word 0 : source buffer base address
+// - word 1 : destination buffer base address
+// - word 2 : transfer length (bytes)
+// - word 3 : next descriptor address (0 for the last descriptor)
+// - word 4 : flags (DMA_DESC_IRQ = 0x1 : IRQ when the transfer is completed)
+// The descriptor is fetched by a 5 words burst read, and the transfers
+// are done back-to-back, without software intervention. A zero length
+// descriptor is skipped. The channel goes to the SUCCESS state (and
+// asserts the IRQ) when the last descriptor transfer is completed, or in
+// the READ_ERROR / WRITE_ERROR states in case of bus error (descriptor
+// fetch errors are reported as READ_ERROR). When a descriptor containing
+// the DMA_DESC_IRQ flag is completed, the IRQ is asserted but the chain
+// continues : this IRQ must be acknowledged by a write in the ACK register.
+// A read access to register DESC returns the address of the current
+// descriptor. As for a single transfer, a write in register RESET stops
+// the chain, and a write in register DESC is ignored if the channel is
+// not IDLE.
+//
+// Each DMA channel contains two private buffers to store a burst
+// (double buffering) : the read burst in one buffer can be done
+// before the write burst from the other buffer, and the transactions
+// of the different channels are interleaved on the bus.
+// When a target answers PIBUS_ACK_RETRY (split transaction), the
+// bus is released, and the complete burst is retried.
+//
+// This component implements the PibusCheckpointable interface, and can
+// be checkpointed when the target FSM is IDLE and the master FSM is not
+// in a bus transaction (IDLE or REQ states). The channel registers, the
+// double buffers and the descriptor buffers are saved : the transfers
+// and the descriptor chains can be checkpointed between two bursts.
 ///////////////////////////////////////////////////////////////////////////
 // Implementation note:
 // This component contains NB_CHANNELS + 2 FSMs:
@@ -57,6 +93,16 @@
 //   or desactivate the CHANNEL_FSM[k]
 // - the MASTER_FSM is a server handling the PIBUS transactions requested
 //   by the CHANNEL_FSM[k]
+// For each channel, the r_channel_full[k] bit-vector defines the state
+// of the two buffers : a channel requests a write burst when the buffer
+// r_channel_wbuf[k] is full, and a read burst when the buffer
+// r_channel_rbuf[k] is empty and there is data to read.
+// The MASTER_FSM selects the next transaction (round-robin between the
+// channels) during the last data cycle of the current transaction, and
+// asserts the bus request in this cycle : as the BCU can grant the bus
+// in the last cycle of a transaction, the next transaction starts
+// without idle cycle. The channel served by the current transaction is
+// not candidate for this pipelined selection.
 ///////////////////////////////////////////////////////////////////////////
 // This component has 5 "constructor" parameters :
 // - sc_module_name 	name		: instance name
@@ -72,10 +118,11 @@
 #include <systemc.h>
 #include "pibus_mnemonics.h"
 #include "pibus_segment_table.h"
+#include "pibus_checkpoint.h"
 
 namespace soclib { namespace caba {
 
-class PibusMultiDma : sc_module {
+class PibusMultiDma : sc_module, public PibusCheckpointable {
 
     // REGISTERS
     sc_register<int>      	r_target_fsm;		// target fsm state register
@@ -85,16 +132,28 @@ class PibusMultiDma : sc_module {
     sc_register<uint32_t>       r_master_index;		// selected channel
     sc_register<uint32_t>       r_master_count;		// word counter in a burst
     sc_register<uint32_t>       r_master_burst;		// actual burst length (words)
+    sc_register<uint32_t>       r_master_buf;		// selected buffer (0/1)
+    sc_register<uint32_t>       r_master_next;		// next selected channel
+    sc_register<int>       	r_master_next_req;	// next transaction type (REQ state)
 
     sc_register<int>*		r_channel_fsm;		// channel fsm state registers [channel]
     sc_register<uint32_t>*     	r_channel_source;	// source buffer base address [channel]
     sc_register<uint32_t>*     	r_channel_dest;  	// destination buffer base address [channel]
-    sc_register<uint32_t>*     	r_channel_length;	// number of bytes to be transfered [channel]
+    sc_register<uint32_t>*     	r_channel_length;	// number of bytes to be written [channel]
+    sc_register<uint32_t>*     	r_channel_rlength;	// number of bytes to be read [channel]
     sc_register<bool>*     	r_channel_noirq;	// IRQ disabled [channel]
     sc_register<bool>*     	r_channel_active;	// channel activation [channel]
-    sc_register<bool>*     	r_channel_done;		// bus transaction completed [channel]
     sc_register<bool>*     	r_channel_error;	// bus error reported [channel]
-    uint32_t**			r_channel_buf;		// local buffer [channels][burst]
+    sc_register<bool>*     	r_channel_werror;	// error on a write transaction [channel]
+    sc_register<uint32_t>*     	r_channel_full;		// full buffers bit-vector [channel]
+    sc_register<uint32_t>*     	r_channel_rbuf;		// next buffer to be read [channel]
+    sc_register<uint32_t>*     	r_channel_wbuf;		// next buffer to be written [channel]
+    sc_register<bool>*     	r_channel_chain;	// descriptor chain mode [channel]
+    sc_register<uint32_t>*     	r_channel_desc;		// current descriptor address [channel]
+    sc_register<bool>*     	r_channel_irq;		// descriptor IRQ pending [channel]
+    uint32_t**			r_channel_buf;		// local buffers [channels][2*burst]
+    uint32_t**			r_channel_nwords;	// buffers content (words) [channels][2]
+    uint32_t**			r_channel_dbuf;		// descriptor buffer [channels][5]
     
     // STRUCTURAL PARAMETERS
     const char*			m_name;			// instance name
@@ -104,9 +163,9 @@ class PibusMultiDma : sc_module {
     uint32_t			m_segbase;		// segment base address
     uint32_t			m_segsize;		// segment size
     const char*			m_segname;		// segment name
-    char			m_master_str[9][20];	// master FSM states names
-    char			m_target_str[11][20];	// target FSM states names
-    char			m_channel_str[8][20];	// channel FSM states names
+    char			m_master_str[13][20];	// master FSM states names
+    char			m_target_str[14][20];	// target FSM states names
+    char			m_channel_str[7][20];	// channel FSM states names
 
     //  CHANNEL_FSM STATES
     enum {
@@ -114,10 +173,9 @@ class PibusMultiDma : sc_module {
     CHANNEL_READ_ERROR	= 1,
     CHANNEL_IDLE	= 2,
     CHANNEL_WRITE_ERROR	= 3,
-    CHANNEL_READ_REQ	= 4,
-    CHANNEL_READ_WAIT	= 5,
-    CHANNEL_WRITE_REQ 	= 6,
-    CHANNEL_WRITE_WAIT	= 7,
+    CHANNEL_MOVE	= 4,
+    CHANNEL_DESC_REQ	= 5,
+    CHANNEL_DESC_WAIT	= 6,
     };
 
     // MASTER FSM STATES
@@ -131,6 +189,10 @@ class PibusMultiDma : sc_module {
     MST_WRITE_AD	= 6,
     MST_WRITE_DTAD	= 7,
     MST_WRITE_DT	= 8,
+    MST_DESC_REQ	= 9,
+    MST_DESC_AD		= 10,
+    MST_DESC_DTAD	= 11,
+    MST_DESC_DT		= 12,
     };
     
     // TARGET FSM STATES
@@ -146,6 +208,9 @@ class PibusMultiDma : sc_module {
     TGT_READ_STATUS	= 8,
     TGT_READ_NOIRQ	= 9,
     TGT_ERROR		= 10,
+    TGT_WRITE_DESC	= 11,
+    TGT_WRITE_ACK	= 12,
+    TGT_READ_DESC	= 13,
     };
 
     // Addressable registers map
@@ -155,14 +220,36 @@ class PibusMultiDma : sc_module {
     DMA_LEN,
     DMA_RST,
     DMA_IRQ,
+    DMA_DESC,
+    DMA_ACK,
+    };
+
+    // Descriptor format
+    enum {
+    DESC_SRC,
+    DESC_DST,
+    DESC_LEN,
+    DESC_NEXT,
+    DESC_FLAGS,
+    DESC_WORDS,
     };
 
+    int  channelRequest(size_t k);
+    int  selectChannel(size_t exclude, size_t &channel);
+    int  startTransaction(size_t k, int req);
+    bool channelBusy(size_t k);
+
 protected:
 
     SC_HAS_PROCESS(PibusMultiDma);
 
 public:
 
+    // Descriptor flags
+    enum {
+    DMA_DESC_IRQ	= 0x1,
+    };
+
     // IO PORTS
     sc_core::sc_in<bool>                 p_ck;
     sc_core::sc_in<bool>                 p_resetn;
@@ -183,6 +270,11 @@ public:
     void genMoore();
     void printTrace();
 
+    // CHECKPOINT
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
+
     // Constructor   
     PibusMultiDma(sc_module_name			name, 
                   uint32_t				tgtid,
@@ -25,9 +25,10 @@ void PibusMultiDma::transition()
         {
             r_channel_fsm[k]      = CHANNEL_IDLE;
 	    r_channel_active[k]   = false;
-            r_channel_done[k]     = false;
             r_channel_error[k]    = false;
 	    r_channel_noirq[k]    = false;
+            r_channel_chain[k]    = false;
+            r_channel_irq[k]      = false;
         }
 	return;
     } 
@@ -49,10 +50,13 @@ void PibusMultiDma::transition()
             else if( !read && ((address & 0x1F) == (DMA_LEN << 2)) ) 		r_target_fsm = TGT_WRITE_LENGTH;
             else if( !read && ((address & 0x1F) == (DMA_RST << 2)) ) 		r_target_fsm = TGT_WRITE_RESET;
             else if( !read && ((address & 0x1F) == (DMA_IRQ << 2)) ) 		r_target_fsm = TGT_WRITE_NOIRQ;
+            else if( !read && ((address & 0x1F) == (DMA_DESC << 2)) ) 		r_target_fsm = TGT_WRITE_DESC;
+            else if( !read && ((address & 0x1F) == (DMA_ACK << 2)) ) 		r_target_fsm = TGT_WRITE_ACK;
             else if(  read && ((address & 0x1F) == (DMA_SRC << 2)) ) 		r_target_fsm = TGT_READ_SOURCE;
             else if(  read && ((address & 0x1F) == (DMA_DST << 2)) ) 		r_target_fsm = TGT_READ_DEST;
             else if(  read && ((address & 0x1F) == (DMA_LEN << 2)) ) 		r_target_fsm = TGT_READ_STATUS;
             else if(  read && ((address & 0x1F) == (DMA_IRQ << 2)) ) 		r_target_fsm = TGT_READ_NOIRQ;
+            else if(  read && ((address & 0x1F) == (DMA_DESC << 2)) ) 		r_target_fsm = TGT_READ_DESC;
             else                                                        	r_target_fsm = TGT_ERROR;
             r_target_index = (address & 0xF000) >> 12;
         }
@@ -102,15 +106,42 @@ void PibusMultiDma::transition()
                 exit(1);
             }
             r_channel_length[k]   = p_d.read();
+            r_channel_chain[k]    = false;
             r_channel_active[k] = true;
         }
         r_target_fsm = TGT_IDLE;
         break;
     }
+    case TGT_WRITE_DESC:
+    {
+        uint32_t k = r_target_index.read();    
+        if(r_channel_fsm[k] == CHANNEL_IDLE)
+        {
+            if( (p_d.read() & 0x3) != 0 )
+            {
+	        printf("ERROR in component PibusMultiDma : %s\n",m_name);
+	        printf("The descriptor address must be word aligned\n");
+                exit(1);
+            }
+            r_channel_desc[k]     = p_d.read();
+            r_channel_chain[k]    = true;
+            r_channel_active[k]   = true;
+        }
+        r_target_fsm = TGT_IDLE;
+        break;
+    }
     case TGT_WRITE_RESET:
     {
         uint32_t k = r_target_index.read();    
         r_channel_active[k]  = false;
+        r_channel_irq[k]     = false;
+        r_target_fsm = TGT_IDLE;
+        break;
+    }
+    case TGT_WRITE_ACK:
+    {
+        uint32_t k = r_target_index.read();    
+        r_channel_irq[k]     = false;
         r_target_fsm = TGT_IDLE;
         break;
     }
@@ -126,6 +157,7 @@ void PibusMultiDma::transition()
     case TGT_READ_SOURCE:
     case TGT_READ_DEST:
     case TGT_READ_NOIRQ:
+    case TGT_READ_DESC:
     {
         r_target_fsm = TGT_IDLE;
         break;
@@ -134,29 +166,39 @@ void PibusMultiDma::transition()
 	
     // The master FSM implements a round-robin policy between the clients channels
     // It controls the following registers :
-    // r_master_fsm, r_master_index, r_master_count
-    // r_channel_done[k] set and r_channel_error[k] to signal the pibus 
-    // transaction completion.
+    // r_master_fsm, r_master_index, r_master_count, r_master_burst, r_master_buf,
+    // r_master_next, r_master_next_req, and the r_channel_source[k], 
+    // r_channel_dest[k], r_channel_length[k], r_channel_rlength[k], 
+    // r_channel_full[k], r_channel_rbuf[k], r_channel_wbuf[k] registers 
+    // for the served channel, and r_channel_error[k] set to signal a bus error.
+    // During a transaction, the next transaction is selected (the served channel
+    // is excluded), and the bus is requested in the last data cycle (DT states) : 
+    // when the bus is granted in this cycle, the next transaction starts 
+    // directly with the address phase.
+
+    if( (r_master_fsm.read() != MST_IDLE) and
+        (r_master_fsm.read() != MST_READ_REQ) and
+        (r_master_fsm.read() != MST_WRITE_REQ) and
+        (r_master_fsm.read() != MST_DESC_REQ) )
+    {
+        size_t next = 0;
+        r_master_next_req = selectChannel(r_master_index.read(), next);
+        r_master_next     = next;
+    }
+    else
+    {
+        r_master_next_req = MST_IDLE;
+    }
 
     switch( r_master_fsm.read() ) {
     case MST_IDLE :
     {
-        bool found = false;
-	for( size_t n=0 ; (n < m_channels) and not found ; n++ )
+        size_t k   = 0;
+        int    req = selectChannel(m_channels, k);
+        if( req != MST_IDLE )
         {
-            size_t k = (r_master_index.read() + n) % m_channels;
-            if ( (r_channel_fsm[k] == CHANNEL_READ_REQ) or
-                 (r_channel_fsm[k] == CHANNEL_WRITE_REQ) )
-            {
-                uint32_t nwords = r_channel_length[k].read() >> 2;
-                found           = true;
-                r_master_index  = k;
-                r_master_count  = 0;
-                if( nwords < m_burst ) r_master_burst = nwords;
-                else                   r_master_burst = m_burst;
-                if( r_channel_fsm[k].read() == CHANNEL_READ_REQ ) r_master_fsm = MST_READ_REQ;
-                else                                              r_master_fsm = MST_WRITE_REQ;
-            }
+            startTransaction(k, req);
+            r_master_fsm = req;
         }
         break;
     }
@@ -177,9 +219,15 @@ void PibusMultiDma::transition()
     case MST_READ_DTAD :
     {
         uint32_t k = r_master_index.read();
-	if( p_ack.read() != PIBUS_ACK_WAIT ) 
+	if( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
         {
-            uint32_t word = r_master_count.read();
+            r_channel_source[k] = r_channel_source[k].read() - (r_master_count.read() << 2);
+            r_master_count      = 0;
+            r_master_fsm        = MST_READ_REQ;
+        }
+	else if( p_ack.read() != PIBUS_ACK_WAIT ) 
+        {
+            uint32_t word = r_master_buf.read()*m_burst + r_master_count.read() - 1;
             r_channel_buf[k][word] = (uint32_t)p_d.read();
 	    r_master_count         = r_master_count.read() + 1;
             r_channel_source[k]    = r_channel_source[k].read() + 4;
@@ -191,19 +239,37 @@ void PibusMultiDma::transition()
     case MST_READ_DT :
     {
         uint32_t k = r_master_index.read();
-	if( p_ack.read() == PIBUS_ACK_READY ) 
+        uint32_t b = r_master_buf.read();
+	if( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
         {
-            uint32_t word          = r_master_count.read();
-            r_channel_buf[k][word] = (uint32_t)p_d.read();
-            r_channel_done[k]      = true;
-            r_channel_error[k]     = false;
-            r_master_fsm           = MST_IDLE;
+            r_channel_source[k] = r_channel_source[k].read() - (r_master_count.read() << 2);
+            r_master_count      = 0;
+            if( p_gnt.read() ) r_master_fsm = MST_READ_AD;
+            else               r_master_fsm = MST_READ_REQ;
         }
-        else if( p_ack.read() == PIBUS_ACK_ERROR ) 
+	else if( p_ack.read() != PIBUS_ACK_WAIT ) 
         {
-            r_channel_done[k]      = true;
-            r_channel_error[k]     = true;
-            r_master_fsm           = MST_IDLE;
+            if( p_ack.read() == PIBUS_ACK_READY ) 
+            {
+                uint32_t word          = b*m_burst + r_master_count.read() - 1;
+                r_channel_buf[k][word] = (uint32_t)p_d.read();
+                r_channel_nwords[k][b] = r_master_burst.read();
+                r_channel_full[k]      = r_channel_full[k].read() | (1 << b);
+                r_channel_rbuf[k]      = b ^ 1;
+                r_channel_rlength[k]   = r_channel_rlength[k].read() - (r_master_burst.read() << 2);
+            }
+            else	// PIBUS_ACK_ERROR
+            {
+                r_channel_error[k]     = true;
+                r_channel_werror[k]    = false;
+            }
+            if( r_master_next_req.read() == MST_IDLE ) r_master_fsm = MST_IDLE;
+            else 
+            {
+                int ad = startTransaction(r_master_next.read(), r_master_next_req.read());
+                if( p_gnt.read() ) r_master_fsm = ad;
+                else               r_master_fsm = r_master_next_req.read();
+            }
         }
         break;
     }
@@ -225,7 +291,14 @@ void PibusMultiDma::transition()
     case MST_WRITE_DTAD :
     {
         uint32_t k = r_master_index.read();
-        if( p_ack.read() != PIBUS_ACK_WAIT ) 
+	if( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
+        {
+            r_channel_dest[k]   = r_channel_dest[k].read() - (r_master_count.read() << 2);
+            r_channel_length[k] = r_channel_length[k].read() + (r_master_count.read() << 2);
+            r_master_count      = 0;
+            r_master_fsm        = MST_WRITE_REQ;
+        }
+        else if( p_ack.read() != PIBUS_ACK_WAIT ) 
         {
 	    r_master_count         = r_master_count.read() + 1;
             r_channel_dest[k]      = r_channel_dest[k].read() + 4;
@@ -238,17 +311,94 @@ void PibusMultiDma::transition()
     case MST_WRITE_DT :
     {
         uint32_t k = r_master_index.read();
-        if( p_ack.read() == PIBUS_ACK_READY ) 
+        uint32_t b = r_master_buf.read();
+	if( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
+        {
+            r_channel_dest[k]   = r_channel_dest[k].read() - (r_master_count.read() << 2);
+            r_channel_length[k] = r_channel_length[k].read() + (r_master_count.read() << 2);
+            r_master_count      = 0;
+            if( p_gnt.read() ) r_master_fsm = MST_WRITE_AD;
+            else               r_master_fsm = MST_WRITE_REQ;
+        }
+        else if( p_ack.read() != PIBUS_ACK_WAIT )
+        {
+            if( p_ack.read() == PIBUS_ACK_READY ) 
+            {
+                r_channel_full[k]      = r_channel_full[k].read() & ~(1 << b);
+                r_channel_wbuf[k]      = b ^ 1;
+            }
+            else	// PIBUS_ACK_ERROR
+            {
+                r_channel_error[k]     = true;
+                r_channel_werror[k]    = true;
+            }
+            if( r_master_next_req.read() == MST_IDLE ) r_master_fsm = MST_IDLE;
+            else 
+            {
+                int ad = startTransaction(r_master_next.read(), r_master_next_req.read());
+                if( p_gnt.read() ) r_master_fsm = ad;
+                else               r_master_fsm = r_master_next_req.read();
+            }
+        }
+        break;
+    }
+    case MST_DESC_REQ :
+    {
+	if(p_gnt.read() == true) r_master_fsm = MST_DESC_AD;
+        break;
+    }
+    case MST_DESC_AD :
+    {
+	r_master_count = r_master_count.read() + 1;
+	r_master_fsm   = MST_DESC_DTAD;
+        break;
+    }
+    case MST_DESC_DTAD :
+    {
+        uint32_t k = r_master_index.read();
+	if( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
+        {
+            r_master_count      = 0;
+            r_master_fsm        = MST_DESC_REQ;
+        }
+	else if( p_ack.read() != PIBUS_ACK_WAIT ) 
+        {
+            uint32_t word = r_master_count.read();
+            r_channel_dbuf[k][word - 1] = (uint32_t)p_d.read();
+	    r_master_count              = r_master_count.read() + 1;
+	    if( r_master_count == (r_master_burst.read() - 1) ) r_master_fsm = MST_DESC_DT;
+	    else				                r_master_fsm = MST_DESC_DTAD;
+	}
+        break;
+    }
+    case MST_DESC_DT :
+    {
+        uint32_t k = r_master_index.read();
+	if( p_ack.read() == PIBUS_ACK_RETRY )	// restart the burst
         {
-            r_channel_done[k]      = true;
-            r_channel_error[k]     = false;
-            r_master_fsm           = MST_IDLE;
+            r_master_count      = 0;
+            if( p_gnt.read() ) r_master_fsm = MST_DESC_AD;
+            else               r_master_fsm = MST_DESC_REQ;
         }
-        else if( p_ack.read() == PIBUS_ACK_ERROR )
+	else if( p_ack.read() != PIBUS_ACK_WAIT ) 
         {
-            r_channel_done[k]      = true;
-            r_channel_error[k]     = true;
-            r_master_fsm           = MST_IDLE;
+            if( p_ack.read() == PIBUS_ACK_READY ) 
+            {
+                uint32_t word               = r_master_count.read();
+                r_channel_dbuf[k][word - 1] = (uint32_t)p_d.read();
+            }
+            else	// PIBUS_ACK_ERROR
+            {
+                r_channel_error[k]     = true;
+                r_channel_werror[k]    = false;
+            }
+            if( r_master_next_req.read() == MST_IDLE ) r_master_fsm = MST_IDLE;
+            else 
+            {
+                int ad = startTransaction(r_master_next.read(), r_master_next_req.read());
+                if( p_gnt.read() ) r_master_fsm = ad;
+                else               r_master_fsm = r_master_next_req.read();
+            }
         }
         break;
     }
@@ -257,54 +407,108 @@ void PibusMultiDma::transition()
     // For each channel (k), the corresponding CHANNEL FSM  
     // define the channel state and control the following registers
     // - r_channel_fsm[k]
-    // - r_channel_done[k] reset
-    // Soft reset : After each burst (read or write), the master FSM
-    // test the r_activate flip-flop to stop the ongoing transfer if requested. 
-    // It goes to the MST_SUCCESS state when the tranfer is isuccessfully 
-    // completed, to assert the IRQ signaling the completion.
-    // In case of bus error, it goes to the MST_WRITE_ERROR or MST_READ_ERROR
-    // state to assert the IRQ signaling the completion.
+    // - r_channel_error[k], r_channel_full[k], r_channel_rbuf[k], 
+    //   r_channel_wbuf[k] and r_channel_rlength[k] initialisation
+    // In the MOVE state, the read and write bursts are requested to the
+    // master FSM, depending on the buffers state (see channelRequest()).
+    // Soft reset : The channel FSM test the r_channel_active[k] flip-flop
+    // when no transaction is in progress for this channel, to stop 
+    // the ongoing transfer if requested. 
+    // It goes to the CHANNEL_DONE state when the tranfer is successfully 
+    // completed (all bytes written), to assert the IRQ signaling the completion.
+    // In case of bus error, it goes to the CHANNEL_WRITE_ERROR or 
+    // CHANNEL_READ_ERROR state to assert the IRQ signaling the completion.
+    // In descriptor chain mode, it also controls r_channel_source[k],
+    // r_channel_dest[k], r_channel_length[k] (loaded from the descriptor),
+    // r_channel_desc[k] and r_channel_irq[k] set.
     for( size_t k=0 ; k<m_channels ; k++ )
     {
         switch( r_channel_fsm[k].read() )
         {
             case CHANNEL_IDLE:
             {
-                if ( r_channel_active[k].read() ) r_channel_fsm[k] = CHANNEL_READ_REQ;
+                if ( r_channel_active[k].read() and not channelBusy(k) ) 
+                {
+                    r_channel_error[k]  = false;
+                    r_channel_werror[k] = false;
+                    r_channel_full[k]   = 0;
+                    r_channel_rbuf[k]   = 0;
+                    r_channel_wbuf[k]   = 0;
+                    if ( r_channel_chain[k].read() ) 
+                    {
+                        r_channel_fsm[k]     = CHANNEL_DESC_REQ;
+                    }
+                    else
+                    {
+                        r_channel_rlength[k] = r_channel_length[k].read();
+                        r_channel_fsm[k]     = CHANNEL_MOVE;
+                    }
+                }
                 break;
             }
-            case CHANNEL_READ_REQ:      // requesting a VCI READ transaction
+            case CHANNEL_DESC_REQ:      // requesting a descriptor READ transaction
             {
-                if ( (r_master_fsm.read() == MST_READ_REQ) and (r_master_index.read() == k) ) 
-                    r_channel_fsm[k] = CHANNEL_READ_WAIT;
+                if      ( channelBusy(k) )                 r_channel_fsm[k] = CHANNEL_DESC_WAIT;
+                else if ( not r_channel_active[k].read() ) r_channel_fsm[k] = CHANNEL_IDLE;
                 break;
             }
-            case CHANNEL_READ_WAIT:     // waiting  VCI READ response
+            case CHANNEL_DESC_WAIT:     // waiting descriptor READ response
             {
-                if ( r_channel_done[k].read() ) 
+                if ( not channelBusy(k) ) 
                 {
                     if      ( not r_channel_active[k].read() ) r_channel_fsm[k] = CHANNEL_IDLE;
                     else if ( r_channel_error[k].read() )      r_channel_fsm[k] = CHANNEL_READ_ERROR;
-                    else                                       r_channel_fsm[k] = CHANNEL_WRITE_REQ;
-                    r_channel_done[k] = false;
+                    else
+                    {
+                        uint32_t* desc = r_channel_dbuf[k];
+                        if( ((desc[DESC_SRC] | desc[DESC_DST] | desc[DESC_LEN] | desc[DESC_NEXT]) & 0x3) != 0 )
+                        {
+	                    printf("ERROR in component PibusMultiDma : %s\n",m_name);
+	                    printf("The descriptor at address 0x%x is not word aligned\n",
+                                   r_channel_desc[k].read());
+                            exit(1);
+                        }
+                        r_channel_source[k]  = desc[DESC_SRC];
+                        r_channel_dest[k]    = desc[DESC_DST];
+                        r_channel_length[k]  = desc[DESC_LEN];
+                        r_channel_rlength[k] = desc[DESC_LEN];
+                        r_channel_full[k]    = 0;
+                        r_channel_rbuf[k]    = 0;
+                        r_channel_wbuf[k]    = 0;
+                        if ( desc[DESC_LEN] != 0 )           r_channel_fsm[k] = CHANNEL_MOVE;
+                        else if ( desc[DESC_NEXT] != 0 )     // skip empty descriptor
+                        {
+                            r_channel_desc[k] = desc[DESC_NEXT];
+                            r_channel_fsm[k]  = CHANNEL_DESC_REQ;
+                        }
+                        else                                 r_channel_fsm[k] = CHANNEL_DONE;
+                    }
                 }
                 break;
             }
-            case CHANNEL_WRITE_REQ:     // requesting a VCI WRITE transaction
+            case CHANNEL_MOVE:          // read & write bursts
             {
-                if ( (r_master_fsm.read() == MST_WRITE_REQ) and (r_master_index.read() == k) ) 
-                    r_channel_fsm[k] = CHANNEL_WRITE_WAIT;
-                break;
-            }
-            case CHANNEL_WRITE_WAIT:    // waiting VCI WRITE response
-            {
-                if ( r_channel_done[k].read() ) 
+                if ( not channelBusy(k) ) 
                 {
                     if      ( not r_channel_active[k].read() ) r_channel_fsm[k] = CHANNEL_IDLE;
-                    else if ( r_channel_error[k].read() )      r_channel_fsm[k] = CHANNEL_WRITE_ERROR;
-                    else if ( r_channel_length[k].read()== 0 ) r_channel_fsm[k] = CHANNEL_DONE;
-                    else                                       r_channel_fsm[k] = CHANNEL_READ_REQ;
-                    r_channel_done[k] = false;
+                    else if ( r_channel_error[k].read() )
+                    {
+                        if ( r_channel_werror[k].read() ) r_channel_fsm[k] = CHANNEL_WRITE_ERROR;
+                        else                              r_channel_fsm[k] = CHANNEL_READ_ERROR;
+                    }
+                    else if ( r_channel_length[k].read() != 0 ) r_channel_fsm[k] = CHANNEL_MOVE;
+                    else if ( not r_channel_chain[k].read() )   r_channel_fsm[k] = CHANNEL_DONE;
+                    else    // descriptor completed
+                    {
+                        uint32_t* desc = r_channel_dbuf[k];
+                        if ( desc[DESC_NEXT] == 0 )            r_channel_fsm[k] = CHANNEL_DONE;
+                        else
+                        {
+                            if ( desc[DESC_FLAGS] & DMA_DESC_IRQ ) r_channel_irq[k] = true;
+                            r_channel_desc[k] = desc[DESC_NEXT];
+                            r_channel_fsm[k]  = CHANNEL_DESC_REQ;
+                        }
+                    }
                 }
                 break;
             }
@@ -320,6 +524,84 @@ void PibusMultiDma::transition()
 
 }  // end transition
 
+////////////////////////////////////////////////////////////////////
+// This function returns the REQ state of the master FSM matching
+// the transaction requested by channel (k), or MST_IDLE.
+////////////////////////////////////////////////////////////////////
+int PibusMultiDma::channelRequest(size_t k)
+{
+    if( not r_channel_active[k].read() or r_channel_error[k].read() ) return MST_IDLE;
+    if( r_channel_fsm[k].read() == CHANNEL_DESC_REQ )                 return MST_DESC_REQ;
+    if( r_channel_fsm[k].read() != CHANNEL_MOVE )                     return MST_IDLE;
+
+    uint32_t full = r_channel_full[k].read();
+    if( (full >> r_channel_wbuf[k].read()) & 0x1 )                    return MST_WRITE_REQ;
+    if( (r_channel_rlength[k].read() != 0) and 
+        (((full >> r_channel_rbuf[k].read()) & 0x1) == 0) )           return MST_READ_REQ;
+    return MST_IDLE;
+} // end channelRequest()
+
+////////////////////////////////////////////////////////////////////
+// This function selects the next channel (round-robin, starting 
+// after the last served channel), excluding the channel (exclude).
+// It returns the REQ state of the selected transaction, or MST_IDLE.
+////////////////////////////////////////////////////////////////////
+int PibusMultiDma::selectChannel(size_t exclude, size_t &channel)
+{
+    for( size_t n=1 ; n <= m_channels ; n++ )
+    {
+        size_t k = (r_master_index.read() + n) % m_channels;
+        if( k == exclude ) continue;
+        int req = channelRequest(k);
+        if( req != MST_IDLE ) 
+        {
+            channel = k;
+            return req;
+        }
+    }
+    return MST_IDLE;
+} // end selectChannel()
+
+////////////////////////////////////////////////////////////////////
+// This function initialises the r_master_* registers for a new 
+// transaction of channel (k), and returns the matching AD state.
+////////////////////////////////////////////////////////////////////
+int PibusMultiDma::startTransaction(size_t k, int req)
+{
+    r_master_index = k;
+    r_master_count = 0;
+    if( req == MST_READ_REQ )
+    {
+        uint32_t nwords = r_channel_rlength[k].read() >> 2;
+        if( nwords < m_burst ) r_master_burst = nwords;
+        else                   r_master_burst = m_burst;
+        r_master_buf = r_channel_rbuf[k].read();
+        return MST_READ_AD;
+    }
+    else if( req == MST_WRITE_REQ )
+    {
+        uint32_t b     = r_channel_wbuf[k].read();
+        r_master_burst = r_channel_nwords[k][b];
+        r_master_buf   = b;
+        return MST_WRITE_AD;
+    }
+    else
+    {
+        r_master_burst = DESC_WORDS;
+        r_master_buf   = 0;
+        return MST_DESC_AD;
+    }
+} // end startTransaction()
+
+////////////////////////////////////////////////////////////////////
+// This function returns true when a transaction of channel (k)
+// is handled by the master FSM.
+////////////////////////////////////////////////////////////////////
+bool PibusMultiDma::channelBusy(size_t k)
+{
+    return (r_master_fsm.read() != MST_IDLE) and (r_master_index.read() == k);
+} // end channelBusy()
+
 //////////////////////////////
 void PibusMultiDma::genMoore()
 {
@@ -345,6 +627,10 @@ void PibusMultiDma::genMoore()
 	p_ack = PIBUS_ACK_READY;
 	p_d = (uint32_t)r_channel_noirq[tk].read();
         break;
+    case TGT_READ_DESC:
+	p_ack = PIBUS_ACK_READY;
+	p_d = (uint32_t)r_channel_desc[tk].read();
+        break;
     case TGT_ERROR:
 	p_ack = PIBUS_ACK_ERROR;
         break;
@@ -353,8 +639,11 @@ void PibusMultiDma::genMoore()
         break;
     } // end switch target fsm
 
-    // p_req signal
-    if((r_master_fsm == MST_READ_REQ) || (r_master_fsm == MST_WRITE_REQ)) 	p_req = true;
+    // p_req signal (pipelined request in the DT states)
+    if((r_master_fsm == MST_READ_REQ) || (r_master_fsm == MST_WRITE_REQ) ||
+       (r_master_fsm == MST_DESC_REQ)) 						p_req = true;
+    else if((r_master_fsm == MST_READ_DT) || (r_master_fsm == MST_WRITE_DT) ||
+       (r_master_fsm == MST_DESC_DT)) 		p_req = (r_master_next_req.read() != MST_IDLE);
     else									p_req = false;
 
     uint32_t	mk = r_master_index.read();
@@ -377,10 +666,19 @@ void PibusMultiDma::genMoore()
 	else			                                p_lock = true;
     }
 
+    if((r_master_fsm == MST_DESC_AD) || (r_master_fsm == MST_DESC_DTAD)) 
+    {
+	p_a   = (uint32_t)r_channel_desc[mk].read() + (r_master_count.read() << 2);
+	p_opc = PIBUS_OPC_WDU;
+	p_read = true;
+	if(r_master_count.read() == r_master_burst.read() - 1) p_lock = false;
+	else			                                p_lock = true;
+    }
+
     // p_d signal
     if((r_master_fsm == MST_WRITE_DTAD) || (r_master_fsm == MST_WRITE_DT)) 
     {
-        uint32_t word = r_master_count.read();
+        uint32_t word = r_master_buf.read()*m_burst + r_master_count.read() - 1;
         p_d = (uint32_t)r_channel_buf[mk][word];
     }
 
@@ -389,7 +687,8 @@ void PibusMultiDma::genMoore()
     {
         p_irq[k] = (( (r_channel_fsm[k].read() == CHANNEL_DONE) or
                       (r_channel_fsm[k].read() == CHANNEL_READ_ERROR) or
-                      (r_channel_fsm[k].read() == CHANNEL_WRITE_ERROR) )
+                      (r_channel_fsm[k].read() == CHANNEL_WRITE_ERROR) or
+                      r_channel_irq[k].read() )
                       and not r_channel_noirq[k].read() );
     }
 } // end GenMoore()
@@ -407,14 +706,24 @@ PibusMultiDma::PibusMultiDma(sc_module_name	name,
       r_master_index("r_master_count"),
       r_master_count("r_master_index"),
       r_master_burst("r_master_burst"),
+      r_master_buf("r_master_buf"),
+      r_master_next("r_master_next"),
+      r_master_next_req("r_master_next_req"),
       r_channel_fsm(alloc_elems<sc_signal<int> >("r_channel_fsm", channels)),
       r_channel_source(alloc_elems<sc_signal<uint32_t> >("r_channel_source", channels)),
       r_channel_dest(alloc_elems<sc_signal<uint32_t> >("r_channel_dest", channels)),
       r_channel_length(alloc_elems<sc_signal<uint32_t> >("r_channel_length", channels)),
+      r_channel_rlength(alloc_elems<sc_signal<uint32_t> >("r_channel_rlength", channels)),
       r_channel_noirq(alloc_elems<sc_signal<bool> >("r_channel_noirq", channels)),
       r_channel_active(alloc_elems<sc_signal<bool> >("r_channel_active", channels)),
-      r_channel_done(alloc_elems<sc_signal<bool> >("r_channel_done", channels)),
       r_channel_error(alloc_elems<sc_signal<bool> >("r_channel_error", channels)),
+      r_channel_werror(alloc_elems<sc_signal<bool> >("r_channel_werror", channels)),
+      r_channel_full(alloc_elems<sc_signal<uint32_t> >("r_channel_full", channels)),
+      r_channel_rbuf(alloc_elems<sc_signal<uint32_t> >("r_channel_rbuf", channels)),
+      r_channel_wbuf(alloc_elems<sc_signal<uint32_t> >("r_channel_wbuf", channels)),
+      r_channel_chain(alloc_elems<sc_signal<bool> >("r_channel_chain", channels)),
+      r_channel_desc(alloc_elems<sc_signal<uint32_t> >("r_channel_desc", channels)),
+      r_channel_irq(alloc_elems<sc_signal<bool> >("r_channel_irq", channels)),
       m_name(name),
       m_tgtid(tgtid),
       m_burst(burst),
@@ -444,10 +753,9 @@ PibusMultiDma::PibusMultiDma(sc_module_name	name,
     strcpy (m_channel_str[1], "READ_ERROR");
     strcpy (m_channel_str[2], "IDLE");
     strcpy (m_channel_str[3], "WRITE_ERROR");
-    strcpy (m_channel_str[4], "READ_REQ");
-    strcpy (m_channel_str[5], "READ_WAIT");
-    strcpy (m_channel_str[6], "WRITE_REQ");
-    strcpy (m_channel_str[7], "WRITE_WAIT");
+    strcpy (m_channel_str[4], "MOVE");
+    strcpy (m_channel_str[5], "DESC_REQ");
+    strcpy (m_channel_str[6], "DESC_WAIT");
 
     strcpy (m_master_str[0], "IDLE");
     strcpy (m_master_str[1], "READ_REQ");
@@ -458,6 +766,10 @@ PibusMultiDma::PibusMultiDma(sc_module_name	name,
     strcpy (m_master_str[6], "WRITE_AD");
     strcpy (m_master_str[7], "WRITE_DTAD");
     strcpy (m_master_str[8], "WRITE_DT");
+    strcpy (m_master_str[9], "DESC_REQ");
+    strcpy (m_master_str[10], "DESC_AD");
+    strcpy (m_master_str[11], "DESC_DTAD");
+    strcpy (m_master_str[12], "DESC_DT");
 
     strcpy (m_target_str[0], "IDLE");
     strcpy (m_target_str[1], "WRITE_SOURCE");
@@ -470,6 +782,9 @@ PibusMultiDma::PibusMultiDma(sc_module_name	name,
     strcpy (m_target_str[8], "READ_STATUS");
     strcpy (m_target_str[9], "READ_NOIRQ");
     strcpy (m_target_str[10], "ERROR");
+    strcpy (m_target_str[11], "WRITE_DESC");
+    strcpy (m_target_str[12], "WRITE_ACK");
+    strcpy (m_target_str[13], "READ_DESC");
 
     if( (channels < 1) or (channels > 16) )
     {
@@ -486,10 +801,14 @@ PibusMultiDma::PibusMultiDma(sc_module_name	name,
     }
 
     r_channel_buf = new uint32_t*[channels];
-    for( size_t k=0 ; k<channels ; k++) r_channel_buf[k] = new uint32_t[burst];
+    for( size_t k=0 ; k<channels ; k++) r_channel_buf[k] = new uint32_t[2*burst];
+    r_channel_nwords = new uint32_t*[channels];
+    for( size_t k=0 ; k<channels ; k++) r_channel_nwords[k] = new uint32_t[2];
+    r_channel_dbuf = new uint32_t*[channels];
+    for( size_t k=0 ; k<channels ; k++) r_channel_dbuf[k] = new uint32_t[DESC_WORDS];
 
     // get segment base address and segment size
-    std::list<SegmentTableEntry> seglist = segtab.getTargetSegmentList(tgtid);
+    const std::list<SegmentTableEntry> &seglist = segtab.getTargetSegmentList(tgtid);
     m_segbase = (*seglist.begin()).getBase();
     m_segsize = (*seglist.begin()).getSize();
     m_segname = (*seglist.begin()).getName();
@@ -529,10 +848,103 @@ void PibusMultiDma::printTrace()
             std::cout  << m_name << "_channel " << k << " : " << m_channel_str[r_channel_fsm[k].read()]
                        << " / source = " << std::hex << r_channel_source[k].read() 
                        << " / dest = " << std::hex << r_channel_dest[k].read() 
-                       << " / nwords = " << std::dec << r_channel_length[k].read() << std::endl;
+                       << " / nbytes = " << std::dec << r_channel_length[k].read()
+                       << " / full = " << r_channel_full[k].read();
+            if( r_channel_chain[k].read() )
+                std::cout << " / desc = " << std::hex << r_channel_desc[k].read() << std::dec;
+            std::cout << std::endl;
         }
     }
 } // end printTrace
 
+//////////////////////////////////////
+bool PibusMultiDma::checkpointReady()
+{
+    int master = r_master_fsm.read();
+    return (r_target_fsm == TGT_IDLE) &&
+           ((master == MST_IDLE) || (master == MST_READ_REQ) || 
+            (master == MST_WRITE_REQ) || (master == MST_DESC_REQ));
+}
+////////////////////////////////////////////////////////////////
+void PibusMultiDma::saveState(PibusCheckpointWriter &writer)
+{
+    writer.put(m_burst);
+    writer.put(m_channels);
+    writer.put(r_target_fsm);
+    writer.put(r_target_index);
+    writer.put(r_master_fsm);
+    writer.put(r_master_index);
+    writer.put(r_master_count);
+    writer.put(r_master_burst);
+    writer.put(r_master_buf);
+    writer.put(r_master_next);
+    writer.put(r_master_next_req);
+    for( size_t k=0 ; k<m_channels ; k++ )
+    {
+        writer.put(r_channel_fsm[k]);
+        writer.put(r_channel_source[k]);
+        writer.put(r_channel_dest[k]);
+        writer.put(r_channel_length[k]);
+        writer.put(r_channel_rlength[k]);
+        writer.put(r_channel_noirq[k]);
+        writer.put(r_channel_active[k]);
+        writer.put(r_channel_error[k]);
+        writer.put(r_channel_werror[k]);
+        writer.put(r_channel_full[k]);
+        writer.put(r_channel_rbuf[k]);
+        writer.put(r_channel_wbuf[k]);
+        writer.put(r_channel_chain[k]);
+        writer.put(r_channel_desc[k]);
+        writer.put(r_channel_irq[k]);
+        writer.putArray(r_channel_buf[k], 2*m_burst);
+        writer.putArray(r_channel_nwords[k], 2);
+        writer.putArray(r_channel_dbuf[k], DESC_WORDS);
+    }
+}
+////////////////////////////////////////////////////////////////
+void PibusMultiDma::restoreState(PibusCheckpointReader &reader)
+{
+    uint32_t burst;
+    uint32_t channels;
+    reader.get(burst);
+    reader.get(channels);
+    if ((burst != m_burst) || (channels != m_channels))
+    {
+	printf("ERROR in component PibusMultiDma : %s\n", m_name);
+	printf("The checkpoint burst size or number of channels does not match\n");
+	exit(1);
+    }
+    reader.get(r_target_fsm);
+    reader.get(r_target_index);
+    reader.get(r_master_fsm);
+    reader.get(r_master_index);
+    reader.get(r_master_count);
+    reader.get(r_master_burst);
+    reader.get(r_master_buf);
+    reader.get(r_master_next);
+    reader.get(r_master_next_req);
+    for( size_t k=0 ; k<m_channels ; k++ )
+    {
+        reader.get(r_channel_fsm[k]);
+        reader.get(r_channel_source[k]);
+        reader.get(r_channel_dest[k]);
+        reader.get(r_channel_length[k]);
+        reader.get(r_channel_rlength[k]);
+        reader.get(r_channel_noirq[k]);
+        reader.get(r_channel_active[k]);
+        reader.get(r_channel_error[k]);
+        reader.get(r_channel_werror[k]);
+        reader.get(r_channel_full[k]);
+        reader.get(r_channel_rbuf[k]);
+        reader.get(r_channel_wbuf[k]);
+        reader.get(r_channel_chain[k]);
+        reader.get(r_channel_desc[k]);
+        reader.get(r_channel_irq[k]);
+        reader.getArray(r_channel_buf[k], 2*m_burst);
+        reader.getArray(r_channel_nwords[k], 2);
+        reader.getArray(r_channel_dbuf[k], DESC_WORDS);
+    }
+}
+
 
 }} // end namespace
@@ -11,6 +11,18 @@
 // The TIMER_COUNT[i] registers used to generate periodic interrupts 
 // are not directly addressables.
 //
+// The timers are not decremented at each cycle : the component counts
+// the cycles since reset, and each running timer is defined by the 
+// absolute cycle of its next expiration (deadline). The deadlines of 
+// the running timers are stored in a min-heap, and the transition()
+// only checks the heap top, so the simulation cost is proportional to
+// the number of expirations, not to the number of cycles. An expired 
+// timer is rescheduled at (deadline + TIMER_PERIOD[i] + 1), as the 
+// TIMER_COUNT[i] register was reloaded with the period.
+// In the same way, the TIMER_VALUE[i] registers are not incremented :
+// a read returns the number of cycles since the last write, plus the 
+// written value.
+//
 // Each timer defines 4 memory mapped registers :
 // - TIMER_VALUE[i]	(0x0) 	(read/write)
 // A read request returns the value contained in TIMER_VALUE[i].
@@ -31,6 +43,16 @@
 //
 // This component cheks address for segmentation violation,
 // and can be used as a default target.
+// When the PIBUS_CLOCK_GATING flag is defined, the transition() and 
+// genMoore() methods are not evaluated when the FSM is IDLE (see the 
+// PibusSimpleRam component) : the transition() sleeps until the next
+// selection, or the next timer deadline, and the genMoore() sleeps until
+// the FSM state, or an IRQ, changes. The cycle counter is updated with 
+// the number of elapsed cycles when the transition() is woken up. 
+// This requires p_ck to be connected to a sc_clock.
+// This component implements the PibusCheckpointable interface, and
+// can be checkpointed when the FSM is IDLE. The deadlines heap is
+// rebuilt on restore, and the sleeping transition() is woken up.
 ///////////////////////////////////////////////////////////////////////////////
 // This component has 4 "constructor" parameters :
 // - sc_module_name	name		: instance name
@@ -43,12 +65,23 @@
 #define PIBUS_MULTI_TIMER_H
 
 #include <systemc>
+#include <queue>
+#include <vector>
+#include <functional>
 #include "pibus_mnemonics.h"
 #include "pibus_segment_table.h"
+#include "pibus_checkpoint.h"
 
 namespace soclib { namespace caba {
 
-class PibusMultiTimer : sc_core::sc_module {
+class PibusMultiTimer : sc_core::sc_module, public PibusCheckpointable {
+
+    // timer expiration (min-heap entry)
+    struct TimerEvent {
+        uint64_t	deadline;	// expiration cycle
+        uint32_t	index;		// timer index
+        bool operator>(const TimerEvent &e) const { return deadline > e.deadline; }
+    };
 
     // Structural parameters
     const char*                 m_name;                 // instance name
@@ -58,14 +91,26 @@ class PibusMultiTimer : sc_core::sc_module {
     uint32_t                    m_segsize;              // segment size
     const char*                 m_segname;              // segment name
     char			m_fsm_str[4][20];	// FSM states names 
+    bool			m_sleep_transition;	// transition() is not clocked (clock gating)
+    bool			m_sleep_moore;		// genMoore() is not clocked (clock gating)
+    sc_core::sc_time		m_sleep_time;		// date of the last transition() before sleep
+    sc_core::sc_time		m_cycle;		// clock period
+    sc_core::sc_event		m_restore_event;	// state restored (clock gating)
+
+    // Timers state
+    uint64_t			m_cycles;		// number of cycles since reset
+    uint32_t			*m_value_offset;	// TIMER_VALUE[i] - cycles
+    uint64_t			*m_deadline;		// expiration cycle (running timer)
+    uint64_t			*m_remaining;		// TIMER_COUNT[i] (stopped timer)
+    uint32_t			m_irq_out;		// p_irq[i] values
+    std::priority_queue<TimerEvent, std::vector<TimerEvent>, 
+                        std::greater<TimerEvent> >	m_events;	// deadlines min-heap
 
     //	Registers
     sc_register<int>		r_fsm_state;
-    sc_register<uint32_t>	*r_value;
     sc_register<uint32_t>	*r_period;
-    sc_register<uint32_t>	*r_counter;
-    sc_register<bool>		*r_running;
-    sc_register<bool>		*r_irq;
+    sc_register<uint32_t>	r_running;		// TIMER_RUNNING[i] bit-vector
+    sc_register<uint32_t>	r_irq;			// TIMER_IRQ[i] bit-vector
     sc_register<uint32_t>	r_index;
     sc_register<uint32_t>	r_cell;
 
@@ -85,6 +130,10 @@ class PibusMultiTimer : sc_core::sc_module {
     IRQ_ADDRESS  	= 12, 
     };
 
+    void startTimer(size_t i);
+    void stopTimer(size_t i);
+    uint32_t expirations(uint32_t running);
+
 protected:
 
     SC_HAS_PROCESS(PibusMultiTimer);
@@ -109,11 +158,18 @@ public:
 		    soclib::common::PibusSegmentTable	&segtab,
 	            uint32_t				ntimer);
 
+    ~PibusMultiTimer();
+
     //  Methods 
     void transition();
     void genMoore();
     void printTrace();
 
+    // checkpoint
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
+
 }; // end class PibusMultiTimer
 
 }} // end namespace
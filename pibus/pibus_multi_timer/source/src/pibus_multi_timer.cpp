@@ -45,7 +45,7 @@ PibusMultiTimer::PibusMultiTimer(sc_core::sc_module_name		name,
     strcpy (m_fsm_str[3], "ERROR");
 
     // get the base address and segment size 
-    std::list<SegmentTableEntry> seglist = segtab.getTargetSegmentList(tgtid);
+    const std::list<SegmentTableEntry> &seglist = segtab.getTargetSegmentList(tgtid);
     m_segbase = (*seglist.begin()).getBase();
     m_segsize = (*seglist.begin()).getSize();
     m_segname = (*seglist.begin()).getName();
@@ -70,11 +70,16 @@ PibusMultiTimer::PibusMultiTimer(sc_core::sc_module_name		name,
     }
                                       
     // register allocation 
-    r_irq	= new 	sc_register<bool>[ntimer];
-    r_running	= new 	sc_register<bool>[ntimer];
-    r_value	= new	sc_register<uint32_t>[ntimer];
-    r_period	= new	sc_register<uint32_t>[ntimer];
-    r_counter	= new	sc_register<uint32_t>[ntimer];
+    r_period		= new	sc_register<uint32_t>[ntimer];
+    m_value_offset	= new	uint32_t[ntimer];
+    m_deadline		= new	uint64_t[ntimer];
+    m_remaining		= new	uint64_t[ntimer];
+    m_cycles		= 0;
+    m_irq_out		= 0;
+
+    m_sleep_transition = false;
+    m_sleep_moore      = false;
+    m_cycle            = SC_ZERO_TIME;
 		
     std::cout << std::endl << "Instanciation of PibusMultiTimer : " << m_name << std::endl;
     std::cout << "    ntimer = " << m_ntimer << std::endl;
@@ -83,19 +88,107 @@ PibusMultiTimer::PibusMultiTimer(sc_core::sc_module_name		name,
                   << " | size = 0x" << m_segsize << std::endl;
 } // end constructor
 
+//////////////////////////////////
+PibusMultiTimer::~PibusMultiTimer()
+{
+    delete [] r_period;
+    delete [] m_value_offset;
+    delete [] m_deadline;
+    delete [] m_remaining;
+} // end destructor
+
+/////////////////////////////////////////////////////////////
+// This function computes the deadline of timer [i], that
+// starts at the next cycle, and pushes it in the heap.
+/////////////////////////////////////////////////////////////
+void PibusMultiTimer::startTimer(size_t i)
+{
+    m_deadline[i] = m_cycles + 1 + m_remaining[i];
+    TimerEvent event = { m_deadline[i], (uint32_t)i };
+    m_events.push(event);
+} // end startTimer()
+
+/////////////////////////////////////////////////////////////
+// This function saves the TIMER_COUNT[i] value of timer [i],
+// that stops at the next cycle. The heap entry is not removed : 
+// it is ignored when it reaches the heap top.
+/////////////////////////////////////////////////////////////
+void PibusMultiTimer::stopTimer(size_t i)
+{
+    if (m_deadline[i] > m_cycles + 1) m_remaining[i] = m_deadline[i] - m_cycles - 1;
+    else                              m_remaining[i] = 0;
+} // end stopTimer()
+
+/////////////////////////////////////////////////////////////
+// This function pops all deadlines reached at the current
+// cycle, reschedules the corresponding timers, and returns
+// the bit-vector of the expired timers.
+// An entry is obsolete (and ignored) if the timer has been
+// stopped, or restarted with another deadline.
+/////////////////////////////////////////////////////////////
+uint32_t PibusMultiTimer::expirations(uint32_t running)
+{
+    uint32_t expired = 0;
+    while ( not m_events.empty() and (m_events.top().deadline <= m_cycles) )
+    {
+        TimerEvent event = m_events.top();
+        m_events.pop();
+        size_t i = event.index;
+        if ( ((running & (1 << i)) == 0) or (event.deadline != m_deadline[i]) ) continue;
+
+        // the cycles skipped by the clock gating can contain several periods
+        uint64_t period = (uint64_t)r_period[i].read() + 1;
+        m_deadline[i]   = event.deadline + period*((m_cycles - event.deadline)/period + 1);
+        event.deadline  = m_deadline[i];
+        m_events.push(event);
+        expired = expired | (1 << i);
+    }
+    return expired;
+} // end expirations()
+
 ///////////////////////////////////
 void PibusMultiTimer::transition() 
 {
+    uint64_t	increment = 1;		// m_cycles increment
+
+#ifdef PIBUS_CLOCK_GATING
+    // woken up by p_sel or p_resetn : wait the clock edge, and
+    // compute the number of cycles since the last evaluation
+    if ( m_sleep_transition )
+    {
+        if ( not p_ck.posedge() )
+        {
+            next_trigger( p_ck.posedge_event() );
+            return;
+        }
+        m_sleep_transition = false;
+        increment = (uint64_t)((sc_time_stamp() - m_sleep_time) / m_cycle + 0.5);
+    }
+#endif
+
     if(p_resetn == false) 
     {
 	r_fsm_state = FSM_IDLE;
+        r_running   = 0;
+        r_irq       = 0;
 	for(size_t i = 0 ; i < m_ntimer ; i++) 
         {
-            r_running[i] = false;
-            r_irq[i] = false;
+            m_value_offset[i] = 0;
+            m_remaining[i]    = 0;
 	}
+        m_events    = std::priority_queue<TimerEvent, std::vector<TimerEvent>,
+                                          std::greater<TimerEvent> >();
+        m_cycles    = 0;
 	return;
     }
+
+    m_cycles = m_cycles + increment;
+
+    // expired timers (r_irq[i] is set after the FSM write, 
+    // an expiration wins against an acknowledge in the same cycle)
+    uint32_t	running = r_running.read();
+    uint32_t	expired = expirations(running);
+    uint32_t	irq     = r_irq.read();
 		
     switch(r_fsm_state) {
     case FSM_IDLE :
@@ -116,17 +209,38 @@ void PibusMultiTimer::transition()
         }
         break;
     case FSM_WRITE :
-	if      (r_cell == VALUE_ADDRESS)     	r_value[r_index] = (uint32_t)p_d.read();
-	else if (r_cell == IRQ_ADDRESS)  	r_irq[r_index] = ((uint32_t)p_d.read() != 0);
-        else if (r_cell == RUNNING_ADDRESS)   	r_running[r_index] = ((uint32_t)p_d.read() != 0);
+    {
+        size_t   i    = r_index.read();
+        uint32_t mask = 1 << i;
+        uint32_t data = (uint32_t)p_d.read();
+	if      (r_cell == VALUE_ADDRESS)     	m_value_offset[i] = data - (uint32_t)(m_cycles + 1);
+	else if (r_cell == IRQ_ADDRESS)  	
+        {
+            if (data != 0) irq = irq | mask;
+            else           irq = irq & ~mask;
+        }
+        else if (r_cell == RUNNING_ADDRESS)   	
+        {
+            if ((data != 0) and ((running & mask) == 0)) 
+            {
+                startTimer(i);
+                running = running | mask;
+            }
+            else if ((data == 0) and ((running & mask) != 0))
+            {
+                stopTimer(i);
+                running = running & ~mask;
+            }
+        }
 	else if (r_cell == PERIOD_ADDRESS) 
         {
-						r_period[r_index] = (uint32_t)p_d.read();
-						r_counter[r_index] = (uint32_t)p_d.read();
-						r_running[r_index] = false;
+            r_period[i]    = data;
+            m_remaining[i] = data;
+            running        = running & ~mask;
 	}
 	r_fsm_state = FSM_IDLE;
         break;
+    }
     case FSM_READ :
 	r_fsm_state = FSM_IDLE;
         break;
@@ -135,29 +249,55 @@ void PibusMultiTimer::transition()
         break;
     } // end switch TARGET FSM
 
-    // Increment r_value[i], decrement r_counter[i] & Set r_irq[i]
+    r_running = running;
+    r_irq     = irq | expired;
 
-    for(size_t i = 0 ; i < m_ntimer ; i++) 
+#ifdef PIBUS_CLOCK_GATING
+    // sleep until the next selection, reset, or timer deadline
+    if ( (r_fsm_state == FSM_IDLE) and not p_sel.read() )
     {
-	r_value[i] = r_value[i] + 1;
-	if (r_running[i]  == true) 
-        { 
-            if ( r_counter[i] > 0) 
+        if ( m_cycle == SC_ZERO_TIME )
+        {
+            sc_clock* clock = dynamic_cast<sc_clock*>( p_ck.get_interface() );
+            if ( clock ) m_cycle = clock->period();
+        }
+        if ( m_cycle != SC_ZERO_TIME )
+        {
+            m_sleep_transition = true;
+            m_sleep_time       = sc_time_stamp();
+            if ( m_events.empty() )
             {
-                r_counter[i] = r_counter[i] - 1;
-            } 
-            else 
+                next_trigger( p_sel.posedge_event() | p_resetn.negedge_event() |
+                              m_restore_event );
+            }
+            else	// woken up half a cycle before the deadline clock edge
             {
-                r_counter[i] = r_period[i];
-                r_irq[i] = true; 
+                double  ncycles = (double)(m_events.top().deadline - m_cycles) - 0.5;
+                next_trigger( m_cycle * ncycles, 
+                              p_sel.posedge_event() | p_resetn.negedge_event() |
+                              m_restore_event );
             }
-	} // end if timer running
-    } // end for
+        }
+    }
+#endif
 } // end transition()
 
 ////////////////////////////////
 void PibusMultiTimer::genMoore()
 {
+#ifdef PIBUS_CLOCK_GATING
+    // woken up by a FSM state change : wait the clock edge
+    if ( m_sleep_moore )
+    {
+        m_sleep_moore = false;
+        if ( not p_ck.negedge() )
+        {
+            next_trigger( p_ck.negedge_event() );
+            return;
+        }
+    }
+#endif
+
     // PIBUS signals 
 	switch (r_fsm_state) {
 	case FSM_IDLE :
@@ -167,27 +307,106 @@ void PibusMultiTimer::genMoore()
             break;
 	case FSM_READ :
 	    p_ack = PIBUS_ACK_READY;
-	    if      (r_cell == VALUE_ADDRESS)    p_d.write((uint32_t)r_value[r_index]); 
+	    if      (r_cell == VALUE_ADDRESS)    p_d.write((uint32_t)m_cycles + m_value_offset[r_index]); 
             else if (r_cell == PERIOD_ADDRESS)   p_d.write((uint32_t)r_period[r_index]);
-            else if (r_cell == RUNNING_ADDRESS)  p_d.write((uint32_t)r_running[r_index]); 
-            else if (r_cell == IRQ_ADDRESS)      p_d.write((uint32_t)r_irq[r_index]); 
+            else if (r_cell == RUNNING_ADDRESS)  p_d.write((r_running.read() >> r_index) & 0x1); 
+            else if (r_cell == IRQ_ADDRESS)      p_d.write((r_irq.read() >> r_index) & 0x1); 
             break;
 	case FSM_ERROR:
             p_ack = PIBUS_ACK_ERROR;
             break;
 	} // end switch FSM
 
-    // IRQ[i]
-    for (size_t i = 0 ; i < m_ntimer ; i++) p_irq[i] = r_irq[i]  && r_running[i];
+    // IRQ[i] : only the modified outputs are written
+    uint32_t irq     = r_irq.read() & r_running.read();
+    uint32_t changed = irq ^ m_irq_out;
+    while ( changed != 0 )
+    {
+        size_t i = __builtin_ctz(changed);
+        p_irq[i] = ((irq >> i) & 0x1) != 0;
+        changed  = changed & (changed - 1);
+    }
+    m_irq_out = irq;
+
+#ifdef PIBUS_CLOCK_GATING
+    // sleep until the FSM leaves the IDLE state, or the IRQs change
+    if ( r_fsm_state == FSM_IDLE )
+    {
+        m_sleep_moore = true;
+        next_trigger( r_fsm_state.value_changed_event() | 
+                      r_irq.value_changed_event() | 
+                      r_running.value_changed_event() );
+    }
+#endif
 
 } // end genMoore()
 	
+/////////////////////////////////////////
+bool PibusMultiTimer::checkpointReady()
+{
+    return (r_fsm_state == FSM_IDLE);
+}
+///////////////////////////////////////////////////////////////////
+void PibusMultiTimer::saveState(PibusCheckpointWriter &writer)
+{
+    writer.put(m_ntimer);
+    writer.put(m_cycles);
+    writer.put(r_fsm_state);
+    writer.put(r_running);
+    writer.put(r_irq);
+    writer.put(r_index);
+    writer.put(r_cell);
+    for (size_t i = 0 ; i < m_ntimer ; i++) writer.put(r_period[i]);
+    writer.putArray(m_value_offset, m_ntimer);
+    writer.putArray(m_deadline, m_ntimer);
+    writer.putArray(m_remaining, m_ntimer);
+}
+///////////////////////////////////////////////////////////////////
+// The sleeping transition() is woken up by m_restore_event.
+///////////////////////////////////////////////////////////////////
+void PibusMultiTimer::restoreState(PibusCheckpointReader &reader)
+{
+    size_t   ntimer;
+    uint32_t running;
+    reader.get(ntimer);
+    if (ntimer != m_ntimer)
+    {
+        printf(" ERROR in PibusMultiTimer component : %s\n",m_name);
+        printf(" The checkpoint number of timers does not match !\n");
+        exit(1);
+    }
+    reader.get(m_cycles);
+    reader.get(r_fsm_state);
+    reader.get(running);
+    reader.get(r_irq);
+    reader.get(r_index);
+    reader.get(r_cell);
+    for (size_t i = 0 ; i < m_ntimer ; i++) reader.get(r_period[i]);
+    reader.getArray(m_value_offset, m_ntimer);
+    reader.getArray(m_deadline, m_ntimer);
+    reader.getArray(m_remaining, m_ntimer);
+
+    r_running = running;
+
+    // the heap contains the deadlines of the running timers
+    m_events = std::priority_queue<TimerEvent, std::vector<TimerEvent>,
+                                   std::greater<TimerEvent> >();
+    for (size_t i = 0 ; i < m_ntimer ; i++)
+    {
+        if ((running & (1 << i)) == 0) continue;
+        TimerEvent event = { m_deadline[i], (uint32_t)i };
+        m_events.push(event);
+    }
+    m_restore_event.notify(sc_core::SC_ZERO_TIME);
+}
+
 //////////////////////////////////
 void PibusMultiTimer::printTrace()
 {
     std::cout << m_name << " : " << m_fsm_str[r_fsm_state] 
               << "   period[0] = " << r_period[0] 
-              << "   running[0] = " << r_running[0] << std::endl;
+              << "   running[0] = " << (r_running.read() & 0x1)
+              << "   pending deadlines = " << m_events.size() << std::endl;
 }
 
 }} // end namespace
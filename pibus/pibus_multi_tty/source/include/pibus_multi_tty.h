@@ -16,6 +16,14 @@
 // - TTY_READ   (0x8)	(read)  the key-board character 
 // - TTY_CONFIG (0xc)	(write) unused 
 //
+// Each terminal has also a multi-characters display FIFO, mapped
+// at offset TTY_FIFO (0x100) + 16 * index, that can be written by
+// single word write requests, or by bursts of up to 4 words :
+// - TTY_FIFO	(0x100)	(write) 4 characters to display
+// Each word contains 4 characters (byte 0 is displayed first), and
+// the null characters are not displayed. The FIFO registers are 
+// available if the segment size is at least 0x100 + 16 * ntty bytes.
+//
 // As a keyboard controler, it contains a TTY_READ register
 // to store the character corresponding to the stroken key.
 // Bit 0 of the TTY_STATUS register is 1 when TTY_READ is full. 
@@ -47,12 +55,46 @@
 // The constructor creates as many UNIX XTERM processes as
 // the number of emulated terminals. It creates a PTY pseudo-terminal 
 // for each XTERM supporting bi-directional inter-process communication.
+// In headless mode, no XTERM is created : the characters displayed 
+// on terminal [i] are written in the <name>_<i>.log file, and the
+// keyboards never receive characters.
+//
+// In buffered mode, the displayed characters are not written one by one
+// on the PTY (or log file), but stored in a per-terminal host buffer
+// (TTY_OBUF_SIZE bytes), that is flushed by a single system call on 
+// a new line character, when the buffer is full, or when the oldest
+// buffered character is older than a flush period (100000 cycles by
+// default, see the setFlushPeriod() method). All buffers are flushed
+// by the destructor.
+// The PTY is non blocking, and a stalled or closed XTERM never blocks
+// the simulation : in buffered mode, the characters not accepted by
+// the PTY are kept in the buffer and retried by the next flush, and
+// a character is dropped when the buffer is full. In unbuffered mode,
+// a character not accepted by the PTY is dropped. The dropped
+// characters are counted (drop_count counter).
+//
+// This component implements the PibusFunctionalTarget interface
+// (fast-forward mode). As the registers are only written by the
+// transition() method, a functional read of TTY_READ sets the
+// m_keyboard_ack[i] flag, and TTY_STATUS[i] is reset by the transition()
+// method at the next cycle.
+//
+// The following 64 bits counters can be registered in a PibusCounterRegistry
+// (registerCounters() method) : for each terminal, the displayed characters,
+// the received (keyboard) characters and the TTY_STATUS reads (polling),
+// the number of bus errors, and the number of host write() system calls.
+//
+// This component implements the PibusCheckpointable interface, and can
+// be checkpointed when the FSM is IDLE. The display buffers are flushed
+// when the checkpoint is saved, and are not part of the checkpoint.
 /////////////////////////////////////////////////////////////////////
-// This component has 4 "constructor" parameters :
+// This component has 6 "constructor" parameters :
 // - sc_module_name	name		: instance name  
 // - unsigned int	tgtid		: target index  
 // - PibusSegmentTable  segtab		: segment table
 // - unsigned int	ntty		: number of terminals
+// - bool		buffered	: buffered display (default = false)
+// - bool		headless	: log files instead of XTERMs (default = false)
 /////////////////////////////////////////////////////////////////////
 
 #ifndef PIBUS_MULTI_TTY_H
@@ -67,13 +109,22 @@
 #include <unistd.h>
 #include "pibus_segment_table.h"
 #include "pibus_mnemonics.h"
+#include "pibus_functional_bus.h"
+#include "pibus_counter_registry.h"
+#include "pibus_checkpoint.h"
 
 namespace soclib { namespace caba {
 
 using namespace sc_core;
 using namespace soclib::common;
 
-class PibusMultiTty : sc_module {
+class PibusMultiTty : sc_module, public PibusFunctionalTarget,
+                      public PibusCheckpointable {
+
+    // display buffer size (buffered mode)
+    enum {
+	TTY_OBUF_SIZE	= 4096,
+    };
 
     //	STRUTURAL PARAMETERS
     const char*			m_name;			// instance name
@@ -84,7 +135,27 @@ class PibusMultiTty : sc_module {
     const char*			m_segname;		// segment name
     pid_t			m_pid[16];		// Process ID table for XTERMs
     int				m_pty[16];		// File Descriptor table for PTYs
-    char			m_fsm_str[6][20];	// FSM states names
+    char			m_fsm_str[7][20];	// FSM states names
+    bool			m_keyboard_ack[16];	// functional read of TTY_READ (fast-forward mode)
+    bool			m_buffered;		// buffered display
+    bool			m_headless;		// log files instead of XTERMs
+    int				m_out[16];		// display File Descriptors (PTY or log file)
+    uint32_t			m_flush_period;		// buffers flush period (cycles)
+
+    //  DISPLAY BUFFERS (buffered mode)
+    char			m_obuf[16][TTY_OBUF_SIZE];	// display buffers
+    size_t			m_olen[16];		// number of buffered characters
+    size_t			m_obytes;		// total number of buffered characters
+    uint64_t			m_cycles;		// cycles since reset
+    uint64_t			m_flush_cycle;		// next flush cycle
+
+    //  INSTRUMENTATION
+    uint64_t			c_display_count[16];	// displayed characters
+    uint64_t			c_keyboard_count[16];	// received characters
+    uint64_t			c_status_count[16];	// TTY_STATUS reads
+    uint64_t			c_error_count;		// ERROR responses
+    uint64_t			c_write_calls;		// host write() system calls
+    uint64_t			c_drop_count;		// characters dropped (PTY full)
 
     //	REGISTERS
     sc_register<int>		r_fsm_state;		// FSM state
@@ -95,6 +166,11 @@ class PibusMultiTty : sc_module {
     sc_register<bool>		r_display_msk[16];	// Display Status Register (true when IRQ enable)
     sc_register<uint32_t>	r_keyboard_buf[16];	// Keyboard Character Buffer (ASCII code)
 
+    size_t hostWrite(size_t index, const char* buf, size_t len);
+    void display(size_t index, char c);
+    void displayWord(size_t index, uint32_t word);
+    void flush(size_t index);
+
 protected:
 
     SC_HAS_PROCESS(PibusMultiTty);
@@ -107,8 +183,10 @@ public:
 	TTY_STATUS	= 0x4,
 	TTY_READ	= 0x8,
 	TTY_CONFIG	= 0xC,
+	TTY_FIFO	= 0x100,
     };
 
+
     // FSM STATES
     enum { 
         FSM_IDLE   	= 0x0,
@@ -117,6 +195,7 @@ public:
         FSM_KEYBOARD  	= 0x3,
         FSM_CONFIG    	= 0x4,
         FSM_ERROR    	= 0x5,
+        FSM_FIFO    	= 0x6,
     };
 
     //	IO PORTS
@@ -136,7 +215,9 @@ public:
     PibusMultiTty(sc_module_name 	name,
 		unsigned int    	index, 
 		PibusSegmentTable	&segtab,
-		unsigned int		ntty);
+		unsigned int		ntty,
+		bool			buffered = false,
+		bool			headless = false);
 
     ~PibusMultiTty();
 
@@ -144,6 +225,17 @@ public:
     void transition();
     void genMoore();
     void printTrace();
+    void registerCounters(PibusCounterRegistry &registry);
+    void setFlushPeriod(uint32_t cycles) { m_flush_period = cycles; }
+
+    // functional access (fast-forward mode)
+    bool functionalRead(uint32_t address, uint32_t* data, uint32_t opc, size_t burst);
+    bool functionalWrite(uint32_t address, const uint32_t* data, uint32_t opc, size_t burst);
+
+    // checkpoint
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
 
 #ifdef SOCVIEW
     void registerDebug( SocviewDebugger db);
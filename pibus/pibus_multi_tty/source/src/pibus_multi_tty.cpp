@@ -59,10 +59,15 @@ static int getmpt()
 PibusMultiTty::PibusMultiTty(sc_module_name 	 	name,
 				unsigned int                  tgtid,
 				PibusSegmentTable	&segtab,
-				unsigned int     		ntty)
+				unsigned int     		ntty,
+				bool				buffered,
+				bool				headless)
     : m_name(name),
       m_tgtid(tgtid),
       m_ntty(ntty),
+      m_buffered(buffered),
+      m_headless(headless),
+      m_flush_period(100000),
       p_ck("p_ck"),
       p_resetn("p_resetn"),
       p_sel("p_sel"),
@@ -87,9 +92,21 @@ PibusMultiTty::PibusMultiTty(sc_module_name 	 	name,
     strcpy (m_fsm_str[3], "KEYBOARD");
     strcpy (m_fsm_str[4], "CONFIG");
     strcpy (m_fsm_str[5], "ERROR");
+    strcpy (m_fsm_str[6], "FIFO");
+
+    for(size_t i = 0 ; i < 16 ; i++) 
+    {
+        m_keyboard_ack[i] = false;
+        m_olen[i]         = 0;
+    }
+    m_obytes      = 0;
+    m_cycles      = 0;
+    m_flush_cycle = 0;
+    c_write_calls = 0;
+    c_drop_count  = 0;
 
     // get the base address and segment size 
-    std::list<SegmentTableEntry> seglist = segtab.getTargetSegmentList(tgtid);
+    const std::list<SegmentTableEntry> &seglist = segtab.getTargetSegmentList(tgtid);
     m_segbase = (*seglist.begin()).getBase(); 
     m_segsize = (*seglist.begin()).getSize(); 
     m_segname = (*seglist.begin()).getName(); 
@@ -121,6 +138,23 @@ PibusMultiTty::PibusMultiTty(sc_module_name 	 	name,
 	char	xterm_name[40];
 	snprintf(xterm_name, 40, "%s_%d", m_name, index);
 
+    // headless mode : create the log file
+        if (m_headless)
+        {
+            char log_name[48];
+            snprintf(log_name, 48, "%s.log", xterm_name);
+            m_pty[index] = -1;
+            m_pid[index] = -1;
+            m_out[index] = open(log_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (m_out[index] < 0)
+            {
+                printf(" ERROR in PibusMultiTty component : %s\n", m_name);
+                printf(" The log file %s cannot be open !\n", log_name);
+                exit(1); 
+            }
+            continue;
+        }
+
     // create PTY
 	if((m_pty[index] = getmpt()) < 0) 
         {
@@ -191,11 +225,14 @@ PibusMultiTty::PibusMultiTty(sc_module_name 	 	name,
             // The last char we want to strip is not always present,
             // so dont block if not here
             read( m_pty[index], &buf, 1 ); 
+            m_out[index] = m_pty[index];
         }
     } // end for m_ntty
 
     std::cout << std::endl << "Instanciation of PibusMultiTty : " << m_name << std::endl;
     std::cout << "    ntty = " << m_ntty << std::endl;
+    if (m_buffered) std::cout << "    buffered display" << std::endl;
+    if (m_headless) std::cout << "    headless (log files)" << std::endl;
     std::cout << "    segment " << m_segname << std::hex 
                   << " | base = 0x" << m_segbase
                   << " | size = 0x" << m_segsize << std::endl;
@@ -207,10 +244,87 @@ PibusMultiTty::~PibusMultiTty()
 {
     for(uint32_t i = 0 ; i < m_ntty ; i++) 
     {
-        kill(m_pid[i],SIGTERM);
+        flush(i);
+        if (m_headless) close(m_out[i]);
+        else            kill(m_pid[i],SIGTERM);
     }
 } // end destructor
 
+/////////////////////////////////////////////////////////////////
+// This function writes at most len characters on the PTY (or log
+// file) of terminal [index], and returns the number of written
+// characters. The PTY is non blocking : the write is only retried
+// when interrupted, and stops when the PTY is full (stalled or
+// closed XTERM), so the simulation is never blocked.
+/////////////////////////////////////////////////////////////////
+size_t PibusMultiTty::hostWrite(size_t index, const char* buf, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = write(m_out[index], buf + done, len - done);
+        c_write_calls++;
+        if (n > 0)                                done = done + n;
+        else if ((n < 0) && (errno == EINTR))     continue;
+        else                                      break;	// PTY full
+    }
+    return done;
+} // end hostWrite()
+
+/////////////////////////////////////////////////////////////////
+// This function flushes the display buffer of terminal [index].
+// The characters that are not accepted by the PTY are kept in
+// the buffer, and retried by the next flush.
+/////////////////////////////////////////////////////////////////
+void PibusMultiTty::flush(size_t index)
+{
+    if (m_olen[index] == 0) return;
+    size_t n = hostWrite(index, m_obuf[index], m_olen[index]);
+    if (n < m_olen[index]) 
+    {
+        memmove(m_obuf[index], m_obuf[index] + n, m_olen[index] - n);
+        m_flush_cycle = m_cycles + m_flush_period;
+    }
+    m_obytes      = m_obytes - n;
+    m_olen[index] = m_olen[index] - n;
+} // end flush()
+
+/////////////////////////////////////////////////////////////////
+// This function displays one character on terminal [index].
+/////////////////////////////////////////////////////////////////
+void PibusMultiTty::display(size_t index, char c)
+{
+    c_display_count[index]++;
+    if (not m_buffered)
+    {
+        if (hostWrite(index, &c, 1) == 0) c_drop_count++;
+        return;
+    }
+    if (m_olen[index] == TTY_OBUF_SIZE)	// PTY full and buffer full
+    {
+        c_drop_count++;
+        return;
+    }
+    if (m_obytes == 0) m_flush_cycle = m_cycles + m_flush_period;
+    m_obuf[index][m_olen[index]] = c;
+    m_olen[index]++;
+    m_obytes++;
+    if ((c == '\n') || (m_olen[index] == TTY_OBUF_SIZE)) flush(index);
+} // end display()
+
+/////////////////////////////////////////////////////////////////
+// This function displays the (non null) characters of a word
+// written in the TTY_FIFO register of terminal [index].
+/////////////////////////////////////////////////////////////////
+void PibusMultiTty::displayWord(size_t index, uint32_t word)
+{
+    for(size_t b = 0 ; b < 4 ; b++) 
+    {
+        char c = (char)((word >> (8*b)) & 0xFF);
+        if (c != 0) display(index, c);
+    }
+} // end displayWord()
+
 /////////////////////////////////
 void PibusMultiTty::transition()
 {
@@ -226,17 +340,34 @@ void PibusMultiTty::transition()
             r_display_sts[i] = false;   // buffer empty
             r_keyboard_msk[i] = true;   // IRQ enable
             r_display_msk[i] = false;   // IRQ disable
+            m_keyboard_ack[i] = false;
+            c_display_count[i]  = 0;
+            c_keyboard_count[i] = 0;
+            c_status_count[i]   = 0;
         }
+        c_error_count = 0;
+        c_write_calls = 0;
+        c_drop_count  = 0;
         return;
     } // end p_resetn
 
+    m_cycles++;
+
     // The p_sel signal is taken into account in all FSM state,
     // All states have all the same next state
     if (p_sel == true) 
     {
         address = (uint32_t)p_a.read();
+        uint32_t offset = address - m_segbase;
         r_index   = (address >> 4 ) & 0xf;
         if ((address < m_segbase) || (address >= (m_segbase + m_segsize)))  	r_fsm_state = FSM_ERROR; 
+        else if (offset >= TTY_FIFO)
+        {
+            r_index = (offset - TTY_FIFO) >> 4;
+            if ((((offset - TTY_FIFO) >> 4) < m_ntty) && (p_read == false))	r_fsm_state = FSM_FIFO;
+            else								r_fsm_state = FSM_ERROR;
+        }
+        else if ((offset >> 4) >= m_ntty)					r_fsm_state = FSM_ERROR; 
         else if (((address & 0xC) == TTY_WRITE) && (p_read == false))  		r_fsm_state = FSM_DISPLAY;  
         else if (((address & 0xC) == TTY_STATUS) && (p_read == true))  		r_fsm_state = FSM_STATUS;  
         else if (((address & 0xC) == TTY_READ) && (p_read == true))  		r_fsm_state = FSM_KEYBOARD;  
@@ -252,14 +383,34 @@ void PibusMultiTty::transition()
     if(r_fsm_state == FSM_DISPLAY) 
     {
         data   = (char)(p_d.read()  & 0x000000FF);
-        write(m_pty[r_index], &data, 1);
+        display(r_index, data);
     }
+    if(r_fsm_state == FSM_FIFO) displayWord(r_index, (uint32_t)p_d.read());
+
+    // flush the display buffers on time
+    if((m_obytes != 0) && (m_cycles >= m_flush_cycle)) 
+    {
+        for(size_t i = 0 ; i < m_ntty ; i++) flush(i);
+    }
+
+    if(r_fsm_state == FSM_STATUS) c_status_count[r_index]++;
+    if(r_fsm_state == FSM_ERROR)  c_error_count++;
 
     // reset keyboard status
     if(r_fsm_state == FSM_KEYBOARD) r_keyboard_sts[r_index] = false;
+
+    // reset keyboard status after a functional read 
+    for(size_t i = 0 ; i < m_ntty ; i++) 
+    {
+        if(m_keyboard_ack[i]) 
+        {
+            r_keyboard_sts[i] = false;
+            m_keyboard_ack[i] = false;
+        }
+    }
     
     // scan all m_pty inputs
-    for(size_t i = 0 ; i < m_ntty ; i++) 
+    for(size_t i = 0 ; (i < m_ntty) && not m_headless ; i++) 
     {
         if((r_keyboard_sts[i] == false) && (r_fsm_state != FSM_KEYBOARD)) 
         {
@@ -273,6 +424,7 @@ void PibusMultiTty::transition()
 		if(data == 0x0d) read(m_pty[i], &data, 1); 
                 r_keyboard_sts[i] = true;
                 r_keyboard_buf[i] = (uint32_t)data;
+                c_keyboard_count[i]++;
             }
 	}
     } // end for
@@ -287,6 +439,7 @@ void PibusMultiTty::genMoore()
         break;
     case FSM_DISPLAY :
     case FSM_CONFIG : 
+    case FSM_FIFO : 
         p_ack = PIBUS_ACK_READY;
         break;
     case FSM_STATUS : 
@@ -313,6 +466,61 @@ void PibusMultiTty::genMoore()
     }
 } // end genMoore()
 
+//////////////////////////////////////////////////////////////
+bool PibusMultiTty::functionalRead(uint32_t	address,
+				   uint32_t*	data,
+				   uint32_t	opc,
+				   size_t	burst)
+{
+    for(size_t i = 0 ; i < burst ; i++) 
+    {
+        uint32_t addr  = address + 4*i;
+        size_t   index = (addr >> 4) & 0xf;
+        if ((addr < m_segbase) || (addr >= (m_segbase + m_segsize))) return false;
+        // the character is consumed if m_keyboard_ack is set 
+        bool     full  = r_keyboard_sts[index] && !m_keyboard_ack[index];
+        if ((addr & 0xC) == TTY_STATUS) 
+        {
+            data[i] = (full ? 0x1 : 0x0) | (r_display_sts[index] ? 0x2 : 0x0);
+            c_status_count[index]++;
+        }
+        else if ((addr & 0xC) == TTY_READ) 
+        {
+            data[i] = (uint32_t)r_keyboard_buf[index];
+            if (full) m_keyboard_ack[index] = true;
+        }
+        else return false;
+    }
+    return true;
+} // end functionalRead()
+
+//////////////////////////////////////////////////////////////
+bool PibusMultiTty::functionalWrite(uint32_t		address,
+				    const uint32_t*	data,
+				    uint32_t		opc,
+				    size_t		burst)
+{
+    for(size_t i = 0 ; i < burst ; i++) 
+    {
+        uint32_t addr  = address + 4*i;
+        size_t   index = (addr >> 4) & 0xf;
+        if ((addr < m_segbase) || (addr >= (m_segbase + m_segsize))) return false;
+        if ((addr - m_segbase) >= TTY_FIFO)
+        {
+            index = (addr - m_segbase - TTY_FIFO) >> 4;
+            if (index >= m_ntty) return false;
+            displayWord(index, data[i]);
+        }
+        else if (((addr - m_segbase) >> 4) >= m_ntty) return false;
+        else if ((addr & 0xC) == TTY_WRITE) 
+        {
+            display(index, (char)(data[i] & 0x000000FF));
+        }
+        else if ((addr & 0xC) != TTY_CONFIG) return false;
+    }
+    return true;
+} // end functionalWrite()
+
 ////////////////////////////////
 void PibusMultiTty::printTrace()
 {
@@ -321,4 +529,68 @@ void PibusMultiTty::printTrace()
                         << "   display status[0] = "  << r_display_sts[0] << std::endl;
 }
 
+////////////////////////////////////////////////////////////////////
+void PibusMultiTty::registerCounters(PibusCounterRegistry &registry)
+{
+    char name[32];
+    for(size_t i = 0 ; i < m_ntty ; i++) 
+    {
+        snprintf(name, 32, "display_count_%d", (int)i);
+        registry.add(m_name, name, &c_display_count[i]);
+        snprintf(name, 32, "keyboard_count_%d", (int)i);
+        registry.add(m_name, name, &c_keyboard_count[i]);
+        snprintf(name, 32, "status_count_%d", (int)i);
+        registry.add(m_name, name, &c_status_count[i]);
+    }
+    registry.add(m_name, "error_count", &c_error_count);
+    registry.add(m_name, "write_calls", &c_write_calls);
+    registry.add(m_name, "drop_count",  &c_drop_count);
+}
+
+///////////////////////////////////////
+bool PibusMultiTty::checkpointReady()
+{
+    return (r_fsm_state == FSM_IDLE);
+}
+/////////////////////////////////////////////////////////////////
+void PibusMultiTty::saveState(PibusCheckpointWriter &writer)
+{
+    writer.put(m_ntty);
+    writer.put(r_fsm_state);
+    writer.put(r_index);
+    for (size_t i = 0 ; i < m_ntty ; i++)
+    {
+        flush(i);
+        writer.put(r_keyboard_sts[i]);
+        writer.put(r_keyboard_msk[i]);
+        writer.put(r_display_sts[i]);
+        writer.put(r_display_msk[i]);
+        writer.put(r_keyboard_buf[i]);
+        writer.put(m_keyboard_ack[i]);
+    }
+}
+/////////////////////////////////////////////////////////////////
+void PibusMultiTty::restoreState(PibusCheckpointReader &reader)
+{
+    size_t ntty;
+    reader.get(ntty);
+    if (ntty != m_ntty)
+    {
+	printf(" ERROR in PibusMultiTty component : %s\n",m_name);
+	printf(" The checkpoint number of terminals does not match\n");
+	exit(1);
+    }
+    reader.get(r_fsm_state);
+    reader.get(r_index);
+    for (size_t i = 0 ; i < m_ntty ; i++)
+    {
+        reader.get(r_keyboard_sts[i]);
+        reader.get(r_keyboard_msk[i]);
+        reader.get(r_display_sts[i]);
+        reader.get(r_display_msk[i]);
+        reader.get(r_keyboard_buf[i]);
+        reader.get(m_keyboard_ack[i]);
+    }
+}
+
 }} // end namespaces
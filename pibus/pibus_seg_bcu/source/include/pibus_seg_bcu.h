@@ -14,23 +14,64 @@
 // - The default master mechanism is not supported.
 // - Only four values are supported for the ACK signal:
 //   READY, WAIT, ERROR, RETRY.
-// - The arbitration policy between masters is round-robin.
 // The bus is granted to a new master in the FSM_IDLE state 
 // (the bus is not used), and in the FSM_DT state (last cycle 
 // of a transaction) when the ACK signal is not PI_ACK-WAT.
-// The COUNT_REQ[i] register counts the total number of transaction 
-// requests for master i. The COUNT_WAIT[i] register counts the total
-// number of wait cycles for master i.
+// A target supporting split transactions can answer RETRY to the
+// first address of a burst (FSM_DTAD state) : the transaction is
+// aborted, and the bus is immediately granted to a new master.
+// The master must retry the complete transaction later.
+// The arbitration policy between masters is a constructor parameter,
+// and uses the per-master WEIGHT[i] parameters (default value is 1) :
+// - BCU_ROUND_ROBIN    : round-robin (default policy).
+// - BCU_FIXED_PRIORITY : the requesting master with the largest
+//   WEIGHT[i] is selected. In case of equality, the smallest index wins.
+// - BCU_WEIGHTED_RR    : the current master keeps the bus for at most
+//   WEIGHT[i] successive transactions (CREDIT[i] registers), and the 
+//   other masters are selected in round-robin order. When no requesting
+//   master has credit, all credits are reloaded.
+// - BCU_TOKEN          : each master receives WEIGHT[i] tokens every
+//   PERIOD cycles (the tokens are not accumulated), and a transaction
+//   consumes one token. The requesting masters with tokens are
+//   selected in round-robin order, and the masters without token are
+//   only selected when no requesting master has tokens.
+// The COUNT_REQ[i] counter counts the total number of transaction 
+// requests for master i. The COUNT_WAIT[i] counter counts the total
+// number of wait cycles for master i. The distribution of the
+// arbitration latency (number of request cycles before the bus is 
+// granted) is registered in a PibusHistogram for each master.
+// The following instrumentation is also registered :
+// - transaction duration (from FSM_AD to the last FSM_DT cycle),
+// - burst length (number of data cycles with ACK != WAIT),
+// - per-target occupancy (busy cycles and number of transactions),
+// - bus utilization : the number of busy cycles (FSM_AD, FSM_DTAD
+//   or FSM_DT states) is registered for each time window of WINDOW 
+//   cycles. The utilization trace can be exported in CSV format
+//   (printCsv() method), and all statistics in JSON format 
+//   (printJson() method).
+// The 64 bits counters can be registered in a PibusCounterRegistry
+// (registerCounters() method) to be sampled during the simulation.
+// A PibusTraceRecorder can be attached (setTraceRecorder() method) to
+// record one binary record per transaction (cycle, master, target,
+// address, burst length, arbitration latency, duration, ack). As the
+// OPC and READ signals are not BCU ports, the optional opc & read
+// arguments are pointers on the corresponding PIBUS signals.
+// This component implements the PibusCheckpointable interface, and
+// can be checkpointed when the FSM is IDLE.
 // This component use the Segment Table to build the Target ROM table, 
 // that decode the address MSB bits and gives the the selected target 
 // index to generate the SEL[i] signals.
 //////////////////////////////////////////////////////////////////////////
-// This component has 5 "constructor" parameters :
+// This component has 9 "constructor" parameters :
 // - sc_module_name	name		: instance name
 // - pibusSegmentTable	segtab		: segment table
 // - int 		nb_master       : number of PIBUS masters   
 // - int 		nb_slave        : number of PIBUS slaves  
 // - int 		time_out	: max wait cycles (default = 100)
+// - int		policy		: arbitration policy (default = BCU_ROUND_ROBIN)
+// - uint32_t*		weights		: per master weights (default = NULL)
+// - uint32_t		period		: tokens period (default = 1000)
+// - uint32_t		window		: utilization window (default = 10000)
 //////////////////////////////////////////////////////////////////////////
 
 #ifndef PIBUS_BCU_H_
@@ -38,14 +79,20 @@
 
 #include <systemc>
 #include <inttypes.h>
+#include <vector>
+#include <iostream>
 #include "pibus_segment_table.h"
 #include "pibus_mnemonics.h"
+#include "pibus_histogram.h"
+#include "pibus_counter_registry.h"
+#include "pibus_trace_recorder.h"
+#include "pibus_checkpoint.h"
 
 
 namespace soclib { namespace caba {
 
 ////////////////////////////////////////
-class PibusSegBcu : sc_core::sc_module {
+class PibusSegBcu : sc_core::sc_module, public PibusCheckpointable {
 
 	// 	FSM states
 	enum fms_state_e 
@@ -59,25 +106,67 @@ class PibusSegBcu : sc_core::sc_module {
 	//	STRUCTURAL PARAMETERS
         const char*			m_name;			// instance name
 	const size_t* 			m_target_table;		// MSB to tgtid trancoding ROM
-	const size_t 			m_msb_shift;		// 32 - MSB_bits_number
 	const size_t 			m_nb_master;		// number of connected masters
 	const size_t 			m_nb_target;		// number of connected targets
 	const uint32_t 			m_time_out;		// number of cycles before time-out
         char				m_fsm_str[4][20];	// FSM states names
+	const int			m_policy;		// arbitration policy
+	uint32_t*			m_weights;		// per master weights
+	const uint32_t			m_period;		// tokens period (BCU_TOKEN)
+	bool				m_token_refill;		// tokens reloaded in the current cycle
+	uint32_t*			m_req_wait;		// current request cycles (per master)
+	PibusHistogram*			m_latency;		// arbitration latency (per master)
+	const uint32_t			m_window;		// utilization window (cycles)
+
+	//	INSTRUMENTATION
+	size_t				m_current_target;	// target of the current transaction
+	uint32_t			m_trans_cycles;		// current transaction duration
+	uint32_t			m_trans_words;		// current transaction burst length
+	PibusHistogram			m_duration;		// transaction duration
+	PibusHistogram			m_burst;		// burst length
+	uint64_t*			c_req_count;		// number of requests (per master)
+	uint64_t*			c_wait_count;		// number of wait cycles (per master)
+	uint64_t*			c_target_busy;		// busy cycles (per target)
+	uint64_t*			c_target_trans;		// number of transactions (per target)
+	uint64_t			c_total_cycles;		// number of cycles
+	uint64_t			c_busy_cycles;		// number of busy cycles
+	uint64_t			c_retry_count;		// number of RETRY responses
+	uint32_t			m_window_cycles;	// cycles in the current window
+	uint32_t			m_window_busy;		// busy cycles in the current window
+	std::vector<uint32_t>		m_window_trace;		// busy cycles (per completed window)
+	PibusTraceRecorder*		m_trace;		// transaction recorder (NULL if not used)
+	const sc_core::sc_signal<uint32_t>*	m_trace_opc;	// PIBUS OPC signal (for the recorder)
+	const sc_core::sc_signal<bool>*		m_trace_read;	// PIBUS READ signal (for the recorder)
+	PibusTraceRecord		m_trace_record;		// current transaction record
 
 	// 	REGISTERS
 	sc_register<int> 		r_fsm_state;		// FSM state
 	sc_register<size_t>		r_current_master;	// current master index
 	sc_register<uint32_t>		r_tout_counter;		// time-out counter
-	sc_register<uint32_t>*		r_req_counter;		// number of requests (per master)
-	sc_register<uint32_t>*		r_wait_counter;		// number of wait cycles (per master)
+	sc_register<uint32_t>*		r_credit;		// remaining grants (BCU_WEIGHTED_RR)
+	sc_register<uint32_t>*		r_tokens;		// remaining tokens (BCU_TOKEN)
+	sc_register<uint32_t>		r_token_timer;		// cycles before tokens reload (BCU_TOKEN)
 
 protected:
 
 	SC_HAS_PROCESS(PibusSegBcu);
 
+	size_t selectMaster();
+	void grantMaster(size_t index);
+	void endTransaction();
+	bool isReleased();
+	void newAllocation();
+
 public:
 
+	//	ARBITRATION POLICIES
+	enum {
+	BCU_ROUND_ROBIN		= 0,
+	BCU_FIXED_PRIORITY	= 1,
+	BCU_WEIGHTED_RR		= 2,
+	BCU_TOKEN		= 3,
+	};
+
 	//	I/O PORTS
 	sc_core::sc_in<bool>  		p_ck;	 
 	sc_core::sc_in<bool>  		p_resetn;  
@@ -95,7 +184,11 @@ public:
 	             soclib::common::PibusSegmentTable       	&segtab,
 		     size_t					nb_master,
 		     size_t					nb_slave,
-		     uint32_t					time_out = 1000000000);
+		     uint32_t					time_out = 1000000000,
+		     int					policy = BCU_ROUND_ROBIN,
+		     const uint32_t*				weights = NULL,
+		     uint32_t					period = 1000,
+		     uint32_t					window = 10000);
 	~PibusSegBcu();
 
 	// 	METHODS
@@ -105,6 +198,17 @@ public:
 	void genMoore();
         void printTrace();
         void printStatistics();
+        void printCsv(std::ostream &o);
+        void printJson(std::ostream &o);
+        void registerCounters(PibusCounterRegistry &registry);
+        void setTraceRecorder(PibusTraceRecorder *recorder,
+                              const sc_core::sc_signal<uint32_t> *opc = NULL,
+                              const sc_core::sc_signal<bool> *read = NULL);
+
+	// 	CHECKPOINT
+        bool checkpointReady();
+        void saveState(PibusCheckpointWriter &writer);
+        void restoreState(PibusCheckpointReader &reader);
 
 #ifdef SOCVIEW
         void registerDebug( SocviewDebugger db );
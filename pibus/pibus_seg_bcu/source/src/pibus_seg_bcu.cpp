@@ -9,6 +9,7 @@
 #include "pibus_seg_bcu.h"
 #include "alloc_elems.h"
 #include <string.h>
+#include <stdio.h>
 namespace soclib { namespace caba {
 
 using namespace sc_core;
@@ -20,18 +21,37 @@ PibusSegBcu::PibusSegBcu (	sc_module_name 			name,
                             PibusSegmentTable 	    &segtab,
                             size_t 					nb_master,
                             size_t 					nb_target,
-                            uint32_t 				time_out)
+                            uint32_t 				time_out,
+                            int 					policy,
+                            const uint32_t* 		weights,
+                            uint32_t 				period,
+                            uint32_t 				window)
 	: m_name(name),
-      m_target_table(segtab.getTargetTable()),
-      m_msb_shift( 32 - segtab.getMSBnumber() ),
+      m_target_table(segtab.getDecodeRom().getTargetTable()),
       m_nb_master(nb_master),
       m_nb_target(nb_target),
       m_time_out(time_out),
+      m_policy(policy),
+      m_period(period),
+      m_token_refill(false),
+      m_window(window),
+      m_current_target(0),
+      m_trans_cycles(0),
+      m_trans_words(0),
+      c_total_cycles(0),
+      c_busy_cycles(0),
+      c_retry_count(0),
+      m_window_cycles(0),
+      m_window_busy(0),
+      m_trace(NULL),
+      m_trace_opc(NULL),
+      m_trace_read(NULL),
       r_fsm_state("r_fsm_state"),
       r_current_master("r_current_master"),
       r_tout_counter("r_tout_counter"),
-      r_req_counter(soclib::common::alloc_elems<sc_signal<uint32_t> >("r_req_counter", nb_master)),
-      r_wait_counter(soclib::common::alloc_elems<sc_signal<uint32_t> >("r_wait_counter", nb_master)),
+      r_credit(soclib::common::alloc_elems<sc_signal<uint32_t> >("r_credit", nb_master)),
+      r_tokens(soclib::common::alloc_elems<sc_signal<uint32_t> >("r_tokens", nb_master)),
+      r_token_timer("r_token_timer"),
       p_ck("p_ck"),
       p_resetn("p_resetn"),
       p_req(soclib::common::alloc_elems<sc_in<bool> >("p_req", nb_master)),
@@ -78,10 +98,65 @@ PibusSegBcu::PibusSegBcu (	sc_module_name 			name,
         exit(0);
     }
 
+	if ((policy < BCU_ROUND_ROBIN) || (policy > BCU_TOKEN)) 
+    {
+	    std::cout << "ERROR in PibusSegBcu Component" << std::endl;
+        std::cout << "Illegal arbitration policy argument" << std::endl;
+        exit(0);
+    }
+
+	if ((policy == BCU_TOKEN) && (period == 0)) 
+    {
+	    std::cout << "ERROR in PibusSegBcu Component" << std::endl;
+        std::cout << "Period argument cannot be 0" << std::endl;
+        exit(0);
+    }
+
+	if (window == 0) 
+    {
+	    std::cout << "ERROR in PibusSegBcu Component" << std::endl;
+        std::cout << "Window argument cannot be 0" << std::endl;
+        exit(0);
+    }
+
+    c_target_busy  = new uint64_t[nb_target];
+    c_target_trans = new uint64_t[nb_target];
+    for (size_t t = 0 ; t < nb_target ; t++)
+    {
+        c_target_busy[t]  = 0;
+        c_target_trans[t] = 0;
+    }
+
+    c_req_count  = new uint64_t[nb_master];
+    c_wait_count = new uint64_t[nb_master];
+    for (size_t i = 0 ; i < nb_master ; i++)
+    {
+        c_req_count[i]  = 0;
+        c_wait_count[i] = 0;
+    }
+
+    m_weights  = new uint32_t[nb_master];
+    m_req_wait = new uint32_t[nb_master];
+    m_latency  = new PibusHistogram[nb_master];
+    for (size_t i = 0 ; i < nb_master ; i++)
+    {
+        m_weights[i]  = (weights == NULL) ? 1 : weights[i];
+        m_req_wait[i] = 0;
+        if ((m_weights[i] == 0) && (policy != BCU_FIXED_PRIORITY))
+        {
+	        std::cout << "ERROR in PibusSegBcu Component" << std::endl;
+            std::cout << "Weight of master " << i << " cannot be 0" << std::endl;
+            exit(0);
+        }
+    }
+
+    memset(&m_trace_record, 0, sizeof(m_trace_record));
+
     std::cout << std::endl << "Instanciation of PibuBcu : " << m_name << std::endl;
     std::cout << "    nb_master = " << m_nb_master << std::endl;
     std::cout << "    nb_target = " << m_nb_target << std::endl;
     std::cout << "    time_out  = " << m_time_out  << std::endl;
+    std::cout << "    policy    = " << m_policy    << std::endl;
 
 }
 
@@ -90,10 +165,147 @@ PibusSegBcu::~PibusSegBcu()
     soclib::common::dealloc_elems(p_req, m_nb_master);
     soclib::common::dealloc_elems(p_gnt, m_nb_master);
     soclib::common::dealloc_elems(p_sel, m_nb_target);
-    soclib::common::dealloc_elems(r_req_counter, m_nb_master);
-    soclib::common::dealloc_elems(r_wait_counter, m_nb_master);
+    soclib::common::dealloc_elems(r_credit, m_nb_master);
+    soclib::common::dealloc_elems(r_tokens, m_nb_master);
+    delete [] m_weights;
+    delete [] m_req_wait;
+    delete [] m_latency;
+    delete [] c_req_count;
+    delete [] c_wait_count;
+    delete [] c_target_busy;
+    delete [] c_target_trans;
 }
 
+/////////////////////////////////////////////////////////////
+// This function returns the index of the master selected
+// by the arbitration policy, or m_nb_master if there is
+// no request. It does not modify the registers.
+/////////////////////////////////////////////////////////////
+size_t PibusSegBcu::selectMaster()
+{
+    size_t current = r_current_master.read();
+
+    switch(m_policy) {
+    case BCU_FIXED_PRIORITY:
+    {
+        size_t selected = m_nb_master;
+        for(size_t i = 0 ; i < m_nb_master ; i++) 
+        {
+            if( p_req[i] && ((selected == m_nb_master) || (m_weights[i] > m_weights[selected])) ) 
+                selected = i;
+        }
+        return selected;
+    }
+    case BCU_WEIGHTED_RR:
+    {
+        if( p_req[current] && (r_credit[current].read() > 0) ) return current;
+        for(size_t i = 0 ; i < m_nb_master ; i++) 
+        {
+            size_t j = (i + 1 + current) % m_nb_master;
+            if( p_req[j] && (r_credit[j].read() > 0) ) return j;
+        }
+        break;  // no credit : round-robin, and credits reload
+    }
+    case BCU_TOKEN:
+    {
+        for(size_t i = 0 ; i < m_nb_master ; i++) 
+        {
+            size_t j = (i + 1 + current) % m_nb_master;
+            if( p_req[j] && (r_tokens[j].read() > 0) ) return j;
+        }
+        break;  // no token : round-robin
+    }
+    } // end switch policy
+
+    for(size_t i = 0 ; i < m_nb_master ; i++) 
+    {
+        size_t j = (i + 1 + current) % m_nb_master;
+        if( p_req[j] ) return j;
+    }
+    return m_nb_master;
+} // end selectMaster()
+
+//////////////////////////////////////////////
+// registers update when master j is granted
+//////////////////////////////////////////////
+void PibusSegBcu::grantMaster(size_t j)
+{
+    r_current_master = j;
+    c_req_count[j]++;
+
+    m_latency[j].add(m_req_wait[j]);
+    m_trace_record.master = j;
+    m_trace_record.wait   = m_req_wait[j];
+    m_req_wait[j] = 0;
+
+    if( m_policy == BCU_WEIGHTED_RR )
+    {
+        if( r_credit[j].read() > 0 ) 
+        {
+            r_credit[j] = r_credit[j].read() - 1;
+        }
+        else    // credits reload
+        {
+            for(size_t i = 0 ; i < m_nb_master ; i++) r_credit[i] = m_weights[i];
+            r_credit[j] = m_weights[j] - 1;
+        }
+    }
+    if( m_policy == BCU_TOKEN )
+    {
+        uint32_t tokens = m_token_refill ? m_weights[j] : r_tokens[j].read();
+        if( tokens > 0 ) r_tokens[j] = tokens - 1;
+    }
+} // end grantMaster()
+
+/////////////////////////////////////////////////
+// instrumentation update at the last cycle of
+// a transaction (including the time-out)
+/////////////////////////////////////////////////
+void PibusSegBcu::endTransaction()
+{
+    m_duration.add(m_trans_cycles);
+    m_burst.add(m_trans_words);
+    c_target_trans[m_current_target]++;
+    if( m_trace != NULL )
+    {
+        m_trace_record.burst    = m_trans_words;
+        m_trace_record.duration = m_trans_cycles;
+        m_trace_record.ack      = p_ack.read();
+        if( r_tout_counter.read() == 0 ) m_trace_record.flags |= PIBUS_TRACE_TIMEOUT;
+        m_trace->record(m_trace_record);
+    }
+    m_trans_cycles = 0;
+    m_trans_words  = 0;
+} // end endTransaction()
+
+////////////////////////////////////////////////////////
+// last cycle of a transaction (FSM_DT state, or RETRY 
+// in FSM_DTAD state) : the bus can be granted to a 
+// new master without idle cycle
+////////////////////////////////////////////////////////
+bool PibusSegBcu::isReleased()
+{
+    return ( (r_fsm_state == FSM_DT) && (p_ack.read() != PIBUS_ACK_WAIT) ) ||
+           ( (r_fsm_state == FSM_DTAD) && (p_ack.read() == PIBUS_ACK_RETRY) );
+} // end isReleased()
+
+//////////////////////////////////////
+void PibusSegBcu::newAllocation()
+{
+    endTransaction();
+    r_tout_counter = m_time_out;
+    size_t j = selectMaster();
+    if(j < m_nb_master) 
+    {
+        grantMaster(j);
+        r_fsm_state = FSM_AD; 
+    }
+    else
+    {
+        r_fsm_state = FSM_IDLE; 
+    }
+} // end newAllocation()
+
 //////////////////////////////
 void PibusSegBcu::transition()
 {
@@ -103,31 +315,89 @@ void PibusSegBcu::transition()
         r_current_master = 0;
         for(size_t i = 0 ; i < m_nb_master ; i++) 
         {
-            r_wait_counter[i] = 0;
-            r_req_counter[i] = 0;
+            c_wait_count[i] = 0;
+            c_req_count[i] = 0;
+            r_credit[i] = m_weights[i];
+            r_tokens[i] = m_weights[i];
+            m_req_wait[i] = 0;
+            m_latency[i].reset();
         }
+        r_token_timer = m_period - 1;
+        for(size_t t = 0 ; t < m_nb_target ; t++) 
+        {
+            c_target_busy[t]  = 0;
+            c_target_trans[t] = 0;
+        }
+        m_duration.reset();
+        m_burst.reset();
+        m_trans_cycles   = 0;
+        m_trans_words    = 0;
+        c_total_cycles   = 0;
+        c_busy_cycles    = 0;
+        c_retry_count    = 0;
+        m_window_cycles  = 0;
+        m_window_busy    = 0;
+        m_window_trace.clear();
         return;
     } // end p_resetn
 
     for(size_t i = 0 ; i < m_nb_master ; i++) 
     {
-        if(p_req[i]) r_wait_counter[i] = r_wait_counter[i] + 1;
+        if(p_req[i]) 
+        {
+            c_wait_count[i]++;
+            m_req_wait[i]++;
+        }
 	}
+
+    // bus utilization & occupancy
+    if( r_fsm_state == FSM_AD ) 
+    {
+        m_current_target = m_target_table[p_a.read() >> PIBUS_DECODE_SHIFT];
+        m_trace_record.cycle   = c_total_cycles;
+        m_trace_record.address = p_a.read();
+        m_trace_record.target  = m_current_target;
+        m_trace_record.opc     = (m_trace_opc == NULL) ? 0 : m_trace_opc->read();
+        m_trace_record.flags   = ((m_trace_read != NULL) && m_trace_read->read()) ? PIBUS_TRACE_READ : 0;
+    }
+    c_total_cycles++;
+    m_window_cycles++;
+    if( r_fsm_state != FSM_IDLE )
+    {
+        c_busy_cycles++;
+        m_window_busy++;
+        m_trans_cycles++;
+        c_target_busy[m_current_target]++;
+        if( (r_fsm_state != FSM_AD) && (p_ack.read() != PIBUS_ACK_WAIT) ) m_trans_words++;
+    }
+    if( m_window_cycles == m_window )
+    {
+        m_window_trace.push_back(m_window_busy);
+        m_window_cycles = 0;
+        m_window_busy   = 0;
+    }
+
+    // tokens reload (BCU_TOKEN)
+    m_token_refill = (m_policy == BCU_TOKEN) && (r_token_timer.read() == 0);
+    if( m_token_refill )
+    {
+        r_token_timer = m_period - 1;
+        for(size_t i = 0 ; i < m_nb_master ; i++) r_tokens[i] = m_weights[i];
+    }
+    else if( m_policy == BCU_TOKEN )
+    {
+        r_token_timer = r_token_timer.read() - 1;
+    }
 	
     switch(r_fsm_state) {
 	case FSM_IDLE:
     {
         r_tout_counter = m_time_out;
-        for(size_t i = 0 ; i < m_nb_master ; i++) 
+        size_t j = selectMaster();
+        if (j < m_nb_master) 
         {
-            int j = (i + 1 + r_current_master) % m_nb_master;
-            if (p_req[j]) 
-            {
-                r_current_master = j;
-                r_req_counter[j] = r_req_counter[j] + 1;
-                r_fsm_state = FSM_AD;
-                break;
-            }
+            grantMaster(j);
+            r_fsm_state = FSM_AD;
         } 
         break;
     }
@@ -141,8 +411,14 @@ void PibusSegBcu::transition()
     {
         if (r_tout_counter == 0) 
         {
+            endTransaction();
             r_fsm_state = FSM_IDLE;
         } 
+        else if ( p_ack.read() == PIBUS_ACK_RETRY )  // split transaction : new allocation
+        {
+            c_retry_count++;
+            newAllocation();
+        } 
         else if ( (p_ack.read() != PIBUS_ACK_WAIT) and (p_lock == false) ) 
         {
             r_fsm_state = FSM_DT; 
@@ -157,24 +433,13 @@ void PibusSegBcu::transition()
     {
         if(r_tout_counter == 0) 
         {
+            endTransaction();
             r_fsm_state = FSM_IDLE;
         } 
         else if(p_ack.read() != PIBUS_ACK_WAIT)  // new allocation
         {
-            r_tout_counter = m_time_out;
-            bool found = false;
-            for(size_t i = 0 ; (i < m_nb_master) and (found == false) ; i++) 
-            {
-                int j = (i + 1 + r_current_master) % m_nb_master;
-                if( p_req[j] == true )
-                {
-                    r_current_master = j;
-                    r_req_counter[j] = r_req_counter[j] + 1;
-                    found = true;
-                }
-            } 
-            if(found == true) r_fsm_state = FSM_AD; 
-            else              r_fsm_state = FSM_IDLE; 
+            if(p_ack.read() == PIBUS_ACK_RETRY) c_retry_count++;
+            newAllocation();
         } 
         else 
         { 
@@ -188,29 +453,14 @@ void PibusSegBcu::transition()
 ////////////////////////////////
 void PibusSegBcu::genMealy_gnt()
 {
-    bool	found = false;
-    if( (r_fsm_state == FSM_IDLE) || ((r_fsm_state == FSM_DT) && (p_ack.read() != PIBUS_ACK_WAIT)) ) 
+    size_t selected = m_nb_master;
+    if( (r_fsm_state == FSM_IDLE) || isReleased() ) 
     {
-        for(size_t i = 0 ; i < m_nb_master ; i++) 
-        {
-            int j = (i + 1 + r_current_master) % m_nb_master;
-            if((p_req[j] == true) && (found == false)) 
-            {
-                p_gnt[j] = true;
-                found = true;
-            } 
-            else 
-            {
-                p_gnt[j] = false;
-            }
-        } 
+        selected = selectMaster();
     } 
-    else 
+    for (size_t i = 0 ; i < m_nb_master ; i++) 
     {
-        for (size_t i = 0 ; i < m_nb_master ; i++) 
-        {
-            p_gnt[i] = false;
-        }
+        p_gnt[i] = (i == selected);
     }
 } // end genMealy_gnt()
 
@@ -219,7 +469,7 @@ void PibusSegBcu::genMealy_sel()
 {
     if((r_fsm_state == FSM_AD) || (r_fsm_state == FSM_DTAD)) 
     {
-        size_t index = m_target_table[p_a.read() >> m_msb_shift];
+        size_t index = m_target_table[p_a.read() >> PIBUS_DECODE_SHIFT];
         for(size_t i = 0; i < m_nb_target ; i++) 
         {
             if(i == index)  	p_sel[i] = true;
@@ -247,23 +497,14 @@ void PibusSegBcu::printTrace()
 {
     std::cout << m_name << " : fsm = " << m_fsm_str[r_fsm_state] << std::dec;
 
-    if( (r_fsm_state == FSM_IDLE) || ((r_fsm_state == FSM_DT) && (p_ack.read() != PIBUS_ACK_WAIT)) ) 
+    if( (r_fsm_state == FSM_IDLE) || isReleased() ) 
     {
-        bool found = false;
-        size_t  index;
-        for(size_t i=0 ; (i<m_nb_master) and (found == false) ; i++) 
-        {
-            index = (i + 1 + r_current_master) % m_nb_master;
-            if( p_req[index] == true )
-            {
-                std::cout << " | granted master = " << index;
-                found = true;
-            }
-        } 
+        size_t index = selectMaster();
+        if( index < m_nb_master ) std::cout << " | granted master = " << index;
     }
     if( (r_fsm_state == FSM_AD) || (r_fsm_state == FSM_DTAD) ) 
     {
-        size_t index = m_target_table[p_a.read() >> m_msb_shift];
+        size_t index = m_target_table[p_a.read() >> PIBUS_DECODE_SHIFT];
         std::cout << " | selected target = " << index; 
     }
     std::cout << std::endl;
@@ -275,11 +516,164 @@ void PibusSegBcu::printStatistics()
     std::cout << m_name << " : Statistics" << std::endl;
     for(size_t i = 0 ; i < m_nb_master ; i++) 
     {
-        size_t req  = r_req_counter[i].read();
-        size_t wait = r_wait_counter[i].read();
+        uint64_t req  = c_req_count[i];
+        uint64_t wait = c_wait_count[i];
         std::cout << "master " << i << " : n_req = " << req << " , n_wait_cycles = " << wait
                   << " , access time = " <<  (float)wait/(float)req << std::endl;
     }
+    for(size_t i = 0 ; i < m_nb_master ; i++) 
+    {
+        std::cout << "master " << i << " arbitration latency : ";
+        m_latency[i].print(std::cout);
+    }
+    std::cout << "transaction duration : ";
+    m_duration.print(std::cout);
+    std::cout << "burst length : ";
+    m_burst.print(std::cout);
+    for(size_t t = 0 ; t < m_nb_target ; t++) 
+    {
+        std::cout << "target " << t << " : n_trans = " << c_target_trans[t] 
+                  << " , busy cycles = " << c_target_busy[t]
+                  << " , occupancy = " << (float)c_target_busy[t]/(float)c_total_cycles << std::endl;
+    }
+    std::cout << "bus utilization = " << (float)c_busy_cycles/(float)c_total_cycles 
+              << " (" << c_busy_cycles << " / " << c_total_cycles << " cycles)" << std::endl;
+    std::cout << "retried transactions = " << c_retry_count << std::endl;
+}
+
+///////////////////////////////////////////////////////////
+// utilization trace : one line per window 
+// (the last line is the current incomplete window)
+///////////////////////////////////////////////////////////
+void PibusSegBcu::printCsv(std::ostream &o)
+{
+    o << "window,first_cycle,cycles,busy_cycles,utilization" << std::endl;
+    for(size_t w = 0 ; w <= m_window_trace.size() ; w++)
+    {
+        uint32_t cycles = (w < m_window_trace.size()) ? m_window : m_window_cycles;
+        uint32_t busy   = (w < m_window_trace.size()) ? m_window_trace[w] : m_window_busy;
+        if( cycles == 0 ) break;
+        o << std::dec << w << "," << (uint64_t)w * m_window << "," << cycles << "," << busy 
+          << "," << (double)busy/(double)cycles << std::endl;
+    }
+}
+
+////////////////////////////////////////////
+void PibusSegBcu::printJson(std::ostream &o)
+{
+    o << "{" << std::endl;
+    o << "  \"name\": \"" << m_name << "\"," << std::endl;
+    o << "  \"policy\": " << std::dec << m_policy << "," << std::endl;
+    o << "  \"cycles\": " << c_total_cycles << "," << std::endl;
+    o << "  \"busy_cycles\": " << c_busy_cycles << "," << std::endl;
+    o << "  \"retries\": " << c_retry_count << "," << std::endl;
+    o << "  \"masters\": [" << std::endl;
+    for(size_t i = 0 ; i < m_nb_master ; i++) 
+    {
+        o << "    { \"n_req\": " << c_req_count[i] 
+          << ", \"n_wait_cycles\": " << c_wait_count[i] 
+          << ", \"latency\": ";
+        m_latency[i].printJson(o);
+        o << " }" << ((i + 1 < m_nb_master) ? "," : "") << std::endl;
+    }
+    o << "  ]," << std::endl;
+    o << "  \"targets\": [" << std::endl;
+    for(size_t t = 0 ; t < m_nb_target ; t++) 
+    {
+        o << "    { \"n_trans\": " << c_target_trans[t] 
+          << ", \"busy_cycles\": " << c_target_busy[t] << " }"
+          << ((t + 1 < m_nb_target) ? "," : "") << std::endl;
+    }
+    o << "  ]," << std::endl;
+    o << "  \"duration\": ";
+    m_duration.printJson(o);
+    o << "," << std::endl;
+    o << "  \"burst\": ";
+    m_burst.printJson(o);
+    o << "," << std::endl;
+    o << "  \"window\": " << m_window << "," << std::endl;
+    o << "  \"utilization\": [";
+    for(size_t w = 0 ; w < m_window_trace.size() ; w++)
+    {
+        o << ((w == 0) ? "" : ", ") << m_window_trace[w];
+    }
+    o << "]" << std::endl;
+    o << "}" << std::endl;
+}
+
+////////////////////////////////////////////////////////////////
+void PibusSegBcu::registerCounters(PibusCounterRegistry &registry)
+{
+    char name[32];
+    for(size_t i = 0 ; i < m_nb_master ; i++) 
+    {
+        sprintf(name, "req_count_%d", (int)i);
+        registry.add(m_name, name, &c_req_count[i]);
+        sprintf(name, "wait_count_%d", (int)i);
+        registry.add(m_name, name, &c_wait_count[i]);
+    }
+    for(size_t t = 0 ; t < m_nb_target ; t++) 
+    {
+        sprintf(name, "target_trans_%d", (int)t);
+        registry.add(m_name, name, &c_target_trans[t]);
+        sprintf(name, "target_busy_%d", (int)t);
+        registry.add(m_name, name, &c_target_busy[t]);
+    }
+    registry.add(m_name, "total_cycles", &c_total_cycles);
+    registry.add(m_name, "busy_cycles",  &c_busy_cycles);
+    registry.add(m_name, "retry_count",  &c_retry_count);
+}
+
+///////////////////////////////////////////////////////////////////////////
+void PibusSegBcu::setTraceRecorder(PibusTraceRecorder              *recorder,
+                                   const sc_signal<uint32_t>       *opc,
+                                   const sc_signal<bool>           *read)
+{
+    m_trace      = recorder;
+    m_trace_opc  = opc;
+    m_trace_read = read;
+}
+
+/////////////////////////////////////////
+bool PibusSegBcu::checkpointReady()
+{
+    return (r_fsm_state == FSM_IDLE);
+}
+///////////////////////////////////////////////////////////////
+void PibusSegBcu::saveState(PibusCheckpointWriter &writer)
+{
+    writer.put(m_nb_master);
+    writer.put(r_fsm_state);
+    writer.put(r_current_master);
+    writer.put(r_tout_counter);
+    writer.put(r_token_timer);
+    for (size_t i = 0 ; i < m_nb_master ; i++)
+    {
+        writer.put(r_credit[i]);
+        writer.put(r_tokens[i]);
+    }
+}
+///////////////////////////////////////////////////////////////
+void PibusSegBcu::restoreState(PibusCheckpointReader &reader)
+{
+    size_t nb_master;
+    reader.get(nb_master);
+    if (nb_master != m_nb_master)
+    {
+        std::cout << "ERROR in PibusSegBcu Component" << std::endl;
+        std::cout << "The checkpoint number of masters does not match" << std::endl;
+        exit(1);
+    }
+    reader.get(r_fsm_state);
+    reader.get(r_current_master);
+    reader.get(r_tout_counter);
+    reader.get(r_token_timer);
+    for (size_t i = 0 ; i < m_nb_master ; i++)
+    {
+        reader.get(r_credit[i]);
+        reader.get(r_tokens[i]);
+        m_req_wait[i] = 0;
+    }
 }
 
 #ifdef SOCVIEW
@@ -289,8 +683,9 @@ void PibusSegBcu::registerDebug(SocviewDebugger db)
     db.add(r_fsm_state     , m_name + ".r_fsm_state");
     db.add(r_current_master, m_name + ".r_current_master");
     db.add(r_tout_counter  , m_name + ".r_tout_counter");
-    db.add(r_req_counter   , m_name + ".r_req_counter");
-    db.add(r_wait_counter  , m_name + ".r_wait_counter");
+    db.add(r_credit        , m_name + ".r_credit");
+    db.add(r_tokens        , m_name + ".r_tokens");
+    db.add(r_token_timer   , m_name + ".r_token_timer");
 }
 #endif
 
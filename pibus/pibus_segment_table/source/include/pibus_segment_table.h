@@ -29,12 +29,34 @@
 // - size_t	index	: target index
 // - bool			cached  : cached when true
 //
+// Once all segments have been declared, the PibusSegmentTable can be
+// "compiled" into an immutable PibusDecodeRom (see getDecodeRom()).
+// The decode ROM is built only once, and shared by all components.
+// It contains three dense tables of 256 entries, aligned on cache lines,
+// and indexed by the 8 MSB bits of the address (whatever the MSB number,
+// the entries of a given page are replicated):
+// - the Target ROM : page -> target index
+// - the Cached ROM : page -> cached flag
+// - the Segment ROM : page -> descriptors of the intersecting segments
+//   (and index of each segment in the segment list of its target)
+// As the decode ROM points on the segment table, no segment can be
+// added after the decode ROM has been built, and the segment table
+// cannot be copied (the copy would point on the original segments) :
+// it must be passed by reference.
+// The getTargetSegmentList() method builds the decode ROM : all
+// segments must therefore be declared before the construction of the
+// first component, and an addSegment() call after this construction
+// is a fatal error (exit).
+//
 // The information defined in the PibusSegmentTable is used by the
 // constructor of the following hardware components:
 // - The constructors of the PIBU_BCU use it to build the Target ROM 
 //   implementing the target selection (decoding the MSB address bits).
 // - The constructors of all PIBUS targets use it to implement the 
-//   segmentation violation detection mechanism.
+//   segmentation violation detection mechanism. The multi-segments
+//   targets (PibusSimpleRam) use the Segment ROM (getSegmentIndex()),
+//   and the single segment targets compare the address with the
+//   segment base and size.
 // - The constructor of the PIBUS_MULTIRAM use it to allocate the 
 //   buffers representing the memory for the segments.
 // - The constructor of the PIBUS_XCACHE use it to build the Cached ROM
@@ -45,6 +67,16 @@
 #define PIBUS_SEGMENT_TABLE_H
 
 #include <list>
+#include <vector>
+#include <stdint.h>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+// decode ROMs geometry
+#define PIBUS_DECODE_PAGES	256	// number of entries in a decode ROM
+#define PIBUS_DECODE_SHIFT	24	// decode ROMs are indexed by address >> 24
+#define PIBUS_DECODE_ALIGN	64	// decode ROMs alignment (cache line)
 
 namespace soclib { namespace common {
 
@@ -77,39 +109,149 @@ SegmentTableEntry(	const char*	nm,
 }; // end constructor
 
 ////////////
-void print()
+void print() const
 { 
 	printf("segment : %s , base = 0x%x , size = 0x%x , target = %d , cached = %d\n",
 		name, base, size,  (int)target, (int)cached);
 };
 /////////////////////
-const char *getName()
+const char *getName() const
 {
 	return name;
 };
 ////////////////
-size_t getBase()
+size_t getBase() const
 {
 	return base;
 };
 ////////////////
-size_t getSize()
+size_t getSize() const
 {
 	return size;
 };
 ///////////////////////
-size_t getTargetIndex()
+size_t getTargetIndex() const
 {
 	return target;
 };
 ////////////////
-bool getCached()
+bool getCached() const
 {
 	return cached;
 };
 
 };	// end class SegmentTable Entry 
 
+//////////////////////////////////////////////////////////////////////////////////
+//			PibusDecodeRom definition
+//////////////////////////////////////////////////////////////////////////////////
+// This immutable object is built by the PibusSegmentTable::getDecodeRom()
+// method. All decode functions have a constant cost : the page index
+// is the 8 MSB bits of the address, and a page contains in practice
+// one single segment.
+//////////////////////////////////////////////////////////////////////////////////
+
+class PibusDecodeRom {
+
+friend class PibusSegmentTable;
+
+public:
+
+// Segment ROM entry : the segments intersecting a page are
+// stored contiguously in the m_page_segments vector (and their
+// index in the target segment list in the m_page_index vector).
+struct PageDescriptor
+{
+	size_t		first;		// index of the first segment
+	size_t		count;		// number of segments
+};
+
+private:
+
+size_t		m_target[PIBUS_DECODE_PAGES] __attribute__((aligned(PIBUS_DECODE_ALIGN)));
+bool		m_cached[PIBUS_DECODE_PAGES] __attribute__((aligned(PIBUS_DECODE_ALIGN)));
+PageDescriptor	m_page[PIBUS_DECODE_PAGES] __attribute__((aligned(PIBUS_DECODE_ALIGN)));
+std::vector<const SegmentTableEntry*>			m_page_segments;
+std::vector<size_t>					m_page_index;
+std::vector<std::list<SegmentTableEntry> >		m_target_segments;
+
+public:
+
+////////////////////////////////////////////////////////////////
+// returns the Target ROM (indexed by address >> PIBUS_DECODE_SHIFT)
+const size_t* getTargetTable() const
+{
+	return m_target;
+}
+
+////////////////////////////////////////////////////////////////
+// returns the Cached ROM (indexed by address >> PIBUS_DECODE_SHIFT)
+const bool* getCachedTable() const
+{
+	return m_cached;
+}
+
+//////////////////////////////////////
+size_t getTarget(uint32_t address) const
+{
+	return m_target[address >> PIBUS_DECODE_SHIFT];
+}
+
+//////////////////////////////////////
+bool isCached(uint32_t address) const
+{
+	return m_cached[address >> PIBUS_DECODE_SHIFT];
+}
+
+////////////////////////////////////////////////////////////////////
+// returns the descriptor of the segment containing the address,
+// or NULL if the address is not contained in any segment.
+const SegmentTableEntry* getSegment(uint32_t address) const
+{
+	const PageDescriptor &page = m_page[address >> PIBUS_DECODE_SHIFT];
+	for (size_t i = page.first ; i < page.first + page.count ; i++)
+	{
+		const SegmentTableEntry *seg = m_page_segments[i];
+		if ((address - seg->getBase()) < seg->getSize()) return seg;
+	}
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////
+// returns true when the address is contained in a segment of the
+// target, and the index of this segment in the target segment list
+// (see getTargetSegmentList()).
+bool getSegmentIndex(uint32_t address, size_t target, size_t* index) const
+{
+	const PageDescriptor &page = m_page[address >> PIBUS_DECODE_SHIFT];
+	for (size_t i = page.first ; i < page.first + page.count ; i++)
+	{
+		const SegmentTableEntry *seg = m_page_segments[i];
+		if (((address - seg->getBase()) < seg->getSize()) &&
+		    (seg->getTargetIndex() == target))
+		{
+			*index = m_page_index[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////
+// returns the list of all segments allocated to a given PIBUS target.
+const std::list<SegmentTableEntry> &getTargetSegmentList(size_t target) const
+{
+	if (target >= m_target_segments.size())
+	{
+		std::cerr << "ERROR in the Decode ROM :" << std::endl ;
+		std::cerr << "The target index " << target << " is larger than 31 !" << std::endl;
+		exit(0);
+	}
+	return m_target_segments[target];
+}
+
+}; // end PibusDecodeRom
+
 
 //////////////////////////////////////////////////////////////////////////////////
 //			PibusSegmentTable definition
@@ -126,6 +268,12 @@ bool*				m_cached_table;
 bool				m_cached_table_called;
 int				m_MSB_number;
 bool				m_MSB_number_called;
+PibusDecodeRom			m_decode_rom;
+bool				m_decode_rom_called;
+
+// not copyable : m_decode_rom points on m_segment_list (not defined)
+PibusSegmentTable(const PibusSegmentTable &);
+PibusSegmentTable &operator=(const PibusSegmentTable &);
 
 public:
 	
@@ -148,8 +296,8 @@ int getMSBnumber()
 	return m_MSB_number;
 }
 
-////////////////////////////////////////////
-std::list<SegmentTableEntry> getSegmentList()
+//////////////////////////////////////////////////////////
+const std::list<SegmentTableEntry> &getSegmentList() const
 {
 	return(m_segment_list);
 }
@@ -162,6 +310,13 @@ void addSegment(const char*	nm,
 		bool	 	ca) 
 {
 				
+	if(m_decode_rom_called == true) 
+	{
+		std::cerr << "ERROR in the Segment Table :" << std::endl ;
+		std::cerr << "The segment " << nm << " cannot be declared" << std::endl ;
+		std::cerr << "after the decode ROM has been built !" << std::endl ;
+		exit(0);
+	}
 	if(m_MSB_number_called == false) 
 	{
 		std::cerr << "ERROR in the Segment Table :" << std::endl ;
@@ -336,19 +491,68 @@ bool *getCachedTable()
 
 ////////////////////////////////////////////////////////////////////////
 // returns the list of all segments allocated to a given PIBUS target.
-std::list<SegmentTableEntry> getTargetSegmentList(size_t target) 
+const std::list<SegmentTableEntry> &getTargetSegmentList(size_t target) 
 {
-	std::list<SegmentTableEntry> list;
-	std::list<SegmentTableEntry>::iterator seg;
-	// loop on all segments
-	for (seg = m_segment_list.begin() ; seg != m_segment_list.end() ; ++seg) 
-        {
-		size_t tg =(*seg).getTargetIndex();
-		if (tg == target) list.push_back(*seg);
-	} // en for seg
-	return(list);
+	return getDecodeRom().getTargetSegmentList(target);
 } // end getTargetSegmentList()
 
+/////////////////////////////////////////////////////////////////////////
+// returns the decode ROM, that is built at the first call
+const PibusDecodeRom &getDecodeRom() 
+{
+	if (m_MSB_number_called == false) 
+	{
+		std::cerr << "ERROR in the Segment Table:" << std::endl ;
+		std::cerr << "the MSB number has not been defined !" << std::endl ;
+		exit(0);
+	}
+	if(m_decode_rom_called == false) 	// not created yet
+	{
+		m_decode_rom_called = true;
+		m_decode_rom.m_target_segments.resize(32);
+		std::list<SegmentTableEntry>::const_iterator seg;
+		std::vector<size_t> local;	// index in the target segment list
+		for (seg = m_segment_list.begin() ; seg != m_segment_list.end() ; ++seg) 
+		{
+			local.push_back(m_decode_rom.m_target_segments[(*seg).getTargetIndex()].size());
+			m_decode_rom.m_target_segments[(*seg).getTargetIndex()].push_back(*seg);
+		}
+
+		// The target & cached flag are defined by the segments
+		// whose base address is in the page, as in getTargetTable()
+		// and getCachedTable(). The segment descriptors are all 
+		// segments intersecting the PIBUS_DECODE_SHIFT sub-page.
+		for (size_t page = 0 ; page < PIBUS_DECODE_PAGES ; page++) 
+		{
+			uint32_t min = page << PIBUS_DECODE_SHIFT;
+			uint32_t max = min + ((1 << PIBUS_DECODE_SHIFT) - 1);
+			m_decode_rom.m_target[page]	= 0;
+			m_decode_rom.m_cached[page]	= false;
+			m_decode_rom.m_page[page].first	= m_decode_rom.m_page_segments.size();
+			m_decode_rom.m_page[page].count	= 0;
+			size_t k = 0;
+			for (seg = m_segment_list.begin() ; seg != m_segment_list.end() ; ++seg, ++k) 
+			{
+				size_t	base	= (*seg).getBase();
+				size_t	size	= (*seg).getSize();
+				if (m_MSB_number == 0 || 
+				    ((base >> (32-m_MSB_number)) == (min >> (32-m_MSB_number)))) 
+				{
+					m_decode_rom.m_target[page] = (*seg).getTargetIndex();
+					m_decode_rom.m_cached[page] = (*seg).getCached();
+				}
+				if ((size != 0) && (base <= max) && (base + size - 1 >= min))
+				{
+					m_decode_rom.m_page_segments.push_back(&(*seg));
+					m_decode_rom.m_page_index.push_back(local[k]);
+					m_decode_rom.m_page[page].count++;
+				}
+			} // end for seg
+		} // end for page
+	} // end if
+	return m_decode_rom;
+}  // end getDecodeRom()
+
 /////////////////////////////////////////////////////////////////////////////
 // cheks if all target indexes registered in the segment table are consistent.
 bool isAllBelow(size_t ntarget) 
@@ -369,6 +573,7 @@ PibusSegmentTable()
 	m_MSB_number_called	= false;
 	m_cached_table_called	= false;
 	m_target_table_called	= false;
+	m_decode_rom_called	= false;
 }  // end constructor 
 
 }; // end PibusSegmentTable
@@ -50,8 +50,11 @@ void PibusSimpleMaster::transition()
             r_fsm_state = FSM_RAM_A2_D1;
             r_buf[0] = (uint32_t)p_d.read();
 	}
+        else if (p_ack.read() == PIBUS_ACK_RETRY)	// split transaction
+        {
+            r_fsm_state = FSM_RAM_REQ;
+        }
         else if ( (p_ack.read() == PIBUS_ACK_ERROR) ||
-                  (p_ack.read() == PIBUS_ACK_RETRY) ||
                   (p_tout == true) )
         {
             std::cout << "error detected by the PibusSimpleMaster component" << std::endl;
@@ -67,8 +70,11 @@ void PibusSimpleMaster::transition()
             r_fsm_state = FSM_RAM_A3_D2;
             r_buf[1] = (uint32_t)p_d.read();
 	}
+        else if (p_ack.read() == PIBUS_ACK_RETRY)	// split transaction
+        {
+            r_fsm_state = FSM_RAM_REQ;
+        }
         else if ( (p_ack.read() == PIBUS_ACK_ERROR) ||
-                  (p_ack.read() == PIBUS_ACK_RETRY) ||
                   (p_tout == true) )
         {
             std::cout << "error detected by the PibusSimpleMaster component" << std::endl;
@@ -84,8 +90,11 @@ void PibusSimpleMaster::transition()
             r_fsm_state = FSM_RAM_D3;
             r_buf[2] = (uint32_t)p_d.read();
 	}
+        else if (p_ack.read() == PIBUS_ACK_RETRY)	// split transaction
+        {
+            r_fsm_state = FSM_RAM_REQ;
+        }
         else if ( (p_ack.read() == PIBUS_ACK_ERROR) ||
-                  (p_ack.read() == PIBUS_ACK_RETRY) ||
                   (p_tout == true) )
         {
             std::cout << "error detected by the PibusSimpleMaster component" << std::endl;
@@ -101,8 +110,11 @@ void PibusSimpleMaster::transition()
             r_fsm_state = FSM_WRITE_REQ;
             r_buf[3] = (uint32_t)p_d.read();
 	}
+        else if (p_ack.read() == PIBUS_ACK_RETRY)	// split transaction
+        {
+            r_fsm_state = FSM_RAM_REQ;
+        }
         else if ( (p_ack.read() == PIBUS_ACK_ERROR) ||
-                  (p_ack.read() == PIBUS_ACK_RETRY) ||
                   (p_tout == true) )
         {
             std::cout << "error detected by the PibusSimpleMaster component" << std::endl;
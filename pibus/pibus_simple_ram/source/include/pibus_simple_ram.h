@@ -7,25 +7,89 @@
 //////////////////////////////////////////////////////////////////////////
 // This component implements a  multi-segment SRAM, with PIBUS interface.
 // It uses the SoCLib loader to load binary code in a given memory segment.
-// This component can contain up to 16 segments.
+// This component can contain any number of segments.
 // Each segment is defined by a BASE address and a SIZE
 // (the SIZE is a number of bytes)
-// Both the BASE and SIZE must be multiple of 4 bytes.
+// Both the BASE and SIZE must be multiple of 4 bytes,
+// and the SIZE cannot be null.
 // Each segment is implemented by a table of "int" dynamically
 // allocated by the RAM constructor.
+// The memory image is defined by the loader. Four allocation
+// modes are supported (alloc_mode constructor argument):
+// - RAM_ALLOC_DENSE : the segments are heap buffers, and the image
+//   is rebuilt by the loader in the segment buffers at each reset
+//   (no second copy of the image is kept).
+// - RAM_ALLOC_MAPPED : the image is written in an (unlinked) host
+//   temporary file, and the segments are private copy-on-write
+//   mappings of this file. A reset simply re-maps the file : the
+//   modified pages are discarded, and the pages are lazily filled
+//   by the host system on first touch.
+// - RAM_ALLOC_SPARSE : the segments are allocated by 4 Kbytes pages,
+//   on the first write in the page, using a two-levels page table
+//   indexed by the offset in the segment. The non null pages of the
+//   memory image are kept in a second page table, and a reset simply
+//   releases the allocated pages. The resident memory depends only
+//   on the working set, not on the segment size.
+// - RAM_ALLOC_HUGEPAGE : as the dense mode, but the segments are
+//   allocated with (explicit or transparent) host huge pages.
 // This component checks address for segmentation violation.
+// The segment selection uses the Segment ROM of the segment table
+// decode ROM, indexed by the 8 MSB bits of the address : each page
+// entry contains the list of segments intersecting this page.
+// Therefore, the segment decoding has a constant cost,
+// whatever the number of segments.
 // In case of burst, all addresses must be in the same segment,
 // and it is forbidden to mix read and write accesses in
 // a single burst.
 // The number of wait cycles at the beginning of a transaction 
 // is a parameter (The value can be 0).
+// For write bursts, the host pointer on the written word is only
+// computed for the first word, and incremented for the next words.
+// The sub-word writes use the pibus_opc_mask[] table, that is
+// shared with the PibusMips32Xcache component.
+// When the PIBUS_CLOCK_GATING flag is defined, the transition() and
+// genMoore() methods are not evaluated when the FSM is IDLE : the
+// transition() is woken up by the rising edge of p_sel (or p_resetn),
+// and the genMoore() by the FSM state change, and both wait the next 
+// clock edge before resuming. The simulation result is not modified.
+// When the split constructor argument is non zero (and the latency
+// is non zero), the RAM supports split transactions : a new request
+// is registered in a pending table (split entries), and the RAM
+// answers PIBUS_ACK_RETRY, releasing the bus for the other masters.
+// The latency is counted in the pending table, and the request 
+// is completed (without wait cycles) when the master retries the
+// same transaction (same first address and same direction). 
+// Several requests can be pending simultaneously. The entries are 
+// tagged by the first address and the direction, not by the master,
+// as the PIBUS targets do not know the master index : two masters
+// requesting the same address in the same direction share the same
+// entry (the first retry completes the request and releases the entry,
+// and the other master gets a new entry on its retry). An entry is only
+// released by the retry of its request, so the masters must always
+// retry a RETRY response. When the pending table is full, the request 
+// is served with wait cycles, as in the non split mode (no starvation).
+// This component implements the PibusFunctionalTarget interface,
+// and can be accessed directly by the masters in fast-forward mode
+// (see the PibusFunctionalBus object).
+// The following 64 bits counters can be registered in a PibusCounterRegistry
+// (registerCounters() method) : transactions, read words, written words,
+// RETRY responses, bus errors, and busy cycles (FSM not idle).
+// This component implements the PibusCheckpointable interface : the
+// modified 4 Kbytes pages are registered by a generation number (the
+// number of checkpoints saved or restored since the reset), and
+// only the pages modified since the reset (or since the parent
+// checkpoint for an incremental checkpoint) are saved. On restore,
+// the pages are mapped from the checkpoint file in mapped mode, and
+// copied in the other modes. It can be checkpointed when the FSM is IDLE.
 ///////////////////////////////////////////////////////////////////////// 
-// This component has 4 "generator" parameters
+// This component has 7 "generator" parameters
 // - sc_module_name		name    : instance name
 // - unsigned int  		index   : target index      
 // - pibusSegmentTable		segmap  : segment table
 // - int			latency	: number of wait cycles
 // - soclib::common::Loader	loader  : loader
+// - int			alloc_mode : segments allocation mode
+// - size_t			split	: pending table size (default = 0)
 /////////////////////////////////////////////////////////////////////////
 
 #ifndef PIBUS_SIMPLE_RAM_H
@@ -34,15 +98,24 @@
 #include <string.h>
 #include <systemc>
 #include <stdio.h>
+#include <vector>
+#include <stdint.h>
 #include "pibus_segment_table.h"
 #include "pibus_mnemonics.h"
+#include "pibus_functional_bus.h"
+#include "pibus_counter_registry.h"
+#include "pibus_checkpoint.h"
 #include "loader.h"
 
-#define MAXSEG 	16
+// sparse mode and checkpoint page geometry
+#define RAM_PAGE_SHIFT		10		// 1024 words per page
+#define RAM_L2_SHIFT		9		// 512 pages per second level table
+#define RAM_HUGEPAGE_SIZE	0x200000	// 2 Mbytes
 
 namespace soclib { namespace caba {
 
-class PibusSimpleRam : sc_core::sc_module {
+class PibusSimpleRam : sc_core::sc_module, public PibusFunctionalTarget,
+                       public PibusCheckpointable {
 
    //  REGISTERS
     sc_register<int>		r_fsm_state;		// FSM state
@@ -50,18 +123,46 @@ class PibusSimpleRam : sc_core::sc_module {
     sc_register<size_t>		r_index;		// Selected segment index
     sc_register<uint32_t>	r_address;		// PIBUS address
     sc_register<int>		r_opc;			// PIBUS codop 
-    uint32_t*			r_buf[MAXSEG];		// segment buffers
+    uint32_t**			r_buf;			// segment buffers
+    int*			m_image_fd;		// image files (mapped mode)
+    bool			m_image_ok;		// images built
+    bool			m_reset_done;		// segments restored
+    uint32_t****		m_sparse;		// page tables (sparse mode)
+    uint32_t****		m_sparse_image;		// image page tables (sparse mode)
+    std::vector<uint32_t*>	m_free_pages;		// released pages (sparse mode)
+    size_t			m_sparse_pages;		// allocated pages (sparse mode)
+    uint32_t*			m_wptr;			// next word pointer (write burst)
+    bool			m_sleep_transition;	// transition() is not clocked (clock gating)
+    bool			m_sleep_moore;		// genMoore() is not clocked (clock gating)
+    bool*			m_pend_valid;		// pending request valid (split mode)
+    uint32_t*			m_pend_address;		// pending request address (split mode)
+    bool*			m_pend_read;		// pending request direction (split mode)
+    uint32_t*			m_pend_counter;		// pending request latency (split mode)
+    size_t			m_pend_busy;		// pending requests not completed (split mode)
+    uint32_t**			m_page_gen;		// last modification generation per page
+    uint32_t			m_gen;			// current generation (checkpoints)
+
+    //  INSTRUMENTATION
+    uint64_t			c_trans_count;		// transactions
+    uint64_t			c_read_words;		// read words
+    uint64_t			c_write_words;		// written words
+    uint64_t			c_retry_count;		// RETRY responses
+    uint64_t			c_error_count;		// ERROR responses
+    uint64_t			c_busy_cycles;		// FSM not idle
 
     //  STRUCTURAL PARAMETERS
     const char*			m_name;			// instance name
     const uint32_t    	 	m_tgtid;		// target index
     size_t      		m_nbseg;		// segment number
-    uint32_t    		m_segsize[MAXSEG];	// segment sizes
-    uint32_t   			m_segbase[MAXSEG];	// segment bases
-    const char*			m_segname[MAXSEG];	// segment names
+    uint32_t*    		m_segsize;		// segment sizes
+    uint32_t*			m_segbase;		// segment bases
+    const char**		m_segname;		// segment names
+    const soclib::common::PibusDecodeRom	&m_decode_rom;	// segment table decode ROM
     const uint32_t		m_latency;		// intrinsic latency
+    const int			m_alloc_mode;		// segments allocation mode
+    const size_t		m_split;		// pending table size (split mode)
     soclib::common::Loader	m_loader;		// loader
-    char			m_fsm_str[6][20];	// FSM states names
+    char			m_fsm_str[7][20];	// FSM states names
     bool			m_monitor_ok;		// monitor activated
     uint32_t			m_monitor_base;		// monitored segment base
     uint32_t			m_monitor_length; 	// monitored segment length
@@ -73,7 +174,8 @@ class PibusSimpleRam : sc_core::sc_module {
 	FSM_READ_OK	= 2,
 	FSM_WRITE_WAIT	= 3,
 	FSM_WRITE_OK	= 4,
-	FSM_ERROR	= 5
+	FSM_ERROR	= 5,
+	FSM_RETRY	= 6
     };
 
 protected:
@@ -82,6 +184,14 @@ protected:
 
 public:
 
+    // segments allocation modes
+    enum {
+	RAM_ALLOC_DENSE		= 0,
+	RAM_ALLOC_MAPPED	= 1,
+	RAM_ALLOC_SPARSE	= 2,
+	RAM_ALLOC_HUGEPAGE	= 3
+    };
+
     // IO PORTS
     sc_core::sc_in<bool> 		p_ck;
     sc_core::sc_in<bool> 		p_resetn;
@@ -98,13 +208,57 @@ public:
 		uint32_t				tgtid,
 		soclib::common::PibusSegmentTable	&segtab,
 		uint32_t				latency, 	
-                const soclib::common::Loader  		&loader = soclib::common::Loader() );
+                const soclib::common::Loader  		&loader = soclib::common::Loader(),
+		int					alloc_mode = RAM_ALLOC_DENSE,
+		size_t					split = 0 );
+    // destructor
+    ~PibusSimpleRam();
+
     // methods
     void transition();
     void genMoore();
     void printTrace(uint32_t address = 0);
     void startMonitor(uint32_t base, uint32_t length);
     void stopMonitor();
+    void registerCounters(soclib::caba::PibusCounterRegistry &registry);
+    size_t getAllocatedPages() { return m_sparse_pages; }
+
+    // checkpoint
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
+
+    // functional access (fast-forward mode)
+    bool functionalRead(uint32_t address, uint32_t* data, uint32_t opc, size_t burst);
+    bool functionalWrite(uint32_t address, const uint32_t* data, uint32_t opc, size_t burst);
+
+private:
+
+    // word access (the word index is relative to the segment base)
+    inline uint32_t readWord(size_t seg, size_t word)
+    {
+        if (r_buf[seg]) return r_buf[seg][word];
+        return readSparse(seg, word);
+    }
+    inline uint32_t* writeWord(size_t seg, size_t word)
+    {
+        m_page_gen[seg][word >> RAM_PAGE_SHIFT] = m_gen;
+        if (r_buf[seg]) return &r_buf[seg][word];
+        return writeSparse(seg, word);
+    }
+    uint32_t readSparse(size_t seg, size_t word);
+    uint32_t* writeSparse(size_t seg, size_t word);
+    size_t getL1Size(size_t seg);
+    void freeSparseTable(uint32_t*** table, size_t l1_size);
+    void buildSparseImage(size_t seg);
+
+    bool getSegment(uint32_t address, size_t* index);
+    size_t getPending(uint32_t address, bool read);
+    bool allocPending(uint32_t address, bool read);
+    size_t getMappedSize(size_t seg);
+    size_t getPages(size_t seg);
+    void buildImage(size_t seg, uint32_t* buf, bool clear);
+    void resetSegments();
 
 };  // end class PibusSimpleRam
 
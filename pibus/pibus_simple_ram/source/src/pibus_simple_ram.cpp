@@ -7,6 +7,9 @@
 ///////////////////////////////////////////////////////////
 
 #include "pibus_simple_ram.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 namespace soclib { namespace caba {
 
@@ -19,10 +22,15 @@ PibusSimpleRam::PibusSimpleRam (sc_module_name	 	name,
 				uint32_t		tgtid,
 				PibusSegmentTable	&segtab,
 				uint32_t		latency,
-				const Loader  		&loader)
+				const Loader  		&loader,
+				int			alloc_mode,
+				size_t			split)
     : m_name(name),
       m_tgtid(tgtid),
+      m_decode_rom(segtab.getDecodeRom()),
       m_latency(latency),
+      m_alloc_mode(alloc_mode),
+      m_split(split),
       m_loader(loader),
       p_ck("p_ck"),
       p_resetn("p_resetn"),
@@ -41,20 +49,46 @@ PibusSimpleRam::PibusSimpleRam (sc_module_name	 	name,
     sensitive_neg << p_ck;
 
     // segments allocation
-    m_nbseg = 0;
-    std::list<SegmentTableEntry> seglist = segtab.getTargetSegmentList(tgtid);
-    std::list<SegmentTableEntry>::iterator iter;
-  
+    const std::list<SegmentTableEntry> &seglist = segtab.getTargetSegmentList(tgtid);
+    std::list<SegmentTableEntry>::const_iterator iter;
+
+    if ((alloc_mode != RAM_ALLOC_DENSE) && (alloc_mode != RAM_ALLOC_MAPPED) &&
+        (alloc_mode != RAM_ALLOC_SPARSE) && (alloc_mode != RAM_ALLOC_HUGEPAGE))
+    {
+	printf("ERROR in component PibusSimpleRam %s\n", m_name);
+	printf("The alloc_mode parameter must be RAM_ALLOC_DENSE, RAM_ALLOC_MAPPED,\n");
+	printf("RAM_ALLOC_SPARSE or RAM_ALLOC_HUGEPAGE\n");
+	exit(1);
+    }
+
+    m_nbseg   = seglist.size();
+    r_buf     = new uint32_t*[m_nbseg];
+    m_image_fd = new int[m_nbseg];
+    m_sparse  = new uint32_t***[m_nbseg];
+    m_sparse_image = new uint32_t***[m_nbseg];
+    m_sparse_pages = 0;
+    m_image_ok = false;
+    m_reset_done = false;
+    m_wptr    = NULL;
+    m_sleep_transition = false;
+    m_sleep_moore = false;
+    m_pend_valid   = new bool[split];
+    m_pend_address = new uint32_t[split];
+    m_pend_read    = new bool[split];
+    m_pend_counter = new uint32_t[split];
+    m_pend_busy    = 0;
+    for (size_t k = 0 ; k < split ; k++) m_pend_valid[k] = false;
+    m_segsize = new uint32_t[m_nbseg];
+    m_segbase = new uint32_t[m_nbseg];
+    m_segname = new const char*[m_nbseg];
+    m_page_gen = new uint32_t*[m_nbseg];
+    m_gen     = 1;
+
+    size_t seg = 0;
     for (iter = seglist.begin() ; iter != seglist.end() ; ++iter) 
     {
     	uint32_t base = (*iter).getBase();
     	uint32_t size = (*iter).getSize();
-        if(m_nbseg == MAXSEG) 
-        {
-	  	printf("ERROR in component PibusSimpleRam %s\n", m_name);
-	  	printf("The number of segments cannot be larger than %d\n",MAXSEG);
-		exit(1);
-	}
 	if((base & 0x00000003) != 0x0) 
         {
 		printf("ERROR in component PibusSimpleRam %s\n", m_name);
@@ -67,11 +101,80 @@ PibusSimpleRam::PibusSimpleRam (sc_module_name	 	name,
 		printf("The m_size parameter must be multiple of 4\n");
 		exit(1);
 	}
-	m_segname[m_nbseg]   = (*iter).getName(); 
-	m_segsize[m_nbseg]   = size;
-	m_segbase[m_nbseg]   = base;
-	r_buf[m_nbseg]       = new uint32_t[size >> 2];
-	m_nbseg              = m_nbseg+1;
+	if(size == 0) 
+        {
+		printf("ERROR in component PibusSimpleRam %s\n", m_name);
+		printf("The segment %s has a null size\n", (*iter).getName());
+		exit(1);
+	}
+	m_segname[seg]   = (*iter).getName(); 
+	m_segsize[seg]   = size;
+	m_segbase[seg]   = base;
+	m_image_fd[seg]  = -1;
+	m_sparse[seg]    = NULL;
+	m_sparse_image[seg] = NULL;
+	m_page_gen[seg]  = new uint32_t[getPages(seg)];
+	memset(m_page_gen[seg], 0, getPages(seg) * sizeof(uint32_t));
+	switch (alloc_mode) {
+	case RAM_ALLOC_MAPPED :
+	{
+	    // the address range is reserved here, and the image
+	    // file is mapped on this range at each reset
+	    void* buf = mmap(NULL, getMappedSize(seg), PROT_READ | PROT_WRITE,
+			     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	    if (buf == MAP_FAILED)
+	    {
+		printf("ERROR in component PibusSimpleRam %s\n", m_name);
+		printf("Cannot map the segment %s\n", m_segname[seg]);
+		exit(1);
+	    }
+	    r_buf[seg] = (uint32_t*)buf;
+	    break;
+	}
+	case RAM_ALLOC_HUGEPAGE :
+	{
+	    // explicit huge pages if available, and transparent
+	    // huge pages otherwise
+	    void* buf = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	    buf = mmap(NULL, getMappedSize(seg), PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	    if (buf == MAP_FAILED)
+	    {
+		buf = mmap(NULL, getMappedSize(seg), PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED)
+		{
+		    printf("ERROR in component PibusSimpleRam %s\n", m_name);
+		    printf("Cannot map the segment %s\n", m_segname[seg]);
+		    exit(1);
+		}
+#ifdef MADV_HUGEPAGE
+		madvise(buf, getMappedSize(seg), MADV_HUGEPAGE);
+#endif
+	    }
+	    r_buf[seg] = (uint32_t*)buf;
+	    break;
+	}
+	case RAM_ALLOC_SPARSE :
+	{
+	    // only the first level of the page tables is allocated here
+	    r_buf[seg] = NULL;
+	    m_sparse[seg] = new uint32_t**[getL1Size(seg)];
+	    m_sparse_image[seg] = new uint32_t**[getL1Size(seg)];
+	    for (size_t l1 = 0 ; l1 < getL1Size(seg) ; l1++)
+	    {
+		m_sparse[seg][l1] = NULL;
+		m_sparse_image[seg][l1] = NULL;
+	    }
+	    break;
+	}
+	default :
+	    r_buf[seg] = new uint32_t[size >> 2];
+	    break;
+	}
+	seg              = seg+1;
     } 
 
     strcpy(m_fsm_str[0], "IDLE");
@@ -80,9 +183,20 @@ PibusSimpleRam::PibusSimpleRam (sc_module_name	 	name,
     strcpy(m_fsm_str[3], "WRITE_WAIT");
     strcpy(m_fsm_str[4], "WRITE_OK");
     strcpy(m_fsm_str[5], "ERROR");
+    strcpy(m_fsm_str[6], "RETRY");
 
     std::cout << std::endl << "Instanciation of PibusSimpleRam : " << m_name << std::endl;
     std::cout << "    latency = " << latency << std::endl;
+    if ((split != 0) && (latency != 0))
+	std::cout << "    split   = " << split << std::endl;
+    if (alloc_mode == RAM_ALLOC_MAPPED)
+	std::cout << "    alloc_mode = MAPPED" << std::endl;
+    else if (alloc_mode == RAM_ALLOC_SPARSE)
+	std::cout << "    alloc_mode = SPARSE" << std::endl;
+    else if (alloc_mode == RAM_ALLOC_HUGEPAGE)
+	std::cout << "    alloc_mode = HUGEPAGE" << std::endl;
+    else
+	std::cout << "    alloc_mode = DENSE" << std::endl;
     for(uint32_t i = 0 ; i < m_nbseg ; i++) 
  	std::cout << "    segment " << m_segname[i] << std::hex
                   << " | base = 0x" << m_segbase[i]
@@ -90,6 +204,92 @@ PibusSimpleRam::PibusSimpleRam (sc_module_name	 	name,
 
 } // end constructor
 
+/////////////////////////////////
+PibusSimpleRam::~PibusSimpleRam()
+{
+    for (size_t seg = 0 ; seg < m_nbseg ; seg++) 
+    {
+        if (m_alloc_mode == RAM_ALLOC_MAPPED)
+        {
+            munmap(r_buf[seg], getMappedSize(seg));
+            if (m_image_fd[seg] >= 0) close(m_image_fd[seg]);
+        }
+        else if (m_alloc_mode == RAM_ALLOC_SPARSE)
+        {
+            freeSparseTable(m_sparse[seg], getL1Size(seg));
+            freeSparseTable(m_sparse_image[seg], getL1Size(seg));
+        }
+        else if (m_alloc_mode == RAM_ALLOC_HUGEPAGE)
+        {
+            munmap(r_buf[seg], getMappedSize(seg));
+        }
+        else
+        {
+            delete [] r_buf[seg];
+        }
+        delete [] m_page_gen[seg];
+    }
+    for (size_t i = 0 ; i < m_free_pages.size() ; i++) delete [] m_free_pages[i];
+    delete [] r_buf;
+    delete [] m_image_fd;
+    delete [] m_sparse;
+    delete [] m_sparse_image;
+    delete [] m_pend_valid;
+    delete [] m_pend_address;
+    delete [] m_pend_read;
+    delete [] m_pend_counter;
+    delete [] m_segsize;
+    delete [] m_segbase;
+    delete [] m_segname;
+    delete [] m_page_gen;
+} // end destructor
+
+/////////////////////////////////////////////////////////////////
+// This function returns true, and the index of the segment
+// containing the address, when the address is in a segment.
+// Only the segments intersecting the page defined by the
+// address MSB bits are checked (Segment ROM of the decode ROM).
+/////////////////////////////////////////////////////////////////
+inline bool PibusSimpleRam::getSegment(uint32_t address, size_t* index)
+{
+    return m_decode_rom.getSegmentIndex(address, m_tgtid, index);
+} // end getSegment()
+
+/////////////////////////////////////////////////////////////////
+// split mode : returns the index of the pending request 
+// matching the address and direction, or m_split if not found
+/////////////////////////////////////////////////////////////////
+size_t PibusSimpleRam::getPending(uint32_t address, bool read)
+{
+    for (size_t k = 0 ; k < m_split ; k++)
+    {
+        if (m_pend_valid[k] && (m_pend_address[k] == address) && 
+            (m_pend_read[k] == read)) return k;
+    }
+    return m_split;
+} // end getPending()
+
+/////////////////////////////////////////////////////////////////
+// split mode : registers a new pending request. An entry is only
+// released by the retry of its request (a completed request is 
+// never replaced). Returns false if the pending table is full.
+/////////////////////////////////////////////////////////////////
+bool PibusSimpleRam::allocPending(uint32_t address, bool read)
+{
+    size_t free = m_split;
+    for (size_t k = 0 ; k < m_split ; k++)
+    {
+        if (not m_pend_valid[k]) { free = k; break; }
+    }
+    if (free == m_split) return false;
+    m_pend_valid[free]   = true;
+    m_pend_address[free] = address;
+    m_pend_read[free]    = read;
+    m_pend_counter[free] = m_latency;
+    m_pend_busy++;
+    return true;
+} // end allocPending()
+
 //////////////////////////////////////////////////////
 //	Functions used to manage the possible
 //	big-endianness of the simulation processor
@@ -100,109 +300,402 @@ bool IsBigEndian()
     return(byte[0] ? false : true); 
 }
 
-int swap_bytes (int LE)
+// This loop has no dependency between iterations,
+// and is vectorized by the compiler (byte shuffle).
+void swap_words (uint32_t* buf, size_t nwords)
+{
+    for (size_t word = 0 ; word < nwords ; word++)
+        buf[word] = __builtin_bswap32(buf[word]);
+}
+
+///////////////////////////////////////////////////////////////
+// returns the segment size rounded to the host page size
+// (or to the huge page size in hugepage mode)
+size_t PibusSimpleRam::getMappedSize(size_t seg)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (m_alloc_mode == RAM_ALLOC_HUGEPAGE) page = RAM_HUGEPAGE_SIZE;
+    return ((m_segsize[seg] + page - 1) / page) * page;
+}
+
+///////////////////////////////////////////////////////////////
+// returns the number of 4 Kbytes pages of a segment
+size_t PibusSimpleRam::getPages(size_t seg)
+{
+    return (m_segsize[seg] + (4 << RAM_PAGE_SHIFT) - 1) >> (RAM_PAGE_SHIFT + 2);
+}
+
+///////////////////////////////////////////////////////////////
+// returns the number of entries of the first level page table
+size_t PibusSimpleRam::getL1Size(size_t seg)
+{
+    size_t l1_bytes = (size_t)4 << (RAM_PAGE_SHIFT + RAM_L2_SHIFT);
+    return (m_segsize[seg] + l1_bytes - 1) / l1_bytes;
+}
+
+///////////////////////////////////////////////////////////////
+// releases all the pages (and second level tables) of a table
+void PibusSimpleRam::freeSparseTable(uint32_t*** table, size_t l1_size)
+{
+    for (size_t l1 = 0 ; l1 < l1_size ; l1++)
+    {
+        if (table[l1] == NULL) continue;
+        for (size_t l2 = 0 ; l2 < (1 << RAM_L2_SHIFT) ; l2++) delete [] table[l1][l2];
+        delete [] table[l1];
+    }
+    delete [] table;
+}
+
+///////////////////////////////////////////////////////////////
+// returns the page in the sparse table of a segment containing 
+// the word (index in the segment), or NULL if not allocated
+inline uint32_t* getSparsePage(uint32_t*** table, size_t word)
+{
+    uint32_t** l2 = table[word >> (RAM_PAGE_SHIFT + RAM_L2_SHIFT)];
+    if (l2 == NULL) return NULL;
+    return l2[(word >> RAM_PAGE_SHIFT) & ((1 << RAM_L2_SHIFT) - 1)];
+}
+
+///////////////////////////////////////////////////////////////
+// sparse mode : returns the value of a word (index in the 
+// segment). The pages are not allocated on a read.
+uint32_t PibusSimpleRam::readSparse(size_t seg, size_t word)
+{
+    uint32_t* page = getSparsePage(m_sparse[seg], word);
+    if (page == NULL) page = getSparsePage(m_sparse_image[seg], word);
+    if (page == NULL) return 0;
+    return page[word & ((1 << RAM_PAGE_SHIFT) - 1)];
+}
+
+///////////////////////////////////////////////////////////////
+// sparse mode : returns a pointer on a word (index in the 
+// segment). The page is allocated and initialised from the 
+// memory image if required.
+uint32_t* PibusSimpleRam::writeSparse(size_t seg, size_t word)
+{
+    uint32_t** &l2 = m_sparse[seg][word >> (RAM_PAGE_SHIFT + RAM_L2_SHIFT)];
+    if (l2 == NULL) 
+    {
+        l2 = new uint32_t*[1 << RAM_L2_SHIFT];
+        memset(l2, 0, sizeof(uint32_t*) << RAM_L2_SHIFT);
+    }
+    uint32_t* &page = l2[(word >> RAM_PAGE_SHIFT) & ((1 << RAM_L2_SHIFT) - 1)];
+    if (page == NULL)
+    {
+        if (m_free_pages.empty()) 
+        {
+            page = new uint32_t[1 << RAM_PAGE_SHIFT];
+        }
+        else
+        {
+            page = m_free_pages.back();
+            m_free_pages.pop_back();
+        }
+        uint32_t* image = getSparsePage(m_sparse_image[seg], word);
+        if (image) memcpy(page, image, 4 << RAM_PAGE_SHIFT);
+        else       memset(page, 0, 4 << RAM_PAGE_SHIFT);
+        m_sparse_pages++;
+    }
+    return &page[word & ((1 << RAM_PAGE_SHIFT) - 1)];
+}
+
+///////////////////////////////////////////////////////////////
+// sparse mode : builds the sparse memory image of a segment.
+// The image is built in a temporary anonymous mapping, and only
+// the pages touched by the loader (resident pages) and not
+// null are copied in the sparse image table.
+void PibusSimpleRam::buildSparseImage(size_t seg)
+{
+    size_t size  = getMappedSize(seg);
+    size_t hpage = (size_t)sysconf(_SC_PAGESIZE);
+    void*  buf   = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED)
+    {
+        printf("ERROR in component PibusSimpleRam %s\n", m_name);
+        printf("Cannot build the image of segment %s\n", m_segname[seg]);
+        exit(1);
+    }
+    buildImage(seg, (uint32_t*)buf, false);
+
+    std::vector<unsigned char> resident((size + hpage - 1) / hpage, 1);
+    mincore(buf, size, &resident[0]);
+
+    uint32_t* image = (uint32_t*)buf;
+    for (size_t word = 0 ; word < (m_segsize[seg] >> 2) ; word += (1 << RAM_PAGE_SHIFT))
+    {
+        if ((resident[(word << 2) / hpage] & 1) == 0) continue;
+        size_t nwords = (m_segsize[seg] >> 2) - word;
+        if (nwords > (1 << RAM_PAGE_SHIFT)) nwords = 1 << RAM_PAGE_SHIFT;
+        bool empty = true;
+        for (size_t i = 0 ; (i < nwords) && empty ; i++) empty = (image[word + i] == 0);
+        if (empty) continue;
+
+        uint32_t** &l2 = m_sparse_image[seg][word >> (RAM_PAGE_SHIFT + RAM_L2_SHIFT)];
+        if (l2 == NULL) 
+        {
+            l2 = new uint32_t*[1 << RAM_L2_SHIFT];
+            memset(l2, 0, sizeof(uint32_t*) << RAM_L2_SHIFT);
+        }
+        uint32_t* page = new uint32_t[1 << RAM_PAGE_SHIFT];
+        memset(page, 0, 4 << RAM_PAGE_SHIFT);
+        memcpy(page, &image[word], nwords << 2);
+        l2[(word >> RAM_PAGE_SHIFT) & ((1 << RAM_L2_SHIFT) - 1)] = page;
+    }
+    munmap(buf, size);
+}
+
+///////////////////////////////////////////////////////////////
+// This function builds the memory image of a segment in buf.
+// The buffer is not cleared when it is already zero-filled.
+void PibusSimpleRam::buildImage(size_t seg, uint32_t* buf, bool clear)
 {
-    int BE;
-    BE =   ((LE & 0xFF000000) >> 24 |
-            (LE & 0x00FF0000) >> 8  |
-            (LE & 0x0000FF00) << 8  |
-            (LE & 0x000000FF) << 24 ); 
-    return BE;
+    if (clear) memset( buf, 0, m_segsize[seg] );
+    m_loader.load( buf, m_segbase[seg], m_segsize[seg] );
+    if (IsBigEndian()) swap_words( buf, m_segsize[seg] >> 2 );
 }
 
+///////////////////////////////////////////////////////////////
+// This function restores the memory image in all segments.
+// In mapped and sparse modes, the images are built at the first
+// call. In dense and hugepage modes, the image is rebuilt by
+// the loader in the segment buffers at each call.
+void PibusSimpleRam::resetSegments()
+{
+    for ( size_t seg = 0 ; seg < m_nbseg ; seg++ )
+    {
+        if (m_alloc_mode == RAM_ALLOC_MAPPED)
+        {
+            size_t size = getMappedSize(seg);
+            if (not m_image_ok)
+            {
+                char filename[] = "/tmp/pibus_ram_XXXXXX";
+                int fd = mkstemp(filename);
+                if ((fd < 0) || (ftruncate(fd, size) != 0))
+                {
+                    printf("ERROR in component PibusSimpleRam %s\n", m_name);
+                    printf("Cannot create the image file for segment %s\n", m_segname[seg]);
+                    exit(1);
+                }
+                unlink(filename);
+                void* image = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (image == MAP_FAILED)
+                {
+                    printf("ERROR in component PibusSimpleRam %s\n", m_name);
+                    printf("Cannot map the image file for segment %s\n", m_segname[seg]);
+                    exit(1);
+                }
+                buildImage(seg, (uint32_t*)image, false);
+                munmap(image, size);
+                m_image_fd[seg] = fd;
+            }
+            // the private dirty pages are discarded by the new mapping
+            if (mmap(r_buf[seg], size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                     m_image_fd[seg], 0) == MAP_FAILED)
+            {
+                printf("ERROR in component PibusSimpleRam %s\n", m_name);
+                printf("Cannot map the image file for segment %s\n", m_segname[seg]);
+                exit(1);
+            }
+        }
+        else if (m_alloc_mode == RAM_ALLOC_SPARSE)
+        {
+            if (not m_image_ok) buildSparseImage(seg);
+            // the allocated pages are released in the free list
+            for (size_t l1 = 0 ; l1 < getL1Size(seg) ; l1++)
+            {
+                if (m_sparse[seg][l1] == NULL) continue;
+                for (size_t l2 = 0 ; l2 < (1 << RAM_L2_SHIFT) ; l2++)
+                {
+                    if (m_sparse[seg][l1][l2] == NULL) continue;
+                    m_free_pages.push_back(m_sparse[seg][l1][l2]);
+                    m_sparse[seg][l1][l2] = NULL;
+                }
+            }
+        }
+        else
+        {
+            buildImage(seg, r_buf[seg], true);
+        }
+        memset(m_page_gen[seg], 0, getPages(seg) * sizeof(uint32_t));
+    }
+    m_gen = 1;
+    m_image_ok = true;
+    m_sparse_pages = 0;
+} // end resetSegments()
+
 ////////////////////////////////////////////////////////////////////////
-void write_seg(uint32_t* tab, size_t index, uint32_t data, uint32_t opc)
+void write_seg(uint32_t* word, uint32_t data, uint32_t opc)
 {
     // The memory organisation is litle endian
-    switch (opc) {
-    case PIBUS_OPC_BY0 :  // write byte 0 
-	tab[index] = (tab[index] & 0xFFFFFF00) | (data & 0x000000FF);
-        break;
-    case PIBUS_OPC_BY1 :  // write byte 1 
-	tab[index] = (tab[index] & 0xFFFF00FF) | (data & 0x0000FF00);
-        break;
-    case PIBUS_OPC_BY2 :  // write byte 2 
-	tab[index] = (tab[index] & 0xFF00FFFF) | (data & 0x00FF0000);
-        break;
-    case PIBUS_OPC_BY3 :  // write byte 3 
-	tab[index] = (tab[index] & 0x00FFFFFF) | (data & 0xFF000000);
-        break;
-    case PIBUS_OPC_HW0 :  // write lower half  
-	tab[index] = (tab[index] & 0xFFFF0000) | (data & 0x0000FFFF);
-        break;
-    case PIBUS_OPC_HW1 :  // write upper half 
-	tab[index] = (tab[index] & 0x0000FFFF) | (data & 0xFFFF0000);
-        break;
-    case PIBUS_OPC_WDU :  // write word
-	tab[index] = data;
-        break;
-    case PIBUS_OPC_NOP :  // no write  
-        break;
-    default :
+    if (((PIBUS_OPC_WRITE_CODES >> opc) & 0x1) == 0)
+    {
 	printf("ERROR in PibusSimpleRam\n");
 	printf("illegal value of the PIBUS OPC field for a WRITE : %0x\n", opc);
 	printf("the supported values are : BY0/BY1/BY2/BY3\n");
 	printf("                           HW0/HW1/WDU/NOP\n");
 	exit(1);
-	break;
-    } // end switch 
+    }
+    uint32_t mask = pibus_opc_mask[opc];
+    *word = (*word & ~mask) | (data & mask);
 } // end write_seg()
 
+/////////////////////////////////////////////////////////////////
+//	Functional access (fast-forward mode)
+// The FSM registers are not modified. All words of a burst 
+// must be in the same segment.
+/////////////////////////////////////////////////////////////////
+bool PibusSimpleRam::functionalRead(uint32_t	address,
+				    uint32_t*	data,
+				    uint32_t	opc,
+				    size_t	burst)
+{
+    size_t index;
+    if (not getSegment(address, &index)) return false;
+    uint32_t word = (address - m_segbase[index]) >> 2;
+    if ((word + burst) > (m_segsize[index] >> 2)) return false;
+    for (size_t i = 0 ; i < burst ; i++) data[i] = readWord(index, word + i);
+    return true;
+} // end functionalRead()
+
+/////////////////////////////////////////////////////////////////
+bool PibusSimpleRam::functionalWrite(uint32_t		address,
+				     const uint32_t*	data,
+				     uint32_t		opc,
+				     size_t		burst)
+{
+    size_t index;
+    if (not getSegment(address, &index)) return false;
+    uint32_t word = (address - m_segbase[index]) >> 2;
+    if ((word + burst) > (m_segsize[index] >> 2)) return false;
+    for (size_t i = 0 ; i < burst ; i++) 
+    {
+        if ( m_monitor_ok )
+        {
+            uint32_t addr = address + 4*i;
+            if ( (addr >= m_monitor_base) and
+                 (addr <  m_monitor_base + m_monitor_length) )
+            {
+                std::cout << " RAM Change : address = " << std::hex << addr
+                          << " / data = " << data[i] << std::endl;
+            }
+        } 
+        uint32_t* ptr = writeWord(index, word + i);
+        if (opc == PIBUS_OPC_WDU) *ptr = data[i];
+        else                      write_seg(ptr, data[i], opc);
+    }
+    return true;
+} // end functionalWrite()
+
 /////////////////////////////////
 void PibusSimpleRam::transition()
 {
+#ifdef PIBUS_CLOCK_GATING
+    // woken up by p_sel or p_resetn : wait the clock edge
+    if ( m_sleep_transition )
+    {
+        m_sleep_transition = false;
+        if ( not p_ck.posedge() )
+        {
+            next_trigger( p_ck.posedge_event() );
+            return;
+        }
+    }
+#endif
+
     if (p_resetn == false) 
     {
         m_monitor_ok = false;
         r_fsm_state  = FSM_IDLE;
-        for ( size_t seg = 0 ; seg < m_nbseg ; seg++ )
-        {
-            memset( &r_buf[seg][0], 0, m_segsize[seg] );
-            m_loader.load( &r_buf[seg][0], m_segbase[seg], m_segsize[seg] );
-            if (IsBigEndian())  
-            {
-                for( size_t word = 0; word < (m_segsize[seg] >> 2); word++) 
-                  r_buf[seg][word] = swap_bytes(r_buf[seg][word]);
-            }
-        }
+        // the segments are restored once per reset sequence
+        if (not m_reset_done) resetSegments();
+        m_reset_done = true;
+        m_wptr       = NULL;
+        m_pend_busy  = 0;
+        for (size_t k = 0 ; k < m_split ; k++) m_pend_valid[k] = false;
+        c_trans_count = 0;
+        c_read_words  = 0;
+        c_write_words = 0;
+        c_retry_count = 0;
+        c_error_count = 0;
+        c_busy_cycles = 0;
         return;
     } // end p_resetn
 
+    m_reset_done = false;
+
+    // split mode : latency of the pending requests
+    if (m_pend_busy != 0)
+    {
+        for (size_t k = 0 ; k < m_split ; k++)
+        {
+            if (not m_pend_valid[k] || (m_pend_counter[k] == 0)) continue;
+            m_pend_counter[k]--;
+            if (m_pend_counter[k] == 0) m_pend_busy--;
+        }
+    }
+
+    if (r_fsm_state != FSM_IDLE) c_busy_cycles++;
+
     switch (r_fsm_state) {
     case FSM_IDLE :
     {
         if (p_sel == true) 
         {
             uint32_t address = ((uint32_t)p_a.read()) & 0xfffffffc; 
-            bool error = true;
-            for (size_t i = 0 ; ((i < m_nbseg) && (error == true)) ; i++) 
-            { 
-                if ((address >= m_segbase[i]) && (address < m_segbase[i] + m_segsize[i])) 
-                { 
-                    error=false;
-                    r_index = i;
-                    r_address  = address;
-                    r_opc   = (int) p_opc.read();
-                    
-                }  
-            }
-            if(error == false) 
+            size_t index;
+            c_trans_count++;
+            if(getSegment(address, &index)) 
             {
+                r_index   = index;
+                r_address = address;
+                r_opc     = (int) p_opc.read();
                 r_counter = m_latency;
-                if((p_read == true)  && (m_latency == 0))  r_fsm_state = FSM_READ_OK; 
-                if((p_read == true)  && (m_latency != 0))  r_fsm_state = FSM_READ_WAIT; 
-                if((p_read == false) && (m_latency == 0))  r_fsm_state = FSM_WRITE_OK; 
-                if((p_read == false) && (m_latency != 0))  r_fsm_state = FSM_WRITE_WAIT; 
+                bool read = p_read;
+                size_t k  = (m_latency != 0) ? getPending(address, read) : m_split;
+                if (k < m_split)			// retried request
+                {
+                    if (m_pend_counter[k] == 0)
+                    {
+                        m_pend_valid[k] = false;
+                        r_fsm_state = read ? FSM_READ_OK : FSM_WRITE_OK;
+                    }
+                    else
+                    {
+                        r_fsm_state = FSM_RETRY;
+                    }
+                }
+                else if ((m_latency != 0) && allocPending(address, read))	// new split request
+                {
+                    r_fsm_state = FSM_RETRY;
+                }
+                else
+                {
+                    if((read == true)  && (m_latency == 0))  r_fsm_state = FSM_READ_OK; 
+                    if((read == true)  && (m_latency != 0))  r_fsm_state = FSM_READ_WAIT; 
+                    if((read == false) && (m_latency == 0))  r_fsm_state = FSM_WRITE_OK; 
+                    if((read == false) && (m_latency != 0))  r_fsm_state = FSM_WRITE_WAIT; 
+                }
             } 
             else 
             {
                 r_fsm_state = FSM_ERROR;
             }
         }
+#ifdef PIBUS_CLOCK_GATING
+        else if (m_pend_busy == 0)
+        {
+            // sleep until the next selection or reset
+            m_sleep_transition = true;
+            next_trigger( p_sel.posedge_event() | p_resetn.negedge_event() );
+        }
+#endif
         break;
     }
     case FSM_ERROR :
+    case FSM_RETRY :
     {
+        if (r_fsm_state == FSM_RETRY) c_retry_count++;
+        else                          c_error_count++;
 	r_fsm_state = FSM_IDLE;
         break;
     }
@@ -214,12 +707,12 @@ void PibusSimpleRam::transition()
     }
     case FSM_READ_OK :
     {
+        c_read_words++;
 	if (p_sel == true) 
         {
             uint32_t address = ((uint32_t)p_a.read()) & 0xfffffffc; 
-            if ((address < m_segbase[r_index]) ||
-                ((address >= (m_segbase[r_index] + m_segsize[r_index])) ||
-                (p_read == false))) 
+            if (((address - m_segbase[r_index]) >= m_segsize[r_index]) ||
+                (p_read == false)) 
             { 
                 r_fsm_state = FSM_ERROR;
             } 
@@ -242,10 +735,16 @@ void PibusSimpleRam::transition()
     }
     case FSM_WRITE_OK :   
     {
+        c_write_words++;
 	uint32_t data     = (uint32_t)p_d.read(); 
         uint32_t address  = r_address.read();
         uint32_t word     = (r_address.read() - m_segbase[r_index.read()]) >> 2;
 
+        // The running pointer m_wptr is used for the successive words
+        // of a burst, and is only computed for the first word, or when
+        // a page boundary is crossed (sparse page or modified page).
+        uint32_t* ptr     = m_wptr ? m_wptr : writeWord(r_index, word);
+
         if ( m_monitor_ok )
         {
             if ( (address >= m_monitor_base) and
@@ -256,19 +755,25 @@ void PibusSimpleRam::transition()
             }
         } 
 
-  	write_seg(r_buf[r_index], word, data, r_opc);
+        if (r_opc == PIBUS_OPC_WDU) *ptr = data;
+  	else                        write_seg(ptr, data, r_opc);
+
+        m_wptr = NULL;
 	if (p_sel == true) 
         { 
-	    uint32_t address = ((uint32_t)p_a.read()) & 0xfffffffc; 
-	    if ((address < m_segbase[r_index]) || 
-		    (address >= m_segbase[r_index] + m_segsize[r_index]) ||
+	    uint32_t next = ((uint32_t)p_a.read()) & 0xfffffffc; 
+	    if (((next - m_segbase[r_index]) >= m_segsize[r_index]) ||
 		    (p_read == true)) 
             { 
                 r_fsm_state = FSM_ERROR;	
             } 
             else 
             {
-                r_address = address;
+                r_address = next;
+                r_opc     = (int) p_opc.read();	// byte enable of the next word
+                if ((next == address + 4) &&
+                    (((word + 1) & ((1 << RAM_PAGE_SHIFT) - 1)) != 0))
+                    m_wptr = ptr + 1;
             } 
 	} 
         else 
@@ -283,19 +788,40 @@ void PibusSimpleRam::transition()
 ///////////////////////////////
 void PibusSimpleRam::genMoore()
 {
+#ifdef PIBUS_CLOCK_GATING
+    // woken up by a FSM state change : wait the clock edge
+    if ( m_sleep_moore )
+    {
+        m_sleep_moore = false;
+        if ( not p_ck.negedge() )
+        {
+            next_trigger( p_ck.negedge_event() );
+            return;
+        }
+    }
+#endif
+
     switch(r_fsm_state) {
     case FSM_IDLE :  
+#ifdef PIBUS_CLOCK_GATING
+        // sleep until the FSM leaves the IDLE state
+        m_sleep_moore = true;
+        next_trigger( r_fsm_state.value_changed_event() );
+#endif
         break;
     case FSM_ERROR : 
         p_ack = PIBUS_ACK_ERROR;
         break;
+    case FSM_RETRY : 
+        p_ack = PIBUS_ACK_RETRY;
+        break;
     case FSM_READ_WAIT :
         p_ack = PIBUS_ACK_WAIT;
         p_d = 0;
         break;
     case FSM_READ_OK :
         p_ack = PIBUS_ACK_READY;
-        p_d = r_buf[r_index][(r_address.read() - m_segbase[r_index]) >> 2];
+        p_d = readWord(r_index, (r_address.read() - m_segbase[r_index]) >> 2);
         break;
     case FSM_WRITE_WAIT :
         p_ack = PIBUS_ACK_WAIT;
@@ -309,23 +835,14 @@ void PibusSimpleRam::genMoore()
 /////////////////////////////////////////////////
 void PibusSimpleRam::printTrace(uint32_t address)
 {
-    bool error = true;
     size_t index;
 
     if ( address )
     {
-        for (size_t i = 0 ; ((i < m_nbseg) && (error == true)) ; i++) 
-        { 
-            if ((address >= m_segbase[i]) && (address < m_segbase[i] + m_segsize[i])) 
-            { 
-                error = false;
-                index = i;
-                break;
-            }  
-        }
+        bool error = not getSegment(address, &index);
         if ( not error )
         {
-            uint32_t data = r_buf[index][(address - m_segbase[index]) >> 2];
+            uint32_t data = readWord(index, (address - m_segbase[index]) >> 2);
             std::cout << m_name << " : address = " << std::hex << address
                       << " data = " <<  data << std::endl;
         }
@@ -353,4 +870,144 @@ void PibusSimpleRam::stopMonitor()
     m_monitor_ok	= false;
 }
 
+/////////////////////////////////////////////////////////////////
+//	Checkpoint
+// The pages modified since the reset (generation not null), or
+// since the parent checkpoint (current generation) are saved.
+// The restored pages are registered in the current generation,
+// and the generation is incremented by a save or a restore.
+/////////////////////////////////////////////////////////////////
+bool PibusSimpleRam::checkpointReady()
+{
+    return (r_fsm_state == FSM_IDLE);
+}
+
+//////////////////////////////////////////////////////////////////////
+void PibusSimpleRam::saveState(PibusCheckpointWriter &writer)
+{
+    writer.put(r_fsm_state);
+    writer.put(r_counter);
+    writer.put(r_index);
+    writer.put(r_address);
+    writer.put(r_opc);
+    writer.put(m_pend_busy);
+    writer.putArray(m_pend_valid, m_split);
+    writer.putArray(m_pend_address, m_split);
+    writer.putArray(m_pend_read, m_split);
+    writer.putArray(m_pend_counter, m_split);
+    writer.put(m_nbseg);
+
+    uint32_t page[1 << RAM_PAGE_SHIFT];
+    for (size_t seg = 0 ; seg < m_nbseg ; seg++)
+    {
+        uint32_t npages = 0;
+        for (size_t p = 0 ; p < getPages(seg) ; p++)
+        {
+            if (writer.isIncremental() ? (m_page_gen[seg][p] == m_gen)
+                                       : (m_page_gen[seg][p] != 0)) npages++;
+        }
+        writer.put(m_segsize[seg]);
+        writer.put(npages);
+        for (size_t p = 0 ; p < getPages(seg) ; p++)
+        {
+            if (writer.isIncremental() ? (m_page_gen[seg][p] != m_gen)
+                                       : (m_page_gen[seg][p] == 0)) continue;
+            size_t word   = p << RAM_PAGE_SHIFT;
+            size_t nwords = (m_segsize[seg] >> 2) - word;
+            if (nwords > (1 << RAM_PAGE_SHIFT)) nwords = 1 << RAM_PAGE_SHIFT;
+            memset(page, 0, sizeof(page));
+            for (size_t i = 0 ; i < nwords ; i++) page[i] = readWord(seg, word + i);
+            writer.putPage(p, page);
+        }
+    }
+    m_gen++;
+} // end saveState()
+
+//////////////////////////////////////////////////////////////////////
+void PibusSimpleRam::restoreState(PibusCheckpointReader &reader)
+{
+    size_t nbseg;
+    reader.get(r_fsm_state);
+    reader.get(r_counter);
+    reader.get(r_index);
+    reader.get(r_address);
+    reader.get(r_opc);
+    reader.get(m_pend_busy);
+    reader.getArray(m_pend_valid, m_split);
+    reader.getArray(m_pend_address, m_split);
+    reader.getArray(m_pend_read, m_split);
+    reader.getArray(m_pend_counter, m_split);
+    reader.get(nbseg);
+    if (nbseg != m_nbseg)
+    {
+        printf("ERROR in component PibusSimpleRam %s\n", m_name);
+        printf("The checkpoint segments do not match the RAM segments\n");
+        exit(1);
+    }
+
+    // the pages can be mapped if the host pages are 4 Kbytes
+    bool mapped = (m_alloc_mode == RAM_ALLOC_MAPPED) &&
+                  (sysconf(_SC_PAGESIZE) == (4 << RAM_PAGE_SHIFT));
+    for (size_t seg = 0 ; seg < m_nbseg ; seg++)
+    {
+        uint32_t size;
+        uint32_t npages;
+        reader.get(size);
+        reader.get(npages);
+        if (size != m_segsize[seg])
+        {
+            printf("ERROR in component PibusSimpleRam %s\n", m_name);
+            printf("The checkpoint segments do not match the RAM segments\n");
+            exit(1);
+        }
+        for (size_t k = 0 ; k < npages ; k++)
+        {
+            uint32_t    p;
+            off_t       offset;
+            const void* page = reader.getPage(&p, &offset);
+            if (p >= getPages(seg))
+            {
+                printf("ERROR in component PibusSimpleRam %s\n", m_name);
+                printf("Illegal page index in the checkpoint\n");
+                exit(1);
+            }
+            size_t word   = p << RAM_PAGE_SHIFT;
+            size_t nwords = (m_segsize[seg] >> 2) - word;
+            if (nwords > (1 << RAM_PAGE_SHIFT)) nwords = 1 << RAM_PAGE_SHIFT;
+            if (mapped && page)
+            {
+                if (mmap(&r_buf[seg][word], 4 << RAM_PAGE_SHIFT, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_FIXED, reader.getFd(), offset) == MAP_FAILED)
+                {
+                    printf("ERROR in component PibusSimpleRam %s\n", m_name);
+                    printf("Cannot map the checkpoint page %d of segment %s\n",
+                           p, m_segname[seg]);
+                    exit(1);
+                }
+            }
+            else
+            {
+                // the generation is set by writeWord()
+                uint32_t* ptr = writeWord(seg, word);
+                if (page) memcpy(ptr, page, nwords << 2);
+                else      memset(ptr, 0, nwords << 2);
+            }
+            m_page_gen[seg][p] = m_gen;
+        }
+    }
+    m_wptr = NULL;
+    m_gen++;
+} // end restoreState()
+
+//////////////////////////////////////////////////////////////////////
+void PibusSimpleRam::registerCounters(PibusCounterRegistry &registry)
+{
+    registry.add(m_name, "trans_count", &c_trans_count);
+    registry.add(m_name, "read_words",  &c_read_words);
+    registry.add(m_name, "write_words", &c_write_words);
+    registry.add(m_name, "retry_count", &c_retry_count);
+    registry.add(m_name, "error_count", &c_error_count);
+    registry.add(m_name, "busy_cycles", &c_busy_cycles);
+}
+
 }} // end namespaces
@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////
+// File : pibus_snoop_filter.h
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// This object is a snoop filter, used by the snooping caches to reject
+// most external writes without a cache directory lookup.
+// It is a counting filter : the address space is divided in pages,
+// and each page is mapped (by a hash function) on one counter, that
+// contains the number of valid cache lines belonging to the pages
+// mapped on this counter. The cache must call the insert() method
+// when a line is written in the cache, and the remove() method when
+// a valid line is invalidated (or replaced), and the reset() method
+// when the cache is flushed.
+// The mayContain() method returns false when the cache cannot contain
+// the address. There is no false negative, and the false positive
+// rate depends on the number of counters.
+// When the number of counters is 0, the filter is not active, and
+// the mayContain() method always returns true.
+///////////////////////////////////////////////////////////////////////////
+// The constructor has 2 parameters :
+// - size_t	nentries	: number of counters (power of 2, or 0)
+// - size_t	page_shift	: log2 of the page size (default = 12)
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef PIBUS_SNOOP_FILTER_H
+#define PIBUS_SNOOP_FILTER_H
+
+#include <vector>
+#include <stdint.h>
+#include <iostream>
+#include <cstdlib>
+
+namespace soclib { namespace caba {
+
+class PibusSnoopFilter {
+
+std::vector<uint32_t>	m_counters;	// number of valid lines per entry
+const size_t		m_page_shift;	// log2 of the page size
+size_t			m_index_bits;	// log2 of the number of counters
+uint64_t		c_lookup_count;	// number of mayContain() calls
+uint64_t		c_reject_count;	// number of rejected addresses
+
+public:
+
+/////////////////////////////////////////////////////////////
+PibusSnoopFilter(size_t nentries, size_t page_shift = 12)
+	: m_counters(nentries, 0),
+	  m_page_shift(page_shift),
+	  m_index_bits(0),
+	  c_lookup_count(0),
+	  c_reject_count(0)
+{
+	if ( (nentries & (nentries - 1)) != 0 )
+	{
+		std::cerr << "ERROR in PibusSnoopFilter" << std::endl;
+		std::cerr << "The number of entries must be a power of 2" << std::endl;
+		exit(0);
+	}
+	while (((size_t)1 << m_index_bits) < nentries) m_index_bits++;
+};
+
+///////////////////////////////////////////
+// hash function : page number folding
+///////////////////////////////////////////
+size_t getIndex(uint32_t address) const
+{
+	uint32_t page = address >> m_page_shift;
+	if (m_index_bits != 0) page = page ^ (page >> m_index_bits);
+	return page & (m_counters.size() - 1);
+};
+////////////////////////
+bool isActive() const
+{
+	return not m_counters.empty();
+};
+////////////////////////////////
+void insert(uint32_t address)
+{
+	if (m_counters.empty()) return;
+	m_counters[getIndex(address)]++;
+};
+////////////////////////////////
+void remove(uint32_t address)
+{
+	if (m_counters.empty()) return;
+	size_t k = getIndex(address);
+	if (m_counters[k] != 0) m_counters[k]--;
+};
+////////////
+void reset()
+{
+	for (size_t k = 0 ; k < m_counters.size() ; k++) m_counters[k] = 0;
+};
+////////////////////////////////////
+bool mayContain(uint32_t address)
+{
+	if (m_counters.empty()) return true;
+	c_lookup_count++;
+	if (m_counters[getIndex(address)] != 0) return true;
+	c_reject_count++;
+	return false;
+};
+////////////////////////////////
+uint64_t getLookupCount() const
+{
+	return c_lookup_count;
+};
+////////////////////////////////
+uint64_t getRejectCount() const
+{
+	return c_reject_count;
+};
+
+}; // end class PibusSnoopFilter
+
+}} // end namespaces
+
+#endif
@@ -1,417 +1,325 @@
-/**************************************************************************
- * File : pibus_target_multi_fifos.h
- * Date : 20/08/2006
- * author : Daniela Genius & Alain Greiner
- * Copyright : UPMC - LIP6
- *
- * This component is a generic PIBUs controler, acting as a slave
- * on the PIBUS. It can be used to interface any hardware coprocessor.
- * It provides six different communication services:
- * - Up to 4 Read Fifos from which the coprocessor can read data.
- * - Up to 4 Write Fifos to which the coprocessor can write data.
- * _ Up to 4 coprocessor Configuration Registers (write)
- * - Up to 4 coprocessor Status Registers (read)
- * - One Soft Reset pseudo register (write)
- * - One Strobe pseudo register (write)
- * A threshold interrupt is issued when a Write Fifo is "nearly" full,
- * or a Read Fifo is "nearly" empty. 
- * The threshold is a parameter for input/output fifos.
- *
- * This component decodes bits A6 to A2 of the ADDRESS :
- *  - bits A6/A5/A4 define the access type    
- *         0  0  0 : Soft Reset
- *         0  0  1 : Strobe    
- *         0  1  0 : Configuraytion Registers
- *         0  1  1 : Status Registers
- *         1  0  0 : Read Fifo Data
- *         1  0  1 : Read Fifo Status
- *         1  1  0 : Write Fido Data
- *         1  1  1 : Write Fifo Status
- *  - bits A3/A2 define the FIFO or register index 
- ****************************************************************************
- * This component has 8 "template" parameters
- * - int	N_FIFO_READ	: number of Read Fifos
- * - int	N_FIFO_WRITE	: number of Write Fifos
- * - int	FIFO_READ_SIZE	: depth of Read Fifos
- * - int	FIFO_WRITE_SIZE	: depth of Write Fifos
- * - int  	THRESHOLD_READ	: threshold value for all Read Fifos
- * _ int  	THRESHOLD_WRITE	: threshold value for all Write Fifos
- * - int  	N_CONFIG_REG	: number of Configuration Registers
- * - int  	N_STATUS_REG	: number of Status Registers
- ****************************************************************************
- * This component has 3 "constructor" parameters
- * - sc_module_name 	name	: instance name
- * - int		index	: PIBUS target index
- * - pibusSegmentTable	segtab	: segment table
- ****************************************************************************/
+//////////////////////////////////////////////////////////////////////////
+// File : pibus_target_multi_fifos.h
+// Author : Daniela Genius & Alain Greiner
+// Date : 20/08/2006
+// This program is released under the GNU Public License
+// Copyright : UPMC-LIP6
+//////////////////////////////////////////////////////////////////////////
+// This component is a generic PIBUS controler, acting as a slave
+// on the PIBUS. It can be used to interface any hardware coprocessor.
+// It provides six different communication services:
+// - Up to 4 Read Fifos from which the coprocessor can read data.
+// - Up to 4 Write Fifos to which the coprocessor can write data.
+// - Up to 4 coprocessor Configuration Registers (write)
+// - Up to 4 coprocessor Status Registers (read)
+// - One Soft Reset pseudo register (write)
+// - One Strobe pseudo register (write)
+// A threshold interrupt is issued when a Write Fifo is "nearly" full,
+// or a Read Fifo is "nearly" empty.
+// The threshold is a parameter for input/output fifos.
+//
+// This component decodes bits A6 to A2 of the ADDRESS :
+//  - bits A6/A5/A4 define the access type
+//         0  0  0 : Soft Reset			(write)
+//         0  0  1 : Strobe    			(write)
+//         0  1  0 : Configuration Registers	(write)
+//         0  1  1 : Status Registers		(read)
+//         1  0  0 : Read Fifo Data		(write)
+//         1  0  1 : Read Fifo Status		(read)
+//         1  1  0 : Write Fifo Data		(read)
+//         1  1  1 : Write Fifo Status		(read)
+//  - bits A3/A2 define the FIFO or register index
+// A Fifo Status read returns the number of words in the FIFO.
+// An access with a wrong direction, or to a FIFO or register index
+// larger than the template parameter, returns a bus error.
+//
+// All template parameters are compile-time constants : the FIFOs are
+// PibusRingFifo objects (power of 2 ring buffers, in the component
+// object, indexed by a mask), and the decode of the access type and
+// index is a switch on constant bounds. There is no allocation.
+// The FIFO depths must be powers of 2.
+//
+// Burst transactions are supported : the access type and the index
+// are decoded from the first address of the transaction, and all
+// words of a burst access the same FIFO (or register), whatever
+// their address (the addresses are only checked against the segment).
+// A master can therefore move a whole burst (up to 32 words) between
+// a memory buffer and a FIFO in one transaction. A burst word is
+// acknowledged with PIBUS_ACK_WAIT as long as the FIFO is full
+// (Read Fifo Data) or empty (Write Fifo Data).
+//
+// The coprocessor is connected to the FIFOs by the DOUT/ROK/R and
+// DIN/WOK/W ports (one word per cycle), or it can be a C++ model
+// using the zero-copy host interface :
+// - readFifoSpan() returns a pointer on the contiguous words available
+//   in a Read Fifo, and readFifoRelease() consumes these words.
+// - writeFifoSpan() returns a pointer on the contiguous free words in
+//   a Write Fifo, and writeFifoCommit() appends the written words.
+// The spans are contiguous up to the end of the ring buffer : a model
+// makes a second call after the wrap. The released and committed
+// words are registered, and applied to the FIFO state by the next
+// transition(), as the R and W ports : the FIFO state used by the
+// PIBUS responses is therefore not modified between the genMoore()
+// and the transition(), and the model can be called from any process
+// or from sc_main. The coprocessor ports must be bound (the R and W
+// ports to false signals) when a C++ model is used.
+//
+// The following 64 bits counters can be registered in a
+// PibusCounterRegistry (registerCounters() method) : transactions,
+// words written in the Read Fifos, words read from the Write Fifos,
+// WAIT cycles, and bus errors.
+//
+// This component implements the PibusCheckpointable interface, and can
+// be checkpointed when the FSM is IDLE. The FIFOs contents, the
+// registers, and the released / committed words of the host interface
+// are saved. The coprocessor state is not saved by this component.
+/////////////////////////////////////////////////////////////////////////
+// This component has 8 "template" parameters
+// - int	N_FIFO_READ	: number of Read Fifos
+// - int	N_FIFO_WRITE	: number of Write Fifos
+// - int	FIFO_READ_SIZE	: depth of Read Fifos (power of 2)
+// - int	FIFO_WRITE_SIZE	: depth of Write Fifos (power of 2)
+// - int  	THRESHOLD_READ	: threshold value for all Read Fifos
+// - int  	THRESHOLD_WRITE	: threshold value for all Write Fifos
+// - int  	N_CONFIG_REG	: number of Configuration Registers
+// - int  	N_STATUS_REG	: number of Status Registers
+/////////////////////////////////////////////////////////////////////////
+// This component has 3 "constructor" parameters
+// - sc_module_name 	name	: instance name
+// - size_t		tgtid	: PIBUS target index
+// - PibusSegmentTable	segtab	: segment table
+/////////////////////////////////////////////////////////////////////////
 
 #ifndef PIBUS_TARGET_MULTI_FIFOS_H
 #define PIBUS_TARGET_MULTI_FIFOS_H
 
-#include "systemc.h"
-#include "shared/soclib_generic_fifo.h"
+#include <systemc.h>
 #include "pibus_mnemonics.h"
-			
-
-template <int 	 N_FIFO_READ, 
-            int  N_FIFO_WRITE,
-            int  FIFO_READ_SIZE,
-            int  FIFO_WRITE_SIZE,
-            int  THRESHOLD_READ,
-            int  THRESHOLD_WRITE,
-            int  N_CONFIG_REG,
-            int  N_STATUS_REG>
-
-struct PIBUS_TARGET_MULTI_FIFOS : sc_module {
-
-//PIBUS ports
-
-sc_in<bool>             	CLK;
-sc_in<bool>             	RESETN;
-
-sc_in<bool>			PI_READ;
-sc_in<bool>			PI_SEL;
-sc_in<bool>			PI_TOUT;
-sc_in< sc_uint<4> >		PI_OPC;
-sc_in< sc_uint<32> >		PI_A;
-sc_inout<sc_uint<32> >		PI_D;
-sc_inout< sc_uint<3> >		PI_ACK;	
-
-sc_out<sc_uint<32> >		DOUT[N_FIFO_READ];                       
-sc_out<bool> 			ROK[N_FIFO_READ];
-sc_in<bool> 			R[N_FIFO_READ];
-
-sc_in<sc_uint<32> >		DIN[N_FIFO_WRITE];                       
-sc_out<bool> 			WOK[N_FIFO_WRITE];
-sc_in<bool> 			W[N_FIFO_WRITE];
-
-sc_out<int>  			CONFIG[N_CONFIG_REG];
-sc_in<sc_uint<32> > 		STATUS[N_STATUS_REG];
-
-sc_out<bool>            	SOFTRESET;
-sc_out<bool>            	STROBE;
-
-sc_out<bool>			FIFO_READ_IRQ[N_FIFO_READ];
-sc_out<bool>			FIFO_WRITE_IRQ[N_FIFO_WRITE];
-
-// STRUCTURAL PARAMETERS
-const char 			*NAME;
-int				IDENT;
-int				BASE;
-int				SIZE;
-
-// REGISTERS
-
-sc_register<int>		STATE;
-sc_register<int>		INDEX;
-sc_register<int>	  	COPROC_CONFIG[N_CONFIG_REG];
-sc_register<int>		COPROC_STATUS[N_STATUS_REG];
-
-soclib_generic_fifo<FIFO_READ_SIZE,32>	FIFO_R[N_FIFO_READ];
-soclib_generic_fifo<FIFO_WRITE_SIZE,32>	FIFO_W[N_FIFO_WRITE];
-
-// States of  FSM
-
-enum { 
-	FSM_IDLE   		= 0x0,
-	FSM_ERROR  		= 0x1,
-	FSM_STS_READ		= 0x2,
-	FSM_DATA_READ		= 0x3,
-	FSM_STS_WRITE		= 0x4,
-	FSM_DATA_WRITE		= 0x5,
-	FSM_COPROC_STATUS	= 0x6,
-	FSM_COPROC_CONFIG	= 0x7,	
-        FSM_SOFTRESET		= 0x8,
-	FSM_STROBE		= 0x9,
-
-};
-
-/////////////////////////////////////////////
-// 	Transition()   
-/////////////////////////////////////////////
- 
-void Transition()
-{
-
-bool		fifo_w[N_FIFO_WRITE];
-bool		fifo_r[N_FIFO_READ];
-
-if(RESETN == false) {  
- 	for(int n=0; n < N_FIFO_READ; n++){	FIFO_R[n].init(); }
- 	for(int n=0; n < N_FIFO_WRITE; n++){	FIFO_W[n].init(); }
-	for(int n = 0 ; n < N_CONFIG_REG ; n++) { COPROC_CONFIG[n]= 0; }
-	STATE = FSM_IDLE;
-	INDEX = 0;
-	return;
-}
-
-//read coprocessor status registers
-for(int n=0 ; n<N_STATUS_REG; n++) { COPROC_STATUS[n]= STATUS[n].read(); }
-
-// fifo read
-for(int n=0; n<N_FIFO_READ; n++){ fifo_r[n] = false; }
-
-// fifo write
-for(int n=0; n<N_FIFO_WRITE; n++){ fifo_w[n] = false; }
-
-switch (STATE) { 
-case FSM_IDLE :
-	if (PI_SEL == true) {
-		int  addr = PI_A.read(); 
-		INDEX = (addr >> 2) & 0x3; 	// bits 3 and 2 define the index
-		int cmd = (addr >>4) & 0x7; 	// bits 4, 5 and 6 define the commnand
-		if ((addr < BASE) || (addr > BASE + SIZE)) {
-		    	STATE = FSM_ERROR;
-		} else {
-			switch (cmd) {
-			case 0x0: //Soft Reset
-				STATE = FSM_SOFTRESET;
-			break;
-			case 0x1: //Strobe
-				STATE = FSM_STROBE;
-			break;
-			case 0x2: //Config register
-				STATE = FSM_COPROC_CONFIG;
-			break;
-			case 0x3: //Status register
-				STATE = FSM_COPROC_STATUS;
-			break;
-			case 0x4: //FIFO Read Data
-				STATE = FSM_DATA_READ;
-			break;
-			case 0x5: //FIFO Read Status
-				STATE = FSM_STS_READ;
-			break;
-			case 0x6: //FIFO Write Data
-				STATE = FSM_DATA_WRITE;
-			break;
-			case 0x7: //FIFO Write Status
-				STATE = FSM_STS_WRITE;
-			break;
-			} // end switch cmd
-		}
-	} // endif PI_SEL
-break; 
-case FSM_ERROR :  
-	STATE=FSM_IDLE;
-break;
-case FSM_STS_READ :	
-	STATE=FSM_IDLE;	
-break;
-case FSM_STS_WRITE : 
-	STATE=FSM_IDLE;
-break;
-case FSM_DATA_READ : 
-	fifo_r[INDEX] = true; 
-	if(FIFO_R[INDEX].wok() == true) {STATE=FSM_IDLE;}
-break;
-case FSM_DATA_WRITE : 
-	fifo_w[INDEX] = true;
-	if(FIFO_W[INDEX].rok() == true) {STATE=FSM_IDLE;}
-break;
-case FSM_COPROC_CONFIG : 
-        COPROC_CONFIG[INDEX]=(sc_uint<32>)PI_D.read();
-	STATE=FSM_IDLE;	
-break;
-case FSM_COPROC_STATUS :
-	STATE=FSM_IDLE;
-break; 
-case FSM_SOFTRESET : 
-        for(int n=0; n<N_FIFO_READ; n++){ FIFO_R[n].init(); }
- 	for(int n=0; n<N_FIFO_WRITE; n++){ FIFO_W[n].init(); }
-	STATE = FSM_IDLE;
-break;
-case FSM_STROBE : 
-	STATE=FSM_IDLE;
-break;
-} // end switch STATE
-
-for (int n = 0 ; n < N_FIFO_READ ; n++) {
-	if((fifo_r[n] == true ) && (R[n] == false)) { FIFO_R[n].simple_put(PI_D.read()); }  
-	if((fifo_r[n] == true ) && (R[n] == true )) { FIFO_R[n].put_and_get(PI_D.read()); } 
-	if((fifo_r[n] == false) && (R[n] == true )) { FIFO_R[n].simple_get();  }
-	}
-
-for (int n = 0 ; n < N_FIFO_WRITE ; n++) {
-	if((fifo_w[n] == true ) && (W[n] == false)) { FIFO_W[n].simple_get(); }
-	if((fifo_w[n] == true ) && (W[n] == true )) { FIFO_W[n].put_and_get(DIN[n].read());  } 
-	if((fifo_w[n] == false) && (W[n] == true )) { FIFO_W[n].simple_put(DIN[n].read());  }
-	}
-
-};  // end Transition()
-
-/////////////////////////////////////////////
-// 	GenMoore()    
-/////////////////////////////////////////////
-
-void GenMoore()
-{
-
-// interface coprocessor FIFO Read
-for(int n=0;n<N_FIFO_READ;n++){
-  	DOUT[n] = FIFO_R[n].read();
-  	ROK[n]  = FIFO_R[n].rok();
-	}
-
-// interface coprocessor FIFO Write
-for(int n=0;n<N_FIFO_WRITE;n++){
-  	WOK[n]  = FIFO_W[n].wok(); 
-	}
-
-// interface coprocessor configuration registers
-for(int n=0;n<N_CONFIG_REG;n++){
-  	CONFIG[n] = (sc_uint<32>)COPROC_CONFIG[n];
-	}
-
-//  signals SOFTRESET, STROBE, PI_D and PI_ACK
-switch (STATE) { 
-  	case FSM_IDLE : 
-	SOFTRESET = false;
-	STROBE = false;
-	break; 
-	
-	case FSM_ERROR :
-	SOFTRESET = false;
-	STROBE = false;
-	PI_ACK=ACK_ERR;
-	break;
-		
-	case FSM_STS_READ :   
-	SOFTRESET = false;
-	STROBE = false;
-	PI_D=(sc_uint<32>)FIFO_R[INDEX].filled_status();
-	PI_ACK=ACK_RDY;
-	break;
-	
-	case FSM_STS_WRITE :
-	SOFTRESET = false;
-	STROBE = false;	
-	PI_D=(sc_uint<32>)FIFO_W[INDEX].filled_status();
-	PI_ACK=ACK_RDY;
-	break;
-
-	case FSM_DATA_READ : 
-	SOFTRESET = false;
-	STROBE = false;					
-	if(FIFO_R[INDEX].wok() == true) PI_ACK=ACK_RDY;
-	else				PI_ACK=ACK_WAT;
-	break;
-
-	case FSM_DATA_WRITE :
-	SOFTRESET = false;
-	STROBE = false;	
-	if(FIFO_W[INDEX].rok() == true) PI_ACK=ACK_RDY;
-	else				PI_ACK=ACK_WAT;
-	PI_D.write(FIFO_W[INDEX].read());	
-	break;
-    
-	case FSM_COPROC_CONFIG : 
-	SOFTRESET = false;
-	STROBE = false;	
-	PI_ACK=ACK_RDY;
-	break;
-
-        case FSM_COPROC_STATUS :  
-	SOFTRESET = false;
-	STROBE = false;	
-	PI_ACK=ACK_RDY;	
-	PI_D=(sc_uint<32>)COPROC_STATUS[INDEX].read();
-	break;
-		
- 	case FSM_SOFTRESET :
-	SOFTRESET = true;
-	STROBE = false;
-	PI_ACK=ACK_RDY;
-	break;
- 
-	case FSM_STROBE :
-	SOFTRESET = false;
-	STROBE = true;
-	PI_ACK=ACK_RDY;
-	break;
-} // end switch
-
-// IRQs: one vector each for read and write
-  
-for(int n=0; n<N_FIFO_READ; n++){
-    if(FIFO_R[n].filled_status()<THRESHOLD_READ){
-        FIFO_READ_IRQ[n] = true;
-    } else {
-        FIFO_READ_IRQ[n] = false;
-    }	    
-}
-
-for(int n=0; n<N_FIFO_WRITE; n++){
-    if(FIFO_W[n].filled_status()>=THRESHOLD_WRITE){
-        FIFO_WRITE_IRQ[n] = true;
-    } else {
-        FIFO_WRITE_IRQ[n] = false;
+#include "pibus_segment_table.h"
+#include "pibus_counter_registry.h"
+#include "pibus_checkpoint.h"
+
+namespace soclib { namespace caba {
+
+////////////////////////////////////////////////////////////////////
+// This object is a ring buffer of DEPTH 32 bits words. DEPTH must be
+// a power of 2 : the read and write pointers are free running
+// counters, and the buffer is indexed by the pointer masked by
+// DEPTH-1. The number of words is the pointers difference.
+////////////////////////////////////////////////////////////////////
+template<int DEPTH>
+class PibusRingFifo {
+
+	// compile-time check : DEPTH must be a non zero power of 2
+	typedef char depth_check[((DEPTH > 0) && ((DEPTH & (DEPTH - 1)) == 0)) ? 1 : -1];
+
+	enum { MASK = DEPTH - 1 };
+
+	uint32_t	m_data[DEPTH];
+	uint32_t	m_rptr;		// read pointer (free running)
+	uint32_t	m_wptr;		// write pointer (free running)
+
+public:
+
+	void init()
+	{
+		m_rptr = 0;
+		m_wptr = 0;
+	};
+	uint32_t filled() const
+	{
+		return m_wptr - m_rptr;
+	};
+	bool rok() const
+	{
+		return (m_wptr != m_rptr);
+	};
+	bool wok() const
+	{
+		return ((m_wptr - m_rptr) != (uint32_t)DEPTH);
+	};
+	uint32_t read() const
+	{
+		return m_data[m_rptr & MASK];
+	};
+	void put(uint32_t data)
+	{
+		m_data[m_wptr & MASK] = data;
+		m_wptr++;
+	};
+	void get()
+	{
+		m_rptr++;
+	};
+	// contiguous words from the read pointer + skip
+	const uint32_t* readSpan(uint32_t skip, size_t* nwords) const
+	{
+		uint32_t ptr   = m_rptr + skip;
+		uint32_t avail = m_wptr - ptr;
+		uint32_t tail  = DEPTH - (ptr & MASK);
+		*nwords = (avail < tail) ? avail : tail;
+		return &m_data[ptr & MASK];
+	};
+	// contiguous free words from the write pointer + skip
+	uint32_t* writeSpan(uint32_t skip, size_t* nwords)
+	{
+		uint32_t ptr   = m_wptr + skip;
+		uint32_t avail = DEPTH - (ptr - m_rptr);
+		uint32_t tail  = DEPTH - (ptr & MASK);
+		*nwords = (avail < tail) ? avail : tail;
+		return &m_data[ptr & MASK];
+	};
+	void release(uint32_t nwords)
+	{
+		m_rptr += nwords;
+	};
+	void commit(uint32_t nwords)
+	{
+		m_wptr += nwords;
+	};
+	void save(PibusCheckpointWriter &writer) const
+	{
+		writer.put(m_rptr);
+		writer.put(m_wptr);
+		writer.putArray(m_data, DEPTH);
+	};
+	void restore(PibusCheckpointReader &reader)
+	{
+		reader.get(m_rptr);
+		reader.get(m_wptr);
+		reader.getArray(m_data, DEPTH);
+	};
+};	// end class PibusRingFifo
+
+template <int	N_FIFO_READ,
+          int	N_FIFO_WRITE,
+          int	FIFO_READ_SIZE,
+          int	FIFO_WRITE_SIZE,
+          int	THRESHOLD_READ,
+          int	THRESHOLD_WRITE,
+          int	N_CONFIG_REG,
+          int	N_STATUS_REG>
+class PibusTargetMultiFifos : sc_core::sc_module, public PibusCheckpointable {
+
+    // compile-time checks of the template parameters
+    typedef char nfifo_check[((N_FIFO_READ  >= 1) && (N_FIFO_READ  <= 4) &&
+                               (N_FIFO_WRITE >= 1) && (N_FIFO_WRITE <= 4)) ? 1 : -1];
+    typedef char nreg_check[((N_CONFIG_REG >= 1) && (N_CONFIG_REG <= 4) &&
+                              (N_STATUS_REG >= 1) && (N_STATUS_REG <= 4)) ? 1 : -1];
+    typedef char size_check[((FIFO_READ_SIZE  <= 256) && (FIFO_WRITE_SIZE <= 256)) ? 1 : -1];
+
+    //  REGISTERS
+    sc_register<int>			r_fsm_state;
+    sc_register<int>			r_index;
+    sc_register<uint32_t>		r_config[N_CONFIG_REG];
+    sc_register<uint32_t>		r_status[N_STATUS_REG];
+    PibusRingFifo<FIFO_READ_SIZE>	r_fifo_read[N_FIFO_READ];
+    PibusRingFifo<FIFO_WRITE_SIZE>	r_fifo_write[N_FIFO_WRITE];
+
+    //  HOST INTERFACE
+    uint32_t				m_read_release[N_FIFO_READ];	// released words
+    uint32_t				m_write_commit[N_FIFO_WRITE];	// committed words
+
+    //  STRUCTURAL PARAMETERS
+    const char*				m_name;		// instance name
+    const size_t			m_tgtid;	// target index
+    uint32_t				m_segbase;	// segment base
+    uint32_t				m_segsize;	// segment size
+    const char*				m_segname;	// segment name
+    char				m_fsm_str[10][20];	// FSM states names
+
+    //  INSTRUMENTATION
+    uint64_t				c_trans_count;	// transactions
+    uint64_t				c_push_words;	// bus words written in the Read Fifos
+    uint64_t				c_pop_words;	// bus words read from the Write Fifos
+    uint64_t				c_wait_cycles;	// WAIT responses
+    uint64_t				c_error_count;	// bus errors
+
+    // FSM states
+    enum {
+        FSM_IDLE		= 0,
+        FSM_ERROR		= 1,
+        FSM_STS_READ		= 2,
+        FSM_DATA_READ		= 3,
+        FSM_STS_WRITE		= 4,
+        FSM_DATA_WRITE		= 5,
+        FSM_COPROC_STATUS	= 6,
+        FSM_COPROC_CONFIG	= 7,
+        FSM_SOFTRESET		= 8,
+        FSM_STROBE		= 9,
+        };
+
+    int decode(uint32_t address, bool read);
+    void resetFifos();
+
+protected:
+
+    SC_HAS_PROCESS(PibusTargetMultiFifos);
+
+public:
+
+    // PIBUS PORTS
+    sc_core::sc_in<bool>		p_ck;
+    sc_core::sc_in<bool>		p_resetn;
+    sc_core::sc_in<bool>		p_sel;
+    sc_core::sc_in<uint32_t>		p_a;
+    sc_core::sc_in<bool>		p_read;
+    sc_core::sc_in<uint32_t>		p_opc;
+    sc_core::sc_out<uint32_t>		p_ack;
+    sc_core::sc_inout<uint32_t>		p_d;
+    sc_core::sc_in<bool>    		p_tout;
+
+    // COPROCESSOR PORTS
+    sc_core::sc_out<uint32_t>		p_dout[N_FIFO_READ];
+    sc_core::sc_out<bool> 		p_rok[N_FIFO_READ];
+    sc_core::sc_in<bool> 		p_r[N_FIFO_READ];
+    sc_core::sc_in<uint32_t>		p_din[N_FIFO_WRITE];
+    sc_core::sc_out<bool> 		p_wok[N_FIFO_WRITE];
+    sc_core::sc_in<bool> 		p_w[N_FIFO_WRITE];
+    sc_core::sc_out<uint32_t>		p_config[N_CONFIG_REG];
+    sc_core::sc_in<uint32_t> 		p_status[N_STATUS_REG];
+    sc_core::sc_out<bool>            	p_softreset;
+    sc_core::sc_out<bool>            	p_strobe;
+    sc_core::sc_out<bool>		p_read_irq[N_FIFO_READ];
+    sc_core::sc_out<bool>		p_write_irq[N_FIFO_WRITE];
+
+    //	constructor
+    PibusTargetMultiFifos(sc_core::sc_module_name		name,
+                          size_t				tgtid,
+                          soclib::common::PibusSegmentTable	&segtab);
+
+    //	methods
+    void transition();
+    void genMoore();
+    void printTrace();
+    void printStatistics();
+    void registerCounters(PibusCounterRegistry &registry);
+
+    // checkpoint
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
+
+    // zero-copy host interface (C++ coprocessor model)
+    const uint32_t* readFifoSpan(size_t index, size_t* nwords)
+    {
+        return r_fifo_read[index].readSpan(m_read_release[index], nwords);
+    }
+    void readFifoRelease(size_t index, size_t nwords)
+    {
+        m_read_release[index] += nwords;
+    }
+    uint32_t* writeFifoSpan(size_t index, size_t* nwords)
+    {
+        return r_fifo_write[index].writeSpan(m_write_commit[index], nwords);
+    }
+    void writeFifoCommit(size_t index, size_t nwords)
+    {
+        m_write_commit[index] += nwords;
     }
-} 
-    
-}; // end genMoore()
-
-////////////////////////////////////////
-//       Constructor   
-////////////////////////////////////////
-
-SC_HAS_PROCESS(PIBUS_TARGET_MULTI_FIFOS);
-
-PIBUS_TARGET_MULTI_FIFOS(sc_module_name 	insname,	// instance name
-			int			index,		// PIBUS target index
-			SOCLIB_SEGMENT_TABLE	&segtab)	// segment table
-{
-	
-SC_METHOD(Transition);
-sensitive_pos << CLK;
-
-SC_METHOD(GenMoore);
-sensitive_neg << CLK;
-
-NAME = (const char *)name;
-IDENT = index;
-
-// segment definition
-std::list<SEGMENT_TABLE_ENTRY> seglist = segtab.getSegmentList(index);cout << "index " << index << endl;
-BASE = (*seglist.begin()).getBase();cout << "BASE" << BASE << endl;
-SIZE = (*seglist.begin()).getSize();cout << "SIZE" << SIZE << endl;
-segNAME = (*seglist.begin()).getName();
-
-if(( FIFO_READ_SIZE > 256) || ( FIFO_READ_SIZE < 1)) {
-	perror("ERROR in PIBUS_TARGET_MULTI_FIFOS\n");
-	perror("The FIFO_READ_SIZE parameter must be larger than 0 and no larger than 256\n");
-	exit(1);
-}
-if(( FIFO_WRITE_SIZE > 256) || ( FIFO_WRITE_SIZE < 1)) {
-	perror("ERROR in PIBUS_TARGET_MULTI_FIFOS\n");
-	perror("The FIFO_WRITE_SIZE parameter must be larger than 0 and no larger than 256\n");
-	exit(1);
-}
-if((N_FIFO_READ > 4) || (N_FIFO_READ < 1)) {
-	perror("ERROR in PIBUS_TARGET_MULTI_FIFOS\n");
-	perror("The number of Read Fifos must be larger than 0 and no larger than 4\n");
-	exit(1);
-}
-if((N_FIFO_WRITE > 4) || (N_FIFO_WRITE < 1)) {
-	perror("ERROR in PIBUS_TARGET_MULTI_FIFOS\n");
-	perror("The number of Write Fifos must be larger than 0 and no larger than 4\n");
-	exit(1);
-}
-if((N_CONFIG_REG > 4) || (N_CONFIG_REG < 1)) {
-	perror("ERROR in PIBUS_TARGET_MULTI_FIFOS\n");
-	perror("The number of Configuration Registers must be larger than 0 and no larger than 4\n");
-	exit(1);
-}
-if((N_STATUS_REG > 4) || (N_STATUS_REG < 1)) {
-	perror("ERROR in PIBUS_TARGET_MULTI_FIFOS\n");
-	perror("The number of Status Registers must be larger than 0 and no larger than 4\n");
-	exit(1);
-}
 
-printf("Successful Instanciation of PIBUS_TARGET_MULTI_FIFOS : %s\n",NAME);
-}; // end constructor
+};  // end class PibusTargetMultiFifos
 
-}; // end struct PIBUS_TARGET_MULTI_FIFOS
+}} // end name spaces
 
 #endif
-
@@ -0,0 +1,366 @@
+//////////////////////////////////////////////////////////////////////////
+// File : pibus_target_multi_fifos.cpp
+// Author : Daniela Genius & Alain Greiner
+// Date : 20/08/2006
+// This program is released under the GNU Public License
+// Copyright : UPMC-LIP6
+/////////////////////////////////////////////////////////////////////////
+
+#include "pibus_target_multi_fifos.h"
+
+namespace soclib { namespace caba {
+
+using namespace sc_core;
+using namespace soclib::caba;
+using namespace soclib::common;
+
+#define tmpl(x) template<int N_FIFO_READ, int N_FIFO_WRITE,		\
+                         int FIFO_READ_SIZE, int FIFO_WRITE_SIZE,	\
+                         int THRESHOLD_READ, int THRESHOLD_WRITE,	\
+                         int N_CONFIG_REG, int N_STATUS_REG>		\
+    x PibusTargetMultiFifos<N_FIFO_READ, N_FIFO_WRITE,			\
+                            FIFO_READ_SIZE, FIFO_WRITE_SIZE,		\
+                            THRESHOLD_READ, THRESHOLD_WRITE,		\
+                            N_CONFIG_REG, N_STATUS_REG>
+
+//////////////////////////////////////////////////////////////////
+tmpl(/**/)::PibusTargetMultiFifos(sc_module_name	name,
+                                  size_t		tgtid,
+                                  PibusSegmentTable	&segtab)
+    : m_name(name),
+      m_tgtid(tgtid),
+      p_ck("p_ck"),
+      p_resetn("p_resetn"),
+      p_sel("p_sel"),
+      p_a("p_a"),
+      p_read("p_read"),
+      p_opc("p_opc"),
+      p_ack("p_ack"),
+      p_d("p_d"),
+      p_tout("p_tout"),
+      p_softreset("p_softreset"),
+      p_strobe("p_strobe")
+{
+    SC_METHOD (transition);
+    sensitive_pos << p_ck;
+
+    SC_METHOD (genMoore);
+    sensitive_neg << p_ck;
+
+    // segment definition
+    const std::list<SegmentTableEntry> &seglist = segtab.getTargetSegmentList(tgtid);
+    m_segbase = (*seglist.begin()).getBase();
+    m_segsize = (*seglist.begin()).getSize();
+    m_segname = (*seglist.begin()).getName();
+
+    if((m_segbase & 0x0000007F) != 0x0)
+    {
+        printf("ERROR in component PibusTargetMultiFifos %s\n", m_name);
+        printf("The segment base address must be aligned on 128 bytes\n");
+        exit(1);
+    }
+    if(m_segsize < 128)
+    {
+        printf("ERROR in component PibusTargetMultiFifos %s\n", m_name);
+        printf("The segment size must be at least 128 bytes\n");
+        exit(1);
+    }
+
+    resetFifos();
+
+    strcpy(m_fsm_str[FSM_IDLE],          "IDLE");
+    strcpy(m_fsm_str[FSM_ERROR],         "ERROR");
+    strcpy(m_fsm_str[FSM_STS_READ],      "STS_READ");
+    strcpy(m_fsm_str[FSM_DATA_READ],     "DATA_READ");
+    strcpy(m_fsm_str[FSM_STS_WRITE],     "STS_WRITE");
+    strcpy(m_fsm_str[FSM_DATA_WRITE],    "DATA_WRITE");
+    strcpy(m_fsm_str[FSM_COPROC_STATUS], "COPROC_STATUS");
+    strcpy(m_fsm_str[FSM_COPROC_CONFIG], "COPROC_CONFIG");
+    strcpy(m_fsm_str[FSM_SOFTRESET],     "SOFTRESET");
+    strcpy(m_fsm_str[FSM_STROBE],        "STROBE");
+
+    std::cout << std::endl << "Instanciation of PibusTargetMultiFifos : " << m_name << std::endl;
+    std::cout << "    read fifos  = " << N_FIFO_READ  << " x " << FIFO_READ_SIZE  << " words" << std::endl;
+    std::cout << "    write fifos = " << N_FIFO_WRITE << " x " << FIFO_WRITE_SIZE << " words" << std::endl;
+    std::cout << "    segment " << m_segname << std::hex
+              << " | base = 0x" << m_segbase
+              << " | size = 0x" << m_segsize << std::dec << std::endl;
+} // end constructor
+
+////////////////////////////////////////////////////
+tmpl(void)::resetFifos()
+{
+    for (int n = 0 ; n < N_FIFO_READ ; n++)
+    {
+        r_fifo_read[n].init();
+        m_read_release[n] = 0;
+    }
+    for (int n = 0 ; n < N_FIFO_WRITE ; n++)
+    {
+        r_fifo_write[n].init();
+        m_write_commit[n] = 0;
+    }
+} // end resetFifos()
+
+//////////////////////////////////////////////////////////////////////
+// This function decodes the bits A6 to A2 of the address, and returns
+// the FSM state of the access (FSM_ERROR for a wrong direction or a
+// wrong index). The index bounds are template parameters.
+//////////////////////////////////////////////////////////////////////
+tmpl(int)::decode(uint32_t address, bool read)
+{
+    if ((address - m_segbase) >= m_segsize) return FSM_ERROR;
+    int index = (address >> 2) & 0x3;
+    switch ((address >> 4) & 0x7) {
+    case 0x0 : return (not read)                            ? FSM_SOFTRESET     : FSM_ERROR;
+    case 0x1 : return (not read)                            ? FSM_STROBE        : FSM_ERROR;
+    case 0x2 : return (not read && (index < N_CONFIG_REG))  ? FSM_COPROC_CONFIG : FSM_ERROR;
+    case 0x3 : return (read     && (index < N_STATUS_REG))  ? FSM_COPROC_STATUS : FSM_ERROR;
+    case 0x4 : return (not read && (index < N_FIFO_READ))   ? FSM_DATA_READ     : FSM_ERROR;
+    case 0x5 : return (read     && (index < N_FIFO_READ))   ? FSM_STS_READ      : FSM_ERROR;
+    case 0x6 : return (read     && (index < N_FIFO_WRITE))  ? FSM_DATA_WRITE    : FSM_ERROR;
+    default  : return (read     && (index < N_FIFO_WRITE))  ? FSM_STS_WRITE     : FSM_ERROR;
+    }
+} // end decode()
+
+////////////////////////////
+tmpl(void)::transition()
+{
+    if (p_resetn == false)
+    {
+        resetFifos();
+        for (int n = 0 ; n < N_CONFIG_REG ; n++) r_config[n] = 0;
+        r_fsm_state   = FSM_IDLE;
+        r_index       = 0;
+        c_trans_count = 0;
+        c_push_words  = 0;
+        c_pop_words   = 0;
+        c_wait_cycles = 0;
+        c_error_count = 0;
+        return;
+    } // end p_resetn
+
+    // coprocessor status registers
+    for (int n = 0 ; n < N_STATUS_REG ; n++) r_status[n] = p_status[n].read();
+
+    // FIFO states seen by the coprocessor ports (genMoore)
+    bool rok[N_FIFO_READ];
+    bool wok[N_FIFO_WRITE];
+    for (int n = 0 ; n < N_FIFO_READ ; n++)  rok[n] = r_fifo_read[n].rok();
+    for (int n = 0 ; n < N_FIFO_WRITE ; n++) wok[n] = r_fifo_write[n].wok();
+
+    // The current word is answered with the FIFO state of the genMoore() :
+    // the FIFOs are only modified by the PIBUS at this point.
+    int  state = r_fsm_state.read();
+    int  index = r_index.read();
+    bool ready = true;
+    switch (state) {
+    case FSM_IDLE :
+        if (p_sel == true)
+        {
+            uint32_t address = (uint32_t)p_a.read();
+            c_trans_count++;
+            r_fsm_state = decode(address, p_read.read());
+            r_index     = (address >> 2) & 0x3;
+        }
+        ready = false;
+        break;
+    case FSM_ERROR :
+        c_error_count++;
+        r_fsm_state = FSM_IDLE;
+        ready = false;
+        break;
+    case FSM_DATA_READ :
+        ready = r_fifo_read[index].wok();
+        if (ready)
+        {
+            r_fifo_read[index].put((uint32_t)p_d.read());
+            c_push_words++;
+        }
+        break;
+    case FSM_DATA_WRITE :
+        ready = r_fifo_write[index].rok();
+        if (ready)
+        {
+            r_fifo_write[index].get();
+            c_pop_words++;
+        }
+        break;
+    case FSM_COPROC_CONFIG :
+        r_config[index] = (uint32_t)p_d.read();
+        break;
+    case FSM_SOFTRESET :
+        resetFifos();
+        break;
+    } // end switch r_fsm_state
+
+    // next word of a burst : same access type and index
+    if (state != FSM_IDLE && state != FSM_ERROR)
+    {
+        if (not ready)
+        {
+            c_wait_cycles++;
+        }
+        else if (p_sel == true)
+        {
+            uint32_t address = (uint32_t)p_a.read();
+            bool     read    = (state == FSM_STS_READ) || (state == FSM_STS_WRITE) ||
+                               (state == FSM_DATA_WRITE) || (state == FSM_COPROC_STATUS);
+            if (((address - m_segbase) >= m_segsize) || (p_read.read() != read))
+                r_fsm_state = FSM_ERROR;
+        }
+        else
+        {
+            r_fsm_state = FSM_IDLE;
+        }
+    }
+
+    // coprocessor ports and host interface
+    for (int n = 0 ; n < N_FIFO_READ ; n++)
+    {
+        if (rok[n] && p_r[n].read()) r_fifo_read[n].get();
+        r_fifo_read[n].release(m_read_release[n]);
+        m_read_release[n] = 0;
+    }
+    for (int n = 0 ; n < N_FIFO_WRITE ; n++)
+    {
+        if (wok[n] && p_w[n].read()) r_fifo_write[n].put(p_din[n].read());
+        r_fifo_write[n].commit(m_write_commit[n]);
+        m_write_commit[n] = 0;
+    }
+} // end transition()
+
+/////////////////////////
+tmpl(void)::genMoore()
+{
+    int index = r_index.read();
+
+    // coprocessor FIFO ports
+    for (int n = 0 ; n < N_FIFO_READ ; n++)
+    {
+        p_dout[n]     = r_fifo_read[n].read();
+        p_rok[n]      = r_fifo_read[n].rok();
+        p_read_irq[n] = (r_fifo_read[n].filled() < (uint32_t)THRESHOLD_READ);
+    }
+    for (int n = 0 ; n < N_FIFO_WRITE ; n++)
+    {
+        p_wok[n]       = r_fifo_write[n].wok();
+        p_write_irq[n] = (r_fifo_write[n].filled() >= (uint32_t)THRESHOLD_WRITE);
+    }
+
+    // coprocessor configuration registers
+    for (int n = 0 ; n < N_CONFIG_REG ; n++) p_config[n] = r_config[n].read();
+
+    p_softreset = (r_fsm_state == FSM_SOFTRESET);
+    p_strobe    = (r_fsm_state == FSM_STROBE);
+
+    // PIBUS
+    switch (r_fsm_state) {
+    case FSM_IDLE :
+        break;
+    case FSM_ERROR :
+        p_ack = PIBUS_ACK_ERROR;
+        break;
+    case FSM_STS_READ :
+        p_ack = PIBUS_ACK_READY;
+        p_d   = r_fifo_read[index].filled();
+        break;
+    case FSM_STS_WRITE :
+        p_ack = PIBUS_ACK_READY;
+        p_d   = r_fifo_write[index].filled();
+        break;
+    case FSM_DATA_READ :
+        p_ack = r_fifo_read[index].wok() ? PIBUS_ACK_READY : PIBUS_ACK_WAIT;
+        break;
+    case FSM_DATA_WRITE :
+        p_ack = r_fifo_write[index].rok() ? PIBUS_ACK_READY : PIBUS_ACK_WAIT;
+        p_d   = r_fifo_write[index].read();
+        break;
+    case FSM_COPROC_STATUS :
+        p_ack = PIBUS_ACK_READY;
+        p_d   = r_status[index].read();
+        break;
+    default :	// FSM_COPROC_CONFIG, FSM_SOFTRESET, FSM_STROBE
+        p_ack = PIBUS_ACK_READY;
+        break;
+    } // end switch r_fsm_state
+} // end genMoore()
+
+///////////////////////////
+tmpl(void)::printTrace()
+{
+    std::cout << m_name << " : " << m_fsm_str[r_fsm_state] << std::dec;
+    for (int n = 0 ; n < N_FIFO_READ ; n++)
+        std::cout << " / rfifo[" << n << "] = " << r_fifo_read[n].filled();
+    for (int n = 0 ; n < N_FIFO_WRITE ; n++)
+        std::cout << " / wfifo[" << n << "] = " << r_fifo_write[n].filled();
+    std::cout << std::endl;
+} // end printTrace()
+
+////////////////////////////////
+tmpl(void)::printStatistics()
+{
+    std::cout << m_name << " : Statistics" << std::dec << std::endl;
+    std::cout << "- TRANSACTIONS     = " << c_trans_count << std::endl;
+    std::cout << "- READ FIFO WORDS  = " << c_push_words << std::endl;
+    std::cout << "- WRITE FIFO WORDS = " << c_pop_words << std::endl;
+    std::cout << "- WAIT CYCLES      = " << c_wait_cycles << std::endl;
+    std::cout << "- BUS ERRORS       = " << c_error_count << std::endl;
+} // end printStatistics()
+
+///////////////////////////////////////////////////////////////////
+tmpl(void)::registerCounters(PibusCounterRegistry &registry)
+{
+    registry.add(m_name, "trans_count", &c_trans_count);
+    registry.add(m_name, "push_words",  &c_push_words);
+    registry.add(m_name, "pop_words",   &c_pop_words);
+    registry.add(m_name, "wait_cycles", &c_wait_cycles);
+    registry.add(m_name, "error_count", &c_error_count);
+} // end registerCounters()
+
+/////////////////////////////////
+tmpl(bool)::checkpointReady()
+{
+    return (r_fsm_state == FSM_IDLE);
+}
+
+///////////////////////////////////////////////////////////////////
+tmpl(void)::saveState(PibusCheckpointWriter &writer)
+{
+    uint32_t params[6] = { N_FIFO_READ, N_FIFO_WRITE, FIFO_READ_SIZE,
+                           FIFO_WRITE_SIZE, N_CONFIG_REG, N_STATUS_REG };
+    writer.putArray(params, 6);
+    writer.put(r_fsm_state);
+    writer.put(r_index);
+    for (int n = 0 ; n < N_CONFIG_REG ; n++) writer.put(r_config[n]);
+    for (int n = 0 ; n < N_STATUS_REG ; n++) writer.put(r_status[n]);
+    for (int n = 0 ; n < N_FIFO_READ ; n++)  r_fifo_read[n].save(writer);
+    for (int n = 0 ; n < N_FIFO_WRITE ; n++) r_fifo_write[n].save(writer);
+    writer.putArray(m_read_release, N_FIFO_READ);
+    writer.putArray(m_write_commit, N_FIFO_WRITE);
+}
+
+///////////////////////////////////////////////////////////////////
+tmpl(void)::restoreState(PibusCheckpointReader &reader)
+{
+    uint32_t params[6] = { N_FIFO_READ, N_FIFO_WRITE, FIFO_READ_SIZE,
+                           FIFO_WRITE_SIZE, N_CONFIG_REG, N_STATUS_REG };
+    uint32_t saved[6];
+    reader.getArray(saved, 6);
+    if (memcmp(params, saved, sizeof(params)) != 0)
+    {
+        printf("ERROR in component PibusTargetMultiFifos %s\n", m_name);
+        printf("The checkpoint template parameters do not match\n");
+        exit(1);
+    }
+    reader.get(r_fsm_state);
+    reader.get(r_index);
+    for (int n = 0 ; n < N_CONFIG_REG ; n++) reader.get(r_config[n]);
+    for (int n = 0 ; n < N_STATUS_REG ; n++) reader.get(r_status[n]);
+    for (int n = 0 ; n < N_FIFO_READ ; n++)  r_fifo_read[n].restore(reader);
+    for (int n = 0 ; n < N_FIFO_WRITE ; n++) r_fifo_write[n].restore(reader);
+    reader.getArray(m_read_release, N_FIFO_READ);
+    reader.getArray(m_write_commit, N_FIFO_WRITE);
+}
+
+}} // end namespace
@@ -0,0 +1,235 @@
+///////////////////////////////////////////////////////////////////////////
+// File : pibus_trace_recorder.h
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// This object records a binary trace of the PIBUS transactions, and is
+// attached to the PibusSegBcu component (setTraceRecorder() method).
+// Contrary to the printTrace() methods, that print the components state
+// at each cycle, it can be used to record complete simulations.
+//
+// Each transaction is registered as one fixed size record (32 bytes,
+// see PibusTraceRecord below) in a ring buffer. The record() method is
+// called by the BCU at the last cycle of the transaction, and only
+// copies the record in the ring buffer : there is no lock and no
+// system call. The ring buffer is written in the trace file by a
+// host thread (POSIX thread), that polls the ring buffer every
+// PIBUS_TRACE_POLL microseconds.
+// The ring buffer has one producer (the BCU) and one consumer (the
+// writer thread) : the two indexes are only written by their owner.
+// No record is lost : when the ring buffer is full, the record()
+// method waits until the writer thread releases one slot. These
+// stalls are counted, and signal an undersized ring buffer.
+//
+// The trace file contains a 16 bytes header (PibusTraceHeader),
+// followed by the records, in the host byte order.
+// The file is flushed and closed by the close() method, or by the
+// destructor. The pibus_trace_decode tool (tools directory) prints
+// the trace in text or CSV format.
+// The platform must be linked with the pthread library.
+///////////////////////////////////////////////////////////////////////////
+// The constructor has 2 parameters :
+// - const char*	filename	: trace file pathname
+// - size_t	nrecords	: ring buffer size (rounded to a power of 2)
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef PIBUS_TRACE_RECORDER_H
+#define PIBUS_TRACE_RECORDER_H
+
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <cstdlib>
+#include <pthread.h>
+#include <unistd.h>
+
+#define PIBUS_TRACE_MAGIC	"PIBTRACE"	// trace file signature (8 bytes)
+#define PIBUS_TRACE_VERSION	1		// trace file format version
+#define PIBUS_TRACE_POLL	1000		// writer thread polling period (us)
+
+// PibusTraceRecord flags
+#define PIBUS_TRACE_READ	0x1		// read transaction
+#define PIBUS_TRACE_TIMEOUT	0x2		// transaction aborted by the time-out
+
+namespace soclib { namespace caba {
+
+//////////////////////////////////////////////////////////////////////////////////
+//			PibusTraceRecord definition
+//////////////////////////////////////////////////////////////////////////////////
+
+struct PibusTraceRecord {
+	uint64_t	cycle;		// cycle of the first address phase
+	uint32_t	address;	// first address
+	uint32_t	duration;	// cycles from the first address phase to the last ack
+	uint32_t	wait;		// arbitration latency (request cycles before grant)
+	uint16_t	burst;		// number of data cycles (ACK != WAIT)
+	uint8_t		master;		// master index
+	uint8_t		target;		// target index
+	uint8_t		opc;		// PIBUS OPC of the first address
+	uint8_t		ack;		// PIBUS ACK of the last data cycle
+	uint8_t		flags;		// PIBUS_TRACE_READ / PIBUS_TRACE_TIMEOUT
+	uint8_t		reserved[5];	// padding (null)
+};
+
+struct PibusTraceHeader {
+	char		magic[8];	// PIBUS_TRACE_MAGIC
+	uint32_t	version;	// PIBUS_TRACE_VERSION
+	uint32_t	record_size;	// sizeof(PibusTraceRecord)
+};
+
+//////////////////////////////////////////////////////////////////////////////////
+//			PibusTraceRecorder definition
+//////////////////////////////////////////////////////////////////////////////////
+
+class PibusTraceRecorder {
+
+std::vector<PibusTraceRecord>	m_ring;		// ring buffer
+size_t				m_mask;		// ring buffer size - 1
+volatile uint64_t		m_head;		// next record to write (producer)
+volatile uint64_t		m_tail;		// next record to flush (writer thread)
+volatile bool			m_exit;		// the writer thread must exit
+FILE*				m_file;		// trace file
+pthread_t			m_thread;	// writer thread
+bool				m_open;		// trace file not closed
+uint64_t			c_stalls;	// record() calls waiting for a free slot
+
+////////////////////////////////////////////////////////////
+// writes the records from the tail to the head (or to the
+// end of the ring buffer), and returns the number of records
+////////////////////////////////////////////////////////////
+size_t flush()
+{
+	uint64_t head = m_head;
+	__sync_synchronize();
+	uint64_t tail = m_tail;
+	if (head == tail) return 0;
+	size_t first = tail & m_mask;
+	size_t n     = head - tail;
+	if (first + n > m_ring.size()) n = m_ring.size() - first;
+	if (fwrite(&m_ring[first], sizeof(PibusTraceRecord), n, m_file) != n)
+	{
+		std::cerr << "ERROR in PibusTraceRecorder" << std::endl;
+		std::cerr << "Cannot write the trace file" << std::endl;
+		exit(0);
+	}
+	__sync_synchronize();
+	m_tail = tail + n;
+	return n;
+};
+///////////////////////////////////
+static void* writer(void* arg)
+{
+	PibusTraceRecorder* recorder = (PibusTraceRecorder*)arg;
+	while (true)
+	{
+		bool exit = recorder->m_exit;
+		__sync_synchronize();
+		if (recorder->flush() != 0) continue;
+		if (exit) break;
+		usleep(PIBUS_TRACE_POLL);
+	}
+	return NULL;
+};
+
+public:
+
+//////////////////////////////////////////////////////////////
+PibusTraceRecorder(const char* filename, size_t nrecords = 65536)
+	: m_head(0),
+	  m_tail(0),
+	  m_exit(false),
+	  m_open(false),
+	  c_stalls(0)
+{
+	size_t size = 2;
+	while (size < nrecords) size = size << 1;
+	m_ring.resize(size);
+	m_mask = size - 1;
+
+	m_file = fopen(filename, "wb");
+	if (m_file == NULL)
+	{
+		std::cerr << "ERROR in PibusTraceRecorder" << std::endl;
+		std::cerr << "Cannot open the trace file " << filename << std::endl;
+		exit(0);
+	}
+	PibusTraceHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PIBUS_TRACE_MAGIC, 8);
+	header.version     = PIBUS_TRACE_VERSION;
+	header.record_size = sizeof(PibusTraceRecord);
+	fwrite(&header, sizeof(header), 1, m_file);
+
+	if (pthread_create(&m_thread, NULL, &PibusTraceRecorder::writer, this) != 0)
+	{
+		std::cerr << "ERROR in PibusTraceRecorder" << std::endl;
+		std::cerr << "Cannot create the writer thread" << std::endl;
+		exit(0);
+	}
+	m_open = true;
+	std::cout << std::endl << "Instanciation of PibusTraceRecorder" << std::endl;
+	std::cout << "    file     = " << filename << std::endl;
+	std::cout << "    nrecords = " << size << std::endl;
+}; // end constructor
+
+//////////////////////
+~PibusTraceRecorder()
+{
+	close();
+};
+
+//////////////////////////////////////////////////////////
+// the record is copied in the ring buffer
+//////////////////////////////////////////////////////////
+void record(const PibusTraceRecord &r)
+{
+	uint64_t head = m_head;
+	if (head - m_tail > m_mask)	// ring buffer full
+	{
+		c_stalls++;
+		while (head - m_tail > m_mask) usleep(1);
+	}
+	__sync_synchronize();
+	m_ring[head & m_mask] = r;
+	__sync_synchronize();
+	m_head = head + 1;
+};
+/////////////////////////////////////////////////////
+// stops the writer thread, when all records have
+// been written, and closes the trace file
+/////////////////////////////////////////////////////
+void close()
+{
+	if (not m_open) return;
+	__sync_synchronize();
+	m_exit = true;
+	pthread_join(m_thread, NULL);
+	fclose(m_file);
+	m_open = false;
+};
+//////////////////////////////
+uint64_t getCount() const
+{
+	return m_head;
+};
+//////////////////////////////
+uint64_t getStalls() const
+{
+	return c_stalls;
+};
+//////////////////////
+void printStatistics()
+{
+	std::cout << "PibusTraceRecorder : Statistics" << std::dec << std::endl;
+	std::cout << "- RECORDS = " << m_head   << std::endl;
+	std::cout << "- STALLS  = " << c_stalls << std::endl;
+};
+
+}; // end class PibusTraceRecorder
+
+}} // end namespaces
+
+#endif
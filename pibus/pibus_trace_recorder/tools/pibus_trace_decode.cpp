@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////
+// File : pibus_trace_decode.cpp
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// This tool decodes a trace file written by the PibusTraceRecorder.
+// It prints one line per transaction, and a summary per master :
+//
+//    pibus_trace_decode [-csv] [-m master] [-t target] [-n max] file
+//
+// - -csv       : CSV format (one header line, then one line per record)
+// - -m master  : only the transactions of this master
+// - -t target  : only the transactions to this target
+// - -n max     : at most max transactions are printed
+//
+// It is a stand-alone program :
+//    g++ -O2 -I../source/include -I../../pibus_mnemonics/source/include -o pibus_trace_decode pibus_trace_decode.cpp
+///////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include "pibus_trace_recorder.h"
+#include "pibus_mnemonics.h"
+
+using namespace soclib::caba;
+using namespace soclib::common;
+
+static const char* opc_str[16] = {
+"NOP", "WD32", "WDU", "WDC", "WD2", "WD4", "WD8", "WD16",
+"HW0", "TB0", "HW1", "TB1", "BY0", "BY1", "BY2", "BY3",
+};
+
+static const char* ack_str[4] = {
+"WAIT", "ERROR", "READY", "RETRY",
+};
+
+struct MasterSummary {
+	uint64_t	trans;		// number of transactions
+	uint64_t	words;		// number of data cycles
+	uint64_t	wait;		// arbitration latency sum
+	uint64_t	duration;	// transaction duration sum
+	uint64_t	retry;		// RETRY responses
+	uint64_t	error;		// ERROR responses and time-outs
+};
+
+///////////////////////
+static void usage()
+{
+	fprintf(stderr, "usage : pibus_trace_decode [-csv] [-m master] [-t target] [-n max] file\n");
+	exit(1);
+}
+
+////////////////////////////////
+int main(int argc, char* argv[])
+{
+	bool		csv    = false;
+	int		master = -1;
+	int		target = -1;
+	uint64_t	max    = 0;
+	const char*	name   = NULL;
+
+	for (int i = 1 ; i < argc ; i++)
+	{
+		if      (strcmp(argv[i], "-csv") == 0)			csv = true;
+		else if ((strcmp(argv[i], "-m") == 0) && (i + 1 < argc))	master = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc))	target = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc))	max = strtoull(argv[++i], NULL, 0);
+		else if ((argv[i][0] != '-') && (name == NULL))		name = argv[i];
+		else usage();
+	}
+	if (name == NULL) usage();
+
+	FILE* file = fopen(name, "rb");
+	if (file == NULL)
+	{
+		fprintf(stderr, "ERROR : cannot open the trace file %s\n", name);
+		exit(1);
+	}
+	PibusTraceHeader header;
+	if ( (fread(&header, sizeof(header), 1, file) != 1) ||
+	     (memcmp(header.magic, PIBUS_TRACE_MAGIC, 8) != 0) )
+	{
+		fprintf(stderr, "ERROR : %s is not a PIBUS trace file\n", name);
+		exit(1);
+	}
+	if ( (header.version != PIBUS_TRACE_VERSION) ||
+	     (header.record_size != sizeof(PibusTraceRecord)) )
+	{
+		fprintf(stderr, "ERROR : unsupported trace format (version %u / record size %u)\n",
+			header.version, header.record_size);
+		exit(1);
+	}
+
+	if (csv) printf("cycle,master,target,address,opc,read,burst,wait,duration,ack,timeout\n");
+
+	std::vector<MasterSummary>	summary;
+	std::vector<PibusTraceRecord>	buffer(4096);
+	uint64_t			count   = 0;
+	uint64_t			printed = 0;
+	size_t				n;
+	while ((n = fread(&buffer[0], sizeof(PibusTraceRecord), buffer.size(), file)) > 0)
+	{
+		for (size_t k = 0 ; k < n ; k++)
+		{
+			const PibusTraceRecord &r = buffer[k];
+			count++;
+			if ((master >= 0) && (r.master != master)) continue;
+			if ((target >= 0) && (r.target != target)) continue;
+
+			if (r.master >= summary.size())
+			{
+				MasterSummary s;
+				memset(&s, 0, sizeof(s));
+				summary.resize(r.master + 1, s);
+			}
+			MasterSummary &s = summary[r.master];
+			s.trans++;
+			s.words    = s.words + r.burst;
+			s.wait     = s.wait + r.wait;
+			s.duration = s.duration + r.duration;
+			if (r.ack == PIBUS_ACK_RETRY) s.retry++;
+			if ((r.ack == PIBUS_ACK_ERROR) || (r.flags & PIBUS_TRACE_TIMEOUT)) s.error++;
+
+			if ((max != 0) && (printed >= max)) continue;
+			printed++;
+			bool read    = (r.flags & PIBUS_TRACE_READ) != 0;
+			bool timeout = (r.flags & PIBUS_TRACE_TIMEOUT) != 0;
+			if (csv)
+			{
+				printf("%llu,%u,%u,0x%08x,%s,%d,%u,%u,%u,%s,%d\n",
+					(unsigned long long)r.cycle, r.master, r.target, r.address,
+					opc_str[r.opc & 0xF], read, r.burst, r.wait, r.duration,
+					ack_str[r.ack & 0x3], timeout);
+			}
+			else
+			{
+				printf("%12llu  master %2u -> target %2u  %s %-4s @ 0x%08x  burst = %2u"
+				       "  wait = %4u  duration = %4u  %s\n",
+					(unsigned long long)r.cycle, r.master, r.target,
+					read ? "READ " : "WRITE", opc_str[r.opc & 0xF], r.address,
+					r.burst, r.wait, r.duration,
+					timeout ? "TIME-OUT" : ack_str[r.ack & 0x3]);
+			}
+		}
+	}
+	fclose(file);
+
+	if (csv) return 0;
+	printf("\n%llu records\n", (unsigned long long)count);
+	for (size_t i = 0 ; i < summary.size() ; i++)
+	{
+		const MasterSummary &s = summary[i];
+		if (s.trans == 0) continue;
+		printf("master %2u : n_trans = %llu , words = %llu , mean wait = %.2f , "
+		       "mean duration = %.2f , retry = %llu , error = %llu\n",
+			(unsigned)i, (unsigned long long)s.trans, (unsigned long long)s.words,
+			(double)s.wait / (double)s.trans, (double)s.duration / (double)s.trans,
+			(unsigned long long)s.retry, (unsigned long long)s.error);
+	}
+	return 0;
+}
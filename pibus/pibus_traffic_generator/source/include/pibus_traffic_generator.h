@@ -0,0 +1,242 @@
+////////////////////////////////////////////////////////////////////////////
+// File  : pibus_traffic_generator.h
+// Date  : 14/10/2026
+// Copyright  UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// This component is a configurable PIBUS master, used to stress the
+// bus controller, the targets and the DMA controllers without software.
+// It generates read and write transactions (bursts of 1 to 32 words),
+// and measures the achieved bandwidth and the transaction latencies.
+//
+// The transaction requests are generated by a GENERATOR process, and
+// stored in a pending requests queue, that is consumed by the PIBUS FSM.
+// The depth of this queue (max_pending parameter) is the maximum number
+// of outstanding requests (generated and not completed). When the queue
+// is full, the generation is delayed (stall cycles are counted).
+// The arrival of a new request is defined by the arrival parameter :
+// - ARRIVAL_FIXED       : one request every gap cycles,
+// - ARRIVAL_UNIFORM     : inter-arrival uniformly distributed in [0 , 2*gap],
+// - ARRIVAL_EXPONENTIAL : inter-arrival exponentially distributed (Poisson
+//                         arrivals) with mean value gap.
+// With gap = 0, a new request is generated as soon as the queue is not full
+// (saturated bus).
+//
+// The address of each request is defined by the mode parameter :
+// - TRAFFIC_STREAM  : consecutive bursts in [base , base + size[,
+// - TRAFFIC_STRIDED : bursts starting every stride bytes in [base , base + size[,
+// - TRAFFIC_RANDOM  : random bursts (word aligned) in [base , base + size[,
+// - TRAFFIC_HOTSPOT : random bursts in [hot_base , hot_base + hot_size[ with
+//                     probability hot_percent, in [base , base + size[ otherwise,
+// - TRAFFIC_TRACE   : replay of a trace file written by a PibusTraceRecorder.
+//                     The address, direction, OPC and burst length of each
+//                     completed transaction of the trace_master master (or
+//                     all masters if trace_master < 0) are replayed, and each
+//                     request is generated at its recorded cycle (relative to
+//                     the first record), or later if the queue is full.
+// The direction is read with probability read_percent (except in trace
+// mode), and the burst length is uniformly distributed in
+// [burst_min , burst_max]. The PIBUS OPC of the requests is the opc
+// parameter (default PIBUS_OPC_WDU), except in trace mode (recorded OPC).
+// The written data is the word address.
+// The random generator is a deterministic xorshift generator (seed).
+//
+// A transaction aborted by the RETRY response (split transaction) is
+// retried. A bus error or a time-out is counted, but does not stop the
+// generator. The generation stops after ntrans requests (ntrans = 0 means
+// no limit), and the isDone() method returns true when all generated
+// requests are completed.
+//
+// Two latencies are registered in PibusHistogram objects :
+// - total latency : from the request generation to the last ACK
+//   (queueing in the pending requests queue included),
+// - bus latency   : from the bus request (REQ) to the last ACK
+//   (arbitration and retries included).
+// The 64 bits counters can be registered in a PibusCounterRegistry.
+//
+// This component implements the PibusCheckpointable interface, and can
+// be checkpointed when the PIBUS FSM is IDLE or REQ. The generator state
+// (random generator, pending requests queue, and trace file offset in
+// TRAFFIC_TRACE mode) and the registers are saved. The counters and the
+// latency histograms are not saved, and restart from zero.
+//////////////////////////////////////////////////////////////////////////
+// This component has 2 "constructor" parameters :
+// - sc_module_name		name	: instance name
+// - PibusTrafficConfig		config	: generator parameters (see below)
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef PIBUS_TRAFFIC_GENERATOR_H
+#define PIBUS_TRAFFIC_GENERATOR_H
+
+#include <stdio.h>
+#include <systemc>
+#include <inttypes.h>
+#include <deque>
+#include "pibus_mnemonics.h"
+#include "pibus_histogram.h"
+#include "pibus_counter_registry.h"
+#include "pibus_trace_recorder.h"
+#include "pibus_checkpoint.h"
+
+namespace soclib { namespace caba {
+
+using namespace sc_core;
+using namespace soclib::common;
+
+////////////////////////////////////////////////////////////
+// generator parameters (default : saturated 4 words reads)
+////////////////////////////////////////////////////////////
+struct PibusTrafficConfig {
+    int			mode;		// address generation mode
+    uint32_t		base;		// region base address
+    uint32_t		size;		// region size (bytes)
+    uint32_t		stride;		// stride (bytes) for TRAFFIC_STRIDED
+    uint32_t		hot_base;	// hot-spot base address
+    uint32_t		hot_size;	// hot-spot size (bytes)
+    uint32_t		hot_percent;	// hot-spot probability (percent)
+    uint32_t		read_percent;	// read probability (percent)
+    uint32_t		burst_min;	// minimal burst length (words)
+    uint32_t		burst_max;	// maximal burst length (words)
+    uint32_t		opc;		// PIBUS OPC of the requests
+    int			arrival;	// inter-arrival distribution
+    uint32_t		gap;		// mean inter-arrival (cycles)
+    uint32_t		max_pending;	// maximal number of outstanding requests
+    uint64_t		ntrans;		// number of requests (0 : no limit)
+    uint32_t		seed;		// random generator seed
+    const char*		trace_file;	// trace file for TRAFFIC_TRACE
+    int			trace_master;	// replayed master (-1 : all)
+
+    PibusTrafficConfig()
+        : mode(0), base(0), size(0x1000), stride(4),
+          hot_base(0), hot_size(0), hot_percent(0),
+          read_percent(100), burst_min(4), burst_max(4), opc(PIBUS_OPC_WDU),
+          arrival(0), gap(0), max_pending(1), ntrans(0), seed(1),
+          trace_file(NULL), trace_master(-1)
+    {}
+};
+
+///////////////////////////////////////////////////
+class PibusTrafficGenerator : sc_module, public PibusCheckpointable {
+
+    // pending request
+    struct Request {
+        uint32_t	address;	// first address
+        bool		read;		// read transaction
+        uint32_t	burst;		// number of words
+        uint32_t	opc;		// PIBUS OPC
+        uint64_t	cycle;		// generation cycle
+    };
+
+    // STRUCTURAL PARAMETERS
+    const char*			m_name;			// instance name
+    const PibusTrafficConfig	m_config;		// generator parameters
+    char			m_fsm_str[5][20];	// FSM states names
+    FILE*			m_trace;		// trace file (TRAFFIC_TRACE)
+
+    // GENERATOR STATE
+    uint64_t			m_cycle;		// cycles since reset
+    uint64_t			m_rand;			// random generator state
+    uint64_t			m_generated;		// number of generated requests
+    uint64_t			m_next_arrival;		// next request generation cycle
+    uint32_t			m_next_address;		// next address (STREAM / STRIDED)
+    bool			m_exhausted;		// no more request to generate
+    bool			m_trace_valid;		// m_trace_next is valid
+    uint64_t			m_trace_first;		// first record cycle
+    Request			m_trace_next;		// next replayed request
+    std::deque<Request>		m_pending;		// pending requests queue
+    uint64_t			m_req_cycle;		// bus request cycle (current request)
+
+    // INSTRUMENTATION
+    uint64_t			c_trans_count;		// completed transactions
+    uint64_t			c_read_words;		// read words
+    uint64_t			c_write_words;		// written words
+    uint64_t			c_retry_count;		// RETRY responses
+    uint64_t			c_error_count;		// bus errors & time-outs
+    uint64_t			c_stall_cycles;		// generation delayed (queue full)
+    PibusHistogram		m_latency;		// total latency
+    PibusHistogram		m_bus_latency;		// bus latency
+
+    // REGISTERS
+    sc_register<int>		r_fsm_state;		// PIBUS FSM state
+    sc_register<uint32_t>	r_address;		// first address
+    sc_register<bool>		r_read;			// read transaction
+    sc_register<uint32_t>	r_burst;		// number of words
+    sc_register<uint32_t>	r_opc;			// PIBUS OPC
+    sc_register<uint32_t>	r_count;		// current address index
+
+    // FSM states
+    enum {
+	FSM_IDLE	= 0,
+	FSM_REQ		= 1,
+	FSM_AD		= 2,
+	FSM_DTAD	= 3,
+	FSM_DT		= 4,
+    };
+
+    uint32_t random();
+    uint32_t randomAddress(uint32_t base, uint32_t size, uint32_t burst);
+    uint64_t nextArrival();
+    bool readTrace();
+    void generate();
+    void startRequest();
+    void endRequest(bool error);
+
+protected:
+
+    SC_HAS_PROCESS(PibusTrafficGenerator);
+
+public:
+
+    // ADDRESS GENERATION MODES
+    enum {
+	TRAFFIC_STREAM		= 0,
+	TRAFFIC_STRIDED		= 1,
+	TRAFFIC_RANDOM		= 2,
+	TRAFFIC_HOTSPOT		= 3,
+	TRAFFIC_TRACE		= 4,
+    };
+
+    // INTER-ARRIVAL DISTRIBUTIONS
+    enum {
+	ARRIVAL_FIXED		= 0,
+	ARRIVAL_UNIFORM		= 1,
+	ARRIVAL_EXPONENTIAL	= 2,
+    };
+
+    // 	I/O PORTS
+    sc_in<bool>			p_ck;
+    sc_in<bool>			p_resetn;
+    sc_in<bool>			p_gnt;
+    sc_out<bool>		p_req;
+    sc_out<uint32_t>		p_a;
+    sc_out<uint32_t>		p_opc;
+    sc_out<bool>		p_read;
+    sc_out<bool>		p_lock;
+    sc_inout<uint32_t>		p_d;
+    sc_in<uint32_t>		p_ack;
+    sc_in<bool>			p_tout;
+
+    // Constructor
+    PibusTrafficGenerator(sc_module_name 		name,
+			  const PibusTrafficConfig	&config);
+
+    ~PibusTrafficGenerator();
+
+    // Methods
+    void transition();
+    void genMoore();
+    void printTrace();
+    void printStatistics();
+    void registerCounters(PibusCounterRegistry &registry);
+    bool isDone() { return m_exhausted && m_pending.empty(); }
+
+    // checkpoint
+    bool checkpointReady();
+    void saveState(PibusCheckpointWriter &writer);
+    void restoreState(PibusCheckpointReader &reader);
+
+};  // end class PibusTrafficGenerator
+
+}} // end namespaces
+
+#endif
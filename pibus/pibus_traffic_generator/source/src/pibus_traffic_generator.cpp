@@ -0,0 +1,506 @@
+/////////////////////////////////////////////////////////////////
+// File  : pibus_traffic_generator.cpp
+// Date  : 14/10/2026
+// Copyright  UPMC - LIP6
+// This program is released under the GNU public license
+/////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <math.h>
+#include "pibus_traffic_generator.h"
+
+namespace soclib { namespace caba {
+
+using namespace sc_core;
+using namespace soclib::common;
+using namespace soclib::caba;
+
+////////////////////////////////////////////////////////////////////////////
+PibusTrafficGenerator::PibusTrafficGenerator(sc_module_name 		name,
+					     const PibusTrafficConfig	&config)
+    : m_name(name),
+      m_config(config),
+      m_trace(NULL),
+      r_fsm_state("r_fsm_state"),
+      r_address("r_address"),
+      r_read("r_read"),
+      r_burst("r_burst"),
+      r_opc("r_opc"),
+      r_count("r_count"),
+      p_ck("p_ck"),
+      p_resetn("p_resetn"),
+      p_gnt("p_gnt"),
+      p_req("p_req"),
+      p_a("p_a"),
+      p_opc("p_opc"),
+      p_read("p_read"),
+      p_lock("p_lock"),
+      p_d("p_d"),
+      p_ack("p_ack"),
+      p_tout("p_tout")
+{
+    SC_METHOD(transition);
+    sensitive_pos << p_ck;
+
+    SC_METHOD(genMoore);
+    sensitive_neg << p_ck;
+
+    strcpy(m_fsm_str[0], "IDLE");
+    strcpy(m_fsm_str[1], "REQ");
+    strcpy(m_fsm_str[2], "AD");
+    strcpy(m_fsm_str[3], "DTAD");
+    strcpy(m_fsm_str[4], "DT");
+
+    // checking parameters
+
+    const char* error = NULL;
+    if ((config.mode < TRAFFIC_STREAM) || (config.mode > TRAFFIC_TRACE))
+        error = "Illegal mode parameter";
+    else if ((config.arrival < ARRIVAL_FIXED) || (config.arrival > ARRIVAL_EXPONENTIAL))
+        error = "Illegal arrival parameter";
+    else if (config.max_pending == 0)
+        error = "The max_pending parameter cannot be 0";
+    else if ((config.mode != TRAFFIC_TRACE) &&
+             ((config.burst_min == 0) || (config.burst_max > 32) || (config.burst_min > config.burst_max)))
+        error = "The burst length must be in [1 , 32] and burst_min <= burst_max";
+    else if ((config.mode != TRAFFIC_TRACE) &&
+             (((config.base & 0x3) != 0) || ((config.size & 0x3) != 0) || (config.size < 4*config.burst_max)))
+        error = "The region must be word aligned and contain burst_max words";
+    else if ((config.mode == TRAFFIC_STRIDED) && ((config.stride == 0) || ((config.stride & 0x3) != 0)))
+        error = "The stride parameter must be a non zero multiple of 4";
+    else if ((config.mode != TRAFFIC_TRACE) &&
+             ((config.opc == PIBUS_OPC_NOP) || (config.opc > PIBUS_OPC_BY3)))
+        error = "Illegal opc parameter";
+    else if ((config.read_percent > 100) || (config.hot_percent > 100))
+        error = "The percent parameters cannot be larger than 100";
+    else if ((config.mode == TRAFFIC_HOTSPOT) &&
+             (((config.hot_base & 0x3) != 0) || ((config.hot_size & 0x3) != 0) ||
+              (config.hot_size < 4*config.burst_max)))
+        error = "The hot-spot must be word aligned and contain burst_max words";
+    else if ((config.mode == TRAFFIC_TRACE) && (config.trace_file == NULL))
+        error = "The trace_file parameter is required in TRAFFIC_TRACE mode";
+    if (error != NULL)
+    {
+        std::cout << "ERROR in PibusTrafficGenerator component : " << m_name << std::endl;
+        std::cout << error << std::endl;
+        exit(0);
+    }
+
+    if (config.mode == TRAFFIC_TRACE)
+    {
+        PibusTraceHeader header;
+        m_trace = fopen(config.trace_file, "rb");
+        if ( (m_trace == NULL) ||
+             (fread(&header, sizeof(header), 1, m_trace) != 1) ||
+             (memcmp(header.magic, PIBUS_TRACE_MAGIC, 8) != 0) ||
+             (header.version != PIBUS_TRACE_VERSION) ||
+             (header.record_size != sizeof(PibusTraceRecord)) )
+        {
+            std::cout << "ERROR in PibusTrafficGenerator component : " << m_name << std::endl;
+            std::cout << "Cannot read the trace file " << config.trace_file << std::endl;
+            exit(0);
+        }
+    }
+
+    std::cout << std::endl << "Instanciation of PibusTrafficGenerator : " << m_name << std::endl;
+    std::cout << "    mode        = " << config.mode << std::endl;
+    if (config.mode == TRAFFIC_TRACE)
+    {
+        std::cout << "    trace file  = " << config.trace_file << std::endl;
+    }
+    else
+    {
+        std::cout << "    region      = 0x" << std::hex << config.base
+                  << " | size = 0x" << config.size << std::dec << std::endl;
+        std::cout << "    burst       = " << config.burst_min << " - " << config.burst_max << std::endl;
+        std::cout << "    read ratio  = " << config.read_percent << " %" << std::endl;
+        std::cout << "    opc         = 0x" << std::hex << config.opc << std::dec << std::endl;
+    }
+    std::cout << "    arrival     = " << config.arrival << " | gap = " << config.gap << std::endl;
+    std::cout << "    max_pending = " << config.max_pending << std::endl;
+
+} // end constructor
+
+////////////////////////////////////////////////
+PibusTrafficGenerator::~PibusTrafficGenerator()
+{
+    if (m_trace != NULL) fclose(m_trace);
+} // end destructor
+
+//////////////////////////////////////////////////
+// xorshift random generator (32 bits results)
+//////////////////////////////////////////////////
+uint32_t PibusTrafficGenerator::random()
+{
+    m_rand ^= m_rand << 13;
+    m_rand ^= m_rand >> 7;
+    m_rand ^= m_rand << 17;
+    return (uint32_t)(m_rand >> 32);
+} // end random()
+
+/////////////////////////////////////////////////////////////////////////////////
+// random first address of a burst contained in [base , base + size[
+/////////////////////////////////////////////////////////////////////////////////
+uint32_t PibusTrafficGenerator::randomAddress(uint32_t base, uint32_t size, uint32_t burst)
+{
+    return base + 4*(random() % ((size >> 2) - burst + 1));
+} // end randomAddress()
+
+/////////////////////////////////////////////
+// inter-arrival delay of the next request
+/////////////////////////////////////////////
+uint64_t PibusTrafficGenerator::nextArrival()
+{
+    switch (m_config.arrival) {
+    case ARRIVAL_UNIFORM:
+        return random() % (2*(uint64_t)m_config.gap + 1);
+    case ARRIVAL_EXPONENTIAL:
+    {
+        double u = ((double)random() + 1.0) / 4294967296.0;	// in ]0 , 1]
+        return (uint64_t)(-(double)m_config.gap * log(u));
+    }
+    default:
+        return m_config.gap;
+    }
+} // end nextArrival()
+
+///////////////////////////////////////////////////////////////////////
+// reads the next replayed record in m_trace_next (the cycle is the
+// recorded cycle), and returns false at the end of the trace.
+///////////////////////////////////////////////////////////////////////
+bool PibusTrafficGenerator::readTrace()
+{
+    PibusTraceRecord record;
+    while (fread(&record, sizeof(record), 1, m_trace) == 1)
+    {
+        if ((m_config.trace_master >= 0) && (record.master != m_config.trace_master)) continue;
+        if (record.ack == PIBUS_ACK_RETRY) continue;	// retried later in the trace
+        m_trace_next.address = record.address & 0xFFFFFFFC;
+        m_trace_next.read    = (record.flags & PIBUS_TRACE_READ) != 0;
+        m_trace_next.burst   = (record.burst == 0) ? 1 : ((record.burst > 32) ? 32 : record.burst);
+        m_trace_next.opc     = (record.opc == PIBUS_OPC_NOP) ? (uint32_t)PIBUS_OPC_WDU : (uint32_t)record.opc;
+        m_trace_next.cycle   = record.cycle;
+        return true;
+    }
+    return false;
+} // end readTrace()
+
+////////////////////////////////////////////
+// GENERATOR : at most one request per cycle
+////////////////////////////////////////////
+void PibusTrafficGenerator::generate()
+{
+    if (m_exhausted || (m_cycle < m_next_arrival)) return;
+    if (m_pending.size() >= m_config.max_pending)
+    {
+        c_stall_cycles++;
+        return;
+    }
+
+    Request request;
+    if (m_config.mode == TRAFFIC_TRACE)
+    {
+        request = m_trace_next;
+        m_trace_valid = readTrace();
+        if (m_trace_valid) m_next_arrival = m_trace_next.cycle - m_trace_first;
+        else               m_exhausted    = true;
+    }
+    else
+    {
+        uint32_t burst = m_config.burst_min + random() % (m_config.burst_max - m_config.burst_min + 1);
+        uint32_t end   = m_config.base + m_config.size;
+        request.burst  = burst;
+        request.read   = (random() % 100) < m_config.read_percent;
+        request.opc    = m_config.opc;
+        switch (m_config.mode) {
+        case TRAFFIC_STREAM:
+        case TRAFFIC_STRIDED:
+        {
+            uint32_t step = (m_config.mode == TRAFFIC_STREAM) ? 4*burst : m_config.stride;
+            if ((m_next_address < m_config.base) || (m_next_address + 4*burst > end))
+                m_next_address = m_config.base;
+            request.address = m_next_address;
+            m_next_address  = m_next_address + step;
+            break;
+        }
+        case TRAFFIC_RANDOM:
+            request.address = randomAddress(m_config.base, m_config.size, burst);
+            break;
+        case TRAFFIC_HOTSPOT:
+            if ((random() % 100) < m_config.hot_percent)
+                request.address = randomAddress(m_config.hot_base, m_config.hot_size, burst);
+            else
+                request.address = randomAddress(m_config.base, m_config.size, burst);
+            break;
+        }
+        m_next_arrival = m_cycle + nextArrival();
+    }
+    request.cycle = m_cycle;
+    m_pending.push_back(request);
+    m_generated++;
+    if ((m_config.ntrans != 0) && (m_generated == m_config.ntrans)) m_exhausted = true;
+} // end generate()
+
+////////////////////////////////////////////////////////
+// the first pending request is sent on the bus
+////////////////////////////////////////////////////////
+void PibusTrafficGenerator::startRequest()
+{
+    const Request &request = m_pending.front();
+    r_address   = request.address;
+    r_read      = request.read;
+    r_burst     = request.burst;
+    r_opc       = request.opc;
+    r_fsm_state = FSM_REQ;
+    m_req_cycle = m_cycle;
+} // end startRequest()
+
+////////////////////////////////////////////////////////
+// last ACK of the current request
+////////////////////////////////////////////////////////
+void PibusTrafficGenerator::endRequest(bool error)
+{
+    m_latency.add(m_cycle - m_pending.front().cycle);
+    m_bus_latency.add(m_cycle - m_req_cycle);
+    c_trans_count++;
+    if (error) c_error_count++;
+    m_pending.pop_front();
+    if (m_pending.empty()) r_fsm_state = FSM_IDLE;
+    else                   startRequest();
+} // end endRequest()
+
+/////////////////////////////////////////
+void PibusTrafficGenerator::transition()
+{
+    if(p_resetn.read() == false)
+    {
+	r_fsm_state    = FSM_IDLE;
+        m_cycle        = 0;
+        m_rand         = ((uint64_t)m_config.seed << 32) ^ 0x9E3779B97F4A7C15ULL;
+        m_generated    = 0;
+        m_next_arrival = 0;
+        m_next_address = m_config.base;
+        m_exhausted    = false;
+        m_pending.clear();
+        c_trans_count  = 0;
+        c_read_words   = 0;
+        c_write_words  = 0;
+        c_retry_count  = 0;
+        c_error_count  = 0;
+        c_stall_cycles = 0;
+        m_latency.reset();
+        m_bus_latency.reset();
+        if (m_trace != NULL)
+        {
+            fseek(m_trace, sizeof(PibusTraceHeader), SEEK_SET);
+            m_trace_valid = readTrace();
+            m_trace_first = m_trace_valid ? m_trace_next.cycle : 0;
+            m_exhausted   = not m_trace_valid;
+        }
+	return;
+    }
+
+    generate();
+
+    switch(r_fsm_state) {
+    case FSM_IDLE:
+    {
+        if (not m_pending.empty()) startRequest();
+        break;
+    }
+    case FSM_REQ:
+    {
+	if (p_gnt.read() == true) r_fsm_state = FSM_AD;
+        break;
+    }
+    case FSM_AD:
+    {
+        r_count = 1;
+        if (r_burst.read() == 1) r_fsm_state = FSM_DT;
+        else                     r_fsm_state = FSM_DTAD;
+        break;
+    }
+    case FSM_DTAD:
+    case FSM_DT:
+    {
+        bool last = (r_fsm_state == FSM_DT);
+        if (p_tout.read() || (p_ack.read() == PIBUS_ACK_ERROR))
+        {
+            endRequest(true);
+        }
+        else if (p_ack.read() == PIBUS_ACK_RETRY)	// split transaction
+        {
+            c_retry_count++;			// the bus latency includes the retries
+            r_fsm_state = FSM_REQ;
+        }
+        else if (p_ack.read() == PIBUS_ACK_READY)
+        {
+            if (r_read.read()) c_read_words++;
+            else               c_write_words++;
+            if (last)                                  endRequest(false);
+            else if (r_count.read() + 1 == r_burst.read()) r_fsm_state = FSM_DT;
+            else                                       r_count = r_count.read() + 1;
+        }
+        break;
+    }
+    } // end switch
+
+    m_cycle++;
+} // end transition()
+
+/////////////////////////////////////
+void PibusTrafficGenerator::genMoore()
+{
+    p_req = (r_fsm_state == FSM_REQ);
+
+    if (r_fsm_state == FSM_AD)
+    {
+	p_a    = r_address.read();
+	p_opc  = r_opc.read();
+	p_read = r_read.read();
+	p_lock = (r_burst.read() > 1);
+    }
+    else if (r_fsm_state == FSM_DTAD)
+    {
+	p_a    = r_address.read() + 4*r_count.read();
+	p_opc  = r_opc.read();
+	p_read = r_read.read();
+	p_lock = (r_count.read() + 1 < r_burst.read());
+        if (not r_read.read()) p_d = r_address.read() + 4*(r_count.read() - 1);
+    }
+    else if (r_fsm_state == FSM_DT)
+    {
+        if (not r_read.read()) p_d = r_address.read() + 4*(r_burst.read() - 1);
+    }
+} // end genMoore()
+
+////////////////////////////////////////
+void PibusTrafficGenerator::printTrace()
+{
+    std::cout << m_name << " : state = " << m_fsm_str[r_fsm_state]
+              << std::dec << " | pending = " << m_pending.size();
+    if (r_fsm_state != FSM_IDLE)
+    {
+        std::cout << " | " << (r_read.read() ? "READ" : "WRITE") << " @ 0x" << std::hex
+                  << r_address.read() << std::dec << " / " << r_burst.read() << " words";
+    }
+    std::cout << std::endl;
+} // end printTrace()
+
+/////////////////////////////////////////////
+void PibusTrafficGenerator::printStatistics()
+{
+    uint64_t words  = c_read_words + c_write_words;
+    double   cycles = (m_cycle == 0) ? 1.0 : (double)m_cycle;
+    std::cout << m_name << " : Statistics" << std::dec << std::endl;
+    std::cout << "- CYCLES           = " << m_cycle << std::endl;
+    std::cout << "- TRANSACTIONS     = " << c_trans_count << std::endl;
+    std::cout << "- READ WORDS       = " << c_read_words << std::endl;
+    std::cout << "- WRITE WORDS      = " << c_write_words << std::endl;
+    std::cout << "- BANDWIDTH        = " << (double)words/cycles << " words/cycle ("
+              << 4.0*(double)words/cycles << " bytes/cycle)" << std::endl;
+    std::cout << "- RETRY RESPONSES  = " << c_retry_count << std::endl;
+    std::cout << "- BUS ERRORS       = " << c_error_count << std::endl;
+    std::cout << "- STALL CYCLES     = " << c_stall_cycles << std::endl;
+    std::cout << "- TOTAL LATENCY    : ";
+    m_latency.print(std::cout);
+    std::cout << "- BUS LATENCY      : ";
+    m_bus_latency.print(std::cout);
+} // end printStatistics()
+
+/////////////////////////////////////////////////////////////////////////////
+void PibusTrafficGenerator::registerCounters(PibusCounterRegistry &registry)
+{
+    registry.add(m_name, "trans_count",  &c_trans_count);
+    registry.add(m_name, "read_words",   &c_read_words);
+    registry.add(m_name, "write_words",  &c_write_words);
+    registry.add(m_name, "retry_count",  &c_retry_count);
+    registry.add(m_name, "error_count",  &c_error_count);
+    registry.add(m_name, "stall_cycles", &c_stall_cycles);
+} // end registerCounters()
+
+//////////////////////////////////////////////
+bool PibusTrafficGenerator::checkpointReady()
+{
+    return (r_fsm_state == FSM_IDLE) || (r_fsm_state == FSM_REQ);
+} // end checkpointReady()
+
+/////////////////////////////////////////////////////////////////////
+void PibusTrafficGenerator::saveState(PibusCheckpointWriter &writer)
+{
+    int64_t offset = (m_trace != NULL) ? (int64_t)ftell(m_trace) : 0;
+    uint32_t npending = m_pending.size();
+
+    writer.put(m_config.mode);
+    writer.put(m_config.max_pending);
+    writer.put(offset);
+    writer.put(m_cycle);
+    writer.put(m_rand);
+    writer.put(m_generated);
+    writer.put(m_next_arrival);
+    writer.put(m_next_address);
+    writer.put(m_exhausted);
+    writer.put(m_trace_valid);
+    writer.put(m_trace_first);
+    writer.put(m_trace_next);
+    writer.put(npending);
+    for (uint32_t n = 0 ; n < npending ; n++) writer.put(m_pending[n]);
+    writer.put(m_req_cycle);
+    writer.put(r_fsm_state);
+    writer.put(r_address);
+    writer.put(r_read);
+    writer.put(r_burst);
+    writer.put(r_opc);
+    writer.put(r_count);
+} // end saveState()
+
+////////////////////////////////////////////////////////////////////////
+void PibusTrafficGenerator::restoreState(PibusCheckpointReader &reader)
+{
+    int      mode;
+    uint32_t max_pending;
+    int64_t  offset;
+    uint32_t npending;
+
+    reader.get(mode);
+    reader.get(max_pending);
+    if ( (mode != m_config.mode) || (max_pending != m_config.max_pending) )
+    {
+        std::cout << "ERROR in PibusTrafficGenerator component : " << m_name << std::endl;
+        std::cout << "The checkpoint mode or max_pending parameter does not match" << std::endl;
+        exit(0);
+    }
+    reader.get(offset);
+    if ((m_trace != NULL) && (fseek(m_trace, (long)offset, SEEK_SET) != 0))
+    {
+        std::cout << "ERROR in PibusTrafficGenerator component : " << m_name << std::endl;
+        std::cout << "Cannot seek the trace file " << m_config.trace_file << std::endl;
+        exit(0);
+    }
+    reader.get(m_cycle);
+    reader.get(m_rand);
+    reader.get(m_generated);
+    reader.get(m_next_arrival);
+    reader.get(m_next_address);
+    reader.get(m_exhausted);
+    reader.get(m_trace_valid);
+    reader.get(m_trace_first);
+    reader.get(m_trace_next);
+    reader.get(npending);
+    m_pending.clear();
+    for (uint32_t n = 0 ; n < npending ; n++)
+    {
+        Request request;
+        reader.get(request);
+        m_pending.push_back(request);
+    }
+    reader.get(m_req_cycle);
+    reader.get(r_fsm_state);
+    reader.get(r_address);
+    reader.get(r_read);
+    reader.get(r_burst);
+    reader.get(r_opc);
+    reader.get(r_count);
+} // end restoreState()
+
+}} // end namespaces
@@ -0,0 +1,295 @@
+///////////////////////////////////////////////////////////////////////////
+// File : pibus_worker_pool.h
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// This object is a pool of host threads (POSIX threads), used to
+// execute in parallel some computations that are private to a
+// component, such as the ISS cycle of the PibusMips32Xcache component.
+// The parallel execution does not modify the simulation result,
+// as a job cannot access any SystemC signal or shared object.
+//
+// A job is an object implementing the PibusWorkerJob interface.
+// - The post() method is called by a SystemC process to start
+//   the job. It is executed by the host thread owning the job.
+// - The wait() method is called by the same SystemC process, before
+//   using the job results (typically at the next clock cycle).
+//   It returns when the job has been completed.
+// A job cannot be posted again before completion.
+//
+// The jobs are posted once per simulated cycle, and the handoff cost
+// must be small compared to one ISS cycle : there is no shared queue,
+// and no mutex or condition variable on the fast path.
+// - At the first post(), a job is attached to a host thread (round
+//   robin), and stays attached to this thread.
+// - Each host thread spins on the pending flags of its jobs, executes
+//   the pending jobs, and resets their pending flags. These flags are
+//   the per-cycle barrier between the SystemC process and the thread.
+// - The wait() method spins on the pending flag of the job.
+// A host thread that found no pending job for PIBUS_WORKER_SPIN
+// iterations blocks on a condition variable (the simulation is
+// stopped, or the components are not clocked), and the next post()
+// of one of its jobs wakes it up. The threads and the wait() method
+// yield the host processor after PIBUS_WORKER_YIELD iterations, so the
+// simulation still progresses when there are more runnable threads
+// than host processors. For a speedup, the number of threads must
+// be smaller than the number of host processors (the SystemC thread
+// is also running) : otherwise, no thread is created, and the jobs
+// are executed by the post() method (sequential execution).
+// The pool must be deleted before the jobs, and the platform must be
+// linked with the pthread library.
+///////////////////////////////////////////////////////////////////////////
+// The constructor has 1 parameter :
+// - size_t	nthreads	: number of host threads
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef PIBUS_WORKER_POOL_H
+#define PIBUS_WORKER_POOL_H
+
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <pthread.h>
+#include <sched.h>
+
+#define PIBUS_WORKER_YIELD	256		// polling iterations before a yield
+#define PIBUS_WORKER_SPIN	(1 << 18)	// polling iterations before blocking
+#define PIBUS_WORKER_JOBS	64		// max number of jobs per thread
+
+#if defined(__i386__) || defined(__x86_64__)
+#define PIBUS_WORKER_PAUSE()	__builtin_ia32_pause()
+#else
+#define PIBUS_WORKER_PAUSE()	__sync_synchronize()
+#endif
+
+namespace soclib { namespace caba {
+
+class PibusWorkerPool;
+
+//////////////////////////////////////////////////////////////////////////////////
+//			PibusWorkerJob definition
+//////////////////////////////////////////////////////////////////////////////////
+
+class PibusWorkerJob {
+
+friend class PibusWorkerPool;
+
+volatile bool	m_pending;	// posted and not completed
+size_t		m_thread;	// owner thread index (attached if m_attached)
+bool		m_attached;	// attached to a host thread
+
+public:
+
+PibusWorkerJob() : m_pending(false), m_thread(0), m_attached(false) {}
+
+virtual ~PibusWorkerJob() {}
+
+virtual void run() = 0;
+
+bool isPending() const
+{
+	return m_pending;
+};
+
+}; // end class PibusWorkerJob
+
+//////////////////////////////////////////////////////////////////////////////////
+//			PibusWorkerPool definition
+//////////////////////////////////////////////////////////////////////////////////
+
+class PibusWorkerPool {
+
+// host thread state
+struct Worker {
+	PibusWorkerPool*	m_pool;
+	pthread_t		m_thread;
+	PibusWorkerJob*		m_jobs[PIBUS_WORKER_JOBS];	// attached jobs
+	volatile size_t		m_njobs;			// number of attached jobs
+	volatile bool		m_sleeping;			// blocked on m_wakeup
+	pthread_cond_t		m_wakeup;			// signaled by post()
+};
+
+std::vector<Worker*>		m_workers;	// host threads
+size_t				m_next;		// next thread for a job attachment
+bool				m_inline;	// jobs executed by post() (no host thread)
+pthread_mutex_t			m_mutex;	// protects the sleeping threads
+volatile bool			m_exit;		// the threads must exit
+
+///////////////////////////////////
+static bool pending(Worker* w)
+{
+	size_t njobs = w->m_njobs;
+	__sync_synchronize();
+	for (size_t k = 0 ; k < njobs ; k++) if (w->m_jobs[k]->m_pending) return true;
+	return false;
+};
+
+///////////////////////////////////
+static void* worker(void* arg)
+{
+	Worker*          w    = (Worker*)arg;
+	PibusWorkerPool* pool = w->m_pool;
+	size_t           idle = 0;
+	while (not pool->m_exit)
+	{
+		// fast path : execute the pending jobs
+		size_t njobs = w->m_njobs;
+		__sync_synchronize();
+		bool   found = false;
+		for (size_t k = 0 ; k < njobs ; k++)
+		{
+			PibusWorkerJob* job = w->m_jobs[k];
+			if (not job->m_pending) continue;
+			__sync_synchronize();
+			job->run();
+			__sync_synchronize();
+			job->m_pending = false;
+			found = true;
+		}
+		if (found)
+		{
+			idle = 0;
+		}
+		else if (++idle < PIBUS_WORKER_SPIN)
+		{
+			if ((idle % PIBUS_WORKER_YIELD) == 0) sched_yield();
+			else                                  PIBUS_WORKER_PAUSE();
+		}
+		else	// slow path : block until the next post()
+		{
+			pthread_mutex_lock(&pool->m_mutex);
+			w->m_sleeping = true;
+			__sync_synchronize();
+			if (not pending(w) && not pool->m_exit) pthread_cond_wait(&w->m_wakeup, &pool->m_mutex);
+			w->m_sleeping = false;
+			pthread_mutex_unlock(&pool->m_mutex);
+			idle = 0;
+		}
+	}
+	return NULL;
+};
+
+public:
+
+//////////////////////////////////////
+PibusWorkerPool(size_t nthreads)
+	: m_workers(nthreads),
+	  m_next(0),
+	  m_exit(false)
+{
+	if (nthreads == 0)
+	{
+		std::cerr << "ERROR in PibusWorkerPool" << std::endl;
+		std::cerr << "The number of threads cannot be 0" << std::endl;
+		exit(0);
+	}
+	pthread_mutex_init(&m_mutex, NULL);
+
+	// spinning threads require a host processor each (+ the SystemC thread)
+	cpu_set_t cpus;
+	size_t    ncpus = 1;
+	if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) ncpus = CPU_COUNT(&cpus);
+	m_inline = (nthreads >= ncpus);
+	if (m_inline)
+	{
+		std::cout << std::endl << "Instanciation of PibusWorkerPool" << std::endl;
+		std::cout << "    nthreads = " << nthreads << " / host processors = " << ncpus
+		          << " : sequential execution" << std::endl;
+		m_workers.clear();
+		return;
+	}
+	for (size_t i = 0 ; i < nthreads ; i++)
+	{
+		Worker* w     = new Worker;
+		w->m_pool     = this;
+		w->m_njobs    = 0;
+		w->m_sleeping = false;
+		pthread_cond_init(&w->m_wakeup, NULL);
+		m_workers[i]  = w;
+		if (pthread_create(&w->m_thread, NULL, &PibusWorkerPool::worker, w) != 0)
+		{
+			std::cerr << "ERROR in PibusWorkerPool" << std::endl;
+			std::cerr << "Cannot create the host thread " << i << std::endl;
+			exit(0);
+		}
+	}
+	std::cout << std::endl << "Instanciation of PibusWorkerPool" << std::endl;
+	std::cout << "    nthreads = " << nthreads << std::endl;
+}; // end constructor
+
+/////////////////////
+~PibusWorkerPool()
+{
+	pthread_mutex_lock(&m_mutex);
+	m_exit = true;
+	for (size_t i = 0 ; i < m_workers.size() ; i++) pthread_cond_signal(&m_workers[i]->m_wakeup);
+	pthread_mutex_unlock(&m_mutex);
+	for (size_t i = 0 ; i < m_workers.size() ; i++)
+	{
+		pthread_join(m_workers[i]->m_thread, NULL);
+		pthread_cond_destroy(&m_workers[i]->m_wakeup);
+		delete m_workers[i];
+	}
+	pthread_mutex_destroy(&m_mutex);
+};
+
+////////////////////////////////
+void post(PibusWorkerJob* job)
+{
+	if (m_inline)
+	{
+		job->run();
+		return;
+	}
+	if (not job->m_attached)	// attach the job to a host thread
+	{
+		Worker* w = m_workers[m_next];
+		if (w->m_njobs == PIBUS_WORKER_JOBS)
+		{
+			std::cerr << "ERROR in PibusWorkerPool" << std::endl;
+			std::cerr << "The number of jobs per thread cannot be larger than "
+			          << PIBUS_WORKER_JOBS << std::endl;
+			exit(0);
+		}
+		w->m_jobs[w->m_njobs] = job;
+		__sync_synchronize();
+		w->m_njobs       = w->m_njobs + 1;
+		job->m_thread   = m_next;
+		job->m_attached = true;
+		m_next          = (m_next + 1) % m_workers.size();
+	}
+	Worker* w = m_workers[job->m_thread];
+	__sync_synchronize();
+	job->m_pending = true;
+	__sync_synchronize();
+	if (w->m_sleeping)		// slow path : wake up the thread
+	{
+		pthread_mutex_lock(&m_mutex);
+		pthread_cond_signal(&w->m_wakeup);
+		pthread_mutex_unlock(&m_mutex);
+	}
+};
+
+////////////////////////////////
+void wait(PibusWorkerJob* job)
+{
+	for (size_t i = 1 ; job->m_pending ; i++)
+	{
+		if ((i % PIBUS_WORKER_YIELD) == 0) sched_yield();
+		else                               PIBUS_WORKER_PAUSE();
+	}
+	__sync_synchronize();
+};
+
+//////////////////////////////
+size_t getNThreads() const
+{
+	return m_workers.size();	// 0 for a sequential execution
+};
+
+}; // end class PibusWorkerPool
+
+}} // end namespaces
+
+#endif
@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////
+// File : bench_map.h
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// Address map of the pibus_bench platform.
+// This file is included by the top cell and by the embedded software
+// (C and assembly), and must only contain #define directives.
+// The MSB number is 8 : each segment is in a separate 16 Mbytes page.
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef BENCH_MAP_H
+#define BENCH_MAP_H
+
+#define BENCH_MAX_PROCS		8
+
+// RAM segments (target 0)
+#define SEG_RESET_BASE		0xBFC00000
+#define SEG_RESET_SIZE		0x00010000
+#define SEG_TEXT_BASE		0x00400000
+#define SEG_TEXT_SIZE		0x00100000
+#define SEG_DATA_BASE		0x10000000
+#define SEG_DATA_SIZE		0x01000000
+#define SEG_STACK_BASE		0x20000000
+#define SEG_STACK_SIZE		0x00080000	// 64 Kbytes per processor
+
+// peripherals (targets 1 to 6)
+#define SEG_TTY_BASE		0x90000000
+#define SEG_TTY_SIZE		0x00000200	// 16 bytes per terminal + FIFOs
+#define SEG_TIMER_BASE		0x91000000
+#define SEG_TIMER_SIZE		0x00000100	// 16 bytes per timer
+#define SEG_ICU_BASE		0x92000000
+#define SEG_ICU_SIZE		0x00000100
+#define SEG_DMA_BASE		0x93000000
+#define SEG_DMA_SIZE		0x00000100
+#define SEG_LOCKS_BASE		0x94000000
+#define SEG_LOCKS_SIZE		0x00000100	// 64 locks
+#define SEG_BDEV_BASE		0x95000000
+#define SEG_BDEV_SIZE		0x00000100
+
+// workload buffers (in the data segment)
+#define BENCH_COPY_BASE		0x10000000	// 1 Mbytes per processor
+#define BENCH_COPY_SIZE		0x00008000	// bytes copied per iteration
+#define BENCH_DMA_SRC		0x10800000
+#define BENCH_DMA_DST		0x10A00000
+#define BENCH_DMA_SIZE		0x00010000	// bytes per DMA transfer
+#define BENCH_BDEV_BUF		0x10C00000
+#define BENCH_BDEV_BLOCKS	8		// blocks per transfer
+#define BENCH_SHARED		0x10F00000	// shared counters
+
+#endif
@@ -0,0 +1,24 @@
+
+# -*- python -*-
+
+# pibus_bench reference platform : soclib-cc -P -p desc.py -o simulator.x
+
+todo = Platform('caba', 'top.cpp',
+	uses = [
+		Uses('caba:pibus_seg_bcu'),
+		Uses('caba:pibus_mips32_xcache'),
+		Uses('caba:pibus_simple_ram'),
+		Uses('caba:pibus_multi_tty'),
+		Uses('caba:pibus_multi_timer'),
+		Uses('caba:pibus_icu'),
+		Uses('caba:pibus_dma'),
+		Uses('caba:pibus_locks'),
+		Uses('caba:pibus_block_device'),
+		Uses('caba:pibus_counter_registry'),
+		Uses('caba:pibus_counter_sampler'),
+		Uses('caba:pibus_trace_recorder'),
+		Uses('caba:pibus_checkpoint'),
+		Uses('common:loader'),
+		Uses('common:mips32'),
+		],
+)
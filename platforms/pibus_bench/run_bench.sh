@@ -0,0 +1,41 @@
+#!/bin/sh
+###########################################################################
+# File : run_bench.sh
+# Date : 14/10/2026
+# Copyright : UPMC - LIP6
+# This program is released under the GNU public license
+###########################################################################
+# Runs all the pibus_bench configurations (1/2/4/8 processors x
+# memcpy/spinlock/dma/bdev workloads), and writes one JSON object per
+# configuration in the result file (default bench_results.json).
+# The workloads are built first (soft/Makefile).
+# The -t option defines the number of ISS host threads (-THREADS).
+#   run_bench.sh [-n ncycles] [-o result_file] [-t nthreads]
+###########################################################################
+
+NCYCLES=1000000
+RESULT=bench_results.json
+NTHREADS=0
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+	-n) NCYCLES=$2; shift 2 ;;
+	-o) RESULT=$2; shift 2 ;;
+	-t) NTHREADS=$2; shift 2 ;;
+	*)  echo "usage : run_bench.sh [-n ncycles] [-o result_file] [-t nthreads]"; exit 1 ;;
+	esac
+done
+
+make -s -C soft || exit 1
+
+SC_SIGNAL_WRITE_CHECK=DISABLE
+export SC_SIGNAL_WRITE_CHECK
+
+: > $RESULT
+for WORKLOAD in memcpy spinlock dma bdev; do
+	for NPROCS in 1 2 4 8; do
+		./simulator.x -NPROCS $NPROCS -WORKLOAD $WORKLOAD -NCYCLES $NCYCLES -THREADS $NTHREADS \
+			| grep '^{ "platform"' >> $RESULT || exit 1
+	done
+done
+cat $RESULT
@@ -0,0 +1,193 @@
+/////////////////////////////////////////////////////////////////////////
+// File : main.c
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+/////////////////////////////////////////////////////////////////////////
+// Workloads of the pibus_bench platform. The workload is selected at
+// compile time, and each workload is an infinite loop (the simulation
+// length is defined by the top cell) :
+// - WORKLOAD_MEMCPY   : each processor copies BENCH_COPY_SIZE bytes
+//                       between two private buffers.
+// - WORKLOAD_SPINLOCK : all processors increment a shared counter,
+//                       protected by lock 0 of the PibusLocks component.
+// - WORKLOAD_DMA      : processor 0 starts BENCH_DMA_SIZE bytes DMA
+//                       transfers, and polls the DMA status.
+// - WORKLOAD_BDEV     : processor 0 reads BENCH_BDEV_BLOCKS blocks from
+//                       the block device, and polls the device status.
+// In the DMA and BDEV workloads, the other processors execute a
+// computation loop in their caches.
+//
+// The binaries (memcpy.elf, spinlock.elf, dma.elf and bdev.elf) are
+// built by the Makefile, with the MIPS32 little endian cross-compiler.
+// The BDEV register indexes must match the PibusBlockDevice register
+// map (BUFFER = 0, LBA = 1, COUNT = 2, OP = 3, STATUS = 4, SIZE = 6).
+/////////////////////////////////////////////////////////////////////////
+
+#include "bench_map.h"
+
+#define DMA_SOURCE		0
+#define DMA_DEST		1
+#define DMA_LENGTH		2
+#define DMA_RESET		3
+#define DMA_IRQ_DISABLED	4
+#define DMA_IDLE		3
+
+#define BDEV_BUFFER		0
+#define BDEV_LBA		1
+#define BDEV_COUNT		2
+#define BDEV_OP			3
+#define BDEV_STATUS		4
+#define BDEV_SIZE		6
+#define BDEV_READ		1
+#define BDEV_READ_SUCCESS	2
+
+typedef volatile unsigned int	reg_t;
+
+//////////////////////////////
+static unsigned int procid()
+{
+    unsigned int ebase;
+    asm volatile ("mfc0 %0, $15, 1" : "=r" (ebase));
+    return ebase & 0x3FF;
+}
+
+////////////////////////////////////////////////
+static void tty_puts(unsigned int id, char* s)
+{
+    reg_t* tty = (reg_t*)(SEG_TTY_BASE + 16*id);
+    while (*s != 0) tty[0] = *s++;
+}
+
+///////////////////////////////////////////////////////////////
+static void tty_putx(unsigned int id, unsigned int value)
+{
+    char buf[11];
+    int  i;
+    buf[0]  = '0';
+    buf[1]  = 'x';
+    buf[10] = 0;
+    for (i = 0 ; i < 8 ; i++)
+    {
+        unsigned int digit = (value >> (28 - 4*i)) & 0xF;
+        buf[2 + i] = (digit < 10) ? ('0' + digit) : ('a' + digit - 10);
+    }
+    tty_puts(id, buf);
+}
+
+/////////////////////////////////////////////
+static void compute(unsigned int id)
+{
+    unsigned int x = id + 1;
+    while (1) x = x * 1103515245 + 12345;
+}
+
+/////////////////////////////////////////////
+static void memcpy_loop(unsigned int id)
+{
+    unsigned int* src = (unsigned int*)(BENCH_COPY_BASE + (id << 20));
+    unsigned int* dst = (unsigned int*)(BENCH_COPY_BASE + (id << 20) + (1 << 19));
+    unsigned int  n   = BENCH_COPY_SIZE >> 2;
+    unsigned int  iter;
+    unsigned int  i;
+    for (iter = 0 ; ; iter++)
+    {
+        for (i = 0 ; i < n ; i++) dst[i] = src[i] + iter;
+        if ((iter & 0xF) == 0)
+        {
+            tty_puts(id, "memcpy ");
+            tty_putx(id, iter);
+            tty_puts(id, "\n");
+        }
+    }
+}
+
+/////////////////////////////////////////////
+static void spinlock_loop(unsigned int id)
+{
+    reg_t*        lock    = (reg_t*)SEG_LOCKS_BASE;
+    unsigned int* counter = (unsigned int*)BENCH_SHARED;
+    unsigned int  iter;
+    for (iter = 0 ; ; iter++)
+    {
+        while (lock[0] != 0);	// a read is a "set"
+        *counter = *counter + 1;
+        lock[0] = 0;		// a write is a "reset"
+        if ((iter & 0xFF) == 0)
+        {
+            tty_puts(id, "counter ");
+            tty_putx(id, *counter);
+            tty_puts(id, "\n");
+        }
+    }
+}
+
+/////////////////////////////////////////////
+static void dma_loop(unsigned int id)
+{
+    reg_t*       dma = (reg_t*)SEG_DMA_BASE;
+    unsigned int iter;
+    unsigned int status;
+    dma[DMA_IRQ_DISABLED] = 1;
+    for (iter = 0 ; ; iter++)
+    {
+        dma[DMA_SOURCE] = BENCH_DMA_SRC;
+        dma[DMA_DEST]   = BENCH_DMA_DST;
+        dma[DMA_LENGTH] = BENCH_DMA_SIZE;
+        while ((status = dma[DMA_LENGTH]) >= DMA_IDLE);
+        dma[DMA_RESET] = 0;
+        if ((status != 0) || ((iter & 0xF) == 0))
+        {
+            tty_puts(id, "dma ");
+            tty_putx(id, iter);
+            tty_puts(id, (status == 0) ? " success\n" : " error\n");
+        }
+    }
+}
+
+/////////////////////////////////////////////
+static void bdev_loop(unsigned int id)
+{
+    reg_t*       bdev   = (reg_t*)SEG_BDEV_BASE;
+    unsigned int nblocks = bdev[BDEV_SIZE];
+    unsigned int lba    = 0;
+    unsigned int iter;
+    unsigned int status;
+    for (iter = 0 ; ; iter++)
+    {
+        if (lba + BENCH_BDEV_BLOCKS > nblocks) lba = 0;
+        bdev[BDEV_BUFFER] = BENCH_BDEV_BUF;
+        bdev[BDEV_COUNT]  = BENCH_BDEV_BLOCKS;
+        bdev[BDEV_LBA]    = lba;
+        bdev[BDEV_OP]     = BDEV_READ;
+        while ((status = bdev[BDEV_STATUS]) < BDEV_READ_SUCCESS);
+        lba = lba + BENCH_BDEV_BLOCKS;
+        if ((status != BDEV_READ_SUCCESS) || ((iter & 0xF) == 0))
+        {
+            tty_puts(id, "bdev ");
+            tty_putx(id, iter);
+            tty_puts(id, (status == BDEV_READ_SUCCESS) ? " success\n" : " error\n");
+        }
+    }
+}
+
+///////////
+int main()
+{
+    unsigned int id = procid();
+
+#if defined(WORKLOAD_MEMCPY)
+    memcpy_loop(id);
+#elif defined(WORKLOAD_SPINLOCK)
+    spinlock_loop(id);
+#elif defined(WORKLOAD_DMA)
+    if (id == 0) dma_loop(id);
+    else         compute(id);
+#elif defined(WORKLOAD_BDEV)
+    if (id == 0) bdev_loop(id);
+    else         compute(id);
+#else
+#error "the workload must be defined"
+#endif
+    return 0;
+}
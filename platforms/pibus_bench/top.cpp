@@ -0,0 +1,498 @@
+///////////////////////////////////////////////////////////////////////////
+// File : top.cpp
+// Date : 14/10/2026
+// Copyright : UPMC - LIP6
+// This program is released under the GNU public license
+///////////////////////////////////////////////////////////////////////////
+// Reference platform for the PIBUS simulation speed benchmarks.
+// It contains 1, 2, 4 or 8 PibusMips32Xcache processors, a RAM, a TTY
+// (one terminal per processor), a timer (one timer per processor),
+// an ICU, a DMA controller, a locks component and a block device.
+// - masters : processors [0 , NPROCS[ , DMA (NPROCS), BDEV (NPROCS+1)
+// - targets : RAM (0), TTY (1), TIMER (2), ICU (3), DMA (4), LOCKS (5),
+//             BDEV (6)
+// The address map is defined in the bench_map.h file. The ICU output
+// is connected to processor 0. The ICU inputs are the TTY keyboard
+// IRQs [0 , NPROCS[, the timer IRQs [NPROCS , 2*NPROCS[, the DMA IRQ,
+// the BDEV IRQ and the LOCKS IRQ (only connected when the locks
+// component is in DEFER mode, the ICU input is null otherwise).
+//
+// The workloads (soft directory) are memcpy, spinlock, dma and bdev.
+// The simulation runs for a fixed number of cycles, and the top cell
+// reports the elaboration and simulation host wall times, the
+// simulation speed (simulated cycles per second) and the peak
+// resident memory (RSS) of the host process. The last line is a JSON
+// object, to be parsed by regression scripts.
+//
+// Command line arguments :
+// - -NPROCS n        : number of processors (1, 2, 4 or 8 / default 1)
+// - -WORKLOAD name   : memcpy, spinlock, dma or bdev (default memcpy)
+// - -SOFT file       : binary file (default soft/<workload>.elf)
+// - -NCYCLES n       : number of simulated cycles (default 1000000)
+// - -DISK file       : block device image (default bench_disk.img,
+//                      created with 2048 null blocks if it does not exist)
+// - -STATS           : the components statistics are printed
+// - -COUNTERS file   : the performance counters are sampled in file
+// - -PERIOD n        : counters sampling period (default 10000 cycles)
+// - -BUSTRACE file   : the PIBUS transactions are recorded in file
+// - -THREADS n       : the ISS cycles are executed by a PibusWorkerPool
+//                      of n host threads (default 0 : sequential)
+// - -HEADLESS        : the terminals are logged in files (tty_<i>.log)
+//                      with a buffered display, instead of XTERMs
+// - -RESTORE file    : the platform state is restored from the checkpoint
+//                      file after the reset
+// - -SAVE file       : the platform state is saved in the checkpoint file
+//                      after NCYCLES cycles (and the cycles required to
+//                      reach a checkpoint condition). The checkpoint is
+//                      incremental when the -RESTORE option is used.
+// To start several experiments from the same boot, the boot is simulated
+// once with -SAVE, and each experiment is started with -RESTORE. The
+// disk image is not saved : the bdev workload only reads the disk.
+//
+// The simulator is built with : soclib-cc -P -p desc.py -o simulator.x
+// and the PIBUS signals have several writers : the SystemC write
+// check is disabled by the SC_SIGNAL_WRITE_CHECK environment variable.
+///////////////////////////////////////////////////////////////////////////
+
+#include <systemc>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "alloc_elems.h"
+#include "loader.h"
+#include "pibus_segment_table.h"
+#include "pibus_seg_bcu.h"
+#include "pibus_mips32_xcache.h"
+#include "pibus_simple_ram.h"
+#include "pibus_multi_tty.h"
+#include "pibus_multi_timer.h"
+#include "pibus_icu.h"
+#include "pibus_dma.h"
+#include "pibus_locks.h"
+#include "pibus_block_device.h"
+#include "pibus_counter_registry.h"
+#include "pibus_counter_sampler.h"
+#include "pibus_trace_recorder.h"
+#include "pibus_checkpoint.h"
+#include "bench_map.h"
+
+#define BENCH_BLOCK_SIZE	512
+#define BENCH_DISK_BLOCKS	2048
+#define BENCH_CKPT_CYCLES	1000000		// max cycles to reach a checkpoint condition
+
+using namespace sc_core;
+using namespace soclib::caba;
+using namespace soclib::common;
+
+///////////////////////////
+static double wallTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + 1e-6 * (double)tv.tv_usec;
+}
+
+/////////////////////////////////////////////////////
+// creates a null disk image if it does not exist
+/////////////////////////////////////////////////////
+static void createDisk(const char* name)
+{
+    if (access(name, F_OK) == 0) return;
+    int fd = open(name, O_RDWR | O_CREAT, 0644);
+    if ((fd < 0) || (ftruncate(fd, (off_t)BENCH_BLOCK_SIZE * BENCH_DISK_BLOCKS) != 0))
+    {
+        std::cout << "ERROR in pibus_bench : cannot create the disk image " << name << std::endl;
+        exit(0);
+    }
+    close(fd);
+}
+
+//////////////////////////////////
+int sc_main(int argc, char *argv[])
+{
+    ///////////////////////////////////////////////////////////////
+    // command line arguments
+    ///////////////////////////////////////////////////////////////
+    size_t		nprocs    = 1;
+    std::string		workload  = "memcpy";
+    std::string		soft_name = "";
+    uint64_t		ncycles   = 1000000;
+    std::string		disk_name = "bench_disk.img";
+    bool		stats     = false;
+    const char*		counters  = NULL;
+    uint32_t		period    = 10000;
+    const char*		bustrace  = NULL;
+    bool		headless  = false;
+    size_t		nthreads  = 0;
+    const char*		save_name = NULL;
+    const char*		restore_name = NULL;
+
+    for (int n = 1 ; n < argc ; n++)
+    {
+        bool value = (n + 1 < argc);
+        if      ((strcmp(argv[n], "-NPROCS") == 0) && value)	nprocs    = atoi(argv[++n]);
+        else if ((strcmp(argv[n], "-WORKLOAD") == 0) && value)	workload  = argv[++n];
+        else if ((strcmp(argv[n], "-SOFT") == 0) && value)	soft_name = argv[++n];
+        else if ((strcmp(argv[n], "-NCYCLES") == 0) && value)	ncycles   = strtoull(argv[++n], NULL, 0);
+        else if ((strcmp(argv[n], "-DISK") == 0) && value)	disk_name = argv[++n];
+        else if  (strcmp(argv[n], "-STATS") == 0)		stats     = true;
+        else if ((strcmp(argv[n], "-COUNTERS") == 0) && value)	counters  = argv[++n];
+        else if ((strcmp(argv[n], "-PERIOD") == 0) && value)	period    = atoi(argv[++n]);
+        else if ((strcmp(argv[n], "-BUSTRACE") == 0) && value)	bustrace  = argv[++n];
+        else if  (strcmp(argv[n], "-HEADLESS") == 0)		headless  = true;
+        else if ((strcmp(argv[n], "-THREADS") == 0) && value)	nthreads  = atoi(argv[++n]);
+        else if ((strcmp(argv[n], "-SAVE") == 0) && value)	save_name = argv[++n];
+        else if ((strcmp(argv[n], "-RESTORE") == 0) && value)	restore_name = argv[++n];
+        else
+        {
+            std::cout << "ERROR in pibus_bench : illegal argument " << argv[n] << std::endl;
+            std::cout << "usage : simulator.x [-NPROCS n] [-WORKLOAD name] [-SOFT file] [-NCYCLES n]" << std::endl;
+            std::cout << "                    [-DISK file] [-STATS] [-COUNTERS file] [-PERIOD n]" << std::endl;
+            std::cout << "                    [-BUSTRACE file] [-THREADS n] [-HEADLESS] [-SAVE file] [-RESTORE file]" << std::endl;
+            exit(0);
+        }
+    }
+    if ((nprocs != 1) && (nprocs != 2) && (nprocs != 4) && (nprocs != 8))
+    {
+        std::cout << "ERROR in pibus_bench : NPROCS must be 1, 2, 4 or 8" << std::endl;
+        exit(0);
+    }
+    if ((workload != "memcpy") && (workload != "spinlock") &&
+        (workload != "dma") && (workload != "bdev"))
+    {
+        std::cout << "ERROR in pibus_bench : WORKLOAD must be memcpy, spinlock, dma or bdev" << std::endl;
+        exit(0);
+    }
+    if (soft_name == "") soft_name = "soft/" + workload + ".elf";
+    createDisk(disk_name.c_str());
+
+    setenv("SC_SIGNAL_WRITE_CHECK", "DISABLE", 1);
+
+    double start_time = wallTime();
+
+    const size_t nmasters = nprocs + 2;
+    const size_t ntargets = 7;
+    const size_t nirq     = 2*nprocs + 3;
+    const int    locks_mode = PibusLocks::LOCKS_MODE_TAS;
+
+    ///////////////////////////////////////////////////////////////
+    // segment table
+    ///////////////////////////////////////////////////////////////
+    PibusSegmentTable segtab;
+    segtab.setMSBnumber(8);
+    segtab.addSegment("seg_reset", SEG_RESET_BASE, SEG_RESET_SIZE, 0, true);
+    segtab.addSegment("seg_text",  SEG_TEXT_BASE,  SEG_TEXT_SIZE,  0, true);
+    segtab.addSegment("seg_data",  SEG_DATA_BASE,  SEG_DATA_SIZE,  0, true);
+    segtab.addSegment("seg_stack", SEG_STACK_BASE, SEG_STACK_SIZE, 0, true);
+    segtab.addSegment("seg_tty",   SEG_TTY_BASE,   SEG_TTY_SIZE,   1, false);
+    segtab.addSegment("seg_timer", SEG_TIMER_BASE, SEG_TIMER_SIZE, 2, false);
+    segtab.addSegment("seg_icu",   SEG_ICU_BASE,   SEG_ICU_SIZE,   3, false);
+    segtab.addSegment("seg_dma",   SEG_DMA_BASE,   SEG_DMA_SIZE,   4, false);
+    segtab.addSegment("seg_locks", SEG_LOCKS_BASE, SEG_LOCKS_SIZE, 5, false);
+    segtab.addSegment("seg_bdev",  SEG_BDEV_BASE,  SEG_BDEV_SIZE,  6, false);
+
+    ///////////////////////////////////////////////////////////////
+    // signals
+    ///////////////////////////////////////////////////////////////
+    sc_clock			signal_clk("signal_clk", sc_time(1, SC_NS));
+    sc_signal<bool>		signal_resetn("signal_resetn");
+    sc_signal<bool>		signal_false("signal_false");
+
+    sc_signal<bool>*		signal_req  = alloc_elems<sc_signal<bool> >("signal_req", nmasters);
+    sc_signal<bool>*		signal_gnt  = alloc_elems<sc_signal<bool> >("signal_gnt", nmasters);
+    sc_signal<bool>*		signal_sel  = alloc_elems<sc_signal<bool> >("signal_sel", ntargets);
+    sc_signal<uint32_t>		signal_a("signal_pibus_a");
+    sc_signal<uint32_t>		signal_opc("signal_pibus_opc");
+    sc_signal<bool>		signal_read("signal_pibus_read");
+    sc_signal<bool>		signal_lock("signal_pibus_lock");
+    sc_signal<uint32_t>		signal_d("signal_pibus_d");
+    sc_signal<uint32_t>		signal_ack("signal_pibus_ack");
+    sc_signal<bool>		signal_tout("signal_pibus_tout");
+    sc_signal<bool>		signal_avalid("signal_pibus_avalid");
+
+    sc_signal<bool>*		signal_irq     = alloc_elems<sc_signal<bool> >("signal_irq", nirq);
+    sc_signal<bool>*		signal_irq_put = alloc_elems<sc_signal<bool> >("signal_irq_put", nprocs);
+    sc_signal<bool>		signal_irq_proc("signal_irq_proc");
+
+    ///////////////////////////////////////////////////////////////
+    // components
+    ///////////////////////////////////////////////////////////////
+    Loader loader(soft_name);
+
+    PibusSegBcu bcu("bcu", segtab, nmasters, ntargets, 100);
+
+    PibusMips32Xcache** proc = new PibusMips32Xcache*[nprocs];
+    for (size_t i = 0 ; i < nprocs ; i++)
+    {
+        char name[16];
+        snprintf(name, 16, "proc_%d", (int)i);
+        proc[i] = new PibusMips32Xcache(name, segtab, i, 4, 64, 8, 4, 64, 8, 8);
+    }
+
+    // parallel mode : ISS cycles executed by host threads
+    PibusWorkerPool* pool = NULL;
+    if (nthreads != 0)
+    {
+        pool = new PibusWorkerPool(nthreads);
+        for (size_t i = 0 ; i < nprocs ; i++) proc[i]->setParallel(pool);
+    }
+
+    PibusSimpleRam		ram("ram", 0, segtab, 0, loader);
+    PibusMultiTty		tty("tty", 1, segtab, nprocs, headless, headless);
+    PibusMultiTimer		timer("timer", 2, segtab, nprocs);
+    PibusIcu			icu("icu", 3, segtab, nirq);
+    PibusDma			dma("dma", 4, segtab, 32);
+    PibusLocks			locks("locks", 5, segtab, 64, locks_mode);
+    PibusBlockDevice		bdev("bdev", 6, segtab, (char*)disk_name.c_str(), BENCH_BLOCK_SIZE, 100);
+
+    ///////////////////////////////////////////////////////////////
+    // net-list
+    ///////////////////////////////////////////////////////////////
+    bcu.p_ck		(signal_clk);
+    bcu.p_resetn	(signal_resetn);
+    bcu.p_a		(signal_a);
+    bcu.p_lock		(signal_lock);
+    bcu.p_ack		(signal_ack);
+    bcu.p_tout		(signal_tout);
+    bcu.p_avalid	(signal_avalid);
+    for (size_t i = 0 ; i < nmasters ; i++)
+    {
+        bcu.p_req[i]	(signal_req[i]);
+        bcu.p_gnt[i]	(signal_gnt[i]);
+    }
+    for (size_t t = 0 ; t < ntargets ; t++) bcu.p_sel[t] (signal_sel[t]);
+
+    for (size_t i = 0 ; i < nprocs ; i++)
+    {
+        proc[i]->p_ck		(signal_clk);
+        proc[i]->p_resetn	(signal_resetn);
+        proc[i]->p_irq		((i == 0) ? signal_irq_proc : signal_false);
+        proc[i]->p_req		(signal_req[i]);
+        proc[i]->p_gnt		(signal_gnt[i]);
+        proc[i]->p_lock		(signal_lock);
+        proc[i]->p_read		(signal_read);
+        proc[i]->p_opc		(signal_opc);
+        proc[i]->p_a		(signal_a);
+        proc[i]->p_d		(signal_d);
+        proc[i]->p_ack		(signal_ack);
+        proc[i]->p_tout		(signal_tout);
+        proc[i]->p_avalid	(signal_avalid);
+    }
+
+    ram.p_ck		(signal_clk);
+    ram.p_resetn	(signal_resetn);
+    ram.p_sel		(signal_sel[0]);
+    ram.p_a		(signal_a);
+    ram.p_read		(signal_read);
+    ram.p_opc		(signal_opc);
+    ram.p_ack		(signal_ack);
+    ram.p_d		(signal_d);
+    ram.p_tout		(signal_tout);
+
+    tty.p_ck		(signal_clk);
+    tty.p_resetn	(signal_resetn);
+    tty.p_sel		(signal_sel[1]);
+    tty.p_a		(signal_a);
+    tty.p_read		(signal_read);
+    tty.p_opc		(signal_opc);
+    tty.p_ack		(signal_ack);
+    tty.p_d		(signal_d);
+    tty.p_tout		(signal_tout);
+    for (size_t i = 0 ; i < nprocs ; i++)
+    {
+        tty.p_irq_get[i]	(signal_irq[i]);
+        tty.p_irq_put[i]	(signal_irq_put[i]);
+    }
+
+    timer.p_ck		(signal_clk);
+    timer.p_resetn	(signal_resetn);
+    timer.p_sel		(signal_sel[2]);
+    timer.p_a		(signal_a);
+    timer.p_read	(signal_read);
+    timer.p_opc		(signal_opc);
+    timer.p_ack		(signal_ack);
+    timer.p_d		(signal_d);
+    timer.p_tout	(signal_tout);
+    for (size_t i = 0 ; i < nprocs ; i++) timer.p_irq[i] (signal_irq[nprocs + i]);
+
+    icu.p_ck		(signal_clk);
+    icu.p_resetn	(signal_resetn);
+    icu.p_sel		(signal_sel[3]);
+    icu.p_a		(signal_a);
+    icu.p_read		(signal_read);
+    icu.p_opc		(signal_opc);
+    icu.p_ack		(signal_ack);
+    icu.p_d		(signal_d);
+    icu.p_tout		(signal_tout);
+    for (size_t i = 0 ; i < nirq ; i++) icu.p_irq_in[i] (signal_irq[i]);
+    icu.p_irq_out[0]	(signal_irq_proc);
+
+    dma.p_ck		(signal_clk);
+    dma.p_resetn	(signal_resetn);
+    dma.p_req		(signal_req[nprocs]);
+    dma.p_gnt		(signal_gnt[nprocs]);
+    dma.p_sel		(signal_sel[4]);
+    dma.p_a		(signal_a);
+    dma.p_read		(signal_read);
+    dma.p_opc		(signal_opc);
+    dma.p_lock		(signal_lock);
+    dma.p_ack		(signal_ack);
+    dma.p_d		(signal_d);
+    dma.p_tout		(signal_tout);
+    dma.p_irq		(signal_irq[2*nprocs]);
+
+    locks.p_ck		(signal_clk);
+    locks.p_resetn	(signal_resetn);
+    locks.p_sel		(signal_sel[5]);
+    locks.p_a		(signal_a);
+    locks.p_read	(signal_read);
+    locks.p_opc		(signal_opc);
+    locks.p_ack		(signal_ack);
+    locks.p_d		(signal_d);
+    locks.p_tout	(signal_tout);
+    if (locks_mode == PibusLocks::LOCKS_MODE_DEFER)
+    {
+        locks.p_irq	(signal_irq[2*nprocs + 2]);
+    }
+
+    bdev.p_ck		(signal_clk);
+    bdev.p_resetn	(signal_resetn);
+    bdev.p_req		(signal_req[nprocs + 1]);
+    bdev.p_gnt		(signal_gnt[nprocs + 1]);
+    bdev.p_sel		(signal_sel[6]);
+    bdev.p_a		(signal_a);
+    bdev.p_read		(signal_read);
+    bdev.p_opc		(signal_opc);
+    bdev.p_lock		(signal_lock);
+    bdev.p_ack		(signal_ack);
+    bdev.p_d		(signal_d);
+    bdev.p_tout		(signal_tout);
+    bdev.p_irq		(signal_irq[2*nprocs + 1]);
+
+    ///////////////////////////////////////////////////////////////
+    // optional instrumentation
+    ///////////////////////////////////////////////////////////////
+    PibusCounterRegistry	registry;
+    PibusCounterSampler*	sampler  = NULL;
+    PibusTraceRecorder*		recorder = NULL;
+    if (counters != NULL)
+    {
+        bcu.registerCounters(registry);
+        for (size_t i = 0 ; i < nprocs ; i++) proc[i]->registerCounters(registry);
+        ram.registerCounters(registry);
+        tty.registerCounters(registry);
+        dma.registerCounters(registry);
+        bdev.registerCounters(registry);
+        locks.registerCounters(registry);
+        sampler = new PibusCounterSampler("sampler", registry, period, counters);
+        sampler->p_ck		(signal_clk);
+        sampler->p_resetn	(signal_resetn);
+    }
+    if (bustrace != NULL)
+    {
+        recorder = new PibusTraceRecorder(bustrace);
+        bcu.setTraceRecorder(recorder, &signal_opc, &signal_read);
+    }
+
+    ///////////////////////////////////////////////////////////////
+    // checkpoint
+    ///////////////////////////////////////////////////////////////
+    PibusCheckpoint	checkpoint;
+    checkpoint.add("bcu", &bcu);
+    for (size_t i = 0 ; i < nprocs ; i++)
+    {
+        char name[16];
+        snprintf(name, 16, "proc_%d", (int)i);
+        checkpoint.add(name, proc[i]);
+    }
+    checkpoint.add("ram", &ram);
+    checkpoint.add("tty", &tty);
+    checkpoint.add("timer", &timer);
+    checkpoint.add("icu", &icu);
+    checkpoint.add("dma", &dma);
+    checkpoint.add("locks", &locks);
+    checkpoint.add("bdev", &bdev);
+
+    double elab_time = wallTime() - start_time;
+
+    ///////////////////////////////////////////////////////////////
+    // simulation
+    ///////////////////////////////////////////////////////////////
+    signal_false = false;
+    signal_resetn = false;
+    sc_start(sc_time(1, SC_NS));
+    signal_resetn = true;
+
+    uint64_t first_cycle = 0;
+    if (restore_name != NULL)
+    {
+        double restore_start = wallTime();
+        first_cycle = checkpoint.restore(restore_name);
+        std::cout << std::endl << "pibus_bench : checkpoint " << restore_name 
+                  << " restored (cycle " << first_cycle << ") in " 
+                  << wallTime() - restore_start << " s" << std::endl;
+    }
+
+    double sim_start = wallTime();
+    sc_start(sc_time((double)ncycles, SC_NS));
+    double sim_time  = wallTime() - sim_start;
+
+    if (save_name != NULL)
+    {
+        // the platform is simulated cycle by cycle until
+        // all components can be checkpointed
+        uint64_t extra = 0;
+        while (not checkpoint.ready() && (extra < BENCH_CKPT_CYCLES))
+        {
+            sc_start(sc_time(1, SC_NS));
+            extra++;
+        }
+        checkpoint.save(save_name, first_cycle + ncycles + extra);
+        std::cout << std::endl << "pibus_bench : checkpoint " << save_name 
+                  << " saved (cycle " << first_cycle + ncycles + extra << ")" << std::endl;
+    }
+
+    if (recorder != NULL) recorder->close();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double speed = (sim_time > 0.0) ? (double)ncycles / sim_time : 0.0;
+
+    if (stats)
+    {
+        std::cout << std::endl;
+        bcu.printStatistics();
+        for (size_t i = 0 ; i < nprocs ; i++) proc[i]->printStatistics();
+        locks.printStatistics();
+        if (recorder != NULL) recorder->printStatistics();
+    }
+
+    std::cout << std::endl << "pibus_bench : " << workload << " / " << nprocs << " processor(s)" << std::endl;
+    std::cout << "- SIMULATED CYCLES  = " << ncycles << std::endl;
+    std::cout << "- ELABORATION TIME  = " << elab_time << " s" << std::endl;
+    std::cout << "- SIMULATION TIME   = " << sim_time << " s" << std::endl;
+    std::cout << "- SIMULATION SPEED  = " << (uint64_t)speed << " cycles/s" << std::endl;
+    std::cout << "- PEAK RSS          = " << usage.ru_maxrss << " Kbytes" << std::endl;
+    std::cout << "{ \"platform\": \"pibus_bench\", \"workload\": \"" << workload << "\""
+              << ", \"nprocs\": " << nprocs
+              << ", \"threads\": " << nthreads
+              << ", \"cycles\": " << ncycles
+              << ", \"elaboration_s\": " << elab_time
+              << ", \"simulation_s\": " << sim_time
+              << ", \"cycles_per_s\": " << (uint64_t)speed
+              << ", \"peak_rss_kb\": " << usage.ru_maxrss << " }" << std::endl;
+
+    delete recorder;
+    delete sampler;
+    delete pool;	// before the processors (jobs)
+    for (size_t i = 0 ; i < nprocs ; i++) delete proc[i];
+    delete [] proc;
+    return 0;
+} // end sc_main